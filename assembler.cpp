@@ -3,10 +3,35 @@
  */
 
 #include "assembler.h"
+#include "binary_io.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
 #include <sstream>
 #include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_map>
 #include <fstream>
 
+// Hash of the assembler's own sources, generated by the build (CMakeLists.txt).
+// A build without it falls back to the compile time: still a new ID for
+// every rebuild, just also for rebuilds that change nothing.
+#if defined(__has_include)
+#if __has_include("assembler_build_id.h")
+#include "assembler_build_id.h"
+#endif
+#endif
+#ifndef GPR_ASM_BUILD_ID
+#define GPR_ASM_BUILD_ID __DATE__ " " __TIME__
+#endif
+
 static int getOpcode(const std::string& mnem) {
     if (mnem == "HALT") return 0;
     if (mnem == "MOVI") return 1;
@@ -27,6 +52,42 @@ static int getOpcode(const std::string& mnem) {
     return -1;
 }
 
+/**
+ * Extended (opcode 15) mnemonics. `group` goes to bits 5-3; `sub` to bits 2-0
+ * unless the instruction takes Rc there. Operand forms:
+ *   '3' Rd, Rs, Rc    'd' Rd    's' Rs or label (via MOVI R7)    '-' none
+ */
+struct ExtInfo {
+    uint8_t group;
+    uint8_t sub;
+    char form;
+};
+
+static bool getExtInfo(const std::string& mnem, ExtInfo& info) {
+    static const std::map<std::string, ExtInfo> table = {
+        {"BMOV",  {1, 0, '3'}},
+        {"BFILL", {2, 0, '3'}},
+        {"CAS",   {3, 0, '3'}},
+        {"RET",   {0, 1, '-'}},
+        {"RETI",  {0, 2, '-'}},
+        {"EI",    {0, 3, '-'}},
+        {"DI",    {0, 4, '-'}},
+        {"CALL",  {0, 5, 's'}},
+        {"PUSH",  {0, 6, 'd'}},
+        {"POP",   {0, 7, 'd'}},
+        {"SETSP", {4, 0, 'd'}},
+        {"GETSP", {4, 1, 'd'}},
+        {"WFI",   {4, 2, '-'}},
+        {"CPUID", {4, 3, 'd'}},
+        {"FENCE", {4, 4, '-'}},
+        {"BRK",   {4, 7, '-'}},
+    };
+    auto it = table.find(mnem);
+    if (it == table.end()) return false;
+    info = it->second;
+    return true;
+}
+
 static char toUpperChar(char c) {
     if (c >= 'a' && c <= 'z') return static_cast<char>(c - 32);
     return c;
@@ -43,14 +104,20 @@ static uint16_t parseNumber(const std::string& s) {
     return static_cast<uint16_t>(v & 0xFFFFu);
 }
 
+/** Operand text parseNumber() accepts; anything else names a label. */
+static bool isNumber(const std::string& s) {
+    size_t i = (!s.empty() && (s[0] == '-' || s[0] == '+')) ? 1 : 0;
+    return i < s.size() && s[i] >= '0' && s[i] <= '9';
+}
+
 static bool parseReg(const std::string& s, uint8_t& r) {
     std::string t = s;
     while (t.size() >= 2 && t[0] == '(' && t.back() == ')')
         t = t.substr(1, t.size() - 2);  // (R0) -> R0
-    if (t.size() < 2 || (t[0] != 'R' && t[0] != 'r')) return false;
-    int n = std::stoi(t.substr(1), nullptr, 10);
-    if (n < 0 || n > 7) return false;
-    r = static_cast<uint8_t>(n);
+    // Exactly "R0".."R7", so labels such as ROUTINE are not mistaken for registers
+    if (t.size() != 2 || (t[0] != 'R' && t[0] != 'r')) return false;
+    if (t[1] < '0' || t[1] > '7') return false;
+    r = static_cast<uint8_t>(t[1] - '0');
     return true;
 }
 
@@ -91,25 +158,65 @@ static uint16_t encMOVI(uint8_t rd, uint16_t imm9) {
 static uint16_t encRR(uint8_t op, uint8_t rd, uint8_t rs) {
     return ((op & 15u) << 12) | ((rd & 7u) << 9) | ((rs & 7u) << 6);
 }
+static uint16_t encExt(uint8_t group, uint8_t rd, uint8_t rs, uint8_t rc) {
+    return (15u << 12) | ((rd & 7u) << 9) | ((rs & 7u) << 6) | ((group & 7u) << 3) | (rc & 7u);
+}
+
+// =============================================================================
+// PARSED PROGRAM
+// =============================================================================
+// assemble() first turns the source into Items, so the optimizer can delete
+// instructions before any address is fixed. Label operands are resolved
+// only once the final layout is known (see OBJECTS and LINKER below).
 
-AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize) {
-    AssembleResult res{true, "", 0};
-    std::map<std::string, uint16_t> labels;
+struct Item {
+    enum Kind : uint8_t { INSTR, WORD, WORD_AT, ORG, LABEL };
+    Kind kind;
+    uint16_t word;        // INSTR: encoding without the operand
+    uint16_t addr;        // ORG / WORD_AT address
+    Operand operand;
+    std::string symbol;   // LABEL: upper-case name; else operand text (label or number)
+    size_t lineNum;
+    bool removed;         // Deleted by the optimizer
+    bool global;          // LABEL named in .GLOBAL
+};
 
-    // First pass: collect labels and compute instruction addresses
-    std::istringstream iss1(source);
+static Item makeItem(Item::Kind kind, size_t lineNum) {
+    return Item{kind, 0, 0, Operand::NONE, "", lineNum, false, false};
+}
+
+static Item instrItem(uint16_t word, size_t lineNum, Operand operand = Operand::NONE, const std::string& symbol = "") {
+    Item it = makeItem(Item::INSTR, lineNum);
+    it.word = word;
+    it.operand = operand;
+    it.symbol = symbol;
+    return it;
+}
+
+static AssembleResult fail(const std::string& error, size_t lineNum) {
+    return AssembleResult{false, error, lineNum, {}};
+}
+
+/** Parse every line into `items`, checking syntax but not label values. */
+static AssembleResult parse(const std::string& source, std::vector<Item>& items) {
+    std::istringstream iss(source);
     std::string line;
     size_t lineNum = 0;
-    uint16_t pc = 0;
+    std::map<std::string, size_t> globals;   // .GLOBAL name -> line
+    bool scratchR7 = false;                  // .SCRATCH R7: long MOVIs may clobber R7
 
-    while (std::getline(iss1, line)) {
+    while (std::getline(iss, line)) {
         ++lineNum;
         std::string rest = stripComment(line);
         if (rest.empty()) continue;
 
         if (rest.back() == ':') {
             std::string name = trim(rest.substr(0, rest.size() - 1));
-            if (!name.empty()) labels[toUpper(name)] = pc;
+            if (!name.empty()) {
+                Item it = makeItem(Item::LABEL, lineNum);
+                it.symbol = toUpper(name);
+                items.push_back(it);
+            }
             continue;
         }
 
@@ -120,165 +227,1322 @@ AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize
         std::string cmd = toUpper(tok[0]);
 
         if (cmd == ".ORG") {
-            if (tok.size() < 2) {
-                res.ok = false; res.error = ".ORG requires address"; res.lineNum = lineNum;
-                return res;
-            }
-            pc = parseNumber(tok[1]);
+            if (tok.size() < 2 || !isNumber(tok[1]))
+                return fail(".ORG requires address", lineNum);
+            Item it = makeItem(Item::ORG, lineNum);
+            it.addr = parseNumber(tok[1]);
+            items.push_back(it);
             continue;
         }
         if (cmd == ".WORD") {
-            if (tok.size() == 1) {
-                res.ok = false; res.error = ".WORD requires value"; res.lineNum = lineNum;
-                return res;
-            }
-            if (tok.size() == 2) {
-                pc++;  // .WORD value at current pc
+            if (tok.size() == 1)
+                return fail(".WORD requires value", lineNum);
+            Item it = makeItem(tok.size() >= 3 ? Item::WORD_AT : Item::WORD, lineNum);
+            it.operand = Operand::DATA;
+            if (it.kind == Item::WORD_AT) {                    // .WORD addr, value
+                if (!isNumber(tok[1]))
+                    return fail(".WORD address must be a number", lineNum);
+                it.addr = parseNumber(tok[1]);
+                it.symbol = tok[2];
+            } else {                                           // .WORD value at current pc
+                it.symbol = tok[1];
             }
+            items.push_back(it);
             continue;
         }
-
-        int op = getOpcode(cmd);
-        if (op >= 0) {
-            pc++;
+        if (cmd == ".GLOBAL") {
+            if (tok.size() < 2)
+                return fail(".GLOBAL requires a label", lineNum);
+            for (size_t t = 1; t < tok.size(); ++t)
+                globals.emplace(toUpper(tok[t]), lineNum);
             continue;
         }
-        res.ok = false; res.error = "Unknown: " + cmd; res.lineNum = lineNum;
-        return res;
-    }
 
-    // Second pass: emit
-    pc = 0;
-    iss1.clear();
-    iss1.str(source);
-    lineNum = 0;
-
-    while (std::getline(iss1, line)) {
-        ++lineNum;
-        std::string rest = stripComment(line);
-        if (rest.empty()) continue;
-
-        if (rest.back() == ':') continue;
-
-        std::vector<std::string> tok;
-        tokenize(rest, tok);
-        if (tok.empty()) continue;
-
-        std::string cmd = toUpper(tok[0]);
-
-        if (cmd == ".ORG") {
-            if (tok.size() >= 2) pc = parseNumber(tok[1]);
-            continue;
-        }
-        if (cmd == ".WORD") {
-            if (tok.size() >= 2) {
-                uint16_t val = parseNumber(tok[1]);
-                if (tok.size() >= 3) {
-                    uint16_t addr = parseNumber(tok[1]);
-                    val = parseNumber(tok[2]);
-                    if (addr < memSize) mem[addr] = val;
-                } else {
-                    if (pc < memSize) mem[pc] = val;
-                    pc++;
-                }
-            }
+        if (cmd == ".SCRATCH") {
+            std::string reg = tok.size() == 2 ? toUpper(tok[1]) : "";
+            if (reg != "R7" && reg != "NONE")
+                return fail(".SCRATCH R7 or .SCRATCH NONE", lineNum);
+            scratchR7 = reg == "R7";
             continue;
         }
 
         int op = getOpcode(cmd);
-        if (op < 0) {
-            res.ok = false; res.error = "Unknown: " + cmd; res.lineNum = lineNum;
-            return res;
-        }
+        ExtInfo ext;
+        bool isExt = op < 0 && getExtInfo(cmd, ext);
+        if (op < 0 && !isExt)
+            return fail("Unknown: " + cmd, lineNum);
 
-        if (pc >= memSize) {
-            res.ok = false; res.error = "Program too large"; res.lineNum = lineNum;
-            return res;
+        if (isExt) {
+            uint8_t rd = 0, rs = 0, rc = ext.sub;
+            switch (ext.form) {
+                case '3':  // BMOV/BFILL/CAS Rd, Rs, Rc
+                    if (tok.size() < 4 || !parseReg(tok[1], rd) || !parseReg(tok[2], rs) || !parseReg(tok[3], rc))
+                        return fail(cmd + " Rd, Rs, Rc", lineNum);
+                    break;
+                case 'd':  // PUSH/POP/SETSP/GETSP/CPUID Rd
+                    if (tok.size() < 2 || !parseReg(tok[1], rd))
+                        return fail(cmd + " Rd", lineNum);
+                    break;
+                case 's':  // CALL Rs | CALL label
+                    if (tok.size() < 2)
+                        return fail("CALL needs target", lineNum);
+                    if (!parseReg(tok[1], rs)) {
+                        items.push_back(instrItem(encMOVI(7, 0), lineNum, Operand::JUMP_TARGET, tok[1]));   // MOVI R7, target
+                        rs = 7;
+                    }
+                    break;
+                default: break;
+            }
+            items.push_back(instrItem(encExt(ext.group, rd, rs, rc), lineNum));
+            continue;
         }
 
-        uint16_t inst = 0;
-
         switch (op) {
-            case 0: inst = 0x0000; break;
+            case 0: items.push_back(instrItem(0x0000, lineNum)); break;
             case 1: {
-                if (tok.size() < 3) {
-                    res.ok = false; res.error = "MOVI Rd, imm"; res.lineNum = lineNum;
-                    return res;
-                }
+                if (tok.size() < 3)
+                    return fail("MOVI Rd, imm", lineNum);
                 uint8_t rd;
-                if (!parseReg(tok[1], rd)) {
-                    res.ok = false; res.error = "Invalid register"; res.lineNum = lineNum;
-                    return res;
-                }
-                uint16_t imm;
-                std::string immStr = tok[2];
-                if (labels.count(toUpper(immStr)))
-                    imm = labels[toUpper(immStr)];
-                else
-                    imm = parseNumber(immStr);
-                imm &= 0x1FF;
-                inst = encMOVI(rd, imm);
+                if (!parseReg(tok[1], rd))
+                    return fail("Invalid register", lineNum);
+                items.push_back(instrItem(encMOVI(rd, 0), lineNum, scratchR7 ? Operand::IMM9_SCRATCH : Operand::IMM9, tok[2]));
                 break;
             }
             case 13: case 14: {  // JMP, JZ - accept label or register
-                if (tok.size() < 2) {
-                    res.ok = false; res.error = "JMP/JZ needs target"; res.lineNum = lineNum;
-                    return res;
-                }
-                std::string arg = tok[1];
+                if (tok.size() < 2)
+                    return fail("JMP/JZ needs target", lineNum);
                 uint8_t rs;
-                if (parseReg(arg, rs)) {
-                    inst = encRR(static_cast<uint8_t>(op), 0, rs);  // Rd unused
+                if (parseReg(tok[1], rs)) {
+                    items.push_back(instrItem(encRR(static_cast<uint8_t>(op), 0, rs), lineNum));  // Rd unused
                 } else {
-                    uint16_t target = labels.count(toUpper(arg)) ? labels[toUpper(arg)] : parseNumber(arg);
-                    if (target > 0x1FF) {
-                        res.ok = false;
-                        res.error = "Jump target > 511 (MOVI 9-bit limit); use register";
-                        res.lineNum = lineNum;
-                        return res;
-                    }
-                    mem[pc++] = encMOVI(7, target);       // MOVI R7, target
-                    inst = encRR(static_cast<uint8_t>(op), 0, 7);   // JMP/JZ R7
+                    items.push_back(instrItem(encMOVI(7, 0), lineNum, Operand::JUMP_TARGET, tok[1]));   // MOVI R7, target
+                    items.push_back(instrItem(encRR(static_cast<uint8_t>(op), 0, 7), lineNum));         // JMP/JZ R7
                 }
                 break;
             }
             case 2: case 3: case 4: case 5: case 6: case 7: case 8: case 9:
             case 10: case 11: case 12: {
-                if (tok.size() < 2) {
-                    res.ok = false; res.error = "Needs operands"; res.lineNum = lineNum;
-                    return res;
-                }
+                if (tok.size() < 2)
+                    return fail("Needs operands", lineNum);
                 uint8_t rd, rs = 0;
-                if (!parseReg(tok[1], rd)) {
-                    res.ok = false; res.error = "Invalid Rd"; res.lineNum = lineNum;
-                    return res;
-                }
+                if (!parseReg(tok[1], rd))
+                    return fail("Invalid Rd", lineNum);
                 if (op == 10 || op == 11 || op == 12) {
                     rs = rd;
-                } else if (tok.size() >= 3) {
-                    std::string arg = tok[2];
-                    if (parseReg(arg, rs)) { /* ok */ }
-                    else {
-                        uint16_t val = labels.count(toUpper(arg)) ? labels[toUpper(arg)] : parseNumber(arg);
-                        rs = static_cast<uint8_t>(val & 7);
-                    }
+                } else if (tok.size() >= 3 && !parseReg(tok[2], rs)) {
+                    items.push_back(instrItem(encRR(static_cast<uint8_t>(op), rd, 0), lineNum, Operand::RS_FIELD, tok[2]));
+                    break;
                 }
-                inst = encRR(static_cast<uint8_t>(op), rd, rs);
+                items.push_back(instrItem(encRR(static_cast<uint8_t>(op), rd, rs), lineNum));
                 break;
             }
-            case 15: inst = 0xF000; break;
+            case 15: items.push_back(instrItem(0xF000, lineNum)); break;
             default: break;
         }
+    }
 
-        mem[pc++] = inst;
+    for (Item& it : items)
+        if (it.kind == Item::LABEL && globals.count(it.symbol)) it.global = true;
+    for (const auto& g : globals) {
+        bool defined = std::any_of(items.begin(), items.end(),
+                                   [&](const Item& it) { return it.kind == Item::LABEL && it.symbol == g.first; });
+        if (!defined)
+            return fail("Undefined global: " + g.first, g.second);
     }
+    return AssembleResult{true, "", 0, {}};
+}
+
+// =============================================================================
+// PEEPHOLE OPTIMIZER
+// =============================================================================
+// Works on straight-line runs of instructions. A label, .ORG or .WORD ends
+// a run, since another path (or data) may meet the code there. Interrupt
+// handlers are assumed to preserve registers, as everywhere else.
+
+static uint8_t opOf(uint16_t w) { return static_cast<uint8_t>(w >> 12); }
+static uint8_t rdOf(uint16_t w) { return static_cast<uint8_t>((w >> 9) & 7u); }
+static uint8_t rsOf(uint16_t w) { return static_cast<uint8_t>((w >> 6) & 7u); }
+
+/** Extended-instruction id: group * 8 + sub-op (or -1 for a base opcode). */
+static int extOf(uint16_t w) {
+    return opOf(w) == 15 ? static_cast<int>((w >> 3) & 7u) * 8 + static_cast<int>(w & 7u) : -1;
+}
+
+static const int EXT_RET = 1, EXT_RETI = 2, EXT_CALL = 5, EXT_PUSH = 6, EXT_POP = 7;
+static const int EXT_SETSP = 32, EXT_GETSP = 33, EXT_CPUID = 35, EXT_BRK = 39;
+
+/** Control leaves the straight line here (or the machine stops). */
+static bool endsRun(uint16_t w) {
+    uint8_t op = opOf(w);
+    if (op == 0 || op == 13 || op == 14) return true;   // HALT, JMP, JZ
+    int ext = extOf(w);
+    return ext == EXT_RET || ext == EXT_RETI || ext == EXT_CALL || ext == EXT_BRK;
+}
+
+/** Execution never continues at the next word. */
+static bool unconditional(uint16_t w) {
+    int ext = extOf(w);
+    return opOf(w) == 0 || opOf(w) == 13 || ext == EXT_RET || ext == EXT_RETI;
+}
+
+/** MOV, LOAD and the ALU operations set all of Z, C and N. */
+static bool setsAllFlags(uint16_t w) {
+    uint8_t op = opOf(w);
+    return op == 2 || op == 3 || (op >= 5 && op <= 12);
+}
+
+/** Registers read by a non-branching instruction, as a bit mask. */
+static unsigned regsRead(uint16_t w) {
+    unsigned rd = 1u << rdOf(w), rs = 1u << rsOf(w);
+    uint8_t op = opOf(w);
+    if (op == 2 || op == 3 || op == 10) return rs;                       // MOV, LOAD, NOT
+    if (op == 4 || (op >= 5 && op <= 9)) return rd | rs;                 // STORE, ALU
+    if (op == 11 || op == 12) return rd;                                 // SHL, SHR
+    if (op != 15) return 0;                                              // MOVI
+    int ext = extOf(w);
+    int group = ext / 8;
+    if (group >= 1 && group <= 3) return rd | rs | (1u << (w & 7u));     // BMOV, BFILL, CAS
+    if (ext == EXT_PUSH || ext == EXT_SETSP) return rd;
+    return 0;
+}
+
+/** Register an instruction overwrites (bit mask). */
+static unsigned regsWritten(uint16_t w) {
+    unsigned rd = 1u << rdOf(w);
+    uint8_t op = opOf(w);
+    if (op == 1 || op == 2 || op == 3 || (op >= 5 && op <= 12)) return rd;
+    int ext = extOf(w);
+    if (ext == EXT_POP || ext == EXT_GETSP || ext == EXT_CPUID || ext / 8 == 3) return rd;   // CAS: Rd on failure
+    return 0;
+}
+
+/** Items that end a straight-line run: another path may arrive after them. */
+static bool isBoundary(const Item& it) {
+    return it.kind != Item::INSTR;
+}
+
+/** Label names some operand still refers to, plus exported ones. */
+static std::set<std::string> referencedLabels(const std::vector<Item>& items) {
+    std::set<std::string> names;
+    for (const Item& it : items) {
+        if (it.kind == Item::LABEL && it.global)
+            names.insert(it.symbol);
+        else if (it.kind != Item::LABEL && !it.removed && it.operand != Operand::NONE)
+            names.insert(toUpper(it.symbol));
+    }
+    return names;
+}
+
+/** Like isBoundary(), but a label nothing refers to can only be fallen into. */
+static bool isJoin(const Item& it, const std::set<std::string>& referenced) {
+    return isBoundary(it) && !(it.kind == Item::LABEL && !referenced.count(it.symbol));
+}
+
+/** Next live item after `i`, or items.size(). */
+static size_t nextLive(const std::vector<Item>& items, size_t i) {
+    while (++i < items.size() && items[i].removed) {}
+    return i;
+}
+
+/** A label of this source or an imported name, rather than a number. */
+static bool isSymbol(const std::string& text, const std::set<std::string>& labelNames) {
+    return labelNames.count(toUpper(text)) || !isNumber(text);
+}
+
+/** Key of the value a MOVI loads: "L:NAME" for a label, "#n" for a number. */
+static std::string constantKey(const Item& it, const std::set<std::string>& labelNames) {
+    if (isSymbol(it.symbol, labelNames)) return "L:" + toUpper(it.symbol);
+    return "#" + std::to_string(parseNumber(it.symbol));
+}
+
+/** A MOVI under .SCRATCH R7 whose value may exceed 511 may use R7 (see loadConstant()). */
+static bool mayUseScratch(const Item& it, const std::set<std::string>& labelNames) {
+    if (it.operand != Operand::IMM9_SCRATCH || rdOf(it.word) == 7) return false;
+    return isSymbol(it.symbol, labelNames) || parseNumber(it.symbol) > 0x1FF;
+}
+
+/** True if items[i] starts a "MOVI R7, label; JMP/JZ/CALL R7" expansion. */
+static bool isJumpPair(const std::vector<Item>& items, size_t i) {
+    return items[i].kind == Item::INSTR && !items[i].removed && items[i].operand == Operand::JUMP_TARGET &&
+           nextLive(items, i) < items.size();
+}
+
+/** FLAGS written by items[i] are overwritten before anything can read them. */
+static bool flagsDeadAfter(const std::vector<Item>& items, size_t i) {
+    for (size_t j = nextLive(items, i); j < items.size(); j = nextLive(items, j)) {
+        const Item& it = items[j];
+        if (it.kind == Item::LABEL) continue;   // Only this path's own successors matter
+        if (isBoundary(it) || endsRun(it.word) || extOf(it.word) / 8 == 3) return false;   // CAS sets Z only
+        if (setsAllFlags(it.word)) return true;
+    }
+    return false;
+}
+
+/** Register `r` is overwritten by items[i]'s successors before being read. */
+static bool regDeadAfter(const std::vector<Item>& items, size_t i, unsigned r) {
+    for (size_t j = nextLive(items, i); j < items.size(); j = nextLive(items, j)) {
+        const Item& it = items[j];
+        if (it.kind == Item::LABEL) continue;
+        if (isBoundary(it) || endsRun(it.word) || (regsRead(it.word) & (1u << r))) return false;
+        if (regsWritten(it.word) & (1u << r)) return true;
+    }
+    return false;
+}
+
+static void compact(std::vector<Item>& items) {
+    items.erase(std::remove_if(items.begin(), items.end(), [](const Item& it) { return it.removed; }), items.end());
+}
+
+/**
+ * Jump threading, jumps to the next instruction and unreachable code.
+ * Returns true if anything changed.
+ */
+static bool optimizeJumps(std::vector<Item>& items, OptimizeReport& report) {
+    std::map<std::string, size_t> labelAt;
+    for (size_t i = 0; i < items.size(); ++i)
+        if (items[i].kind == Item::LABEL) labelAt[items[i].symbol] = i;
+
+    // First instruction at or after a label, skipping further labels.
+    auto codeAt = [&](const std::string& name) -> size_t {
+        auto it = labelAt.find(toUpper(name));
+        if (it == labelAt.end()) return items.size();
+        size_t j = it->second;
+        while (j < items.size() && (items[j].kind == Item::LABEL || items[j].removed)) ++j;
+        return j;
+    };
+
+    bool changed = false;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (!isJumpPair(items, i)) continue;
+        size_t branch = nextLive(items, i);
+
+        // JMP/JZ/CALL L where L: JMP M  ->  JMP/JZ/CALL M (R7 ends up as M either way).
+        // The chain is followed first and the jump changed only if it ends
+        // elsewhere, so a cycle such as L: JMP L cannot report a change forever.
+        std::string target = items[i].symbol;
+        std::set<size_t> seen{i};
+        for (;;) {
+            size_t t = codeAt(target);
+            if (t >= items.size() || !seen.insert(t).second || !isJumpPair(items, t)) break;
+            size_t tb = nextLive(items, t);
+            if (items[tb].kind != Item::INSTR || opOf(items[tb].word) != 13 || rsOf(items[tb].word) != 7) break;
+            target = items[t].symbol;
+        }
+        if (toUpper(target) != toUpper(items[i].symbol)) {
+            items[i].symbol = target;
+            ++report.jumpsThreaded;
+            changed = true;
+        }
+
+        // JMP/JZ to the very next instruction: drop the pair.
+        uint8_t op = opOf(items[branch].word);
+        if (op == 13 || op == 14) {
+            size_t after = nextLive(items, branch);
+            for (size_t j = after; j < items.size() && (items[j].kind == Item::LABEL || items[j].removed); ++j) {
+                if (!items[j].removed && items[j].symbol == toUpper(items[i].symbol)) {
+                    items[i].removed = items[branch].removed = true;
+                    report.jumpsRemoved += 2;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Instructions after an unconditional transfer, up to a label in use.
+    std::set<std::string> referenced = referencedLabels(items);
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].removed || items[i].kind != Item::INSTR || !unconditional(items[i].word)) continue;
+        for (size_t j = i + 1; j < items.size() && !isJoin(items[j], referenced); ++j) {
+            if (!items[j].removed) {
+                items[j].removed = true;
+                ++report.unreachableRemoved;
+                changed = true;
+            }
+        }
+    }
+    compact(items);
+    return changed;
+}
+
+/**
+ * Redundant loads: a MOVI of the constant a register already holds, and a
+ * MOV whose result is already in Rd (kept if its flags could be read).
+ * Registers carry value numbers: a constant key from constantKey(), or a
+ * fresh "?n" for each value nothing more is known about, which MOV copies.
+ */
+static void removeRedundantLoads(std::vector<Item>& items, OptimizeReport& report) {
+    std::set<std::string> labelNames;
+    for (const Item& it : items)
+        if (it.kind == Item::LABEL) labelNames.insert(it.symbol);
+    std::set<std::string> referenced = referencedLabels(items);
+
+    std::string known[8];
+    size_t nextValue = 0;
+    auto unknown = [&]() { return "?" + std::to_string(nextValue++); };
+    auto forgetAll = [&]() { for (std::string& k : known) k = unknown(); };
+    forgetAll();
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        Item& it = items[i];
+        if (isJoin(it, referenced)) {
+            forgetAll();
+            continue;
+        }
+        if (isBoundary(it)) continue;
+        uint16_t w = it.word;
+        uint8_t rd = rdOf(w), rs = rsOf(w);
+        if (opOf(w) == 1 && it.operand != Operand::NONE) {
+            std::string key = constantKey(it, labelNames);
+            if (known[rd] == key) {
+                it.removed = true;
+                ++report.loadsRemoved;
+            }
+            known[rd] = key;
+            if (!it.removed && mayUseScratch(it, labelNames))
+                known[7] = unknown();
+        } else if (opOf(w) == 2) {
+            if (known[rd] == known[rs] && flagsDeadAfter(items, i)) {
+                it.removed = true;
+                ++report.movesRemoved;
+            }
+            known[rd] = known[rs];
+        } else {
+            unsigned written = regsWritten(w);
+            for (unsigned r = 0; r < 8; ++r)
+                if (written & (1u << r)) known[r] = unknown();
+        }
+        // The callee may change any register; other run ends start a new run.
+        if (endsRun(w) && opOf(w) != 14)
+            forgetAll();
+    }
+    compact(items);
+}
+
+/** MOVIs whose register is overwritten before it is read. */
+static void removeDeadLoads(std::vector<Item>& items, OptimizeReport& report) {
+    for (size_t i = 0; i < items.size(); ++i) {
+        Item& it = items[i];
+        if (it.kind == Item::INSTR && opOf(it.word) == 1 && regDeadAfter(items, i, rdOf(it.word))) {
+            it.removed = true;
+            ++report.loadsRemoved;
+        }
+    }
+    compact(items);
+}
+
+static size_t countWords(const std::vector<Item>& items) {
+    size_t n = 0;
+    for (const Item& it : items)
+        if (it.kind == Item::INSTR || it.kind == Item::WORD) ++n;
+    return n;
+}
+
+static void optimize(std::vector<Item>& items, OptimizeReport& report) {
+    report.wordsBefore = countWords(items);
+    while (optimizeJumps(items, report)) {}
+    // Constants are only tracked once the jumps are final: threading or
+    // dropping a jump changes what R7 holds afterwards.
+    removeRedundantLoads(items, report);
+    removeDeadLoads(items, report);
+    report.wordsAfter = countWords(items);
+}
+
+// =============================================================================
+// CONSTANT SYNTHESIS
+// =============================================================================
+// MOVI holds 9 bits. Larger values are built from a MOVI and single-register
+// steps (SHL, SHR, NOT Rd, Rd). A breadth-first search over all 65536 values
+// gives the shortest such chain for each; it is run once and shared.
+
+namespace {
+
+struct ChainTable {
+    enum Step : uint8_t { MOVI_STEP, SHL_STEP, SHR_STEP, NOT_STEP };
+    std::vector<uint8_t> cost;       // Words in the shortest chain
+    std::vector<uint16_t> prev;      // Value before the last step
+    std::vector<uint8_t> step;
+    std::vector<uint16_t> byCost;    // All values, cheapest first
+
+    ChainTable() : cost(65536, 0xFF), prev(65536, 0), step(65536, MOVI_STEP) {
+        for (uint32_t v = 0; v <= 0x1FF; ++v) {
+            cost[v] = 1;
+            byCost.push_back(static_cast<uint16_t>(v));
+        }
+        // byCost doubles as the BFS queue: values enter in cost order.
+        for (size_t head = 0; head < byCost.size(); ++head) {
+            uint16_t x = byCost[head];
+            const uint16_t next[3] = {static_cast<uint16_t>(x << 1), static_cast<uint16_t>(x >> 1),
+                                      static_cast<uint16_t>(~x)};
+            const Step how[3] = {SHL_STEP, SHR_STEP, NOT_STEP};
+            for (int k = 0; k < 3; ++k) {
+                if (cost[next[k]] != 0xFF) continue;
+                cost[next[k]] = static_cast<uint8_t>(cost[x] + 1);
+                prev[next[k]] = x;
+                step[next[k]] = how[k];
+                byCost.push_back(next[k]);
+            }
+        }
+    }
+
+    void append(std::vector<uint16_t>& out, uint8_t r, uint16_t v) const {
+        std::vector<uint16_t> rev;
+        for (; step[v] != MOVI_STEP; v = prev[v]) {
+            uint8_t op = step[v] == SHL_STEP ? 11 : step[v] == SHR_STEP ? 12 : 10;
+            rev.push_back(encRR(op, r, r));
+        }
+        out.push_back(encMOVI(r, v));
+        out.insert(out.end(), rev.rbegin(), rev.rend());
+    }
+};
+
+const ChainTable& chains() {
+    static const ChainTable table;
+    return table;
+}
+
+} // namespace
+
+std::vector<uint16_t> loadConstant(uint8_t rd, uint16_t value, bool scratchR7) {
+    const ChainTable& t = chains();
+    rd &= 7u;
+    // Relaxation asks again for every constant each round; remember answers.
+    // The memo is shared, since the linker sizes objects on several threads.
+    static std::mutex memoLock;
+    static std::unordered_map<uint32_t, std::vector<uint16_t>> memo;
+    uint32_t key = value | (static_cast<uint32_t>(rd) << 16) | (scratchR7 ? 1u << 19 : 0u);
+    {
+        std::lock_guard<std::mutex> guard(memoLock);
+        auto hit = memo.find(key);
+        if (hit != memo.end()) return hit->second;
+    }
+
+    unsigned best = t.cost[value];
+    int bestOp = -1;
+    uint16_t bestA = 0, bestB = 0;
+    if (scratchR7 && rd != 7) {
+        // value = a OP b with b built in R7 and a in Rd. Try every b that
+        // could still beat the best so far, cheapest first.
+        static const uint8_t ops[5] = {5, 6, 9, 8, 7};   // ADD, SUB, XOR, OR, AND
+        for (uint16_t b : t.byCost) {
+            if (t.cost[b] + 2u >= best) break;
+            for (uint8_t op : ops) {
+                uint16_t a = 0, r = 0;
+                switch (op) {
+                    case 5: a = static_cast<uint16_t>(value - b); r = static_cast<uint16_t>(a + b); break;
+                    case 6: a = static_cast<uint16_t>(value + b); r = static_cast<uint16_t>(a - b); break;
+                    case 9: a = static_cast<uint16_t>(value ^ b); r = static_cast<uint16_t>(a ^ b); break;
+                    case 8: a = static_cast<uint16_t>(value & ~b); r = static_cast<uint16_t>(a | b); break;
+                    default: a = static_cast<uint16_t>(value | ~b); r = static_cast<uint16_t>(a & b); break;
+                }
+                unsigned c = t.cost[a] + t.cost[b] + 1u;
+                if (r == value && c < best) {
+                    best = c;
+                    bestOp = op;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+    }
+    std::vector<uint16_t> out;
+    if (bestOp < 0) {
+        t.append(out, rd, value);
+    } else {
+        t.append(out, 7, bestB);
+        t.append(out, rd, bestA);
+        out.push_back(encRR(static_cast<uint8_t>(bestOp), rd, 7));
+    }
+    std::lock_guard<std::mutex> guard(memoLock);
+    memo.emplace(key, out);
+    return out;
+}
+
+
+// =============================================================================
+// OBJECTS
+// =============================================================================
+// An object is the parsed program with label operands left symbolic: each
+// operand naming a label becomes a relocation against the symbol table,
+// and numbers are folded in now.
+
+static void toObject(const std::vector<Item>& items, ObjectFile& object) {
+    object.items.clear();
+    object.symbols.clear();
+    object.relocations.clear();
+    std::map<std::string, uint32_t> index;
+    auto symbolIndex = [&](const std::string& name) {
+        auto found = index.find(name);
+        if (found != index.end()) return found->second;
+        uint32_t k = static_cast<uint32_t>(object.symbols.size());
+        object.symbols.push_back(ObjectSymbol{name, false, false});
+        index.emplace(name, k);
+        return k;
+    };
+    for (const Item& it : items) {
+        if (it.kind != Item::LABEL) continue;
+        ObjectSymbol& sym = object.symbols[symbolIndex(it.symbol)];
+        sym.defined = true;
+        sym.global = sym.global || it.global;
+    }
+
+    for (const Item& it : items) {
+        ObjectItem out{static_cast<ObjectItem::Kind>(it.kind), it.operand, it.word, it.addr, 0,
+                       static_cast<uint32_t>(it.lineNum)};
+        if (it.kind == Item::LABEL) {
+            out.value = symbolIndex(it.symbol);
+        } else if (it.operand != Operand::NONE) {
+            // A label wins over a number, as in the absolute assembler.
+            std::string name = toUpper(it.symbol);
+            auto found = index.find(name);
+            if ((found != index.end() && object.symbols[found->second].defined) || !isNumber(it.symbol))
+                object.relocations.push_back(Relocation{static_cast<uint32_t>(object.items.size()), symbolIndex(name)});
+            else
+                out.value = parseNumber(it.symbol);
+        }
+        object.items.push_back(out);
+    }
+}
+
+AssembleResult assembleObject(const std::string& source, ObjectFile& object, const AssembleOptions& options) {
+    std::vector<Item> items;
+    AssembleResult res = parse(source, items);
+    if (!res.ok) return res;
+    if (options.optimize)
+        optimize(items, res.report);
+    toObject(items, object);
+    return res;
+}
+
+// =============================================================================
+// LINKER
+// =============================================================================
+// Objects are laid out one after another. A constant above 511 takes
+// several words, which moves every later label, which can make another
+// constant longer. Sizes only ever grow, so the layout settles after a few
+// rounds (relaxation). Each round assigns addresses in order, which is
+// cheap, then sizes every object's operands in parallel.
+
+/** Below this many items in total, threads cost more than they save. */
+static constexpr size_t PARALLEL_MIN_ITEMS = 4096;
+
+static constexpr uint32_t NOT_IMPORTED = 0xFFFFFFFFu;
+
+namespace {
+
+/** One object being linked. */
+struct LinkUnit {
+    const ObjectFile* object;
+    std::vector<int32_t> relocOf;                              // Item -> symbol, or -1
+    std::vector<std::pair<uint32_t, uint32_t>> importFrom;     // Symbol -> (unit, symbol) exporting it
+    std::vector<uint16_t> symbolAddr;
+    std::vector<uint8_t> size;                                 // Words per item
+    std::vector<std::vector<uint16_t>> code;
+    std::vector<std::vector<uint16_t>> before;                 // Long constants hoisted in front of an item
+    std::vector<std::vector<uint32_t>> beforeLines;            // Source line of each hoisted word
+    uint32_t start;                                            // Address where the object begins
+};
+
+} // namespace
+
+/** Run fn(0) .. fn(n - 1) on up to `threads` threads (0 = one per CPU). */
+static void parallelFor(size_t n, unsigned threads, const std::function<void(size_t)>& fn) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads > n) threads = static_cast<unsigned>(n);
+    if (threads <= 1) {
+        for (size_t k = 0; k < n; ++k) fn(k);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t)
+        pool.emplace_back([&]() {
+            for (size_t k; (k = next++) < n;) fn(k);
+        });
+    for (std::thread& th : pool) th.join();
+}
+
+static AssembleResult linkError(const LinkUnit& u, const std::string& error, size_t lineNum) {
+    const std::string& name = u.object->name;
+    return fail(name.empty() ? error : name + ": " + error, lineNum);
+}
+
+static uint16_t operandValue(const LinkUnit& u, size_t i) {
+    int32_t sym = u.relocOf[i];
+    return sym >= 0 ? u.symbolAddr[static_cast<size_t>(sym)] : static_cast<uint16_t>(u.object->items[i].value);
+}
+
+/** Words for one instruction item, before padding. */
+static std::vector<uint16_t> encodeItem(const ObjectItem& it, uint16_t val) {
+    if (it.operand == Operand::NONE)
+        return {it.word};
+    if (it.operand == Operand::RS_FIELD)
+        return {static_cast<uint16_t>(it.word | ((val & 7u) << 6))};
+    if (val <= 0x1FF)
+        return {static_cast<uint16_t>(it.word | val)};
+    // Only a MOVI the source allowed (.SCRATCH R7) may borrow R7.
+    return loadConstant(rdOf(it.word), val, it.operand == Operand::IMM9_SCRATCH);
+}
+
+static uint8_t encodedSize(const ObjectItem& it, uint16_t val) {
+    if (it.operand == Operand::RS_FIELD || val <= 0x1FF) return 1;
+    if (it.operand != Operand::IMM9_SCRATCH || rdOf(it.word) == 7) return chains().cost[val];   // One chain, no scratch
+    return static_cast<uint8_t>(loadConstant(rdOf(it.word), val, true).size());
+}
+
+/** Addresses for the current sizes; imports take their exporter's address. */
+static void layout(std::vector<LinkUnit>& units) {
+    uint32_t pc = 0;
+    for (LinkUnit& u : units) {
+        u.start = pc;
+        const std::vector<ObjectItem>& items = u.object->items;
+        for (size_t i = 0; i < items.size(); ++i) {
+            switch (items[i].kind) {
+                case ObjectItem::ORG:   pc = items[i].addr; break;
+                case ObjectItem::LABEL: u.symbolAddr[items[i].value] = static_cast<uint16_t>(pc); break;
+                case ObjectItem::INSTR: case ObjectItem::WORD: pc += u.size[i]; break;
+                default: break;
+            }
+        }
+    }
+    for (LinkUnit& u : units)
+        for (size_t s = 0; s < u.symbolAddr.size(); ++s)
+            if (u.importFrom[s].first != NOT_IMPORTED)
+                u.symbolAddr[s] = units[u.importFrom[s].first].symbolAddr[u.importFrom[s].second];
+}
+
+/**
+ * Size each operand for the current layout: grow only, or (exact) set
+ * every size to what it needs now. Returns true if a size changed.
+ */
+static bool resize(LinkUnit& u, bool exact) {
+    const std::vector<ObjectItem>& items = u.object->items;
+    bool changed = false;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].kind != ObjectItem::INSTR || items[i].operand == Operand::NONE) continue;
+        uint8_t need = encodedSize(items[i], operandValue(u, i));
+        if (exact ? need != u.size[i] : need > u.size[i]) {
+            u.size[i] = need;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * A multi-word constant changes FLAGS. True if a JZ later in the same
+ * straight line would read flags set before items[i].
+ */
+static bool flagsReadAfter(const std::vector<ObjectItem>& items, const std::vector<std::vector<uint16_t>>& code, size_t i) {
+    for (size_t j = i + 1; j < items.size(); ++j) {
+        const ObjectItem& it = items[j];
+        if (it.kind == ObjectItem::LABEL) continue;
+        if (it.kind != ObjectItem::INSTR) return false;
+        if (opOf(it.word) == 14) return true;
+        if (code[j].size() > 1) continue;   // Another long constant: hoisted too
+        if (setsAllFlags(it.word) || endsRun(it.word) || extOf(it.word) / 8 == 3) return false;
+    }
+    return false;
+}
+
+/**
+ * Where the long constant at items[i] can move so the flags a later JZ
+ * reads are set after it: before the instruction that sets them, if
+ * nothing in between touches the registers the sequence writes. -1 if
+ * there is no such place.
+ */
+static long hoistPoint(const std::vector<ObjectItem>& items, const std::vector<std::vector<uint16_t>>& code,
+                       const std::vector<uint8_t>& size, size_t i) {
+    unsigned uses = 0;
+    for (uint16_t w : code[i]) uses |= regsWritten(w);
+    for (size_t j = i; j-- > 0;) {
+        const ObjectItem& it = items[j];
+        if (it.kind != ObjectItem::INSTR) return -1;   // Another path may join here
+        if (size[j] > 1 && it.operand != Operand::NONE) continue;   // Long constant: moved the same way
+        if ((regsRead(it.word) | regsWritten(it.word)) & uses) return -1;
+        if (opOf(it.word) == 14 && (uses & (1u << rsOf(it.word)))) return -1;
+        if (setsAllFlags(it.word) || extOf(it.word) / 8 == 3) return static_cast<long>(j);
+        if (endsRun(it.word) && opOf(it.word) != 14) return -1;
+    }
+    return -1;
+}
+
+/** Final words of one object. A constant that shrank since its size was fixed is padded with NOPs in front. */
+static AssembleResult encodeUnit(LinkUnit& u) {
+    const std::vector<ObjectItem>& items = u.object->items;
+    u.code.assign(items.size(), {});
+    u.before.assign(items.size(), {});
+    u.beforeLines.assign(items.size(), {});
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].kind != ObjectItem::INSTR) continue;
+        u.code[i] = encodeItem(items[i], operandValue(u, i));
+        u.code[i].insert(u.code[i].begin(), u.size[i] - u.code[i].size(), 0xF000);
+    }
+
+    // Move long constants above the flag setting a later JZ depends on.
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (u.code[i].size() <= 1 || items[i].operand == Operand::NONE || !flagsReadAfter(items, u.code, i)) continue;
+        long j = hoistPoint(items, u.code, u.size, i);
+        if (j < 0)
+            return linkError(u, "Constant > 511 changes FLAGS read by a later JZ; load it before the instruction that sets them",
+                             items[i].lineNum);
+        u.before[j].insert(u.before[j].end(), u.code[i].begin(), u.code[i].end());
+        u.beforeLines[j].insert(u.beforeLines[j].end(), u.code[i].size(), items[i].lineNum);
+        u.code[i].clear();
+    }
+    return AssembleResult{true, "", 0, {}};
+}
+
+/** Every word must land in memory, and no two objects may share one. */
+static AssembleResult checkPlacement(const std::vector<LinkUnit>& units, size_t memSize) {
+    struct Run { uint32_t start, end; size_t unit; };
+    std::vector<Run> runs;
+    for (size_t k = 0; k < units.size(); ++k) {
+        const LinkUnit& u = units[k];
+        const std::vector<ObjectItem>& items = u.object->items;
+        uint32_t pc = u.start, runStart = pc;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (items[i].kind == ObjectItem::ORG) {
+                if (pc > runStart) runs.push_back(Run{runStart, pc, k});
+                pc = runStart = items[i].addr;
+            } else if (items[i].kind == ObjectItem::INSTR || items[i].kind == ObjectItem::WORD) {
+                pc += u.size[i];
+                if (pc > memSize)
+                    return linkError(u, "Program too large", items[i].lineNum);
+            }
+        }
+        if (pc > runStart) runs.push_back(Run{runStart, pc, k});
+    }
+    std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) { return a.start < b.start; });
+    // Compare each run with the furthest-reaching run before it, not just
+    // its neighbour: one long run can cover several shorter ones.
+    Run reach{0, 0, 0};
+    for (const Run& b : runs) {
+        if (b.start < reach.end && reach.unit != b.unit) {
+            std::ostringstream msg;
+            msg << "Overlaps " << (units[reach.unit].object->name.empty() ? "another object" : units[reach.unit].object->name)
+                << " at 0x" << std::hex << b.start;
+            return linkError(units[b.unit], msg.str(), 0);
+        }
+        if (b.end > reach.end) reach = b;
+    }
+    return AssembleResult{true, "", 0, {}};
+}
+
+static void emitUnit(const LinkUnit& u, uint16_t* mem) {
+    const std::vector<ObjectItem>& items = u.object->items;
+    uint32_t pc = u.start;
+    for (size_t i = 0; i < items.size(); ++i) {
+        switch (items[i].kind) {
+            case ObjectItem::ORG:
+                pc = items[i].addr;
+                break;
+            case ObjectItem::WORD:
+                mem[pc++] = operandValue(u, i);
+                break;
+            case ObjectItem::INSTR:
+                for (uint16_t w : u.before[i]) mem[pc++] = w;
+                for (uint16_t w : u.code[i]) mem[pc++] = w;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/** Source lines of every word the object placed, and its labels. */
+static void recordDebugInfo(const LinkUnit& u, DebugMap& map) {
+    const std::vector<ObjectItem>& items = u.object->items;
+    uint16_t file = map.addFile(u.object->source.empty() ? u.object->name : u.object->source);
+    uint32_t pc = u.start;
+    for (size_t i = 0; i < items.size(); ++i) {
+        const ObjectItem& it = items[i];
+        switch (it.kind) {
+            case ObjectItem::ORG:
+                pc = it.addr;
+                break;
+            case ObjectItem::WORD:
+                map.setLine(static_cast<uint16_t>(pc++), file, it.lineNum, true);
+                break;
+            case ObjectItem::WORD_AT:
+                map.setLine(it.addr, file, it.lineNum, true);
+                break;
+            case ObjectItem::INSTR:
+                for (uint32_t line : u.beforeLines[i]) map.setLine(static_cast<uint16_t>(pc++), file, line);
+                for (size_t k = 0; k < u.code[i].size(); ++k) map.setLine(static_cast<uint16_t>(pc++), file, it.lineNum);
+                break;
+            default:
+                break;
+        }
+    }
+    for (size_t s = 0; s < u.object->symbols.size(); ++s)
+        if (u.object->symbols[s].defined) map.addLabel(u.symbolAddr[s], u.object->symbols[s].name);
+}
+
+AssembleResult link(const std::vector<const ObjectFile*>& objects, uint16_t* mem, size_t memSize, const LinkOptions& options) {
+    std::vector<LinkUnit> units(objects.size());
+    size_t totalItems = 0;
+    for (size_t k = 0; k < objects.size(); ++k) {
+        LinkUnit& u = units[k];
+        u.object = objects[k];
+        u.relocOf.assign(u.object->items.size(), -1);
+        for (const Relocation& r : u.object->relocations)
+            u.relocOf[r.item] = static_cast<int32_t>(r.symbol);
+        u.importFrom.assign(u.object->symbols.size(), {NOT_IMPORTED, 0});
+        u.symbolAddr.assign(u.object->symbols.size(), 0);
+        u.size.assign(u.object->items.size(), 0);
+        for (size_t i = 0; i < u.object->items.size(); ++i) {
+            ObjectItem::Kind kind = u.object->items[i].kind;
+            if (kind == ObjectItem::INSTR || kind == ObjectItem::WORD) u.size[i] = 1;
+        }
+        totalItems += u.object->items.size();
+    }
+
+    // Symbol resolution: each global has one exporter; every import needs one.
+    std::map<std::string, std::pair<uint32_t, uint32_t>> exports;
+    for (size_t k = 0; k < units.size(); ++k) {
+        const std::vector<ObjectSymbol>& symbols = units[k].object->symbols;
+        for (size_t s = 0; s < symbols.size(); ++s) {
+            if (!symbols[s].global) continue;
+            auto added = exports.emplace(symbols[s].name, std::make_pair(static_cast<uint32_t>(k), static_cast<uint32_t>(s)));
+            if (!added.second) {
+                const std::string& first = units[added.first->second.first].object->name;
+                return linkError(units[k], "Duplicate global " + symbols[s].name +
+                                 (first.empty() ? "" : " (also in " + first + ")"), 0);
+            }
+        }
+    }
+    for (LinkUnit& u : units) {
+        for (const Relocation& r : u.object->relocations) {
+            const ObjectSymbol& sym = u.object->symbols[r.symbol];
+            if (sym.defined) continue;
+            auto found = exports.find(sym.name);
+            if (found == exports.end())
+                return linkError(u, "Undefined symbol: " + sym.name, u.object->items[r.item].lineNum);
+            u.importFrom[r.symbol] = found->second;
+        }
+    }
+
+    unsigned workers = totalItems >= PARALLEL_MIN_ITEMS ? options.threads : 1;
+    std::vector<uint8_t> changed(units.size());
+    auto relax = [&](bool exact) {
+        layout(units);
+        parallelFor(units.size(), workers, [&](size_t k) { changed[k] = resize(units[k], exact); });
+        return std::find(changed.begin(), changed.end(), 1) != changed.end();
+    };
+
+    // Relaxation: start every instruction at one word and grow until stable.
+    while (relax(false)) {}
+
+    // Costs do not grow with the value, so some constants may now fit in
+    // fewer words. Try exact sizes; keep them only if they settle.
+    std::vector<std::vector<uint8_t>> grown;
+    for (const LinkUnit& u : units) grown.push_back(u.size);
+    bool settled = false;
+    for (int round = 0; round < 8 && !settled; ++round)
+        settled = !relax(true);
+    if (!settled)
+        for (size_t k = 0; k < units.size(); ++k) units[k].size = grown[k];
+    layout(units);
+
+    AssembleResult placed = checkPlacement(units, memSize);
+    if (!placed.ok) return placed;
+
+    std::vector<AssembleResult> encoded(units.size());
+    parallelFor(units.size(), workers, [&](size_t k) {
+        encoded[k] = encodeUnit(units[k]);
+        if (encoded[k].ok) emitUnit(units[k], mem);
+    });
+    for (const AssembleResult& r : encoded)
+        if (!r.ok) return r;
+
+    // .WORD addr, value lands last, in object order (e.g. interrupt vectors).
+    for (const LinkUnit& u : units) {
+        const std::vector<ObjectItem>& items = u.object->items;
+        for (size_t i = 0; i < items.size(); ++i)
+            if (items[i].kind == ObjectItem::WORD_AT && items[i].addr < memSize)
+                mem[items[i].addr] = operandValue(u, i);
+    }
+    if (options.debugMap)
+        for (const LinkUnit& u : units) recordDebugInfo(u, *options.debugMap);
+    return AssembleResult{true, "", 0, {}};
+}
+
+/** Link a single assembled object, keeping the optimizer report. */
+static AssembleResult linkAssembled(const ObjectFile& object, const AssembleResult& assembled, uint16_t* mem,
+                                    size_t memSize, const AssembleOptions& options) {
+    LinkOptions linkOptions;
+    linkOptions.debugMap = options.debugMap;
+    AssembleResult linked = link({&object}, mem, memSize, linkOptions);
+    linked.report = assembled.report;
+    return linked;
+}
+
+AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize, const AssembleOptions& options) {
+    ObjectFile object;
+    AssembleResult res = assembleObject(source, object, options);
+    if (!res.ok) return res;
+    return linkAssembled(object, res, mem, memSize, options);
+}
+
+static AssembleResult assembleFileCached(const char* path, uint16_t* mem, size_t memSize,
+                                         const AssembleOptions& options);
+
+AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize, const AssembleOptions& options) {
+    if (!options.cacheDir.empty()) return assembleFileCached(path, mem, memSize, options);
+    ObjectFile object;
+    AssembleResult res = assembleObjectFile(path, object, options);
+    if (!res.ok) return res;
+    object.name.clear();   // A single file: errors carry just the line
+    return linkAssembled(object, res, mem, memSize, options);
+}
+
+AssembleResult assembleObjectFile(const char* path, ObjectFile& object, const AssembleOptions& options) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return AssembleResult{false, "Cannot open file", 0, {}};
+    std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    AssembleResult res = assembleObject(source, object, options);
+    object.name = object.source = path;
     return res;
 }
 
-AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize) {
+// =============================================================================
+// OBJECT FILES
+// =============================================================================
+
+static const char OBJECT_MAGIC[8] = {'G', 'P', 'R', '1', '6', 'O', 'B', 'J'};
+
+AssembleResult saveObject(const char* path, const ObjectFile& object) {
+    std::vector<uint8_t> out(OBJECT_MAGIC, OBJECT_MAGIC + sizeof(OBJECT_MAGIC));
+    put32(out, OBJECT_VERSION);
+    put32(out, static_cast<uint32_t>(object.symbols.size()));
+    put32(out, static_cast<uint32_t>(object.items.size()));
+    put32(out, static_cast<uint32_t>(object.relocations.size()));
+    size_t sourceLength = std::min<size_t>(object.source.size(), 0xFFFF);
+    put16(out, static_cast<uint16_t>(sourceLength));
+    out.insert(out.end(), object.source.begin(), object.source.begin() + static_cast<std::ptrdiff_t>(sourceLength));
+    for (const ObjectSymbol& sym : object.symbols) {
+        out.push_back(sym.defined ? 1 : 0);
+        out.push_back(sym.global ? 1 : 0);
+        put16(out, static_cast<uint16_t>(sym.name.size()));
+        out.insert(out.end(), sym.name.begin(), sym.name.end());
+    }
+    for (const ObjectItem& it : object.items) {
+        out.push_back(static_cast<uint8_t>(it.kind));
+        out.push_back(static_cast<uint8_t>(it.operand));
+        put16(out, it.word);
+        put16(out, it.addr);
+        put32(out, it.value);
+        put32(out, it.lineNum);
+    }
+    for (const Relocation& r : object.relocations) {
+        put32(out, r.item);
+        put32(out, r.symbol);
+    }
+    put32(out, fnv1a32(out.data(), out.size()));
+
+    std::string error;
+    if (!replaceFile(path, std::string(path) + ".tmp", out, false, error))
+        return AssembleResult{false, error, 0, {}};
+    return AssembleResult{true, "", 0, {}};
+}
+
+/** Decode and validate an object image; any bad count or index rejects it. */
+static bool decodeObject(const uint8_t* p, size_t n, ObjectFile& object) {
+    const uint8_t* end = p + n;
+    auto need = [&](size_t bytes) { return static_cast<size_t>(end - p) >= bytes; };
+    if (!need(26)) return false;
+    uint32_t symbols = get32(p + 12), items = get32(p + 16), relocations = get32(p + 20);
+    uint16_t sourceLength = get16(p + 24);
+    p += 26;
+    if (!need(sourceLength)) return false;
+    object.source.assign(reinterpret_cast<const char*>(p), sourceLength);
+    p += sourceLength;
+
+    object.symbols.clear();
+    for (uint32_t s = 0; s < symbols; ++s) {
+        if (!need(4)) return false;
+        uint16_t len = get16(p + 2);
+        if (!need(4u + len) || len == 0) return false;
+        object.symbols.push_back(ObjectSymbol{std::string(reinterpret_cast<const char*>(p + 4), len), p[0] != 0, p[1] != 0});
+        p += 4 + len;
+    }
+    if (!need(static_cast<size_t>(items) * 14)) return false;
+    object.items.clear();
+    for (uint32_t i = 0; i < items; ++i, p += 14) {
+        ObjectItem it{static_cast<ObjectItem::Kind>(p[0]), static_cast<Operand>(p[1]), get16(p + 2), get16(p + 4),
+                      get32(p + 6), get32(p + 10)};
+        if (p[0] > ObjectItem::LABEL || p[1] > static_cast<uint8_t>(Operand::IMM9_SCRATCH)) return false;
+        if (it.kind == ObjectItem::LABEL && (it.value >= symbols || !object.symbols[it.value].defined)) return false;
+        object.items.push_back(it);
+    }
+    if (!need(static_cast<size_t>(relocations) * 8)) return false;
+    object.relocations.clear();
+    for (uint32_t r = 0; r < relocations; ++r, p += 8) {
+        Relocation rel{get32(p), get32(p + 4)};
+        if (rel.item >= items || rel.symbol >= symbols) return false;
+        const ObjectItem& it = object.items[rel.item];
+        if (it.kind == ObjectItem::LABEL || it.kind == ObjectItem::ORG || it.operand == Operand::NONE) return false;
+        object.relocations.push_back(rel);
+    }
+    return p == end;
+}
+
+AssembleResult loadObject(const char* path, ObjectFile& object) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return AssembleResult{false, std::string("cannot open ") + path, 0, {}};
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < 30 || std::memcmp(data.data(), OBJECT_MAGIC, sizeof(OBJECT_MAGIC)) != 0)
+        return AssembleResult{false, std::string(path) + " is not an object file", 0, {}};
+    if (get32(data.data() + 8) != OBJECT_VERSION)
+        return AssembleResult{false, std::string(path) + ": unsupported object version", 0, {}};
+    size_t body = data.size() - 4;
+    if (get32(data.data() + body) != fnv1a32(data.data(), body) || !decodeObject(data.data(), body, object))
+        return AssembleResult{false, std::string(path) + " is corrupt", 0, {}};
+    object.name = path;
+    return AssembleResult{true, "", 0, {}};
+}
+
+bool isObjectFile(const char* path) {
+    char head[sizeof(OBJECT_MAGIC)] = {};
+    std::ifstream in(path, std::ios::binary);
+    return in.read(head, sizeof(head)) && std::memcmp(head, OBJECT_MAGIC, sizeof(OBJECT_MAGIC)) == 0;
+}
+
+// =============================================================================
+// ASSEMBLY CACHE
+// =============================================================================
+
+static const char CACHE_MAGIC[8] = {'G', 'P', 'R', '1', '6', 'A', 'S', 'C'};
+
+/** Bytes before the runs: magic, version, key and the seven report counts. */
+static constexpr size_t CACHE_HEADER = 8 + 4 + 8 + 7 * 4;
+
+/** Addresses a DebugMap (and so a cached image) covers. */
+static constexpr size_t CACHE_ADDRESSES = 65536;
+
+/** Per cached word: the word, u16 file (bit 15 = data), u32 line. */
+static constexpr size_t CACHE_WORD_BYTES = 8;
+
+/** Temporary files left this long (by a process that died mid-write) are removed. */
+static constexpr auto CACHE_STALE_TMP = std::chrono::hours(1);
+
+static uint64_t cacheKey(const char* path, const std::string& source, size_t memSize, const AssembleOptions& options) {
+    std::vector<uint8_t> head(CACHE_MAGIC, CACHE_MAGIC + sizeof(CACHE_MAGIC));
+    put32(head, CACHE_VERSION);
+    head.insert(head.end(), GPR_ASM_BUILD_ID, GPR_ASM_BUILD_ID + sizeof(GPR_ASM_BUILD_ID));
+    head.push_back(options.optimize ? 1 : 0);
+    put32(head, static_cast<uint32_t>(std::min<size_t>(memSize, 0xFFFFFFFFu)));
+    uint64_t h = fnv1a64(head.data(), head.size());
+    h = fnv1a64(path, std::strlen(path) + 1, h);
+    return fnv1a64(source.data(), source.size(), h);
+}
+
+static std::string cacheEntryPath(const std::string& dir, uint64_t key) {
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx.gprc", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(dir) / name).string();
+}
+
+/**
+ * Apply cache entry `entry` to mem and `map` if it is intact and for `key`.
+ * Everything is checked before memory is touched, so a miss changes nothing.
+ */
+static bool loadCached(const std::string& entry, uint64_t key, uint16_t* mem, size_t memSize, DebugMap* map,
+                       OptimizeReport& report) {
+    std::ifstream in(entry, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    std::vector<uint8_t> data(static_cast<size_t>(std::max<std::streamoff>(0, in.tellg())));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()))) return false;
+    if (data.size() < CACHE_HEADER + 4 + 2 + 4 + 4 || std::memcmp(data.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+        return false;
+    size_t body = data.size() - 4;
+    if (get32(data.data() + 8) != CACHE_VERSION || get32(data.data() + body) != fnv1a32(data.data(), body))
+        return false;
+    if (get64(data.data() + 12) != key) return false;
+
+    const uint8_t* p = data.data() + CACHE_HEADER;
+    const uint8_t* end = data.data() + body;
+    auto need = [&](size_t bytes) { return static_cast<size_t>(end - p) >= bytes; };
+
+    struct Run { uint16_t addr; uint32_t words; const uint8_t* data; };
+    uint32_t runCount = get32(p);
+    p += 4;
+    if (runCount > CACHE_ADDRESSES) return false;
+    std::vector<Run> runs(runCount);
+    for (Run& r : runs) {
+        if (!need(6)) return false;
+        r = Run{get16(p), get32(p + 2), p + 6};
+        if (r.words > memSize || r.addr > memSize - r.words || !need(6 + CACHE_WORD_BYTES * size_t{r.words}))
+            return false;
+        p += 6 + CACHE_WORD_BYTES * size_t{r.words};
+    }
+
+    DebugMap loaded;
+    if (!need(2)) return false;
+    uint16_t fileCount = get16(p);
+    p += 2;
+    for (uint16_t f = 0; f < fileCount; ++f) {
+        if (!need(2) || !need(2u + get16(p))) return false;
+        loaded.addFile(std::string(reinterpret_cast<const char*>(p + 2), get16(p)));
+        p += 2 + get16(p);
+    }
+    if (loaded.fileNames().size() != fileCount || !need(4)) return false;
+    uint32_t labelCount = get32(p);
+    p += 4;
+    for (uint32_t l = 0; l < labelCount; ++l) {
+        if (!need(4) || !need(4u + get16(p + 2))) return false;
+        loaded.addLabel(get16(p), std::string(reinterpret_cast<const char*>(p + 4), get16(p + 2)));
+        p += 4 + get16(p + 2);
+    }
+    if (p != end) return false;
+    for (const Run& r : runs)
+        for (uint32_t i = 0; i < r.words; ++i) {
+            const uint8_t* w = r.data + CACHE_WORD_BYTES * i;
+            if ((get16(w + 2) & 0x7FFF) >= fileCount || get32(w + 4) == 0) return false;
+        }
+
+    for (const Run& r : runs)
+        for (uint32_t i = 0; i < r.words; ++i) {
+            const uint8_t* w = r.data + CACHE_WORD_BYTES * i;
+            uint16_t pc = static_cast<uint16_t>(r.addr + i);
+            mem[pc] = get16(w);
+            if (map) loaded.setLine(pc, get16(w + 2) & 0x7FFF, get32(w + 4), (get16(w + 2) & 0x8000) != 0);
+        }
+    if (map) *map = std::move(loaded);
+    const uint8_t* counts = data.data() + 20;
+    report.wordsBefore = get32(counts);
+    report.wordsAfter = get32(counts + 4);
+    report.loadsRemoved = get32(counts + 8);
+    report.movesRemoved = get32(counts + 12);
+    report.jumpsThreaded = get32(counts + 16);
+    report.jumpsRemoved = get32(counts + 20);
+    report.unreachableRemoved = get32(counts + 24);
+    return true;
+}
+
+/** Remove the least recently used entries while the cache is over `limit` bytes (keeping `keep`). */
+static void evictCached(const std::string& dir, uint64_t limit, const std::string& keep) {
+    namespace fs = std::filesystem;
+    struct Entry { fs::file_time_type time; uintmax_t size; fs::path path; };
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+    std::error_code ec;
+    auto now = fs::file_time_type::clock::now();
+    for (fs::directory_iterator it(dir, ec), last; !ec && it != last; it.increment(ec)) {
+        const fs::path& path = it->path();
+        fs::file_time_type time = fs::last_write_time(path, ec);
+        if (ec) { ec.clear(); continue; }
+        if (path.extension() == ".gprc") {
+            uintmax_t size = fs::file_size(path, ec);
+            if (ec) { ec.clear(); continue; }
+            entries.push_back(Entry{time, size, path});
+            total += size;
+        } else if (path.filename().string().find(".gprc.tmp") != std::string::npos && now - time > CACHE_STALE_TMP) {
+            fs::remove(path, ec);
+            ec.clear();
+        }
+    }
+    if (total <= limit) return;
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    for (const Entry& e : entries) {
+        if (total <= limit) break;
+        if (e.path == keep) continue;
+        // Another process may have removed it first; either way it is gone
+        fs::remove(e.path, ec);
+        ec.clear();
+        total -= e.size;
+    }
+}
+
+/** Write an entry for the words `map` says were assembled, with the map. Failures only cost a later miss. */
+static void storeCached(const std::string& entry, uint64_t key, const uint16_t* mem, size_t memSize,
+                        const DebugMap& map, const OptimizeReport& report, const AssembleOptions& options) {
+    std::vector<uint8_t> out(CACHE_MAGIC, CACHE_MAGIC + sizeof(CACHE_MAGIC));
+    put32(out, CACHE_VERSION);
+    put64(out, key);
+    for (size_t count : {report.wordsBefore, report.wordsAfter, report.loadsRemoved, report.movesRemoved,
+                         report.jumpsThreaded, report.jumpsRemoved, report.unreachableRemoved})
+        put32(out, static_cast<uint32_t>(count));
+
+    // Every word the linker wrote has a source line; runs of them are the image
+    size_t countAt = out.size();
+    put32(out, 0);
+    uint32_t runs = 0;
+    size_t limit = std::min<size_t>(memSize, CACHE_ADDRESSES);
+    for (size_t pc = 0; pc < limit;) {
+        if (map.lineAt(static_cast<uint16_t>(pc)).line == 0) { ++pc; continue; }
+        size_t start = pc;
+        while (pc < limit && map.lineAt(static_cast<uint16_t>(pc)).line != 0) ++pc;
+        put16(out, static_cast<uint16_t>(start));
+        put32(out, static_cast<uint32_t>(pc - start));
+        for (size_t i = start; i < pc; ++i) {
+            SourceLine src = map.lineAt(static_cast<uint16_t>(i));
+            uint16_t file = static_cast<uint16_t>(src.file - map.fileNames().data());
+            put16(out, mem[i]);
+            put16(out, static_cast<uint16_t>(file | (map.isData(static_cast<uint16_t>(i)) ? 0x8000 : 0)));
+            put32(out, src.line);
+        }
+        ++runs;
+    }
+    patch32(out, countAt, runs);
+
+    put16(out, static_cast<uint16_t>(map.fileNames().size()));
+    for (const std::string& name : map.fileNames()) {
+        put16(out, static_cast<uint16_t>(name.size()));
+        out.insert(out.end(), name.begin(), name.end());
+    }
+    put32(out, static_cast<uint32_t>(map.labelList().size()));
+    for (const auto& label : map.labelList()) {
+        put16(out, label.first);
+        put16(out, static_cast<uint16_t>(label.second.size()));
+        out.insert(out.end(), label.second.begin(), label.second.end());
+    }
+    put32(out, fnv1a32(out.data(), out.size()));
+
+    // A private temporary per writer, renamed into place: readers see the
+    // old entry, no entry or the whole new one. No fsync; a torn file
+    // after a host crash fails the checksum and is rebuilt. If another
+    // process stored the entry first, its copy is as good.
+    std::error_code ec;
+    std::filesystem::create_directories(options.cacheDir, ec);
+    std::random_device random;
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".tmp%08x%08x", random(), random());
+    std::string error;
+    if (!replaceFile(entry, entry + suffix, out, false, error)) return;
+    evictCached(options.cacheDir, options.cacheLimit, entry);
+}
+
+static AssembleResult assembleFileCached(const char* path, uint16_t* mem, size_t memSize,
+                                         const AssembleOptions& options) {
     std::ifstream in(path, std::ios::binary);
-    if (!in) return AssembleResult{false, "Cannot open file", 0};
+    if (!in) return AssembleResult{false, "Cannot open file", 0, {}};
     std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-    in.close();
-    return assemble(source, mem, memSize);
+    uint64_t key = cacheKey(path, source, memSize, options);
+    std::string entry = cacheEntryPath(options.cacheDir, key);
+
+    AssembleResult res{true, "", 0, {}};
+    if (loadCached(entry, key, mem, memSize, options.debugMap, res.report)) {
+        std::error_code ec;
+        std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec);
+        return res;
+    }
+
+    // Miss: assemble as assembleFile() does, always with a map, which also
+    // tells which words were written
+    DebugMap map;
+    AssembleOptions uncached = options;
+    uncached.cacheDir.clear();
+    uncached.debugMap = &map;
+    ObjectFile object;
+    res = assembleObject(source, object, uncached);
+    if (!res.ok) return res;
+    object.source = path;
+    res = linkAssembled(object, res, mem, memSize, uncached);
+    if (!res.ok) return res;
+    storeCached(entry, key, mem, memSize, map, res.report, options);
+    if (options.debugMap) *options.debugMap = std::move(map);
+    return res;
 }
@@ -6,25 +6,198 @@
 #ifndef ASSEMBLER_H
 #define ASSEMBLER_H
 
+#include "debug_map.h"
 #include <cstdint>
 #include <cstddef>
 #include <string>
 #include <vector>
 
+/** How an item's operand completes its word(s). */
+enum class Operand : uint8_t {
+    NONE,
+    IMM9,          // MOVI immediate; values above 511 become a longer sequence
+    JUMP_TARGET,   // MOVI R7 of a JMP/JZ/CALL label expansion
+    RS_FIELD,      // ALU source given as a number: low 3 bits select Rs
+    DATA,          // .WORD value
+    IMM9_SCRATCH   // IMM9 after ".SCRATCH R7": a long value may also use R7
+};
+
+/** One entry of an object's program, in source order. */
+struct ObjectItem {
+    enum Kind : uint8_t { INSTR, WORD, WORD_AT, ORG, LABEL };
+    Kind kind;
+    Operand operand;
+    uint16_t word;       // INSTR: encoding without the operand
+    uint16_t addr;       // ORG / WORD_AT address
+    uint32_t value;      // Operand value unless relocated; LABEL: symbol index
+    uint32_t lineNum;
+};
+
+struct ObjectSymbol {
+    std::string name;    // Upper case
+    bool defined;        // A label in this object (else imported)
+    bool global;         // Defined and exported with .GLOBAL
+};
+
+/** The operand of items[item] is the address of symbols[symbol]. */
+struct Relocation {
+    uint32_t item;
+    uint32_t symbol;
+};
+
+/**
+ * A relocatable object: the program before addresses are assigned.
+ * Items before the first .ORG (or a whole object without one) are placed
+ * by the linker; labels are local unless named in .GLOBAL, and a name
+ * that is neither a label nor a number is imported.
+ */
+struct ObjectFile {
+    std::string name;    // Shown in link errors (file path when loaded)
+    std::string source;  // .asm file it was assembled from, for debug maps
+    std::vector<ObjectItem> items;
+    std::vector<ObjectSymbol> symbols;
+    std::vector<Relocation> relocations;
+};
+
+/** What the peephole optimizer removed (all zero when it is off). */
+struct OptimizeReport {
+    size_t wordsBefore = 0;
+    size_t wordsAfter = 0;
+    size_t loadsRemoved = 0;         // MOVI of a value already in the register, or never read
+    size_t movesRemoved = 0;         // MOV Rn, Rn and copies of an equal value
+    size_t jumpsThreaded = 0;        // Jumps to a JMP retargeted to its destination
+    size_t jumpsRemoved = 0;         // Words of jumps to the next instruction
+    size_t unreachableRemoved = 0;   // Unlabeled instructions after JMP/RET/RETI/HALT
+};
+
 /** Result of assembly: success + optional error message */
 struct AssembleResult {
     bool ok;
     std::string error;
     size_t lineNum;
+    OptimizeReport report;
+};
+
+/**
+ * Assembler options.
+ *
+ * optimize: run a peephole pass before addresses are assigned. It keeps
+ * everything the program can observe except R7 after a `JMP/JZ/CALL label`
+ * (whose expansion loads R7), which is left unspecified. Code layout
+ * changes, so only labels keep their meaning: computed jumps or data reads
+ * into code by numeric address are not supported in this mode.
+ *
+ * debugMap: when set, receives the source line of every word and the
+ * address of every label (see DebugMap).
+ *
+ * cacheDir: when set, assembleFile() keeps assembled programs there (see
+ * "Assembly cache" below) and skips assembly for a source it has seen.
+ * cacheLimit: bytes the cache may hold before the least recently used
+ * entries are removed.
+ */
+struct AssembleOptions {
+    bool optimize = false;
+    DebugMap* debugMap = nullptr;
+    std::string cacheDir;
+    uint64_t cacheLimit = 64ull << 20;
+};
+
+/**
+ * Linker options. threads: worker threads (0 = one per CPU, 1 = none).
+ * debugMap: as in AssembleOptions; lines refer to each object's source
+ * (or its name when the source is unknown).
+ */
+struct LinkOptions {
+    unsigned threads = 0;
+    DebugMap* debugMap = nullptr;
 };
 
 /**
  * Assemble source code into memory.
  * Returns AssembleResult; on success, instructions/data are written to mem.
  */
-AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize);
+AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize,
+                        const AssembleOptions& options = AssembleOptions());
+
+/**
+ * Shortest instruction sequence found that leaves `value` in Rd: one MOVI
+ * for 0-511, else a MOVI followed by SHL/SHR/NOT Rd steps. With scratchR7
+ * (and Rd != R7), two such chains in Rd and R7 joined by one ADD, SUB,
+ * XOR, OR or AND are tried as well. Longer sequences change FLAGS.
+ */
+std::vector<uint16_t> loadConstant(uint8_t rd, uint16_t value, bool scratchR7);
 
-/** Load and assemble a .asm file. */
-AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize);
+/** Load and assemble a .asm file (through options.cacheDir if set). */
+AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize,
+                            const AssembleOptions& options = AssembleOptions());
+
+/** Assemble source code into a relocatable object (nothing is placed yet). */
+AssembleResult assembleObject(const std::string& source, ObjectFile& object,
+                              const AssembleOptions& options = AssembleOptions());
+
+/** Load a .asm file and assemble it into an object named (and sourced from) `path`. */
+AssembleResult assembleObjectFile(const char* path, ObjectFile& object,
+                                  const AssembleOptions& options = AssembleOptions());
+
+/**
+ * Link `objects` into memory. Each object continues at the address where
+ * the previous one ended unless it starts with .ORG; the first starts at 0.
+ * Imports resolve to the one object exporting that name. Long constants
+ * and jumps are relaxed across all objects at once, then objects are
+ * encoded and written in parallel. Objects may not overlap each other.
+ *
+ * link() only reads the objects, so one loaded library can be linked into
+ * many programs from several threads at once.
+ */
+AssembleResult link(const std::vector<const ObjectFile*>& objects, uint16_t* mem, size_t memSize,
+                    const LinkOptions& options = LinkOptions());
+
+/**
+ * Object file, version 2 (all fields little-endian):
+ *
+ *   Header   "GPR16OBJ", u32 version, u32 symbols, u32 items, u32 relocations,
+ *            u16 source name length, source name bytes
+ *   Symbol   u8 defined, u8 global, u16 name length, name bytes
+ *   Item     u8 kind, u8 operand, u16 word, u16 addr, u32 value, u32 line
+ *   Reloc    u32 item, u32 symbol
+ *   Trailer  u32 FNV-1a checksum of everything before it
+ */
+constexpr uint32_t OBJECT_VERSION = 2;
+
+/** Write `object` to `path` (beside it first, then renamed over it). */
+AssembleResult saveObject(const char* path, const ObjectFile& object);
+
+/** Read an object written by saveObject(); its name becomes `path`. */
+AssembleResult loadObject(const char* path, ObjectFile& object);
+
+/** True if `path` starts like an object file. */
+bool isObjectFile(const char* path);
+
+/**
+ * Assembly cache: one file per assembled program and its debug map (kept
+ * binary: parsing the text map would cost as much as assembling), named
+ * by a 64-bit FNV-1a hash of the source text, the file path (debug maps name it), the
+ * options that change output (optimize, memSize), CACHE_VERSION and the
+ * assembler build ID (a hash of the assembler's sources made at build
+ * time, so a rebuilt assembler never reuses another build's output):
+ *
+ *   Header   "GPR16ASC", u32 version, u64 key, seven u32 OptimizeReport counts
+ *   Runs     u32 count, then per run: u16 addr, u32 words, and per word
+ *            u16 value, u16 file index (bit 15: data), u32 source line
+ *   Files    u16 count, then per file: u16 length, name bytes
+ *   Labels   u32 count, then per label: u16 addr, u16 length, name bytes
+ *   Trailer  u32 FNV-1a checksum of everything before it
+ *
+ * Runs hold exactly the words the assembler wrote, so a hit leaves the rest
+ * of memory as it was, like assembling does. Entries are written to a
+ * uniquely named temporary file and renamed into place, so concurrent
+ * processes never see a partial entry; a damaged or unreadable entry is a
+ * miss. A hit refreshes the entry's time; a store then removes the oldest
+ * entries while the directory holds more than cacheLimit bytes. Failed
+ * assemblies are not cached. Bump CACHE_VERSION when the entry format or
+ * the assembler's output for the same source changes; the build ID covers
+ * local builds in between.
+ */
+constexpr uint32_t CACHE_VERSION = 1;
 
 #endif // ASSEMBLER_H
@@ -0,0 +1,15 @@
+# Writes OUT with a GPR_ASM_BUILD_ID macro: a hash of the SOURCES that decide
+# what the assembler emits, so cached assemblies from a different assembler
+# build miss. Run at build time by add_custom_command in CMakeLists.txt;
+# SOURCES is a "|"-separated list.
+
+string(REPLACE "|" ";" GPR_ASM_SOURCES "${SOURCES}")
+set(GPR_ASM_HASHES "")
+foreach(source IN LISTS GPR_ASM_SOURCES)
+    file(SHA256 "${source}" source_hash)
+    string(APPEND GPR_ASM_HASHES "${source_hash}")
+endforeach()
+string(SHA256 GPR_ASM_ID "${GPR_ASM_HASHES}")
+string(SUBSTRING "${GPR_ASM_ID}" 0 16 GPR_ASM_ID)
+
+file(WRITE "${OUT}" "// Generated by cmake/AssemblerBuildId.cmake - do not edit\n#define GPR_ASM_BUILD_ID \"${GPR_ASM_ID}\"\n")
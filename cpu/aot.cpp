@@ -0,0 +1,562 @@
+/**
+ * 16-bit GPR CPU Emulator - Ahead-of-Time Recompiler
+ */
+
+#include "aot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// =============================================================================
+// INTERFACE SHARED WITH GENERATED CODE
+// =============================================================================
+// The generated library only sees this plain struct, never Bus or GPRCPU, so
+// it needs no headers from the emulator. CONTEXT_SOURCE must declare the
+// same layout; gpr_aot_context_size catches a mismatch at load time.
+
+struct AotContext {
+    uint16_t r[8];
+    uint16_t pc, flags, sp, coreId;
+    uint8_t ie, halted, stop, unused;
+    uint64_t cycles, budget;
+    const uint16_t* mem;
+    uint16_t (*read)(AotContext* c, uint16_t addr);
+    void (*write)(AotContext* c, uint16_t addr, uint16_t value);
+    void (*copy)(AotContext* c, uint16_t dst, uint16_t src, uint16_t count);
+    void (*fill)(AotContext* c, uint16_t dst, uint16_t value, uint16_t count);
+};
+
+/** Return codes of gpr_aot_execute(); `stop` holds X_SLICE or X_CODE. */
+enum : int { X_INTERPRET = 0, X_HALT = 1, X_SLICE = 2, X_CODE = 3, X_NEXT = 4 };
+
+static const char* const CONTEXT_SOURCE = R"(#include <stdint.h>
+
+struct AotContext {
+    uint16_t r[8];
+    uint16_t pc, flags, sp, coreId;
+    uint8_t ie, halted, stop, unused;
+    uint64_t cycles, budget;
+    const uint16_t* mem;
+    uint16_t (*read)(AotContext* c, uint16_t addr);
+    void (*write)(AotContext* c, uint16_t addr, uint16_t value);
+    void (*copy)(AotContext* c, uint16_t dst, uint16_t src, uint16_t count);
+    void (*fill)(AotContext* c, uint16_t dst, uint16_t value, uint16_t count);
+};
+
+enum { X_INTERPRET = 0, X_HALT = 1, X_SLICE = 2, X_CODE = 3, X_NEXT = 4 };
+
+/* FLAGS: Z = 1, C = 2, N = 4; other bits are preserved. */
+static inline uint16_t F_RES(uint16_t f, uint16_t r) {
+    return (uint16_t)((f & ~7u) | (r == 0 ? 1u : 0u) | ((r & 0x8000u) ? 4u : 0u));
+}
+static inline uint16_t F_ADD(uint16_t f, uint16_t a, uint16_t b, uint16_t r) {
+    return (uint16_t)(F_RES(f, r) | ((uint32_t)a + b > 0xFFFFu ? 2u : 0u));
+}
+static inline uint16_t F_SUB(uint16_t f, uint16_t a, uint16_t b, uint16_t r) {
+    return (uint16_t)(F_RES(f, r) | (a >= b ? 2u : 0u));
+}
+static inline uint16_t F_SHL(uint16_t f, uint16_t v, uint16_t r) {
+    return (uint16_t)(F_RES(f, r) | ((v & 0x8000u) ? 2u : 0u));
+}
+static inline uint16_t F_SHR(uint16_t f, uint16_t v, uint16_t r) {
+    return (uint16_t)(F_RES(f, r) | ((v & 1u) ? 2u : 0u));
+}
+/* RAM reads skip the Bus; the MMIO page may reach a device. */
+static inline uint16_t RD(AotContext* c, uint16_t a) {
+    return a >= 0xFF00u ? c->read(c, a) : c->mem[a];
+}
+)";
+
+// =============================================================================
+// CODE GENERATION
+// =============================================================================
+
+static uint8_t opOf(uint16_t inst) { return static_cast<uint8_t>((inst >> 12) & 0xFu); }
+static unsigned rdOf(uint16_t inst) { return (inst >> 9) & 0x7u; }
+static unsigned rsOf(uint16_t inst) { return (inst >> 6) & 0x7u; }
+static uint8_t groupOf(uint16_t inst) { return static_cast<uint8_t>((inst >> 3) & 0x7u); }
+static uint8_t rcOf(uint16_t inst) { return static_cast<uint8_t>(inst & 0x7u); }
+
+static std::string hex4(uint16_t v) {
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), "0x%04X", v);
+    return buf;
+}
+
+static std::string reg(unsigned r) { return "r" + std::to_string(r); }
+
+/** Instructions left to the interpreter; they split a block into segments. */
+static bool interpreted(uint16_t inst) {
+    if (static_cast<Opcode>(opOf(inst)) != Opcode::NOP) return false;
+    ExtOp group = static_cast<ExtOp>(groupOf(inst));
+    if (group == ExtOp::CAS) return true;
+    if (group != ExtOp::SYS) return false;
+    SysOp sub = static_cast<SysOp>(rcOf(inst));
+    return sub == SysOp::WFI || sub == SysOp::BRK;
+}
+
+/** Sets all of Z, C and N. */
+static bool setsFlags(uint16_t inst) {
+    Opcode op = static_cast<Opcode>(opOf(inst));
+    return op == Opcode::MOV || op == Opcode::LOAD || (op >= Opcode::ADD && op <= Opcode::SHR);
+}
+
+/** May end the segment early (a write that hits code or MMIO) or reads FLAGS. */
+static bool observesFlags(uint16_t inst) {
+    Opcode op = static_cast<Opcode>(opOf(inst));
+    if (op == Opcode::STORE || op == Opcode::JZ) return true;
+    if (op != Opcode::NOP) return false;
+    ExtOp group = static_cast<ExtOp>(groupOf(inst));
+    return group == ExtOp::BMOV || group == ExtOp::BFILL ||
+           (group == ExtOp::MISC && static_cast<MiscOp>(rcOf(inst)) == MiscOp::PUSH);
+}
+
+/** Registers (bits 0-7), FLAGS (bit 8) and SP (bit 9) an instruction writes. */
+static unsigned writes(uint16_t inst) {
+    const unsigned rd = 1u << rdOf(inst);
+    switch (static_cast<Opcode>(opOf(inst))) {
+        case Opcode::MOVI: return rd;
+        case Opcode::MOV: case Opcode::LOAD: case Opcode::ADD: case Opcode::SUB: case Opcode::AND:
+        case Opcode::OR: case Opcode::XOR: case Opcode::NOT: case Opcode::SHL: case Opcode::SHR:
+            return rd | 0x100u;
+        case Opcode::NOP: break;
+        default: return 0;
+    }
+    switch (static_cast<ExtOp>(groupOf(inst))) {
+        case ExtOp::MISC:
+            switch (static_cast<MiscOp>(rcOf(inst))) {
+                case MiscOp::RET: case MiscOp::CALL: case MiscOp::PUSH: return 0x200u;
+                case MiscOp::RETI: return 0x300u;
+                case MiscOp::POP: return rd | 0x200u;
+                default: return 0;
+            }
+        case ExtOp::SYS:
+            switch (static_cast<SysOp>(rcOf(inst))) {
+                case SysOp::SETSP: return 0x200u;
+                case SysOp::GETSP: case SysOp::CPUID: return rd;
+                default: return 0;
+            }
+        default: return 0;
+    }
+}
+
+/** One compiled run of instructions: part or all of a basic block. */
+struct Segment {
+    uint16_t start;
+    uint16_t count;
+    bool toInterpreter;   // Ends just before a WFI/BRK/CAS
+};
+
+/** Emit `static int s_XXXX(AotContext* c)` for one segment. */
+static void emitSegment(std::string& out, const uint16_t* mem, const Segment& seg) {
+    std::vector<uint16_t> insts(seg.count);
+    unsigned modified = 0;
+    for (uint16_t i = 0; i < seg.count; ++i) {
+        insts[i] = mem[static_cast<uint16_t>(seg.start + i)];
+        modified |= writes(insts[i]);
+    }
+
+    // A flag result is dead if another flag-setting instruction follows
+    // before anything can observe FLAGS.
+    std::vector<uint8_t> flagsLive(seg.count, 0);
+    bool needed = true;   // Segment end: FLAGS are part of CPUState
+    for (uint16_t i = seg.count; i-- > 0;) {
+        if (setsFlags(insts[i])) {
+            flagsLive[i] = needed;
+            needed = false;
+        }
+        if (observesFlags(insts[i])) needed = true;
+    }
+
+    std::string save;
+    for (unsigned r = 0; r < 8; ++r)
+        if (modified & (1u << r)) save += "c->r[" + std::to_string(r) + "] = " + reg(r) + "; ";
+    if (modified & 0x100u) save += "c->flags = f; ";
+    if (modified & 0x200u) save += "c->sp = sp; ";
+
+    auto leave = [&](const std::string& pc, unsigned counted, const std::string& code) {
+        return "{ " + save + "c->pc = " + pc + "; c->cycles += " + std::to_string(counted) + "; return " + code + "; }";
+    };
+
+    out += "\n/* " + hex4(seg.start) + ": " + std::to_string(seg.count) + " instructions */\n";
+    out += "static int s_" + hex4(seg.start).substr(2) + "(AotContext* c) {\n";
+    out += "    uint16_t r0 = c->r[0], r1 = c->r[1], r2 = c->r[2], r3 = c->r[3];\n";
+    out += "    uint16_t r4 = c->r[4], r5 = c->r[5], r6 = c->r[6], r7 = c->r[7];\n";
+    out += "    uint16_t f = c->flags, sp = c->sp;\n";
+    out += "    (void)r0; (void)r1; (void)r2; (void)r3; (void)r4; (void)r5; (void)r6; (void)r7; (void)f; (void)sp;\n";
+
+    bool ended = false;
+    for (uint16_t i = 0; i < seg.count && !ended; ++i) {
+        const uint16_t inst = insts[i];
+        const std::string d = reg(rdOf(inst)), s = reg(rsOf(inst)), rc = reg(rcOf(inst));
+        const std::string next = hex4(static_cast<uint16_t>(seg.start + i + 1));
+        const std::string stopCheck = " if (c->stop) " + leave(next, i + 1u, "c->stop");
+        std::string line;
+
+        auto binary = [&](const char* op, const char* flagFn) {
+            if (!flagsLive[i])
+                return d + " = (uint16_t)(" + d + " " + op + " " + s + ");";
+            return "{ uint16_t a = " + d + ", b = " + s + "; " + d + " = (uint16_t)(a " + op + " b); f = " + flagFn +
+                   "(f, a, b, " + d + "); }";
+        };
+        auto logic = [&](const std::string& expr) {
+            return d + " = (uint16_t)(" + expr + ");" + (flagsLive[i] ? " f = F_RES(f, " + d + ");" : "");
+        };
+        auto shift = [&](const char* op, const char* flagFn) {
+            if (!flagsLive[i])
+                return d + " = (uint16_t)(" + d + " " + op + " 1);";
+            return "{ uint16_t v = " + d + "; " + d + " = (uint16_t)(v " + op + " 1); f = " + flagFn + "(f, v, " + d + "); }";
+        };
+
+        switch (static_cast<Opcode>(opOf(inst))) {
+            case Opcode::HALT:
+                line = "c->halted = 1; " + leave(next, i, "X_HALT");   // HALT is not counted
+                ended = true;
+                break;
+            case Opcode::MOVI:  line = d + " = " + std::to_string(inst & 0x1FFu) + ";"; break;
+            case Opcode::MOV:   line = logic(s); break;
+            case Opcode::LOAD:  line = logic("RD(c, " + s + ")"); break;
+            case Opcode::STORE: line = "c->write(c, " + s + ", " + d + ");" + stopCheck; break;
+            case Opcode::ADD:   line = binary("+", "F_ADD"); break;
+            case Opcode::SUB:   line = binary("-", "F_SUB"); break;
+            case Opcode::AND:   line = logic(d + " & " + s); break;
+            case Opcode::OR:    line = logic(d + " | " + s); break;
+            case Opcode::XOR:   line = logic(d + " ^ " + s); break;
+            case Opcode::NOT:   line = logic("~" + s); break;
+            case Opcode::SHL:   line = shift("<<", "F_SHL"); break;
+            case Opcode::SHR:   line = shift(">>", "F_SHR"); break;
+            case Opcode::JMP:
+                line = leave(s, i + 1u, "X_NEXT");
+                ended = true;
+                break;
+            case Opcode::JZ:
+                line = leave("(f & 1u) ? " + s + " : " + next, i + 1u, "X_NEXT");
+                ended = true;
+                break;
+            case Opcode::NOP:
+                switch (static_cast<ExtOp>(groupOf(inst))) {
+                    case ExtOp::BMOV:  line = "c->copy(c, " + d + ", " + s + ", " + rc + ");" + stopCheck; break;
+                    case ExtOp::BFILL: line = "c->fill(c, " + d + ", " + s + ", " + rc + ");" + stopCheck; break;
+                    case ExtOp::MISC:
+                        switch (static_cast<MiscOp>(rcOf(inst))) {
+                            case MiscOp::RET:
+                                line = "{ uint16_t t = RD(c, sp); sp = (uint16_t)(sp + 1); " + leave("t", i + 1u, "X_NEXT") + " }";
+                                ended = true;
+                                break;
+                            case MiscOp::RETI:
+                                line = "{ f = RD(c, sp); sp = (uint16_t)(sp + 1); uint16_t t = RD(c, sp); sp = (uint16_t)(sp + 1); "
+                                       "c->ie = 1; " + leave("t", i + 1u, "X_NEXT") + " }";
+                                ended = true;
+                                break;
+                            case MiscOp::EI: line = "c->ie = 1;"; break;
+                            case MiscOp::DI: line = "c->ie = 0;"; break;
+                            case MiscOp::CALL:
+                                line = "sp = (uint16_t)(sp - 1); c->write(c, sp, " + next + "); " +
+                                       leave(s, i + 1u, "c->stop ? c->stop : X_NEXT");
+                                ended = true;
+                                break;
+                            case MiscOp::PUSH: line = "sp = (uint16_t)(sp - 1); c->write(c, sp, " + d + ");" + stopCheck; break;
+                            case MiscOp::POP:  line = d + " = RD(c, sp); sp = (uint16_t)(sp + 1);"; break;
+                            default: line = "/* NOP */"; break;
+                        }
+                        break;
+                    case ExtOp::SYS:
+                        switch (static_cast<SysOp>(rcOf(inst))) {
+                            case SysOp::SETSP: line = "sp = " + d + ";"; break;
+                            case SysOp::GETSP: line = d + " = sp;"; break;
+                            case SysOp::CPUID: line = d + " = c->coreId;"; break;
+                            case SysOp::FENCE: line = "__atomic_thread_fence(__ATOMIC_SEQ_CST);"; break;
+                            default: line = "/* NOP */"; break;
+                        }
+                        break;
+                    default: line = "/* NOP */"; break;
+                }
+                break;
+        }
+        out += "    " + line + "  /* " + hex4(static_cast<uint16_t>(seg.start + i)) + " " + disassemble(inst) + " */\n";
+    }
+    if (!ended) {
+        const std::string pc = hex4(static_cast<uint16_t>(seg.start + seg.count));
+        out += "    " + leave(pc, seg.count, seg.toInterpreter ? "X_INTERPRET" : "X_NEXT") + "\n";
+    }
+    out += "}\n";
+}
+
+std::string generateAotSource(const uint16_t* memory, const ProgramCFG& cfg) {
+    // Cut blocks around the instructions the interpreter keeps.
+    std::vector<Segment> segments;
+    for (const BasicBlock& b : cfg.blocks) {
+        uint16_t segStart = b.start;
+        for (uint16_t i = 0; i < b.length; ++i) {
+            uint16_t pc = static_cast<uint16_t>(b.start + i);
+            if (!interpreted(memory[pc])) continue;
+            if (pc != segStart) segments.push_back({segStart, static_cast<uint16_t>(pc - segStart), true});
+            segStart = static_cast<uint16_t>(pc + 1);
+        }
+        uint16_t end = b.end();
+        if (segStart != end && static_cast<uint16_t>(segStart - b.start) < b.length)
+            segments.push_back({segStart, static_cast<uint16_t>(end - segStart), false});
+    }
+
+    std::string out = "/* Generated by the GPR-16 AOT recompiler. Do not edit. */\n";
+    out += CONTEXT_SOURCE;
+    for (const Segment& seg : segments) emitSegment(out, memory, seg);
+
+    // Dispatcher: a segment only starts if the whole of it fits the budget.
+    out += "\nextern \"C\" int gpr_aot_execute(AotContext* c) {\n    for (;;) {\n        int x;\n        switch (c->pc) {\n";
+    for (const Segment& seg : segments) {
+        std::string name = hex4(seg.start);
+        out += "        case " + name + ": if (c->budget - c->cycles < " + std::to_string(seg.count) +
+               ") return X_INTERPRET; x = s_" + name.substr(2) + "(c); break;\n";
+    }
+    out += "        default: return X_INTERPRET;\n        }\n        if (x != X_NEXT) return x;\n    }\n}\n";
+
+    // Every compiled word, so the host can verify the image and catch writes.
+    size_t words = 0;
+    out += "\nextern \"C\" const uint16_t gpr_aot_code[][2] = {\n";
+    for (const Segment& seg : segments) {
+        for (uint16_t i = 0; i < seg.count; ++i, ++words) {
+            uint16_t pc = static_cast<uint16_t>(seg.start + i);
+            out += "    {" + hex4(pc) + ", " + hex4(memory[pc]) + "},\n";
+        }
+    }
+    out += "    {0, 0}\n};\n";
+    out += "extern \"C\" const uint32_t gpr_aot_code_count = " + std::to_string(words) + ";\n";
+    out += "extern \"C\" const uint32_t gpr_aot_abi = " + std::to_string(AOT_ABI_VERSION) + ";\n";
+    out += "extern \"C\" const uint32_t gpr_aot_context_size = sizeof(AotContext);\n";
+    return out;
+}
+
+/**
+ * Run `args` (args[0] looked up in PATH) without a shell, so nothing in a
+ * path is ever interpreted. True if it exited with status 0.
+ */
+static bool runCommand(const std::vector<std::string>& args) {
+#ifndef _WIN32
+    std::vector<char*> argv;
+    for (const std::string& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0) {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+    (void)args;
+    return false;
+#endif
+}
+
+AotResult compileAot(const uint16_t* memory, const std::string& soPath) {
+    ProgramCFG cfg = buildCFG(memory, defaultEntries(memory));
+    std::string srcPath = soPath + ".cpp";
+    {
+        std::ofstream src(srcPath, std::ios::binary);
+        if (!src)
+            return {false, "cannot write " + srcPath};
+        src << generateAotSource(memory, cfg);
+        if (!src)
+            return {false, "cannot write " + srcPath};
+    }
+    // $CXX is split at spaces like make does ("ccache c++" works); the
+    // paths are passed as single arguments.
+    const char* cxx = std::getenv("CXX");
+    std::istringstream words(cxx && *cxx ? cxx : "c++");
+    std::vector<std::string> args;
+    for (std::string w; words >> w;) args.push_back(w);
+    if (args.empty()) args.push_back("c++");
+    for (const char* flag : {"-std=c++11", "-O2", "-fPIC", "-shared", "-o"}) args.push_back(flag);
+    args.push_back(soPath);
+    args.push_back(srcPath);
+    if (!runCommand(args)) {
+        std::string command;
+        for (const std::string& a : args) command += (command.empty() ? "" : " ") + a;
+        return {false, "compiler failed (" + command + "); source kept in " + srcPath};
+    }
+    std::remove(srcPath.c_str());
+    return {true, ""};
+}
+
+// =============================================================================
+// LOADED PROGRAM
+// =============================================================================
+
+namespace {
+
+/** AotContext plus what the host callbacks need; ctx must stay first. */
+struct HostContext {
+    AotContext ctx;
+    Bus* bus;
+    const uint8_t* codeMap;
+};
+
+HostContext* host(AotContext* c) { return reinterpret_cast<HostContext*>(c); }
+
+/** Flag the run to stop after a write that ended the slice or hit compiled code. */
+void checkWrite(AotContext* c, uint16_t dst, uint16_t count) {
+    HostContext* h = host(c);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (h->codeMap[static_cast<uint16_t>(dst + i)]) {
+            c->stop = X_CODE;
+            return;
+        }
+    }
+    if (h->bus->sliceBreak()) c->stop = X_SLICE;
+}
+
+uint16_t hostRead(AotContext* c, uint16_t addr) { return host(c)->bus->read(addr); }
+
+void hostWrite(AotContext* c, uint16_t addr, uint16_t value) {
+    host(c)->bus->write(addr, value);
+    checkWrite(c, addr, 1);
+}
+
+void hostCopy(AotContext* c, uint16_t dst, uint16_t src, uint16_t count) {
+    host(c)->bus->copyBlock(dst, src, count);
+    checkWrite(c, dst, count);
+}
+
+void hostFill(AotContext* c, uint16_t dst, uint16_t value, uint16_t count) {
+    host(c)->bus->fillBlock(dst, value, count);
+    checkWrite(c, dst, count);
+}
+
+} // namespace
+
+AotProgram::AotProgram() : handle(nullptr), entry(nullptr), codeMap(MEMORY_SIZE, 0) {}
+
+AotProgram::~AotProgram() {
+#ifndef _WIN32
+    if (handle) dlclose(handle);
+#endif
+}
+
+bool AotProgram::load(const std::string& soPath) {
+#ifndef _WIN32
+    // Close first: dlopen() would hand back a still-open library of the
+    // same name even if the file was rebuilt.
+    if (handle) dlclose(handle);
+    handle = nullptr;
+    entry = nullptr;
+    code.clear();
+    codePages.clear();
+    std::fill(codeMap.begin(), codeMap.end(), 0);
+
+    // Without a slash dlopen() searches the library path instead of the file.
+    std::string path = soPath.find('/') == std::string::npos ? "./" + soPath : soPath;
+    void* h = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!h) {
+        const char* why = dlerror();
+        error = why ? why : "dlopen failed";
+        return false;
+    }
+    auto abi = static_cast<const uint32_t*>(dlsym(h, "gpr_aot_abi"));
+    auto contextSize = static_cast<const uint32_t*>(dlsym(h, "gpr_aot_context_size"));
+    auto words = static_cast<const uint16_t(*)[2]>(dlsym(h, "gpr_aot_code"));
+    auto count = static_cast<const uint32_t*>(dlsym(h, "gpr_aot_code_count"));
+    void* fn = dlsym(h, "gpr_aot_execute");
+    if (!abi || !contextSize || !words || !count || !fn || *abi != AOT_ABI_VERSION ||
+        *contextSize != sizeof(AotContext)) {
+        error = soPath + " is not an AOT library for this emulator version";
+        dlclose(h);
+        return false;
+    }
+    handle = h;
+    entry = reinterpret_cast<int (*)(void*)>(fn);
+    for (uint32_t i = 0; i < *count; ++i) {
+        code.emplace_back(words[i][0], words[i][1]);
+        codeMap[words[i][0]] = 1;
+    }
+    std::sort(code.begin(), code.end());
+    for (size_t i = 0; i < code.size(); ++i) {
+        unsigned page = static_cast<unsigned>(code[i].first / PAGE_WORDS);
+        if (codePages.empty() || codePages.back().page != page)
+            codePages.push_back({page, i, i});
+        codePages.back().last = i + 1;
+    }
+    return true;
+#else
+    error = "AOT libraries need dlopen (POSIX only)";
+    (void)soPath;
+    return false;
+#endif
+}
+
+bool AotProgram::matches(const uint16_t* memory) const {
+    for (const auto& w : code)
+        if (memory[w.first] != w.second) return false;
+    return entry != nullptr;
+}
+
+bool AotProgram::codeChanged(const Bus& bus) const {
+    // The written bits are one byte per page, so the common case (no code
+    // page touched) is a handful of loads. A page that only had data
+    // stored into it is compared word by word and stays compiled.
+    const uint16_t* memory = bus.getMemory();
+    for (const CodePage& p : codePages) {
+        if (!bus.isPageWritten(p.page)) continue;
+        for (size_t i = p.first; i < p.last; ++i)
+            if (memory[code[i].first] != code[i].second) return true;
+    }
+    return false;
+}
+
+CompiledCode::Exit AotProgram::execute(CPUState& state, Bus& bus, uint16_t coreId, size_t budget, size_t& cycles) {
+    if (!entry)
+        return Exit::INTERPRET;
+    // Stores the compiled code did not make itself (the interpreter's
+    // fallback steps, CAS, host writes) are only visible here.
+    if (codeChanged(bus))
+        return Exit::CODE_WRITTEN;
+    HostContext h{};
+    AotContext& c = h.ctx;
+    h.bus = &bus;
+    h.codeMap = codeMap.data();
+    for (unsigned r = 0; r < 8; ++r) c.r[r] = state.R[r];
+    c.pc = state.PC;
+    c.flags = state.FLAGS;
+    c.sp = state.SP;
+    c.coreId = coreId;
+    c.ie = state.IE ? 1 : 0;
+    c.budget = budget;
+    c.mem = bus.getMemory();
+    c.read = hostRead;
+    c.write = hostWrite;
+    c.copy = hostCopy;
+    c.fill = hostFill;
+
+    int x = entry(&c);
+
+    for (unsigned r = 0; r < 8; ++r) state.R[r] = c.r[r];
+    state.PC = c.pc;
+    state.FLAGS = c.flags;
+    state.SP = c.sp;
+    state.IE = c.ie != 0;
+    if (c.halted) state.halted = true;
+    cycles += static_cast<size_t>(c.cycles);
+
+    switch (x) {
+        case X_HALT:  return Exit::HALT;
+        case X_SLICE: return Exit::SLICE_BREAK;
+        case X_CODE:  return Exit::CODE_WRITTEN;
+        default:      return Exit::INTERPRET;
+    }
+}
@@ -0,0 +1,103 @@
+/**
+ * 16-bit GPR CPU Emulator - Ahead-of-Time Recompiler
+ * Translates an assembled image into C++, builds it into a shared library
+ * with the system compiler, and runs it in place of the interpreter.
+ */
+
+#ifndef AOT_H
+#define AOT_H
+
+#include "gpr_cpu.h"
+#include "cfg.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Bumped whenever the generated code's interface changes. */
+constexpr uint32_t AOT_ABI_VERSION = 1;
+
+struct AotResult {
+    bool ok;
+    std::string error;
+};
+
+/**
+ * C++ source for the code in `cfg` (built from `memory`). Each basic block
+ * becomes one function with the registers in locals; FLAGS are only
+ * computed where a later JZ, a possible early exit or the block end can
+ * see them. WFI, BRK and CAS are left to the interpreter.
+ */
+std::string generateAotSource(const uint16_t* memory, const ProgramCFG& cfg);
+
+/**
+ * Generate the source for the code reachable in `memory` (see
+ * defaultEntries()), write it to `soPath` + ".cpp" and compile it into the
+ * shared library `soPath` with $CXX (default "c++"). The compiler runs
+ * without a shell. The source is removed after a successful build and
+ * kept for inspection when the compiler fails. POSIX only.
+ */
+AotResult compileAot(const uint16_t* memory, const std::string& soPath);
+
+/**
+ * AotProgram: a library from compileAot(), loaded with dlopen and handed
+ * to GPRCPU::setCompiledCode(). It runs with the interpreter's exact
+ * CPUState, memory and cycle semantics:
+ *
+ *   - every LOAD/STORE/stack access goes through the Bus (RAM reads take
+ *     a direct path), so devices, MMIO slice breaks and dirty pages behave
+ *     as before;
+ *   - a block only runs if the slice has cycles for all of it, so device
+ *     events still land on their exact cycle;
+ *   - code the analysis did not find is interpreted.
+ *
+ * A write by compiled code to any compiled word detaches the program and
+ * the CPU interprets from then on. Other Bus writes (the host, CAS, code
+ * the program never saw) are caught before the next execute(): a code page
+ * whose written bit is set is compared against the compiled words, and a
+ * mismatch detaches the program the same way. Edits through getMemory()
+ * bypass the Bus and are not seen; call matches() after changing code
+ * that way.
+ *
+ * POSIX only (dlopen). One program may serve any number of CPUs.
+ */
+class AotProgram : public CompiledCode {
+public:
+    AotProgram();
+    ~AotProgram() override;
+
+    AotProgram(const AotProgram&) = delete;
+    AotProgram& operator=(const AotProgram&) = delete;
+
+    /** dlopen `soPath`. On failure, lastError() says why. */
+    bool load(const std::string& soPath);
+
+    /** True if every compiled word still equals `memory` (MEMORY_SIZE words). */
+    bool matches(const uint16_t* memory) const;
+
+    /** Number of compiled instruction words. */
+    size_t codeWords() const { return code.size(); }
+
+    const std::string& lastError() const { return error; }
+
+    Exit execute(CPUState& state, Bus& bus, uint16_t coreId, size_t budget, size_t& cycles) override;
+
+private:
+    void* handle;
+    int (*entry)(void* context);
+    /** The compiled words of one 256-word page: code[first, last). */
+    struct CodePage {
+        unsigned page;
+        size_t first, last;
+    };
+
+    std::vector<std::pair<uint16_t, uint16_t>> code;   // (address, word) compiled, by address
+    std::vector<uint8_t> codeMap;                      // 1 where a word is compiled
+    std::vector<CodePage> codePages;                   // Pages holding compiled words
+
+    /** True if a page written through `bus` no longer holds its compiled words. */
+    bool codeChanged(const Bus& bus) const;
+    std::string error;
+};
+
+#endif // AOT_H
@@ -0,0 +1,59 @@
+/**
+ * 16-bit GPR CPU Emulator - Binary File Helpers
+ */
+
+#include "binary_io.h"
+#include <cstdio>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+uint32_t fnv1a32(const void* data, size_t n) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint64_t fnv1a64(const void* data, size_t n, uint64_t h) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool replaceFile(const std::string& path, const std::string& tmp, const std::vector<uint8_t>& bytes, bool sync,
+                 std::string& error) {
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        error = "cannot create " + tmp;
+        return false;
+    }
+    bool written = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size() && std::fflush(f) == 0;
+#ifndef _WIN32
+    if (sync) written = written && fsync(fileno(f)) == 0;
+#else
+    (void)sync;
+#endif
+    written = (std::fclose(f) == 0) && written;
+    if (!written) {
+        std::remove(tmp.c_str());
+        error = "write failed: " + tmp;
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());   // rename() does not replace on Windows
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        error = "cannot rename " + tmp + " to " + path;
+        return false;
+    }
+    return true;
+}
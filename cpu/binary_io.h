@@ -0,0 +1,75 @@
+/**
+ * 16-bit GPR CPU Emulator - Binary File Helpers
+ * Little-endian fields, FNV-1a hashes and crash-safe file replacement,
+ * shared by every binary format the emulator reads or writes.
+ */
+
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// LITTLE-ENDIAN FIELDS (independent of the host's byte order)
+// =============================================================================
+
+inline void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+inline void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (unsigned i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+inline void put64(std::vector<uint8_t>& out, uint64_t v) {
+    for (unsigned i = 0; i < 8; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+/** Overwrite four bytes at `at` (a count patched in once it is known). */
+inline void patch32(std::vector<uint8_t>& out, size_t at, uint32_t v) {
+    for (unsigned i = 0; i < 4; ++i) out[at + i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+inline uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+inline uint32_t get32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t get64(const uint8_t* p) {
+    return static_cast<uint64_t>(get32(p)) | (static_cast<uint64_t>(get32(p + 4)) << 32);
+}
+
+// =============================================================================
+// FNV-1a HASHES
+// =============================================================================
+
+/** 32-bit FNV-1a: the trailing checksum of every file format. Catches truncation and bit rot, not tampering. */
+uint32_t fnv1a32(const void* data, size_t n);
+
+constexpr uint64_t FNV64_OFFSET = 14695981039346656037ull;
+
+/** 64-bit FNV-1a, continuing from `h` so several pieces can be hashed as one. */
+uint64_t fnv1a64(const void* data, size_t n, uint64_t h = FNV64_OFFSET);
+
+// =============================================================================
+// FILE REPLACEMENT
+// =============================================================================
+
+/**
+ * Write `bytes` to `tmp`, then rename it over `path`, so a reader sees the
+ * old file or the whole new one, never a partial write. With `sync` the
+ * data is on disk (fsync) before the rename, so the new file also survives
+ * a host crash. On failure `tmp` is removed, `path` is unchanged and
+ * `error` says what went wrong. `tmp` must be on the same file system as
+ * `path` (normally beside it).
+ */
+bool replaceFile(const std::string& path, const std::string& tmp, const std::vector<uint8_t>& bytes, bool sync,
+                 std::string& error);
+
+#endif // BINARY_IO_H
@@ -0,0 +1,242 @@
+/**
+ * 16-bit GPR CPU Emulator - Branch Predictor Simulation
+ */
+
+#include "branch_predictor.h"
+#include <algorithm>
+#include <iomanip>
+
+/** Saturating 2-bit counter update: 0-1 predict not-taken, 2-3 predict taken. */
+static void train2bit(uint8_t& c, bool taken) {
+    if (taken) { if (c < 3) ++c; }
+    else       { if (c > 0) --c; }
+}
+
+// =============================================================================
+// BIMODAL
+// =============================================================================
+
+BimodalPredictor::BimodalPredictor(unsigned indexBits)
+    : counters(size_t(1) << indexBits, 1), mask(static_cast<uint16_t>((1u << indexBits) - 1)) {}
+
+bool BimodalPredictor::predict(uint16_t pc, uint16_t) {
+    return counters[pc & mask] >= 2;
+}
+
+void BimodalPredictor::update(uint16_t pc, uint16_t, bool taken) {
+    train2bit(counters[pc & mask], taken);
+}
+
+// =============================================================================
+// GSHARE
+// =============================================================================
+
+GsharePredictor::GsharePredictor(unsigned historyBits)
+    : counters(size_t(1) << historyBits, 1), history(0), mask((1u << historyBits) - 1) {}
+
+bool GsharePredictor::predict(uint16_t pc, uint16_t) {
+    return counters[(pc ^ history) & mask] >= 2;
+}
+
+void GsharePredictor::update(uint16_t pc, uint16_t, bool taken) {
+    train2bit(counters[(pc ^ history) & mask], taken);
+    history = ((history << 1) | (taken ? 1u : 0u)) & mask;
+}
+
+// =============================================================================
+// TAGE-LITE
+// =============================================================================
+
+static const unsigned TAGE_HISTORY[4] = {4, 8, 16, 32};
+
+TagePredictor::TagePredictor(unsigned bits)
+    : base(size_t(1) << bits, 1), indexBits(bits), history(0), allocSeed(1), provider(-1), altProvider(-1), index{}, tag{} {
+    for (auto& t : tables)
+        t.assign(size_t(1) << bits, Entry{0, 0, 0, false});
+}
+
+uint32_t TagePredictor::foldHistory(unsigned length, unsigned bits) const {
+    // XOR-fold the newest `length` history bits down to `bits` bits.
+    uint64_t h = length >= 64 ? history : (history & ((uint64_t(1) << length) - 1));
+    uint32_t folded = 0;
+    while (h) {
+        folded ^= static_cast<uint32_t>(h & ((1u << bits) - 1));
+        h >>= bits;
+    }
+    return folded;
+}
+
+bool TagePredictor::predict(uint16_t pc, uint16_t) {
+    provider = altProvider = -1;
+    for (unsigned t = 0; t < TABLES; ++t) {
+        uint32_t idxMask = (1u << indexBits) - 1;
+        index[t] = (pc ^ (pc >> indexBits) ^ foldHistory(TAGE_HISTORY[t], indexBits)) & idxMask;
+        tag[t] = static_cast<uint8_t>((pc ^ foldHistory(TAGE_HISTORY[t], 8) ^ (foldHistory(TAGE_HISTORY[t], 7) << 1)) & 0xFFu);
+        if (tables[t][index[t]].valid && tables[t][index[t]].tag == tag[t]) {
+            altProvider = provider;
+            provider = static_cast<int>(t);
+        }
+    }
+    if (provider >= 0)
+        return tables[provider][index[provider]].ctr >= 0;
+    return base[pc & ((1u << indexBits) - 1)] >= 2;
+}
+
+void TagePredictor::update(uint16_t pc, uint16_t, bool taken) {
+    uint8_t& baseCtr = base[pc & ((1u << indexBits) - 1)];
+    bool altPred = altProvider >= 0 ? tables[altProvider][index[altProvider]].ctr >= 0 : baseCtr >= 2;
+    bool predicted = provider >= 0 ? tables[provider][index[provider]].ctr >= 0 : baseCtr >= 2;
+
+    if (provider >= 0) {
+        Entry& e = tables[provider][index[provider]];
+        if (taken && e.ctr < 3) ++e.ctr;
+        if (!taken && e.ctr > -4) --e.ctr;
+        // Usefulness: provider was right where the alternative was wrong.
+        if (predicted != altPred) {
+            if (predicted == taken && e.useful < 3) ++e.useful;
+            if (predicted != taken && e.useful > 0) --e.useful;
+        }
+    } else {
+        train2bit(baseCtr, taken);
+    }
+
+    // Misprediction: allocate in one longer table with a free (not useful) entry.
+    if (predicted != taken && provider < static_cast<int>(TABLES) - 1) {
+        bool allocated = false;
+        allocSeed = allocSeed * 1103515245u + 12345u;
+        unsigned startT = static_cast<unsigned>(provider + 1) + ((allocSeed >> 16) & 1u);
+        for (unsigned t = std::min(startT, TABLES - 1); t < TABLES && !allocated; ++t) {
+            Entry& e = tables[t][index[t]];
+            if (e.useful == 0) {
+                e = Entry{tag[t], static_cast<int8_t>(taken ? 0 : -1), 0, true};
+                allocated = true;
+            }
+        }
+        if (!allocated)   // Age everyone so future allocations can succeed
+            for (unsigned t = static_cast<unsigned>(provider + 1); t < TABLES; ++t)
+                if (tables[t][index[t]].useful) --tables[t][index[t]].useful;
+    }
+
+    history = (history << 1) | (taken ? 1u : 0u);
+}
+
+std::unique_ptr<BranchPredictor> makeBranchPredictor(const std::string& name) {
+    if (name == "static")  return std::unique_ptr<BranchPredictor>(new StaticPredictor());
+    if (name == "bimodal") return std::unique_ptr<BranchPredictor>(new BimodalPredictor());
+    if (name == "gshare")  return std::unique_ptr<BranchPredictor>(new GsharePredictor());
+    if (name == "tage")    return std::unique_ptr<BranchPredictor>(new TagePredictor());
+    return nullptr;
+}
+
+// =============================================================================
+// BRANCH SIMULATOR
+// =============================================================================
+
+BranchSim::BranchSim(std::unique_ptr<BranchPredictor> p, unsigned btbIndexBits)
+    : predictor(std::move(p)),
+      btb(size_t(1) << btbIndexBits, BTBEntry{0, 0, false}),
+      btbMask(static_cast<uint16_t>((1u << btbIndexBits) - 1)),
+      ras{}, rasPos(0), rasCount(0),
+      perPC(MEMORY_SIZE) {}
+
+void BranchSim::onBlock(uint16_t, uint16_t end, BranchKind kind, bool taken, uint16_t next) {
+    if (kind != BranchKind::IRQ && kind != BranchKind::HALT)
+        resolve(static_cast<uint16_t>(end - 1), kind, taken, next);
+}
+
+bool BranchSim::resolve(uint16_t pc, BranchKind kind, bool taken, uint16_t next) {
+    bool correct = true;
+
+    switch (kind) {
+        case BranchKind::JZ: {
+            BTBEntry& e = btb[pc & btbMask];
+            bool btbHit = e.valid && e.pc == pc;
+            // The taken target is only visible when the branch is taken; otherwise
+            // fall back to the BTB's memory of it (or treat it as a forward branch).
+            uint16_t target = taken ? next : (btbHit ? e.target : static_cast<uint16_t>(pc + 1));
+            bool predTaken = predictor->predict(pc, target);
+            predictor->update(pc, target, taken);
+            // Redirecting fetch without a bubble also needs the right BTB target.
+            correct = (predTaken == taken) && (!taken || (btbHit && e.target == next));
+            if (taken) e = BTBEntry{pc, next, true};
+            jzTotal.executed++;
+            if (!correct) jzTotal.mispredicted++;
+            break;
+        }
+
+        case BranchKind::JMP:
+        case BranchKind::CALL: {
+            BTBEntry& e = btb[pc & btbMask];
+            correct = e.valid && e.pc == pc && e.target == next;
+            e = BTBEntry{pc, next, true};
+            if (kind == BranchKind::CALL) {
+                ras[rasPos] = static_cast<uint16_t>(pc + 1);
+                rasPos = (rasPos + 1) & 7u;
+                if (rasCount < 8) ++rasCount;
+            }
+            indirectTotal.executed++;
+            if (!correct) indirectTotal.mispredicted++;
+            break;
+        }
+
+        case BranchKind::RET: {
+            if (rasCount) {
+                rasPos = (rasPos + 7) & 7u;
+                --rasCount;
+                correct = ras[rasPos] == next;
+            } else {
+                correct = false;
+            }
+            retTotal.executed++;
+            if (!correct) retTotal.mispredicted++;
+            break;
+        }
+
+        default:
+            // RETI: returns to an interrupted, unpredictable PC.
+            return false;
+    }
+
+    BranchCounters& c = perPC[pc];
+    c.executed++;
+    if (!correct) c.mispredicted++;
+    return correct;
+}
+
+static void printRate(std::ostream& os, const char* label, const BranchCounters& c) {
+    double rate = c.executed ? 100.0 * static_cast<double>(c.mispredicted) / static_cast<double>(c.executed) : 0.0;
+    os << label << c.executed << " executed, " << c.mispredicted << " mispredicted (" << std::fixed << std::setprecision(2)
+       << rate << "%)" << std::defaultfloat << "\n";
+}
+
+void BranchSim::printReport(std::ostream& os, size_t topN, const DebugMap* map) const {
+    os << "\n--- Branch prediction (" << predictor->name() << ") ---\n";
+    printRate(os, "JZ (direction):  ", jzTotal);
+    printRate(os, "JMP/CALL (BTB):  ", indirectTotal);
+    printRate(os, "RET (RAS):       ", retTotal);
+
+    BranchCounters all;
+    all.executed = jzTotal.executed + indirectTotal.executed + retTotal.executed;
+    all.mispredicted = jzTotal.mispredicted + indirectTotal.mispredicted + retTotal.mispredicted;
+    printRate(os, "Overall:         ", all);
+
+    std::vector<uint16_t> pcs;
+    for (size_t pc = 0; pc < MEMORY_SIZE; ++pc)
+        if (perPC[pc].mispredicted) pcs.push_back(static_cast<uint16_t>(pc));
+    std::sort(pcs.begin(), pcs.end(), [this](uint16_t a, uint16_t b) {
+        return perPC[a].mispredicted > perPC[b].mispredicted;
+    });
+    if (pcs.size() > topN) pcs.resize(topN);
+    if (pcs.empty()) return;
+
+    os << "\n  PC     | executed   mispred    rate\n";
+    for (uint16_t pc : pcs) {
+        const BranchCounters& c = perPC[pc];
+        os << "  0x" << std::hex << std::setw(4) << std::setfill('0') << pc << std::dec << std::setfill(' ')
+           << " | " << std::setw(10) << c.executed << " " << std::setw(10) << c.mispredicted << " "
+           << std::fixed << std::setprecision(1) << std::setw(6)
+           << 100.0 * static_cast<double>(c.mispredicted) / static_cast<double>(c.executed) << "%" << std::defaultfloat;
+        if (map) os << "  " << map->describe(pc);
+        os << "\n";
+    }
+}
@@ -0,0 +1,171 @@
+/**
+ * 16-bit GPR CPU Emulator - Branch Predictor Simulation
+ * Pluggable direction predictors for JZ, a BTB for register-indirect
+ * JMP/CALL and a return-address stack for RET.
+ */
+
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include "gpr_cpu.h"
+#include "debug_map.h"
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// DIRECTION PREDICTORS (for JZ)
+// =============================================================================
+
+/** Predicts taken / not-taken for conditional branches. */
+class BranchPredictor {
+public:
+    virtual ~BranchPredictor() = default;
+
+    /** Predict the branch at `pc` whose taken-target is `target`. */
+    virtual bool predict(uint16_t pc, uint16_t target) = 0;
+
+    /** Train with the real outcome (called right after predict). */
+    virtual void update(uint16_t pc, uint16_t target, bool taken) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+/** Static: backward-taken / forward-not-taken. */
+class StaticPredictor : public BranchPredictor {
+public:
+    bool predict(uint16_t pc, uint16_t target) override { return target <= pc; }
+    void update(uint16_t, uint16_t, bool) override {}
+    const char* name() const override { return "static (BTFN)"; }
+};
+
+/** Bimodal: 2-bit saturating counters indexed by PC. */
+class BimodalPredictor : public BranchPredictor {
+public:
+    explicit BimodalPredictor(unsigned indexBits = 12);
+    bool predict(uint16_t pc, uint16_t target) override;
+    void update(uint16_t pc, uint16_t target, bool taken) override;
+    const char* name() const override { return "bimodal"; }
+
+private:
+    std::vector<uint8_t> counters;
+    uint16_t mask;
+};
+
+/** Gshare: 2-bit counters indexed by PC XOR global history. */
+class GsharePredictor : public BranchPredictor {
+public:
+    explicit GsharePredictor(unsigned historyBits = 12);
+    bool predict(uint16_t pc, uint16_t target) override;
+    void update(uint16_t pc, uint16_t target, bool taken) override;
+    const char* name() const override { return "gshare"; }
+
+private:
+    std::vector<uint8_t> counters;
+    uint32_t history;
+    uint32_t mask;
+};
+
+/**
+ * TAGE-lite: a bimodal base plus four tagged tables using geometric
+ * global-history lengths (4, 8, 16, 32). The longest matching table
+ * provides the prediction; on a misprediction one longer table gets a
+ * new entry. Tags are 8 bits and each table has 2^indexBits entries.
+ */
+class TagePredictor : public BranchPredictor {
+public:
+    explicit TagePredictor(unsigned indexBits = 10);
+    bool predict(uint16_t pc, uint16_t target) override;
+    void update(uint16_t pc, uint16_t target, bool taken) override;
+    const char* name() const override { return "TAGE-lite"; }
+
+private:
+    static constexpr unsigned TABLES = 4;
+
+    struct Entry {
+        uint8_t tag;
+        int8_t ctr;      // 3-bit signed: taken when >= 0
+        uint8_t useful;  // 2-bit
+        bool valid;      // Allocated; a never-used entry matches no tag (0 included)
+    };
+
+    std::vector<uint8_t> base;            // 2-bit bimodal counters
+    std::vector<Entry> tables[TABLES];
+    unsigned indexBits;
+    uint64_t history;
+    uint32_t allocSeed;
+
+    // Lookup state from the last predict(), consumed by update().
+    int provider;
+    int altProvider;
+    size_t index[TABLES];
+    uint8_t tag[TABLES];
+
+    uint32_t foldHistory(unsigned length, unsigned bits) const;
+};
+
+/** Build a predictor by name: "static", "bimodal", "gshare" or "tage". Returns nullptr if unknown. */
+std::unique_ptr<BranchPredictor> makeBranchPredictor(const std::string& name);
+
+// =============================================================================
+// BRANCH SIMULATOR (ControlFlowListener)
+// =============================================================================
+
+/** Per-branch counters. */
+struct BranchCounters {
+    uint64_t executed = 0;
+    uint64_t mispredicted = 0;
+};
+
+/**
+ * BranchSim evaluates a direction predictor on every JZ, a direct-mapped
+ * BTB on every JMP/CALL (all register-indirect in this ISA) and an
+ * 8-entry return-address stack on RET.
+ *
+ * Either attach it to the CPU with addFlowListener(), or hand it to
+ * PipelineTiming::setBranchSim() so mispredictions drive the pipeline's
+ * branch penalty. Do not do both, or each branch is counted twice.
+ */
+class BranchSim : public ControlFlowListener {
+public:
+    BranchSim(std::unique_ptr<BranchPredictor> predictor, unsigned btbIndexBits = 8);
+
+    void onBlock(uint16_t start, uint16_t end, BranchKind kind, bool taken, uint16_t next) override;
+
+    /**
+     * Predict, train and count one branch at `pc`. Returns true when the
+     * front end would have fetched `next` without a bubble.
+     */
+    bool resolve(uint16_t pc, BranchKind kind, bool taken, uint16_t next);
+
+    const BranchCounters& conditionalTotals() const { return jzTotal; }
+    const BranchCounters& indirectTotals() const { return indirectTotal; }
+    const BranchCounters& returnTotals() const { return retTotal; }
+    const BranchCounters& countersAt(uint16_t pc) const { return perPC[pc]; }
+
+    /**
+     * Print overall rates and the `topN` branch PCs with most mispredictions,
+     * each with its label and source line if `map` is given.
+     */
+    void printReport(std::ostream& os, size_t topN = 10, const DebugMap* map = nullptr) const;
+
+private:
+    struct BTBEntry {
+        uint16_t pc;
+        uint16_t target;
+        bool valid;
+    };
+
+    std::unique_ptr<BranchPredictor> predictor;
+    std::vector<BTBEntry> btb;
+    uint16_t btbMask;
+    uint16_t ras[8];     // Circular: overflow overwrites the oldest return address
+    unsigned rasPos;     // Next slot to push into
+    unsigned rasCount;   // Valid entries (at most 8)
+    BranchCounters jzTotal, indirectTotal, retTotal;
+    std::vector<BranchCounters> perPC;   // 65536 entries
+};
+
+#endif // BRANCH_PREDICTOR_H
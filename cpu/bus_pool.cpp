@@ -0,0 +1,36 @@
+/**
+ * 16-bit GPR CPU Emulator - Bus Pool
+ */
+
+#include "bus_pool.h"
+
+BusPool::BusPool(const ProgramImage& image, BusArena* arena) : image(image), arena(arena) {}
+
+Bus* BusPool::acquire() {
+    if (!freeList.empty()) {
+        Bus* bus = freeList.back();
+        freeList.pop_back();
+        return bus;
+    }
+    if (arena) {
+        all.emplace_back(new Bus(*arena));
+        all.back()->loadMemory(image.words());
+    } else {
+        all.emplace_back(new Bus(image));
+    }
+    return all.back().get();
+}
+
+void BusPool::release(Bus* bus) {
+    bus->setProbe(nullptr);
+    for (unsigned slot = 0; slot < MMIO_SLOTS; ++slot)
+        bus->attachDevice(slot, nullptr);
+    bus->clearSliceBreak();
+
+    // Small runs: copying a few pages beats a syscall. Large runs: let the
+    // host drop them, which also gives the memory back. Arena Buses do not
+    // map the image, so dropping pages would revert them to zeros.
+    if (arena || bus->writtenPageCount() <= DISCARD_PAGES || !bus->discardMemory())
+        bus->resetMemory(image.words());
+    freeList.push_back(bus);
+}
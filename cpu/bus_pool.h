@@ -0,0 +1,61 @@
+/**
+ * 16-bit GPR CPU Emulator - Bus Pool
+ * Recycles Bus instances between short runs instead of building new ones.
+ */
+
+#ifndef BUS_POOL_H
+#define BUS_POOL_H
+
+#include "gpr_cpu.h"
+#include "placement.h"
+#include "program_image.h"
+#include <memory>
+#include <vector>
+
+/**
+ * BusPool: hands out Buses that all start from one ProgramImage and takes
+ * them back for reuse. release() restores only the pages the run wrote:
+ *
+ *   - up to DISCARD_PAGES written pages: copy them back from the image
+ *     (Bus::resetMemory), about 512 bytes each;
+ *   - more than that: drop the host pages (Bus::discardMemory) so they
+ *     re-map the image on next touch and their memory is freed.
+ *
+ * Either way the cost tracks what the run wrote, not the 128 KiB address
+ * space. release() also detaches devices and any probe; the CPU is the
+ * caller's, so call GPRCPU::reset() as usual.
+ *
+ * Only writes made through the Bus are tracked. Do not assemble into a
+ * pooled Bus through getMemory(); build the ProgramImage instead.
+ *
+ * With a BusArena, Buses are carved from its huge-page slabs on its NUMA
+ * node and start as a copy of the image instead of a shared mapping;
+ * release() then always copies written pages back.
+ *
+ * Not thread-safe: use one pool (and arena) per worker thread.
+ */
+class BusPool {
+public:
+    /** Written-page count above which release() discards instead of copying. */
+    static constexpr size_t DISCARD_PAGES = 64;
+
+    /** The image, and `arena` if given, must outlive the pool. */
+    explicit BusPool(const ProgramImage& image, BusArena* arena = nullptr);
+
+    /** Get a Bus whose memory equals the image (reused if one is free). */
+    Bus* acquire();
+
+    /** Return `bus` (from acquire()) in its original state for reuse. */
+    void release(Bus* bus);
+
+    size_t created() const { return all.size(); }
+    size_t available() const { return freeList.size(); }
+
+private:
+    const ProgramImage& image;
+    BusArena* arena;
+    std::vector<std::unique_ptr<Bus>> all;
+    std::vector<Bus*> freeList;
+};
+
+#endif // BUS_POOL_H
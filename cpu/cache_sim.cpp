@@ -0,0 +1,146 @@
+/**
+ * 16-bit GPR CPU Emulator - Cache Simulator
+ */
+
+#include "cache_sim.h"
+#include <algorithm>
+#include <iomanip>
+
+// =============================================================================
+// CACHE MODEL
+// =============================================================================
+
+/** floor(log2(v)) for v > 0. */
+static unsigned log2u(unsigned v) {
+    unsigned r = 0;
+    while (v >>= 1) ++r;
+    return r;
+}
+
+CacheModel::CacheModel(const CacheConfig& cfg) : config(cfg), clock(0), writebacks(0), rng(0x9E3779B9u) {
+    // Round geometry down to powers of two so index/tag are shifts and masks.
+    if (config.lineBytes < 2) config.lineBytes = 2;
+    if (config.associativity == 0) config.associativity = 1;
+    if (config.setSampling == 0) config.setSampling = 1;
+    config.lineBytes = 1u << log2u(config.lineBytes);
+    unsigned lines = std::max(1u, config.sizeBytes / config.lineBytes);
+    config.associativity = std::min(config.associativity, lines);
+    sets = 1u << log2u(std::max(1u, lines / config.associativity));
+    lineShift = log2u(config.lineBytes / 2);
+    ways.assign(static_cast<size_t>(sets) * config.associativity, Way{0, 0, false, false});
+}
+
+void CacheModel::clear() {
+    for (Way& w : ways) w = Way{0, 0, false, false};
+}
+
+int CacheModel::access(uint16_t address, bool write) {
+    uint32_t line = static_cast<uint32_t>(address) >> lineShift;
+    unsigned set = line & (sets - 1);
+    if (set % config.setSampling)
+        return -1;
+    uint32_t tag = line / sets;
+
+    Way* base = &ways[static_cast<size_t>(set) * config.associativity];
+    ++clock;
+
+    for (unsigned w = 0; w < config.associativity; ++w) {
+        if (base[w].valid && base[w].tag == tag) {
+            if (config.policy == ReplacementPolicy::LRU) base[w].stamp = clock;
+            base[w].dirty |= write;
+            return 1;
+        }
+    }
+
+    // Miss: fill an invalid way if there is one, else evict per policy.
+    Way* victim = nullptr;
+    for (unsigned w = 0; w < config.associativity && !victim; ++w)
+        if (!base[w].valid) victim = &base[w];
+    if (!victim) {
+        if (config.policy == ReplacementPolicy::RANDOM) {
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;   // xorshift32
+            victim = &base[rng % config.associativity];
+        } else {
+            victim = base;   // LRU and FIFO both evict the smallest stamp
+            for (unsigned w = 1; w < config.associativity; ++w)
+                if (base[w].stamp < victim->stamp) victim = &base[w];
+        }
+        if (victim->dirty) ++writebacks;
+    }
+    *victim = Way{tag, clock, true, write};
+    return 0;
+}
+
+// =============================================================================
+// CACHE SIMULATOR (BusProbe)
+// =============================================================================
+
+CacheSim::CacheSim(const CacheConfig& icfg, const CacheConfig& dcfg)
+    : icache(icfg), dcache(dcfg), currentPC(0), iPerPC(MEMORY_SIZE), dPerPC(MEMORY_SIZE) {}
+
+void CacheSim::processBatch(const Access* accesses, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const Access& a = accesses[i];
+        bool isFetch = a.kind == AccessKind::FETCH;
+        if (isFetch) currentPC = a.address;
+
+        CacheModel& cache = isFetch ? icache : dcache;
+        int hit = cache.access(a.address, a.kind == AccessKind::WRITE);
+        if (hit < 0)
+            continue;   // Set not sampled
+
+        // Scale sampled sets back up so totals estimate the full stream.
+        uint64_t weight = cache.getConfig().setSampling;
+        uint64_t miss = hit ? 0 : weight;
+        CacheCounters& total = isFetch ? iTotal : dTotal;
+        CacheCounters& pc = isFetch ? iPerPC[currentPC] : dPerPC[currentPC];
+        CacheCounters& region = isFetch ? iPerRegion[a.address >> 8] : dPerRegion[a.address >> 8];
+        total.accesses += weight;  total.misses += miss;
+        pc.accesses += weight;     pc.misses += miss;
+        region.accesses += weight; region.misses += miss;
+    }
+}
+
+static void printCacheLine(std::ostream& os, const char* name, const CacheModel& c, const CacheCounters& t) {
+    const CacheConfig& cfg = c.getConfig();
+    os << name << " " << cfg.sizeBytes << "B " << cfg.associativity << "-way " << cfg.lineBytes << "B lines: "
+       << t.accesses << " accesses, " << t.misses << " misses (" << std::fixed << std::setprecision(2)
+       << 100.0 * t.missRate() << "%)" << std::defaultfloat;
+    if (cfg.setSampling > 1) os << " [1/" << cfg.setSampling << " sets sampled]";
+    os << "\n";
+}
+
+void CacheSim::printReport(std::ostream& os, size_t topN, const DebugMap* map) {
+    flush();
+    os << "\n--- Cache simulation ---\n";
+    printCacheLine(os, "L1I", icache, iTotal);
+    printCacheLine(os, "L1D", dcache, dTotal);
+    os << "L1D writebacks: " << dcache.getWritebacks() << "\n";
+
+    // Top PCs by combined misses.
+    std::vector<uint16_t> pcs;
+    for (size_t pc = 0; pc < MEMORY_SIZE; ++pc)
+        if (iPerPC[pc].misses || dPerPC[pc].misses) pcs.push_back(static_cast<uint16_t>(pc));
+    std::sort(pcs.begin(), pcs.end(), [this](uint16_t a, uint16_t b) {
+        return iPerPC[a].misses + dPerPC[a].misses > iPerPC[b].misses + dPerPC[b].misses;
+    });
+    if (pcs.size() > topN) pcs.resize(topN);
+
+    os << "\n  PC     | I acc     I miss    | D acc     D miss\n";
+    for (uint16_t pc : pcs) {
+        os << "  0x" << std::hex << std::setw(4) << std::setfill('0') << pc << std::dec << std::setfill(' ')
+           << " | " << std::setw(9) << iPerPC[pc].accesses << " " << std::setw(9) << iPerPC[pc].misses
+           << " | " << std::setw(9) << dPerPC[pc].accesses << " " << std::setw(9) << dPerPC[pc].misses;
+        if (map) os << "  " << map->describe(pc);
+        os << "\n";
+    }
+
+    os << "\n  Region      | I acc     I miss    | D acc     D miss\n";
+    for (unsigned r = 0; r < 256; ++r) {
+        if (!iPerRegion[r].accesses && !dPerRegion[r].accesses) continue;
+        os << "  0x" << std::hex << std::setw(2) << std::setfill('0') << r << "00-" << std::setw(2) << r << "FF"
+           << std::dec << std::setfill(' ')
+           << " | " << std::setw(9) << iPerRegion[r].accesses << " " << std::setw(9) << iPerRegion[r].misses
+           << " | " << std::setw(9) << dPerRegion[r].accesses << " " << std::setw(9) << dPerRegion[r].misses << "\n";
+    }
+}
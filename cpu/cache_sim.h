@@ -0,0 +1,120 @@
+/**
+ * 16-bit GPR CPU Emulator - Cache Simulator
+ * Set-associative L1 instruction and data cache models driven by the Bus.
+ */
+
+#ifndef CACHE_SIM_H
+#define CACHE_SIM_H
+
+#include "gpr_cpu.h"
+#include "debug_map.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/** Victim selection when a set is full. */
+enum class ReplacementPolicy : uint8_t { LRU, FIFO, RANDOM };
+
+/** Geometry of one cache. Sizes are in bytes; one guest word is 2 bytes. */
+struct CacheConfig {
+    unsigned sizeBytes = 1024;
+    unsigned associativity = 2;
+    unsigned lineBytes = 16;
+    ReplacementPolicy policy = ReplacementPolicy::LRU;
+    /**
+     * Set sampling: simulate only every Nth set and scale the counts by N.
+     * 1 simulates every access; larger values trade accuracy for speed.
+     */
+    unsigned setSampling = 1;
+};
+
+/** Hit/miss counters. */
+struct CacheCounters {
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+
+    double missRate() const { return accesses ? static_cast<double>(misses) / static_cast<double>(accesses) : 0.0; }
+};
+
+/**
+ * CacheModel: one set-associative, write-back, write-allocate cache.
+ * Only tags are modelled; data always comes from the Bus.
+ */
+class CacheModel {
+public:
+    explicit CacheModel(const CacheConfig& config);
+
+    /**
+     * Look up the line holding word `address`.
+     * Returns 1 on hit, 0 on miss, -1 if the set is not sampled.
+     */
+    int access(uint16_t address, bool write);
+
+    const CacheConfig& getConfig() const { return config; }
+    unsigned numSets() const { return sets; }
+    uint64_t getWritebacks() const { return writebacks; }
+
+    /** Empty every line. */
+    void clear();
+
+private:
+    struct Way {
+        uint32_t tag;
+        uint64_t stamp;  // LRU: last use; FIFO: fill time
+        bool valid;
+        bool dirty;
+    };
+
+    CacheConfig config;
+    unsigned sets;
+    unsigned lineShift;      // log2(line size in words)
+    std::vector<Way> ways;   // sets * associativity
+    uint64_t clock;
+    uint64_t writebacks;
+    uint32_t rng;
+};
+
+/**
+ * CacheSim: a BusProbe feeding an L1I (fetches) and an L1D (reads and
+ * writes). Results are kept per PC and per 256-word address region.
+ * Data accesses are charged to the PC of the most recent fetch. Accesses
+ * arrive in BusProbe batches, so the CPU hot path only appends a record.
+ *
+ * Attach with bus.setProbe(&sim). Call flush() (or printReport) before
+ * reading the counters.
+ */
+class CacheSim : public BusProbe {
+public:
+    CacheSim(const CacheConfig& icache = CacheConfig(), const CacheConfig& dcache = CacheConfig());
+
+    const CacheCounters& icacheTotals() const { return iTotal; }
+    const CacheCounters& dcacheTotals() const { return dTotal; }
+
+    /** Per-PC counters for fetches (I) and for data accesses made by that PC (D). */
+    const CacheCounters& icacheAt(uint16_t pc) const { return iPerPC[pc]; }
+    const CacheCounters& dcacheAt(uint16_t pc) const { return dPerPC[pc]; }
+
+    /** Per-region counters (region = address >> 8). */
+    const CacheCounters& regionCounters(uint8_t region, bool instruction) const {
+        return instruction ? iPerRegion[region] : dPerRegion[region];
+    }
+
+    /**
+     * Print totals, the `topN` PCs with most misses (with label and source
+     * line if `map` is given) and every active region.
+     */
+    void printReport(std::ostream& os, size_t topN = 10, const DebugMap* map = nullptr);
+
+protected:
+    void processBatch(const Access* accesses, size_t n) override;
+
+private:
+    CacheModel icache;
+    CacheModel dcache;
+    uint16_t currentPC;
+    CacheCounters iTotal, dTotal;
+    std::vector<CacheCounters> iPerPC, dPerPC;   // 65536 entries each
+    CacheCounters iPerRegion[256], dPerRegion[256];
+};
+
+#endif // CACHE_SIM_H
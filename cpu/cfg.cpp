@@ -0,0 +1,676 @@
+/**
+ * 16-bit GPR CPU Emulator - Control-Flow Graph and Static Analysis
+ */
+
+#include "cfg.h"
+#include <algorithm>
+#include <cstdio>
+
+// =============================================================================
+// DECODING
+// =============================================================================
+
+static uint8_t opOf(uint16_t inst) { return static_cast<uint8_t>((inst >> 12) & 0xFu); }
+static uint8_t rdOf(uint16_t inst) { return static_cast<uint8_t>((inst >> 9) & 0x7u); }
+static uint8_t rsOf(uint16_t inst) { return static_cast<uint8_t>((inst >> 6) & 0x7u); }
+static uint8_t groupOf(uint16_t inst) { return static_cast<uint8_t>((inst >> 3) & 0x7u); }
+static uint8_t rcOf(uint16_t inst) { return static_cast<uint8_t>(inst & 0x7u); }
+
+/** BlockExit::FALLTHROUGH for every instruction that does not end a block. */
+static BlockExit exitOf(uint16_t inst) {
+    switch (static_cast<Opcode>(opOf(inst))) {
+        case Opcode::HALT: return BlockExit::HALT;
+        case Opcode::JMP:  return BlockExit::JMP;
+        case Opcode::JZ:   return BlockExit::JZ;
+        case Opcode::NOP:
+            if (static_cast<ExtOp>(groupOf(inst)) != ExtOp::MISC) break;
+            switch (static_cast<MiscOp>(rcOf(inst))) {
+                case MiscOp::RET:  return BlockExit::RET;
+                case MiscOp::RETI: return BlockExit::RETI;
+                case MiscOp::CALL: return BlockExit::CALL;
+                default: break;
+            }
+            break;
+        default: break;
+    }
+    return BlockExit::FALLTHROUGH;
+}
+
+static bool hasTarget(BlockExit e) { return e == BlockExit::JMP || e == BlockExit::JZ || e == BlockExit::CALL; }
+
+// =============================================================================
+// CONSTANT TRANSFER FUNCTION (mirrors GPRCPU::execute)
+// =============================================================================
+
+static constexpr unsigned F = RegConstants::FLAGS_INDEX;
+
+static uint16_t resultFlags(uint16_t r) {
+    return static_cast<uint16_t>((r == 0 ? FLAG_ZERO : 0) | ((r & 0x8000u) ? FLAG_NEGATIVE : 0));
+}
+
+/** Rd = result with Z/N flags (C cleared), known only if `ok`. */
+static void setResult(RegConstants& s, unsigned rd, bool ok, uint16_t r) {
+    if (ok) {
+        s.set(rd, r);
+        s.set(F, resultFlags(r));
+    } else {
+        s.forget(rd);
+        s.forget(F);
+    }
+}
+
+static void evalInstruction(uint16_t inst, RegConstants& s) {
+    const unsigned rd = rdOf(inst), rs = rsOf(inst);
+    const bool both = s.isKnown(rd) && s.isKnown(rs);
+    const uint16_t a = s.value[rd], b = s.value[rs];
+
+    switch (static_cast<Opcode>(opOf(inst))) {
+        case Opcode::MOVI:
+            s.set(rd, inst & 0x1FFu);     // FLAGS unchanged
+            break;
+        case Opcode::MOV:
+            setResult(s, rd, s.isKnown(rs), b);
+            break;
+        case Opcode::LOAD:
+            s.forget(rd);
+            s.forget(F);
+            break;
+        case Opcode::ADD: {
+            uint16_t r = static_cast<uint16_t>(a + b);
+            setResult(s, rd, both, r);
+            if (both && a + b > 0xFFFFu) s.value[F] |= FLAG_CARRY;
+            break;
+        }
+        case Opcode::SUB: {
+            bool self = rd == rs;         // SUB Rd, Rd is 0 whatever Rd held
+            uint16_t r = self ? 0 : static_cast<uint16_t>(a - b);
+            setResult(s, rd, both || self, r);
+            if ((both && a >= b) || self) s.value[F] |= FLAG_CARRY;
+            break;
+        }
+        case Opcode::AND: setResult(s, rd, both, a & b); break;
+        case Opcode::OR:  setResult(s, rd, both, a | b); break;
+        case Opcode::XOR: setResult(s, rd, both || rd == rs, rd == rs ? 0 : a ^ b); break;
+        case Opcode::NOT: setResult(s, rd, s.isKnown(rs), static_cast<uint16_t>(~b)); break;
+        case Opcode::SHL:
+            setResult(s, rd, s.isKnown(rd), static_cast<uint16_t>(a << 1));
+            if (s.isKnown(rd) && (a & 0x8000u)) s.value[F] |= FLAG_CARRY;
+            break;
+        case Opcode::SHR:
+            setResult(s, rd, s.isKnown(rd), static_cast<uint16_t>(a >> 1));
+            if (s.isKnown(rd) && (a & 1u)) s.value[F] |= FLAG_CARRY;
+            break;
+        case Opcode::NOP:
+            switch (static_cast<ExtOp>(groupOf(inst))) {
+                case ExtOp::CAS:
+                    s.forget(rd);
+                    s.forget(F);
+                    break;
+                case ExtOp::MISC:
+                    if (static_cast<MiscOp>(rcOf(inst)) == MiscOp::POP) s.forget(rd);
+                    break;
+                case ExtOp::SYS: {
+                    SysOp sub = static_cast<SysOp>(rcOf(inst));
+                    if (sub == SysOp::GETSP || sub == SysOp::CPUID) s.forget(rd);
+                    break;
+                }
+                default: break;
+            }
+            break;
+        default:   // HALT, STORE, JMP, JZ: no register effect
+            break;
+    }
+}
+
+/** Meet (intersection) of two states; returns true if `into` changed. */
+static bool meet(RegConstants& into, const RegConstants& other) {
+    uint16_t known = into.known & other.known;
+    for (unsigned r = 0; r <= F; ++r)
+        if (((known >> r) & 1u) && into.value[r] != other.value[r])
+            known &= static_cast<uint16_t>(~(1u << r));
+    bool changed = known != into.known;
+    into.known = known;
+    return changed;
+}
+
+// =============================================================================
+// CFG CONSTRUCTION
+// =============================================================================
+
+namespace {
+
+/** Working state shared by the analysis phases. */
+struct Builder {
+    const uint16_t* mem;
+    std::vector<uint8_t> code;     // Word was decoded as an instruction
+    std::vector<uint8_t> leader;   // Word starts a block
+    std::vector<uint8_t> isFunction;
+    std::vector<uint16_t> work;
+    ProgramCFG& cfg;
+
+    Builder(const uint16_t* m, ProgramCFG& c)
+        : mem(m), code(MEMORY_SIZE, 0), leader(MEMORY_SIZE, 0), isFunction(MEMORY_SIZE, 0), cfg(c) {}
+
+    /**
+     * Phase 1: walk straight-line code from every pending address, marking
+     * code words and leaders. Targets known from constants within the walk
+     * (the MOVI R7 idiom) are queued; the rest wait for phase 2.
+     */
+    void explore() {
+        while (!work.empty()) {
+            uint16_t start = work.back();
+            work.pop_back();
+            leader[start] = 1;
+            if (code[start]) continue;
+            RegConstants local;
+            for (uint32_t pc = start;; ++pc) {
+                pc &= 0xFFFFu;
+                if (code[pc] && pc != start) break;   // Joined code explored earlier
+                code[pc] = 1;
+                uint16_t inst = mem[pc];
+                BlockExit exit = exitOf(inst);
+                uint16_t next = static_cast<uint16_t>(pc + 1);
+                if (exit == BlockExit::FALLTHROUGH) {
+                    evalInstruction(inst, local);
+                    if (next == 0) { work.push_back(0); break; }
+                    continue;
+                }
+                if (hasTarget(exit) && local.isKnown(rsOf(inst)))
+                    work.push_back(local.value[rsOf(inst)]);
+                if (exit == BlockExit::JZ || exit == BlockExit::CALL)
+                    work.push_back(next);
+                break;
+            }
+        }
+    }
+
+    /** Cut the code words into blocks at leaders and after exits. */
+    void formBlocks() {
+        cfg.blocks.clear();
+        cfg.blockOf.assign(MEMORY_SIZE, -1);
+        size_t starts = 0;
+        for (uint32_t pc = 0; pc < MEMORY_SIZE; ++pc)
+            starts += code[pc] && (pc == 0 || leader[pc] || !code[pc - 1] || exitOf(mem[pc - 1]) != BlockExit::FALLTHROUGH);
+        cfg.blocks.reserve(starts);
+        for (uint32_t pc = 0; pc < MEMORY_SIZE; ++pc) {
+            if (!code[pc]) continue;
+            BasicBlock b{};
+            b.start = static_cast<uint16_t>(pc);
+            b.target = 0;
+            b.zKnown = -1;
+            b.loop = -1;
+            int32_t index = static_cast<int32_t>(cfg.blocks.size());
+            for (;;) {
+                cfg.blockOf[pc] = index;
+                ++b.length;
+                b.exit = exitOf(mem[pc]);
+                if (b.exit != BlockExit::FALLTHROUGH || pc + 1 >= MEMORY_SIZE || !code[pc + 1] || leader[pc + 1])
+                    break;
+                ++pc;
+            }
+            cfg.blocks.push_back(b);
+        }
+    }
+
+    /** Run the block body (all but a branch exit) over `s`. */
+    void evalBlock(const BasicBlock& b, RegConstants& s) const {
+        uint16_t count = b.exit == BlockExit::FALLTHROUGH ? b.length : static_cast<uint16_t>(b.length - 1);
+        for (uint16_t i = 0; i < count; ++i)
+            evalInstruction(mem[static_cast<uint16_t>(b.start + i)], s);
+    }
+
+    /** Block starting exactly at `pc`, or -1 (not yet a leader). */
+    int32_t blockStarting(uint16_t pc) const {
+        int32_t i = cfg.blockOf[pc];
+        return (i >= 0 && cfg.blocks[i].start == pc) ? i : -1;
+    }
+
+    /**
+     * Phase 2: conditional constant propagation. Only edges that can be
+     * taken under the known constants carry state, so a JZ with a known Z
+     * leaves its other side unreached. Returns the branch targets that are
+     * not block starts yet.
+     */
+    std::vector<uint16_t> propagate() {
+        const size_t n = cfg.blocks.size();
+        std::vector<uint8_t> reached(n, 0), queued(n, 0);
+        std::vector<uint32_t> queue;
+        std::vector<uint16_t> missing;
+        RegConstants unknown;
+
+        auto flow = [&](int32_t to, const RegConstants& s) {
+            if (to < 0) return;
+            BasicBlock& t = cfg.blocks[to];
+            bool changed = false;
+            if (!reached[to]) {
+                reached[to] = 1;
+                t.in = s;
+                changed = true;
+            } else {
+                changed = meet(t.in, s);
+            }
+            if (changed && !queued[to]) {
+                queued[to] = 1;
+                queue.push_back(static_cast<uint32_t>(to));
+            }
+        };
+
+        for (uint16_t e : cfg.entries) flow(blockStarting(e), unknown);
+        for (uint16_t f : cfg.functions) flow(blockStarting(f), unknown);
+
+        while (!queue.empty()) {
+            uint32_t i = queue.back();
+            queue.pop_back();
+            queued[i] = 0;
+            BasicBlock& b = cfg.blocks[i];
+            b.out = b.in;
+            evalBlock(b, b.out);
+            uint16_t last = static_cast<uint16_t>(b.end() - 1);
+            uint16_t inst = mem[last];
+            uint16_t next = b.end();
+
+            bool knownTarget = hasTarget(b.exit) && b.out.isKnown(rsOf(inst));
+            uint16_t target = knownTarget ? b.out.value[rsOf(inst)] : 0;
+            if (knownTarget && blockStarting(target) < 0) {
+                missing.push_back(target);
+                knownTarget = false;     // Resolved next round
+            }
+
+            switch (b.exit) {
+                case BlockExit::FALLTHROUGH:
+                    flow(blockStarting(next), b.out);
+                    break;
+                case BlockExit::JMP:
+                    if (knownTarget) flow(blockStarting(target), b.out);
+                    break;
+                case BlockExit::JZ: {
+                    int z = b.out.isKnown(F) ? ((b.out.value[F] & FLAG_ZERO) ? 1 : 0) : -1;
+                    if (z != 0 && knownTarget) flow(blockStarting(target), b.out);
+                    if (z != 1) flow(blockStarting(next), b.out);
+                    break;
+                }
+                case BlockExit::CALL:
+                    // The callee may change anything before it returns.
+                    if (knownTarget && !isFunction[target]) {
+                        isFunction[target] = 1;
+                        cfg.functions.push_back(target);
+                        flow(blockStarting(target), unknown);
+                    }
+                    flow(blockStarting(next), unknown);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Unreached blocks: summarize from nothing known.
+        for (size_t i = 0; i < n; ++i) {
+            BasicBlock& b = cfg.blocks[i];
+            b.reachable = reached[i] != 0;
+            if (!b.reachable) {
+                b.in = unknown;
+                b.out = unknown;
+                evalBlock(b, b.out);
+            }
+        }
+        return missing;
+    }
+
+    /** Final edges and branch facts from the converged constants. */
+    void link() {
+        for (BasicBlock& b : cfg.blocks) {
+            b.succs.clear();
+            b.preds.clear();
+        }
+        for (size_t i = 0; i < cfg.blocks.size(); ++i) {
+            BasicBlock& b = cfg.blocks[i];
+            uint16_t inst = mem[static_cast<uint16_t>(b.end() - 1)];
+            b.indirect = hasTarget(b.exit) && !b.out.isKnown(rsOf(inst));
+            b.target = hasTarget(b.exit) && !b.indirect ? b.out.value[rsOf(inst)] : 0;
+            if (b.exit == BlockExit::JZ && b.out.isKnown(F))
+                b.zKnown = (b.out.value[F] & FLAG_ZERO) ? 1 : 0;
+
+            auto edge = [&](int32_t to) {
+                if (to < 0 || std::find(b.succs.begin(), b.succs.end(), static_cast<uint32_t>(to)) != b.succs.end())
+                    return;
+                b.succs.push_back(static_cast<uint32_t>(to));
+                cfg.blocks[to].preds.push_back(static_cast<uint32_t>(i));
+            };
+            if ((b.exit == BlockExit::JMP || b.exit == BlockExit::JZ) && !b.indirect)
+                edge(blockStarting(b.target));
+            if (b.exit == BlockExit::FALLTHROUGH || b.exit == BlockExit::JZ || b.exit == BlockExit::CALL)
+                edge(blockStarting(b.end()));
+        }
+    }
+
+    void findUnreachable() {
+        cfg.unreachable.clear();
+        for (uint32_t w = 0; w < IVT_BASE; ++w) {
+            if (code[w] || mem[w] == 0) continue;
+            uint16_t first = static_cast<uint16_t>(w);
+            while (w + 1 < IVT_BASE && !code[w + 1] && mem[w + 1] != 0) ++w;
+            cfg.unreachable.emplace_back(first, static_cast<uint16_t>(w));
+        }
+    }
+};
+
+} // namespace
+
+// =============================================================================
+// LOOPS (dominators, then natural loops of back edges)
+// =============================================================================
+
+static void findLoops(ProgramCFG& cfg) {
+    const uint32_t n = static_cast<uint32_t>(cfg.blocks.size());
+    const uint32_t root = n;   // Virtual root above every entry
+    std::vector<uint8_t> isRoot(MEMORY_SIZE, 0);
+    for (uint16_t e : cfg.entries) isRoot[e] = 1;
+    for (uint16_t f : cfg.functions) isRoot[f] = 1;
+    std::vector<uint32_t> rootSuccs;
+    std::vector<uint8_t> fromRoot(n, 0);
+    for (uint32_t i = 0; i < n; ++i) {
+        if (isRoot[cfg.blocks[i].start] || cfg.blocks[i].preds.empty()) {
+            rootSuccs.push_back(i);
+            fromRoot[i] = 1;
+        }
+    }
+    auto succ = [&](uint32_t u) -> const std::vector<uint32_t>& { return u == root ? rootSuccs : cfg.blocks[u].succs; };
+
+    // Reverse postorder by iterative DFS.
+    std::vector<uint32_t> order, rpoIndex(n + 1, UINT32_MAX);
+    std::vector<uint8_t> seen(n + 1, 0);
+    std::vector<std::pair<uint32_t, size_t>> stack{{root, 0}};
+    seen[root] = 1;
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second < succ(top.first).size()) {
+            uint32_t s = succ(top.first)[top.second++];
+            if (!seen[s]) {
+                seen[s] = 1;
+                stack.push_back({s, 0});
+            }
+        } else {
+            order.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    for (uint32_t k = 0; k < order.size(); ++k) rpoIndex[order[k]] = k;
+
+    // Cooper-Harvey-Kennedy iterative dominators.
+    std::vector<uint32_t> idom(n + 1, UINT32_MAX);
+    idom[root] = root;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t k = 1; k < order.size(); ++k) {
+            uint32_t v = order[k], best = fromRoot[v] ? root : UINT32_MAX;
+            for (uint32_t p : cfg.blocks[v].preds) {
+                if (idom[p] == UINT32_MAX) continue;
+                if (best == UINT32_MAX) { best = p; continue; }
+                uint32_t a = p, b = best;
+                while (a != b) {
+                    while (rpoIndex[a] > rpoIndex[b]) a = idom[a];
+                    while (rpoIndex[b] > rpoIndex[a]) b = idom[b];
+                }
+                best = a;
+            }
+            if (best != UINT32_MAX && idom[v] != best) {
+                idom[v] = best;
+                changed = true;
+            }
+        }
+    }
+    auto dominates = [&](uint32_t h, uint32_t v) {
+        if (idom[v] == UINT32_MAX) return false;
+        for (;;) {
+            if (v == h) return true;
+            if (v == root) return false;
+            v = idom[v];
+        }
+    };
+
+    // One loop per header; the body is everything reaching a latch without
+    // passing through the header.
+    cfg.loops.clear();
+    std::vector<int32_t> loopOfHeader(n, -1);
+    for (uint32_t u = 0; u < n; ++u) {
+        for (uint32_t h : cfg.blocks[u].succs) {
+            // Only a retreating edge (against reverse postorder) can be a back edge.
+            if (rpoIndex[h] > rpoIndex[u] || !dominates(h, u)) continue;
+            if (loopOfHeader[h] < 0) {
+                loopOfHeader[h] = static_cast<int32_t>(cfg.loops.size());
+                cfg.loops.push_back(Loop{h, {h}, {}, -1, 1});
+            }
+            cfg.loops[loopOfHeader[h]].latches.push_back(u);
+        }
+    }
+    std::vector<uint8_t> inBody(n, 0);
+    for (Loop& loop : cfg.loops) {
+        std::fill(inBody.begin(), inBody.end(), 0);
+        inBody[loop.header] = 1;
+        std::vector<uint32_t> todo;
+        for (uint32_t l : loop.latches)
+            if (!inBody[l]) { inBody[l] = 1; todo.push_back(l); }
+        while (!todo.empty()) {
+            uint32_t v = todo.back();
+            todo.pop_back();
+            for (uint32_t p : cfg.blocks[v].preds)
+                if (!inBody[p]) { inBody[p] = 1; todo.push_back(p); }
+        }
+        loop.blocks.clear();
+        for (uint32_t v = 0; v < n; ++v)
+            if (inBody[v]) loop.blocks.push_back(v);
+    }
+
+    // Nesting: the parent is the smallest other loop containing the header.
+    // Visiting large loops first lets each block end up in its innermost one.
+    std::vector<uint32_t> bySize(cfg.loops.size());
+    for (uint32_t i = 0; i < bySize.size(); ++i) bySize[i] = i;
+    std::stable_sort(bySize.begin(), bySize.end(), [&](uint32_t a, uint32_t b) {
+        return cfg.loops[a].blocks.size() > cfg.loops[b].blocks.size();
+    });
+    for (uint32_t i : bySize) {
+        Loop& loop = cfg.loops[i];
+        int32_t parent = cfg.blocks[loop.header].loop;   // Innermost larger loop seen so far
+        loop.parent = parent;
+        loop.depth = parent < 0 ? 1 : cfg.loops[parent].depth + 1;
+        for (uint32_t v : loop.blocks) cfg.blocks[v].loop = static_cast<int32_t>(i);
+    }
+}
+
+// =============================================================================
+// PUBLIC API
+// =============================================================================
+
+std::vector<uint16_t> defaultEntries(const uint16_t* memory) {
+    std::vector<uint16_t> entries{0};
+    for (unsigned line = 0; line < 16; ++line) {
+        uint16_t handler = memory[IVT_BASE + line];
+        if (handler != 0 && std::find(entries.begin(), entries.end(), handler) == entries.end())
+            entries.push_back(handler);
+    }
+    return entries;
+}
+
+ProgramCFG buildCFG(const uint16_t* memory, const std::vector<uint16_t>& entries) {
+    ProgramCFG cfg;
+    cfg.entries = entries;
+    Builder b(memory, cfg);
+    b.work = entries;
+
+    // Exploring can only add code, so this ends within a handful of rounds.
+    for (;;) {
+        ++cfg.rounds;
+        b.explore();
+        b.formBlocks();
+        std::vector<uint16_t> missing = b.propagate();
+        if (missing.empty()) break;
+        b.work = missing;
+    }
+    b.link();
+    b.findUnreachable();
+    findLoops(cfg);
+    return cfg;
+}
+
+std::string disassemble(uint16_t inst) {
+    static const char* const names[] = {"HALT", "MOVI", "MOV", "LOAD", "STORE", "ADD", "SUB", "AND",
+                                        "OR", "XOR", "NOT", "SHL", "SHR", "JMP", "JZ", "NOP"};
+    const std::string rd = "R" + std::to_string(rdOf(inst));
+    const std::string rs = "R" + std::to_string(rsOf(inst));
+    const std::string rc = "R" + std::to_string(rcOf(inst));
+    const std::string name = names[opOf(inst)];
+
+    switch (static_cast<Opcode>(opOf(inst))) {
+        case Opcode::HALT: return name;
+        case Opcode::MOVI: return name + " " + rd + ", " + std::to_string(inst & 0x1FFu);
+        case Opcode::LOAD: return name + " " + rd + ", (" + rs + ")";
+        case Opcode::STORE: return name + " " + rd + ", (" + rs + ")";
+        case Opcode::SHL:
+        case Opcode::SHR: return name + " " + rd;
+        case Opcode::JMP:
+        case Opcode::JZ: return name + " " + rs;
+        case Opcode::NOP: break;
+        default: return name + " " + rd + ", " + rs;
+    }
+
+    switch (static_cast<ExtOp>(groupOf(inst))) {
+        case ExtOp::BMOV:  return "BMOV " + rd + ", " + rs + ", " + rc;
+        case ExtOp::BFILL: return "BFILL " + rd + ", " + rs + ", " + rc;
+        case ExtOp::CAS:   return "CAS " + rd + ", (" + rs + "), " + rc;
+        case ExtOp::MISC:
+            switch (static_cast<MiscOp>(rcOf(inst))) {
+                case MiscOp::RET:  return "RET";
+                case MiscOp::RETI: return "RETI";
+                case MiscOp::EI:   return "EI";
+                case MiscOp::DI:   return "DI";
+                case MiscOp::CALL: return "CALL " + rs;
+                case MiscOp::PUSH: return "PUSH " + rd;
+                case MiscOp::POP:  return "POP " + rd;
+                default: return "NOP";
+            }
+        case ExtOp::SYS:
+            switch (static_cast<SysOp>(rcOf(inst))) {
+                case SysOp::SETSP: return "SETSP " + rd;
+                case SysOp::GETSP: return "GETSP " + rd;
+                case SysOp::WFI:   return "WFI";
+                case SysOp::CPUID: return "CPUID " + rd;
+                case SysOp::FENCE: return "FENCE";
+                case SysOp::BRK:   return "BRK";
+                default: return "NOP";
+            }
+        default:
+            return "NOP";
+    }
+}
+
+// =============================================================================
+// DUMPS
+// =============================================================================
+
+static const char* exitName(BlockExit e) {
+    switch (e) {
+        case BlockExit::FALLTHROUGH: return "fallthrough";
+        case BlockExit::JMP:  return "JMP";
+        case BlockExit::JZ:   return "JZ";
+        case BlockExit::CALL: return "CALL";
+        case BlockExit::RET:  return "RET";
+        case BlockExit::RETI: return "RETI";
+        case BlockExit::HALT: return "HALT";
+    }
+    return "?";
+}
+
+static std::string hex4(uint16_t v) {
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), "0x%04X", v);
+    return buf;
+}
+
+static std::string constantsText(const RegConstants& s) {
+    std::string text;
+    for (unsigned r = 0; r < 8; ++r)
+        if (s.isKnown(r)) text += " R" + std::to_string(r) + "=" + hex4(s.value[r]);
+    if (s.isKnown(F)) {
+        text += " Z=" + std::to_string((s.value[F] & FLAG_ZERO) ? 1 : 0);
+        text += " C=" + std::to_string((s.value[F] & FLAG_CARRY) ? 1 : 0);
+        text += " N=" + std::to_string((s.value[F] & FLAG_NEGATIVE) ? 1 : 0);
+    }
+    return text.empty() ? " -" : text;
+}
+
+static std::string exitText(const BasicBlock& b) {
+    std::string text = exitName(b.exit);
+    if (hasTarget(b.exit)) text += b.indirect ? " (indirect)" : " " + hex4(b.target);
+    if (b.zKnown == 1) text += " (always taken)";
+    if (b.zKnown == 0) text += " (never taken)";
+    return text;
+}
+
+void dumpCFG(const ProgramCFG& cfg, const uint16_t* memory, std::ostream& out) {
+    size_t dead = std::count_if(cfg.blocks.begin(), cfg.blocks.end(), [](const BasicBlock& b) { return !b.reachable; });
+    out << "CFG: " << cfg.blocks.size() << " blocks (" << dead << " unreachable), " << cfg.loops.size() << " loops, "
+        << cfg.functions.size() << " functions, " << cfg.rounds << " rounds\n";
+    out << "Entries:";
+    for (uint16_t e : cfg.entries) out << " " << hex4(e);
+    out << "\nFunctions:";
+    for (uint16_t f : cfg.functions) out << " " << hex4(f);
+    out << "\n";
+
+    for (size_t i = 0; i < cfg.blocks.size(); ++i) {
+        const BasicBlock& b = cfg.blocks[i];
+        out << "\nB" << i << " [" << hex4(b.start) << ", " << hex4(b.end()) << ") " << b.length << " insts -> "
+            << exitText(b);
+        if (b.loop >= 0) out << "  loop L" << b.loop;
+        if (!b.reachable) out << "  UNREACHABLE";
+        out << "\n  preds:";
+        if (b.preds.empty()) out << " -";
+        for (uint32_t p : b.preds) out << " B" << p;
+        out << "  succs:";
+        if (b.succs.empty()) out << " -";
+        for (uint32_t s : b.succs) out << " B" << s;
+        out << "\n  in: " << constantsText(b.in) << "\n";
+        for (uint16_t k = 0; k < b.length; ++k) {
+            uint16_t pc = static_cast<uint16_t>(b.start + k);
+            char word[8];
+            std::snprintf(word, sizeof(word), "%04X", memory[pc]);
+            out << "    " << hex4(pc) << "  " << word << "  " << disassemble(memory[pc]) << "\n";
+        }
+    }
+
+    out << "\nLoops:\n";
+    if (cfg.loops.empty()) out << "  none\n";
+    for (size_t i = 0; i < cfg.loops.size(); ++i) {
+        const Loop& l = cfg.loops[i];
+        out << "  L" << i << ": header B" << l.header << " (" << hex4(cfg.blocks[l.header].start) << "), "
+            << l.blocks.size() << " blocks, depth " << l.depth << ", latches";
+        for (uint32_t v : l.latches) out << " B" << v;
+        if (l.parent >= 0) out << ", inside L" << l.parent;
+        out << "\n";
+    }
+
+    out << "\nNon-zero words outside code (dead code or data):\n";
+    if (cfg.unreachable.empty()) out << "  none\n";
+    for (const auto& r : cfg.unreachable)
+        out << "  " << hex4(r.first) << "-" << hex4(r.second) << " (" << (r.second - r.first + 1) << " words)\n";
+}
+
+void dumpCFGDot(const ProgramCFG& cfg, const uint16_t* memory, std::ostream& out) {
+    out << "digraph cfg {\n  node [shape=box, fontname=monospace];\n";
+    for (size_t i = 0; i < cfg.blocks.size(); ++i) {
+        const BasicBlock& b = cfg.blocks[i];
+        out << "  B" << i << " [label=\"B" << i << " " << hex4(b.start);
+        for (uint16_t k = 0; k < b.length; ++k)
+            out << "\\l" << disassemble(memory[static_cast<uint16_t>(b.start + k)]);
+        out << "\\l\"" << (b.reachable ? "" : ", style=dashed") << "];\n";
+        for (uint32_t s : b.succs) {
+            bool taken = b.exit == BlockExit::JZ && !b.indirect && cfg.blocks[s].start == b.target;
+            out << "  B" << i << " -> B" << s << (taken ? " [label=\"Z\"]" : "") << ";\n";
+        }
+        if (b.exit == BlockExit::CALL && !b.indirect) {
+            int32_t callee = cfg.blockAt(b.target);
+            if (callee >= 0) out << "  B" << i << " -> B" << callee << " [style=dotted, label=\"call\"];\n";
+        }
+    }
+    out << "}\n";
+}
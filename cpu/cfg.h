@@ -0,0 +1,117 @@
+/**
+ * 16-bit GPR CPU Emulator - Control-Flow Graph and Static Analysis
+ * Recovers basic blocks, branch targets, register constants and loops
+ * from a raw memory image.
+ */
+
+#ifndef CFG_H
+#define CFG_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** How control leaves a basic block. */
+enum class BlockExit : uint8_t {
+    FALLTHROUGH,   // No branch: the next word starts another block
+    JMP,
+    JZ,
+    CALL,          // Continues at the next word when the callee returns
+    RET,
+    RETI,
+    HALT
+};
+
+/**
+ * Register constants at one program point. Bit i of `known` is set when
+ * R[i] holds value[i] on every path reaching the point; bit FLAGS_INDEX
+ * covers the Z, C and N bits of FLAGS (other FLAGS bits are not tracked).
+ */
+struct RegConstants {
+    static constexpr unsigned FLAGS_INDEX = 8;
+    static constexpr uint16_t ALL_KNOWN = 0x1FF;
+
+    uint16_t value[9] = {};
+    uint16_t known = 0;
+
+    bool isKnown(unsigned r) const { return (known >> r) & 1u; }
+    void set(unsigned r, uint16_t v) { value[r] = v; known |= static_cast<uint16_t>(1u << r); }
+    void forget(unsigned r) { known &= static_cast<uint16_t>(~(1u << r)); }
+};
+
+struct BasicBlock {
+    uint16_t start;        // First instruction
+    uint16_t length;       // Instruction count (the last one is the exit branch, if any)
+    BlockExit exit;
+    bool indirect;         // JMP/JZ/CALL whose target register is not a known constant
+    uint16_t target;       // Branch or callee address (valid for JMP/JZ/CALL when !indirect)
+    int8_t zKnown;         // JZ only: -1 unknown, 0 never taken, 1 always taken
+    bool reachable;        // Some path from an entry gets here with feasible branches
+    std::vector<uint32_t> succs;   // Intra-procedural successors (CALL: the return site)
+    std::vector<uint32_t> preds;
+    RegConstants in;       // Constants on entry
+    RegConstants out;      // Constants before the exit instruction takes effect
+    int32_t loop;          // Innermost loop containing the block, or -1
+
+    uint16_t end() const { return static_cast<uint16_t>(start + length); }
+};
+
+/** A natural loop: the header dominates every block in it. */
+struct Loop {
+    uint32_t header;                 // Block index
+    std::vector<uint32_t> blocks;    // Includes the header, sorted
+    std::vector<uint32_t> latches;   // Blocks with a back edge to the header
+    int32_t parent;                  // Enclosing loop, or -1
+    unsigned depth;                  // 1 for outermost
+};
+
+/**
+ * ProgramCFG: result of buildCFG(). Blocks are sorted by start address and
+ * never overlap. CALL edges are not successors: callees are listed in
+ * `functions` and analyzed as separate roots, so loops stay intra-procedural.
+ */
+struct ProgramCFG {
+    std::vector<BasicBlock> blocks;
+    std::vector<Loop> loops;
+    std::vector<uint16_t> entries;      // Roots given to buildCFG()
+    std::vector<uint16_t> functions;    // Resolved CALL targets
+    /** Inclusive ranges of non-zero words never reached as code (dead code or data). */
+    std::vector<std::pair<uint16_t, uint16_t>> unreachable;
+    /** Number of analysis rounds (more than 1 when constant propagation found new targets). */
+    unsigned rounds = 0;
+
+    /** Index of the block containing word `pc`, or -1 if it is not code. */
+    int blockAt(uint16_t pc) const { return blockOf.empty() ? -1 : blockOf[pc]; }
+
+    std::vector<int32_t> blockOf;       // MEMORY_SIZE entries
+};
+
+/** Program entry (0) plus every non-zero interrupt vector in the IVT. */
+std::vector<uint16_t> defaultEntries(const uint16_t* memory);
+
+/**
+ * Build the CFG of the MEMORY_SIZE-word image `memory`, starting from
+ * `entries` (registers unknown at each). JMP/JZ/CALL targets are
+ * resolved from register constants, which covers the assembler's
+ * "MOVI R7, target; JMP R7" expansion and any other constant address.
+ * Newly resolved targets are explored and the analysis repeats until
+ * nothing changes.
+ *
+ * Assumes code is not modified at run time and interrupt handlers
+ * preserve registers.
+ */
+ProgramCFG buildCFG(const uint16_t* memory, const std::vector<uint16_t>& entries);
+
+/** One instruction as assembler text, e.g. "ADD R0, R1" or "MOVI R7, 18". */
+std::string disassemble(uint16_t instruction);
+
+/** Text listing of every block: instructions, edges, constants and loops. */
+void dumpCFG(const ProgramCFG& cfg, const uint16_t* memory, std::ostream& out);
+
+/** Graphviz digraph of the blocks (one node per block). */
+void dumpCFGDot(const ProgramCFG& cfg, const uint16_t* memory, std::ostream& out);
+
+#endif // CFG_H
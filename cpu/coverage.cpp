@@ -0,0 +1,256 @@
+/**
+ * 16-bit GPR CPU Emulator - Coverage
+ */
+
+#include "coverage.h"
+#include "binary_io.h"
+#include "debug_map.h"
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <map>
+
+static const char MAGIC[8] = {'G', 'P', 'R', '1', '6', 'C', 'O', 'V'};
+
+/** Header (magic, version, runs) + three bitmaps + checksum. */
+static constexpr size_t FILE_SIZE = 8 + 4 + 8 + 3 * Coverage::BITMAP_WORDS * 8 + 4;
+
+Coverage::Coverage() : blockState(MEMORY_SIZE, 0) { clear(); }
+
+void Coverage::clear() {
+    std::memset(executedBits, 0, sizeof(executedBits));
+    std::memset(takenBits, 0, sizeof(takenBits));
+    std::memset(notTakenBits, 0, sizeof(notTakenBits));
+    std::fill(blockState.begin(), blockState.end(), 0);
+    runCount = 0;
+}
+
+void Coverage::onBlock(uint16_t start, uint16_t end, BranchKind kind, bool taken, uint16_t) {
+    uint32_t key = static_cast<uint32_t>(end) + 1;
+    uint32_t state = blockState[start];
+    uint32_t seen = 0;
+    if (kind == BranchKind::JZ) seen = taken ? SEEN_TAKEN : SEEN_NOT_TAKEN;
+    if ((state & (END_MASK | seen)) == (key | seen)) return;   // Hot path: nothing new
+
+    if ((state & END_MASK) != key) {
+        for (uint16_t pc = start; pc != end; ++pc)   // Wraps like the PC does
+            executedBits[pc >> 6] |= uint64_t(1) << (pc & 63);
+        state = key;
+    }
+    if (seen) {
+        uint16_t pc = static_cast<uint16_t>(end - 1);
+        (taken ? takenBits : notTakenBits)[pc >> 6] |= uint64_t(1) << (pc & 63);
+    }
+    blockState[start] = state | seen;
+}
+
+static size_t countBits(const uint64_t* bits) {
+    size_t n = 0;
+    for (size_t i = 0; i < Coverage::BITMAP_WORDS; ++i) n += std::bitset<64>(bits[i]).count();
+    return n;
+}
+
+size_t Coverage::executedCount() const { return countBits(executedBits); }
+size_t Coverage::jzTakenCount() const { return countBits(takenBits); }
+size_t Coverage::jzNotTakenCount() const { return countBits(notTakenBits); }
+
+size_t Coverage::merge(const Coverage& other) {
+    size_t added = 0;
+    for (size_t i = 0; i < BITMAP_WORDS; ++i) {
+        added += std::bitset<64>(other.executedBits[i] & ~executedBits[i]).count() +
+                 std::bitset<64>(other.takenBits[i] & ~takenBits[i]).count() +
+                 std::bitset<64>(other.notTakenBits[i] & ~notTakenBits[i]).count();
+        executedBits[i] |= other.executedBits[i];
+        takenBits[i] |= other.takenBits[i];
+        notTakenBits[i] |= other.notTakenBits[i];
+    }
+    runCount += other.runCount;
+    return added;
+}
+
+// =============================================================================
+// FILE
+// =============================================================================
+
+CoverageResult Coverage::save(const char* path) const {
+    std::vector<uint8_t> out(MAGIC, MAGIC + 8);
+    out.reserve(FILE_SIZE);
+    put32(out, COVERAGE_VERSION);
+    put64(out, runCount);
+    for (const uint64_t* bits : {executedBits, takenBits, notTakenBits})
+        for (size_t i = 0; i < BITMAP_WORDS; ++i) put64(out, bits[i]);
+    put32(out, fnv1a32(out.data(), out.size()));
+
+    std::string error;
+    if (!replaceFile(path, std::string(path) + ".tmp", out, true, error))
+        return {false, error};
+    return {true, ""};
+}
+
+CoverageResult Coverage::load(const char* path) {
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f)
+        return {false, std::string("cannot open ") + path};
+    std::vector<uint8_t> data(FILE_SIZE + 1);
+    size_t n = std::fread(data.data(), 1, data.size(), f);
+    std::fclose(f);
+    if (n != FILE_SIZE || std::memcmp(data.data(), MAGIC, 8) != 0)
+        return {false, std::string(path) + " is not a coverage file"};
+    if (get32(data.data() + 8) != COVERAGE_VERSION)
+        return {false, std::string(path) + ": unsupported coverage version"};
+    if (fnv1a32(data.data(), FILE_SIZE - 4) != get32(data.data() + FILE_SIZE - 4))
+        return {false, std::string(path) + ": checksum mismatch"};
+
+    clear();
+    runCount = get64(data.data() + 12);
+    const uint8_t* p = data.data() + 20;
+    for (uint64_t* bits : {executedBits, takenBits, notTakenBits})
+        for (size_t i = 0; i < BITMAP_WORDS; ++i, p += 8) bits[i] = get64(p);
+    return {true, ""};
+}
+
+// =============================================================================
+// REPORTS
+// =============================================================================
+
+/** What a source line contributes: whether it ran and the JZs assembled from it. */
+struct LineTally {
+    bool hit = false;
+    std::vector<uint16_t> branches;
+};
+
+using FileTally = std::map<uint32_t, LineTally>;
+
+static bool isJz(const Coverage& cov, const uint16_t* image, uint16_t pc) {
+    if (image) return ((image[pc] >> 12) & 0xF) == static_cast<unsigned>(Opcode::JZ);
+    return cov.jzTaken(pc) || cov.jzNotTaken(pc);
+}
+
+/** Fold the bitmaps onto source lines, one tally per file of `map`. */
+static std::vector<FileTally> tallyLines(const Coverage& cov, const DebugMap& map, const uint16_t* image) {
+    const std::vector<std::string>& files = map.fileNames();
+    std::vector<FileTally> tally(files.size());
+    for (size_t a = 0; a < MEMORY_SIZE; ++a) {
+        uint16_t pc = static_cast<uint16_t>(a);
+        SourceLine src = map.lineAt(pc);
+        if (!src.line || map.isData(pc)) continue;
+        LineTally& line = tally[static_cast<size_t>(src.file - files.data())][src.line];
+        line.hit = line.hit || cov.executed(pc);
+        if (isJz(cov, image, pc)) line.branches.push_back(pc);
+    }
+    return tally;
+}
+
+void Coverage::writeLcov(std::ostream& out, const DebugMap& map, const uint16_t* image) const {
+    std::vector<FileTally> tally = tallyLines(*this, map, image);
+    for (size_t f = 0; f < tally.size(); ++f) {
+        if (tally[f].empty()) continue;
+        out << "TN:\nSF:" << map.fileNames()[f] << "\n";
+        size_t branches = 0, branchesHit = 0, linesHit = 0;
+        for (const auto& entry : tally[f]) {
+            for (size_t b = 0; b < entry.second.branches.size(); ++b) {
+                uint16_t pc = entry.second.branches[b];
+                bool outcome[2] = {jzTaken(pc), jzNotTaken(pc)};
+                for (unsigned k = 0; k < 2; ++k) {
+                    out << "BRDA:" << entry.first << "," << b << "," << k << ",";
+                    if (executed(pc)) out << (outcome[k] ? 1 : 0);
+                    else out << "-";
+                    out << "\n";
+                    branchesHit += outcome[k];
+                }
+                branches += 2;
+            }
+        }
+        out << "BRF:" << branches << "\nBRH:" << branchesHit << "\n";
+        for (const auto& entry : tally[f]) {
+            out << "DA:" << entry.first << "," << (entry.second.hit ? 1 : 0) << "\n";
+            linesHit += entry.second.hit;
+        }
+        out << "LF:" << tally[f].size() << "\nLH:" << linesHit << "\nend_of_record\n";
+    }
+}
+
+static void writeJsonString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (c < 0x20) out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << unsigned(c) << std::dec;
+        else out << c;
+    }
+    out << '"';
+}
+
+void Coverage::writeJson(std::ostream& out, const DebugMap* map, const uint16_t* image) const {
+    out << "{\n  \"runs\": " << runCount << ",\n  \"executedWords\": " << executedCount()
+        << ",\n  \"jzTaken\": " << jzTakenCount() << ",\n  \"jzNotTaken\": " << jzNotTakenCount()
+        << ",\n  \"executed\": [";
+    const char* sep = "";
+    for (size_t a = 0; a < MEMORY_SIZE;) {   // [first, last] ranges of executed words
+        if (!executed(static_cast<uint16_t>(a))) {
+            ++a;
+            continue;
+        }
+        size_t last = a;
+        while (last + 1 < MEMORY_SIZE && executed(static_cast<uint16_t>(last + 1))) ++last;
+        out << sep << "[" << a << ", " << last << "]";
+        sep = ", ";
+        a = last + 1;
+    }
+    out << "],\n  \"files\": [";
+
+    std::vector<FileTally> tally;
+    if (map) tally = tallyLines(*this, *map, image);
+    sep = "";
+    for (size_t f = 0; f < tally.size(); ++f) {
+        if (tally[f].empty()) continue;
+        out << sep << "\n    {\"name\": ";
+        writeJsonString(out, map->fileNames()[f]);
+        out << ",\n     \"lines\": [";
+        const char* lineSep = "";
+        for (const auto& entry : tally[f]) {
+            out << lineSep << "[" << entry.first << ", " << (entry.second.hit ? 1 : 0) << "]";
+            lineSep = ", ";
+        }
+        out << "],\n     \"branches\": [";
+        lineSep = "";
+        for (const auto& entry : tally[f]) {
+            for (uint16_t pc : entry.second.branches) {
+                out << lineSep << "{\"line\": " << entry.first << ", \"pc\": " << pc << ", \"executed\": "
+                    << (executed(pc) ? "true" : "false") << ", \"taken\": " << (jzTaken(pc) ? "true" : "false")
+                    << ", \"notTaken\": " << (jzNotTaken(pc) ? "true" : "false") << "}";
+                lineSep = ", ";
+            }
+        }
+        out << "]}";
+        sep = ",";
+    }
+    out << (tally.empty() ? "" : "\n  ") << "]\n}\n";
+}
+
+void Coverage::printReport(std::ostream& os, const DebugMap* map, const uint16_t* image) const {
+    os << "\n--- Coverage (" << runCount << (runCount == 1 ? " run" : " runs") << ") ---\n";
+    os << "Words executed: " << executedCount() << "\n";
+    os << "JZ outcomes:    " << jzTakenCount() << " taken, " << jzNotTakenCount() << " not taken\n";
+    if (!map) return;
+
+    std::vector<FileTally> tally = tallyLines(*this, *map, image);
+    os << std::fixed << std::setprecision(1);
+    for (size_t f = 0; f < tally.size(); ++f) {
+        if (tally[f].empty()) continue;
+        size_t lines = tally[f].size(), linesHit = 0, outcomes = 0, outcomesHit = 0;
+        for (const auto& entry : tally[f]) {
+            linesHit += entry.second.hit;
+            for (uint16_t pc : entry.second.branches) {
+                outcomes += 2;
+                outcomesHit += jzTaken(pc) + jzNotTaken(pc);
+            }
+        }
+        os << "  " << map->fileNames()[f] << ": lines " << linesHit << "/" << lines << " ("
+           << 100.0 * static_cast<double>(linesHit) / static_cast<double>(lines) << "%), JZ outcomes "
+           << outcomesHit << "/" << outcomes << "\n";
+    }
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+}
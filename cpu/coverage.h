@@ -0,0 +1,104 @@
+/**
+ * 16-bit GPR CPU Emulator - Coverage
+ * Records which words executed and which way every JZ went, in bitmaps
+ * of one bit per word, for merging across runs and lcov/JSON export.
+ */
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class DebugMap;
+
+/**
+ * File format, version 1 (all fields little-endian):
+ *
+ *   Header   "GPR16COV", u32 version, u64 runs
+ *   Bitmaps  executed, JZ taken, JZ not taken: 1024 u64 each, bit (pc & 63)
+ *            of word (pc >> 6)
+ *   Trailer  u32 FNV-1a checksum of everything before it
+ */
+constexpr uint32_t COVERAGE_VERSION = 1;
+
+/** Result of a coverage file operation. */
+struct CoverageResult {
+    bool ok;
+    std::string error;
+};
+
+/**
+ * Coverage: attach with GPRCPU::addFlowListener().
+ *
+ * Works a basic block at a time. The words of a block are marked the first
+ * time it runs, and the outcome of the JZ ending it the first time it goes
+ * each way; after that a block costs one table lookup.
+ *
+ * Bitmaps only say whether something happened, not how often, so merging
+ * is a plain OR and a file holding thousands of runs is as small as one
+ * holding a single run.
+ */
+class Coverage : public ControlFlowListener {
+public:
+    static constexpr size_t BITMAP_WORDS = MEMORY_SIZE / 64;
+
+    Coverage();
+
+    void onBlock(uint16_t start, uint16_t end, BranchKind kind, bool taken, uint16_t next) override;
+
+    /** Forget everything, including the run count. */
+    void clear();
+
+    /** Count one finished run (the CPU cannot tell where runs end). */
+    void countRun() { ++runCount; }
+    uint64_t runs() const { return runCount; }
+
+    bool executed(uint16_t pc) const { return test(executedBits, pc); }
+    bool jzTaken(uint16_t pc) const { return test(takenBits, pc); }
+    bool jzNotTaken(uint16_t pc) const { return test(notTakenBits, pc); }
+
+    size_t executedCount() const;
+    size_t jzTakenCount() const;
+    size_t jzNotTakenCount() const;
+
+    /** OR `other` into this and add its runs. Returns how many bits were new. */
+    size_t merge(const Coverage& other);
+
+    /** Written beside `path` and renamed over it, like snapshots. */
+    CoverageResult save(const char* path) const;
+    CoverageResult load(const char* path);
+
+    /**
+     * Reports. `image` is the program as loaded (before it ran); it tells
+     * which never-executed words are JZ instructions. Without it only JZs
+     * that ran are listed. Lines and files come from `map`; .WORD data is
+     * not counted as a line.
+     *
+     * writeLcov() writes one record per source file: DA per line (1 if any
+     * word of it ran), BRDA per JZ (branch 0 taken, 1 not taken).
+     * writeJson() adds the executed address ranges and works without a map.
+     */
+    void writeLcov(std::ostream& out, const DebugMap& map, const uint16_t* image) const;
+    void writeJson(std::ostream& out, const DebugMap* map, const uint16_t* image) const;
+    void printReport(std::ostream& os, const DebugMap* map, const uint16_t* image) const;
+
+private:
+    static bool test(const uint64_t* bits, uint16_t pc) { return (bits[pc >> 6] >> (pc & 63)) & 1; }
+
+    uint64_t executedBits[BITMAP_WORDS];
+    uint64_t takenBits[BITMAP_WORDS];
+    uint64_t notTakenBits[BITMAP_WORDS];
+    // Per block start: end + 1 once its words are marked (0 = never), plus
+    // which outcomes of the JZ ending it have been recorded.
+    static constexpr uint32_t END_MASK = 0x1FFFF;
+    static constexpr uint32_t SEEN_TAKEN = 1u << 17;
+    static constexpr uint32_t SEEN_NOT_TAKEN = 1u << 18;
+    std::vector<uint32_t> blockState;
+    uint64_t runCount;
+};
+
+#endif // COVERAGE_H
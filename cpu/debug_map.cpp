@@ -0,0 +1,179 @@
+/**
+ * 16-bit GPR CPU Emulator - Source Debug Map
+ */
+
+#include "debug_map.h"
+#include "gpr_cpu.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+void DebugMap::clear() {
+    files.clear();
+    fileOf.clear();
+    lineOf.clear();
+    dataAt.clear();
+    labels.clear();
+}
+
+uint16_t DebugMap::addFile(const std::string& name) {
+    for (size_t i = 0; i < files.size(); ++i)
+        if (files[i] == name) return static_cast<uint16_t>(i);
+    files.push_back(name);
+    return static_cast<uint16_t>(files.size() - 1);
+}
+
+void DebugMap::setLine(uint16_t pc, uint16_t file, uint32_t line, bool data) {
+    if (lineOf.empty()) {
+        fileOf.assign(MEMORY_SIZE, 0);
+        lineOf.assign(MEMORY_SIZE, 0);
+        dataAt.assign(MEMORY_SIZE, 0);
+    }
+    fileOf[pc] = file;
+    lineOf[pc] = line;
+    dataAt[pc] = data;
+}
+
+void DebugMap::addLabel(uint16_t pc, const std::string& name) {
+    // Labels at the same address stay in the order they were added.
+    auto at = std::upper_bound(labels.begin(), labels.end(), pc,
+                               [](uint16_t a, const std::pair<uint16_t, std::string>& l) { return a < l.first; });
+    labels.insert(at, std::make_pair(pc, name));
+}
+
+SourceLine DebugMap::lineAt(uint16_t pc) const {
+    if (lineOf.empty() || lineOf[pc] == 0 || fileOf[pc] >= files.size())
+        return SourceLine{nullptr, 0};
+    return SourceLine{&files[fileOf[pc]], lineOf[pc]};
+}
+
+const std::string* DebugMap::labelAt(uint16_t pc, uint16_t& offset) const {
+    auto at = std::upper_bound(labels.begin(), labels.end(), pc,
+                               [](uint16_t a, const std::pair<uint16_t, std::string>& l) { return a < l.first; });
+    if (at == labels.begin()) return nullptr;
+    --at;
+    while (at != labels.begin() && std::prev(at)->first == at->first) --at;   // First name given to the address
+    offset = static_cast<uint16_t>(pc - at->first);
+    return &at->second;
+}
+
+std::string DebugMap::describe(uint16_t pc) const {
+    std::ostringstream out;
+    uint16_t offset = 0;
+    if (const std::string* name = labelAt(pc, offset)) {
+        out << *name;
+        if (offset) out << "+" << offset;
+    }
+    SourceLine src = lineAt(pc);
+    if (src.line) {
+        if (out.tellp() > 0) out << " ";
+        out << (src.file->empty() ? "line " : *src.file + ":") << src.line;
+    }
+    return out.str();
+}
+
+bool DebugMap::resolve(const std::string& where, uint16_t& pc) const {
+    if (where.empty()) return false;
+    if (where.size() > 2 && where[0] == '0' && (where[1] == 'x' || where[1] == 'X')) {
+        // strtoul would skip a sign or stop at a bad digit; accept hex digits only.
+        if (where.find_first_not_of("0123456789abcdefABCDEF", 2) != std::string::npos) return false;
+        char* end = nullptr;
+        errno = 0;
+        unsigned long addr = std::strtoul(where.c_str() + 2, &end, 16);
+        if (errno != 0 || *end != '\0' || addr >= MEMORY_SIZE) return false;
+        pc = static_cast<uint16_t>(addr);
+        return true;
+    }
+    std::string upper = where;
+    for (char& c : upper) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    for (const auto& l : labels) {
+        if (l.second == upper) {
+            pc = l.first;
+            return true;
+        }
+    }
+
+    // "file:line" or a bare line number
+    size_t colon = where.rfind(':');
+    std::string file = colon == std::string::npos ? "" : where.substr(0, colon);
+    std::string digits = colon == std::string::npos ? where : where.substr(colon + 1);
+    if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos || lineOf.empty())
+        return false;
+    errno = 0;
+    unsigned long parsed = std::strtoul(digits.c_str(), nullptr, 10);
+    if (errno != 0 || parsed > UINT32_MAX) return false;
+    uint32_t line = static_cast<uint32_t>(parsed);
+    for (size_t a = 0; a < MEMORY_SIZE; ++a) {
+        if (lineOf[a] != line || fileOf[a] >= files.size()) continue;
+        if (!file.empty() && files[fileOf[a]] != file) continue;
+        pc = static_cast<uint16_t>(a);
+        return true;
+    }
+    return false;
+}
+
+// =============================================================================
+// TEXT FORMAT
+// =============================================================================
+
+void DebugMap::write(std::ostream& out) const {
+    out << "# gpr16 debug map v1\n";
+    for (size_t i = 0; i < files.size(); ++i)
+        out << "file " << i << " " << files[i] << "\n";
+    out << std::hex << std::setfill('0');
+    for (const auto& l : labels)
+        out << "label " << std::setw(4) << l.first << " " << l.second << "\n";
+    for (size_t a = 0; a < lineOf.size();) {
+        if (lineOf[a] == 0) {
+            ++a;
+            continue;
+        }
+        size_t run = 1;
+        while (a + run < lineOf.size() && lineOf[a + run] == lineOf[a] && fileOf[a + run] == fileOf[a] &&
+               dataAt[a + run] == dataAt[a])
+            ++run;
+        out << (dataAt[a] ? "data " : "line ") << std::setw(4) << a << " " << std::dec << run << " " << fileOf[a] << " " << lineOf[a]
+            << std::hex << "\n";
+        a += run;
+    }
+    out << std::dec << std::setfill(' ');
+}
+
+bool DebugMap::read(std::istream& in) {
+    clear();
+    std::string text;
+    while (std::getline(in, text)) {
+        if (text.empty() || text[0] == '#') continue;
+        std::istringstream rec(text);
+        std::string kind;
+        rec >> kind;
+        if (kind == "file") {
+            size_t index;
+            std::string name;
+            if (!(rec >> index) || index != files.size()) return false;
+            rec.get();   // The space before the name, which may itself contain spaces
+            std::getline(rec, name);
+            files.push_back(name);
+        } else if (kind == "label") {
+            unsigned addr;
+            std::string name;
+            if (!(rec >> std::hex >> addr >> name) || addr >= MEMORY_SIZE) return false;
+            addLabel(static_cast<uint16_t>(addr), name);
+        } else if (kind == "line" || kind == "data") {
+            unsigned addr, run, file;
+            uint32_t line;
+            if (!(rec >> std::hex >> addr >> std::dec >> run >> file >> line)) return false;
+            if (file >= files.size() || addr + run > MEMORY_SIZE || line == 0) return false;
+            for (unsigned k = 0; k < run; ++k)
+                setLine(static_cast<uint16_t>(addr + k), static_cast<uint16_t>(file), line, kind == "data");
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
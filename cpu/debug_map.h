@@ -0,0 +1,80 @@
+/**
+ * 16-bit GPR CPU Emulator - Source Debug Map
+ * Maps memory addresses back to the .asm line and label they came from,
+ * so traces and reports can name source instead of raw PCs.
+ */
+
+#ifndef DEBUG_MAP_H
+#define DEBUG_MAP_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Where one word came from. line 0 means unknown. */
+struct SourceLine {
+    const std::string* file;   // nullptr when unknown
+    uint32_t line;
+};
+
+/**
+ * DebugMap: filled by the assembler/linker (AssembleOptions::debugMap,
+ * LinkOptions::debugMap). Every emitted word records its file and line;
+ * every label records its address. A word is attributed to the nearest
+ * label at or before it, which for most programs is the routine it
+ * belongs to (or a loop inside it).
+ *
+ * Lookups are O(1) for lines and O(log labels) for labels.
+ */
+class DebugMap {
+public:
+    void clear();
+    bool empty() const { return files.empty() && labels.empty(); }
+
+    /** Index for `name`, added if new. */
+    uint16_t addFile(const std::string& name);
+    /** `data` marks words placed by .WORD rather than assembled instructions. */
+    void setLine(uint16_t pc, uint16_t file, uint32_t line, bool data = false);
+    void addLabel(uint16_t pc, const std::string& name);
+
+    SourceLine lineAt(uint16_t pc) const;
+    bool isData(uint16_t pc) const { return !dataAt.empty() && dataAt[pc]; }
+
+    /** Nearest label at or before `pc` (nullptr if none); `offset` is pc minus its address. */
+    const std::string* labelAt(uint16_t pc, uint16_t& offset) const;
+
+    /** "LOOP+2 prog.asm:14", or "" when nothing is known about `pc`. */
+    std::string describe(uint16_t pc) const;
+
+    /**
+     * Address for a label name, "file:line", a bare line number (first
+     * file that has it) or a number with a 0x prefix. Lines resolve to the
+     * lowest address assembled from them. Returns false if nothing matches
+     * or the text is malformed (bad hex digits, an address past 0xFFFF).
+     */
+    bool resolve(const std::string& where, uint16_t& pc) const;
+
+    const std::vector<std::string>& fileNames() const { return files; }
+    const std::vector<std::pair<uint16_t, std::string>>& labelList() const { return labels; }
+
+    /**
+     * Text map, one record per line: "file N name", "label ADDR name" and
+     * "line ADDR COUNT FILE LINE" for runs of words from the same line
+     * ("data" instead of "line" for .WORD data; addresses in hex).
+     * read() accepts what write() produces.
+     */
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+
+private:
+    std::vector<std::string> files;
+    std::vector<uint16_t> fileOf;   // MEMORY_SIZE entries once a line is set
+    std::vector<uint32_t> lineOf;   // 0 = no line
+    std::vector<uint8_t> dataAt;    // 1 = data word
+    std::vector<std::pair<uint16_t, std::string>> labels;   // Sorted by address
+};
+
+#endif // DEBUG_MAP_H
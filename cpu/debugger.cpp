@@ -0,0 +1,319 @@
+/**
+ * 16-bit GPR CPU Emulator - Breakpoint and Watchpoint Engine
+ */
+
+#include "debugger.h"
+#include <algorithm>
+
+Debugger::Debugger(GPRCPU& cpu, Bus& bus)
+    : cpu(cpu), bus(bus), next(nullptr), attached(false), nextId(1), watchedPages{}, breakPages{} {}
+
+Debugger::~Debugger() {
+    repatch();
+    detach();
+    uint16_t* mem = bus.getMemory();
+    for (const auto& p : patched)
+        mem[p.first] = p.second;
+}
+
+// =============================================================================
+// BREAKPOINTS (BRK patching)
+// =============================================================================
+
+int Debugger::addBreakpoint(uint16_t pc, const DebugCondition& cond) {
+    if (!patched.count(pc)) {
+        // Patch straight into RAM: a debugger edit is not a guest write, so
+        // it must not reach probes or the dirty-page bitmap.
+        uint16_t* mem = bus.getMemory();
+        patched[pc] = mem[pc];
+        mem[pc] = BRK_INSTRUCTION;
+        setBreakPage(pc, true);
+        attach();   // To see guest writes onto the patched word
+    }
+    breakpoints.push_back(Breakpoint{nextId, pc, cond, 0});
+    return nextId++;
+}
+
+int Debugger::addBreakpoint(const DebugMap& map, const std::string& where, const DebugCondition& cond) {
+    uint16_t pc;
+    return map.resolve(where, pc) ? addBreakpoint(pc, cond) : -1;
+}
+
+uint16_t Debugger::originalWord(uint16_t address) const {
+    auto it = patched.find(address);
+    return it != patched.end() ? it->second : bus.getMemory()[address];
+}
+
+void Debugger::writeWord(uint16_t address, uint16_t value) {
+    repatch();
+    auto it = patched.find(address);
+    if (it != patched.end()) {
+        it->second = value;
+        return;
+    }
+    BusProbe* probe = bus.getProbe();
+    bus.setProbe(nullptr);
+    bus.write(address, value);
+    bus.setProbe(probe);
+}
+
+void Debugger::setBreakPage(uint16_t pc, bool patchedHere) {
+    unsigned page = pc >> 8;
+    breakPages[page] = static_cast<uint16_t>(breakPages[page] + (patchedHere ? 1 : -1));
+    setImmediatePage(page, watchedPages[page] != 0 || breakPages[page] != 0);
+}
+
+void Debugger::repatch() {
+    flush();
+    uint16_t* mem = bus.getMemory();
+    for (uint16_t address : overwritten) {
+        auto it = patched.find(address);
+        // Still BRK: the write left it alone (a failed CAS), or stored BRK
+        // itself, which cannot be told apart and keeps the old original.
+        if (it != patched.end() && mem[address] != BRK_INSTRUCTION) {
+            it->second = mem[address];
+            mem[address] = BRK_INSTRUCTION;
+        }
+    }
+    overwritten.clear();
+}
+
+size_t Debugger::stepOriginal() {
+    uint16_t pc = cpu.getState().PC;
+    uint16_t* mem = bus.getMemory();
+    mem[pc] = patched[pc];
+    size_t n = cpu.runFor(1);
+    patched[pc] = mem[pc];   // The instruction may have rewritten itself
+    mem[pc] = BRK_INSTRUCTION;
+    return n;
+}
+
+bool Debugger::checkBreakpoints() {
+    uint16_t pc = cpu.getState().PC;
+    if (!patched.count(pc)) {
+        // A BRK written in the program itself: always stops.
+        stop.reason = DebugStop::Reason::BREAKPOINT;
+        stop.id = -1;
+        stop.address = pc;
+        return true;
+    }
+
+    bool stopping = false;
+    for (Breakpoint& bp : breakpoints) {
+        if (bp.pc != pc || !conditionHolds(bp.cond))
+            continue;
+        if (++bp.hits > bp.cond.ignoreHits && !stopping) {
+            stopping = true;
+            stop.reason = DebugStop::Reason::BREAKPOINT;
+            stop.id = bp.id;
+            stop.address = pc;
+        }
+    }
+    return stopping;
+}
+
+// =============================================================================
+// WATCHPOINTS (immediate pages on the Bus probe)
+// =============================================================================
+
+int Debugger::addWatchpoint(uint16_t address, uint16_t length, WatchKind kind, const DebugCondition& cond) {
+    if (length == 0)
+        length = 1;
+    watchpoints.push_back(Watchpoint{nextId, address, length, kind, cond, 0});
+    setPagesWatched(address, length, true);
+    attach();
+    return nextId++;
+}
+
+void Debugger::setPagesWatched(uint16_t address, uint16_t length, bool watched) {
+    unsigned page = address >> 8;
+    unsigned last = static_cast<uint16_t>(address + length - 1) >> 8;
+    for (;;) {   // Walks forward with wraparound
+        watchedPages[page] = static_cast<uint16_t>(watchedPages[page] + (watched ? 1 : -1));
+        setImmediatePage(page, watchedPages[page] != 0 || breakPages[page] != 0);
+        if (page == last) break;
+        page = (page + 1) & 0xFFu;
+    }
+}
+
+void Debugger::attach() {
+    if (attached)
+        return;
+    next = bus.getProbe();
+    bus.setProbe(this);
+    attached = true;
+}
+
+void Debugger::detach() {
+    if (!attached)
+        return;
+    flush();
+    if (bus.getProbe() == this)
+        bus.setProbe(next);
+    next = nullptr;
+    attached = false;
+}
+
+void Debugger::processBatch(const Access* accesses, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const Access& a = accesses[i];
+        if (next)
+            next->record(a.kind, a.address);
+        if (a.kind == AccessKind::WRITE && breakPages[a.address >> 8] && patched.count(a.address)) {
+            overwritten.push_back(a.address);
+            cpu.requestStop();   // Repatch before the word can run
+        }
+        if (a.kind == AccessKind::FETCH || !watchedPages[a.address >> 8])
+            continue;
+
+        uint8_t bit = (a.kind == AccessKind::READ) ? static_cast<uint8_t>(WatchKind::READ)
+                                                   : static_cast<uint8_t>(WatchKind::WRITE);
+        for (const Watchpoint& w : watchpoints) {
+            // Unsigned distance handles ranges that wrap past 0xFFFF.
+            if ((static_cast<uint8_t>(w.kind) & bit) && static_cast<uint16_t>(a.address - w.address) < w.length) {
+                pending.push_back(PendingHit{w.id, a.address, a.kind});
+                cpu.requestStop();   // Finish this instruction, then return from runFor()
+            }
+        }
+    }
+}
+
+bool Debugger::checkWatchpoints() {
+    bool stopping = false;
+    for (const PendingHit& hit : pending) {
+        auto w = std::find_if(watchpoints.begin(), watchpoints.end(),
+                              [&](const Watchpoint& x) { return x.id == hit.id; });
+        if (w == watchpoints.end() || !conditionHolds(w->cond))
+            continue;
+        if (++w->hits > w->cond.ignoreHits && !stopping) {
+            stopping = true;
+            stop.reason = DebugStop::Reason::WATCHPOINT;
+            stop.id = w->id;
+            stop.address = hit.address;
+            stop.access = hit.access;
+        }
+    }
+    pending.clear();
+    return stopping;
+}
+
+// =============================================================================
+// CONDITIONS, REMOVAL & QUERIES
+// =============================================================================
+
+bool Debugger::conditionHolds(const DebugCondition& cond) const {
+    const CPUState& st = cpu.getState();
+    uint16_t v;
+    switch (cond.source) {
+        case DebugCondition::Source::REGISTER:
+            v = cond.index < 8 ? st.R[cond.index] : (cond.index == 8 ? st.FLAGS : st.SP);
+            break;
+        case DebugCondition::Source::MEMORY:
+            v = originalWord(cond.index);   // RAM only: no MMIO side effects
+            break;
+        case DebugCondition::Source::ALWAYS:
+        default:
+            return true;
+    }
+    switch (cond.compare) {
+        case DebugCondition::Compare::NE: return v != cond.value;
+        case DebugCondition::Compare::LT: return v < cond.value;
+        case DebugCondition::Compare::GE: return v >= cond.value;
+        case DebugCondition::Compare::EQ:
+        default:                          return v == cond.value;
+    }
+}
+
+bool Debugger::remove(int id) {
+    auto bp = std::find_if(breakpoints.begin(), breakpoints.end(), [&](const Breakpoint& b) { return b.id == id; });
+    if (bp != breakpoints.end()) {
+        uint16_t pc = bp->pc;
+        breakpoints.erase(bp);
+        bool stillUsed = std::any_of(breakpoints.begin(), breakpoints.end(), [&](const Breakpoint& b) { return b.pc == pc; });
+        if (!stillUsed) {
+            repatch();
+            bus.getMemory()[pc] = patched[pc];
+            patched.erase(pc);
+            setBreakPage(pc, false);
+            if (patched.empty() && watchpoints.empty())
+                detach();
+        }
+        return true;
+    }
+
+    auto w = std::find_if(watchpoints.begin(), watchpoints.end(), [&](const Watchpoint& x) { return x.id == id; });
+    if (w != watchpoints.end()) {
+        setPagesWatched(w->address, w->length, false);
+        watchpoints.erase(w);
+        if (watchpoints.empty() && patched.empty())
+            detach();
+        return true;
+    }
+    return false;
+}
+
+uint64_t Debugger::hitCount(int id) const {
+    for (const Breakpoint& b : breakpoints)
+        if (b.id == id) return b.hits;
+    for (const Watchpoint& w : watchpoints)
+        if (w.id == id) return w.hits;
+    return 0;
+}
+
+// =============================================================================
+// RUN
+// =============================================================================
+
+size_t Debugger::run(size_t maxCycles) {
+    stop = DebugStop();
+    pending.clear();
+    size_t total = 0;
+    bool resuming = true;    // Execute a breakpointed instruction under PC first
+
+    while (total < maxCycles) {
+        const CPUState& st = cpu.getState();
+        if (st.halted) {
+            stop.reason = DebugStop::Reason::HALT;
+            break;
+        }
+
+        size_t budget = maxCycles - total;
+        size_t n;
+        if (resuming && bus.getMemory()[st.PC] == BRK_INSTRUCTION) {
+            resuming = false;
+            if (!patched.count(st.PC)) {
+                cpu.getState().PC += 1;   // Program's own BRK: resume after it
+                continue;
+            }
+            budget = 1;
+            n = stepOriginal();
+        } else {
+            resuming = false;
+            n = cpu.runFor(budget);
+        }
+        total += n;
+
+        if (attached)
+            flush();
+        bool rewrote = !overwritten.empty();   // Stopped to repatch, not stalled
+        repatch();
+        bool watchHit = !pending.empty();
+        if (checkWatchpoints())
+            break;
+        if (st.halted) {
+            stop.reason = DebugStop::Reason::HALT;
+            break;
+        }
+        if (cpu.breakpointHit()) {
+            if (checkBreakpoints())
+                break;
+            resuming = true;      // Condition false or hit ignored: keep going
+            continue;
+        }
+        if (n < budget && !watchHit && !rewrote) {
+            stop.reason = DebugStop::Reason::STALLED;
+            break;
+        }
+    }
+    return total;
+}
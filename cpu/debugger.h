@@ -0,0 +1,191 @@
+/**
+ * 16-bit GPR CPU Emulator - Breakpoint and Watchpoint Engine
+ * Stops a run at an exact instruction or memory access without adding
+ * any check to step() or to the Bus fast paths.
+ */
+
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include "gpr_cpu.h"
+#include "debug_map.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/** Which accesses trigger a watchpoint. */
+enum class WatchKind : uint8_t {
+    READ   = 1,
+    WRITE  = 2,
+    ACCESS = 3   // READ | WRITE
+};
+
+/**
+ * Extra test applied when a breakpoint or watchpoint is reached. The point
+ * only stops the run when the test passes and it has passed more than
+ * `ignoreHits` times before (so ignoreHits = 9 stops on the 10th hit).
+ */
+struct DebugCondition {
+    enum class Source : uint8_t { ALWAYS, REGISTER, MEMORY };
+    enum class Compare : uint8_t { EQ, NE, LT, GE };   // Unsigned compares
+
+    Source source = Source::ALWAYS;
+    uint16_t index = 0;      // Register 0-7 (8 = FLAGS, 9 = SP) or memory word address
+    Compare compare = Compare::EQ;
+    uint16_t value = 0;
+    uint64_t ignoreHits = 0;
+};
+
+/** Why Debugger::run() returned. */
+struct DebugStop {
+    enum class Reason : uint8_t {
+        NONE,        // Cycle budget used up
+        BREAKPOINT,
+        WATCHPOINT,
+        HALT,
+        STALLED      // Asleep in WFI with no device event, or stopped externally
+    };
+    Reason reason = Reason::NONE;
+    int id = -1;             // Breakpoint/watchpoint id (-1: BRK assembled into the program)
+    uint16_t address = 0;    // PC for breakpoints, accessed word for watchpoints
+    AccessKind access = AccessKind::READ;
+};
+
+/**
+ * Debugger: breakpoints, watchpoints, conditions and hit counts for one
+ * CPU + Bus.
+ *
+ * Breakpoints patch the guest instruction with BRK and keep the original
+ * word. The BRK stops runFor() with PC on it; run() then evaluates the
+ * condition and either reports the stop or executes the original
+ * instruction and carries on.
+ *
+ * While any point is set the debugger is the Bus probe (chaining any probe
+ * already there), and only pages holding a point are marked immediate.
+ * Accesses to other pages are batched like any probe; an access to a
+ * marked page is seen during the instruction that made it, which then
+ * completes before the run stops (PC is on the next instruction, as with
+ * GDB). A guest write onto a patched word (STORE, CAS, BMOV, BFILL)
+ * becomes the new original and the BRK is put back before the word can
+ * run, so the breakpoint survives and remove() never restores a stale
+ * word. With no points set the debugger is not attached at all. While it
+ * is attached the CPU interprets instead of running compiled code
+ * (GPRCPU::setCompiledCode()), so breakpoints also stop AOT runs.
+ *
+ * Guest reads of a patched word see the BRK; use originalWord() for
+ * display and writeWord() for host edits. Not for use with
+ * DeterministicSMP private Buses.
+ */
+class Debugger : public BusProbe {
+public:
+    Debugger(GPRCPU& cpu, Bus& bus);
+
+    /** Removes every patch and detaches from the Bus. */
+    ~Debugger() override;
+
+    /** Break before executing `pc`. Returns an id for remove(). */
+    int addBreakpoint(uint16_t pc, const DebugCondition& cond = DebugCondition());
+
+    /**
+     * Break at a label, "file:line" or line number from `map` (see
+     * DebugMap::resolve()). Returns -1 if `where` is not in the map.
+     */
+    int addBreakpoint(const DebugMap& map, const std::string& where, const DebugCondition& cond = DebugCondition());
+
+    /** Watch `length` words from `address`. Returns an id for remove(). */
+    int addWatchpoint(uint16_t address, uint16_t length, WatchKind kind,
+                      const DebugCondition& cond = DebugCondition());
+
+    /** Remove a breakpoint or watchpoint. Returns false for an unknown id. */
+    bool remove(int id);
+
+    /** Times the point's condition held (stops plus ignored hits). */
+    uint64_t hitCount(int id) const;
+
+    /**
+     * Run for at most `maxCycles`, stopping early at a breakpoint or
+     * watchpoint whose condition holds, at HALT, or when stalled. A run
+     * that starts on a breakpoint executes that instruction first.
+     * Returns the cycles that elapsed; see lastStop() for why it ended.
+     */
+    size_t run(size_t maxCycles);
+
+    const DebugStop& lastStop() const { return stop; }
+
+    /** Memory word as the program was written (the original under a BRK patch). */
+    uint16_t originalWord(uint16_t address) const;
+
+    /**
+     * Host edit of a memory word (a debugger poke): under a breakpoint it
+     * replaces the saved original and the BRK stays. Elsewhere it is a Bus
+     * write (devices and written pages see it) hidden from probes and
+     * watchpoints.
+     */
+    void writeWord(uint16_t address, uint16_t value);
+
+    /** True if a breakpoint is patched in at `pc`. */
+    bool hasBreakpointAt(uint16_t pc) const { return patched.count(pc) != 0; }
+
+protected:
+    void processBatch(const Access* accesses, size_t n) override;
+
+private:
+    struct Breakpoint {
+        int id;
+        uint16_t pc;
+        DebugCondition cond;
+        uint64_t hits;
+    };
+    struct Watchpoint {
+        int id;
+        uint16_t address;
+        uint16_t length;
+        WatchKind kind;
+        DebugCondition cond;
+        uint64_t hits;
+    };
+    struct PendingHit {
+        int id;
+        uint16_t address;
+        AccessKind access;
+    };
+
+    GPRCPU& cpu;
+    Bus& bus;
+    BusProbe* next;                        // Probe that was attached before us
+    bool attached;
+    int nextId;
+    std::vector<Breakpoint> breakpoints;
+    std::vector<Watchpoint> watchpoints;
+    std::map<uint16_t, uint16_t> patched;  // PC -> original instruction
+    uint16_t watchedPages[PAGE_COUNT];     // Watchpoints covering each page
+    uint16_t breakPages[PAGE_COUNT];       // Patched words in each page
+    std::vector<PendingHit> pending;       // Watched accesses since the last check
+    std::vector<uint16_t> overwritten;     // Patched words the guest wrote since the last repatch()
+    DebugStop stop;
+
+    bool conditionHolds(const DebugCondition& cond) const;
+    void setPagesWatched(uint16_t address, uint16_t length, bool watched);
+    void setBreakPage(uint16_t pc, bool patchedHere);
+    void attach();
+    void detach();
+
+    /**
+     * Take the guest's value of every patched word it wrote as the new
+     * original and put the BRK back. Probes see a write before it lands,
+     * so this runs once the writing instruction has finished.
+     */
+    void repatch();
+
+    /** Execute the instruction under PC as if it were not patched. */
+    size_t stepOriginal();
+
+    /** Evaluate breakpoints at PC after a BRK stop; true if the run should stop. */
+    bool checkBreakpoints();
+
+    /** Evaluate pending watch hits; true if the run should stop. */
+    bool checkWatchpoints();
+};
+
+#endif // DEBUGGER_H
@@ -0,0 +1,310 @@
+/**
+ * 16-bit GPR CPU Emulator - Coverage-Guided Fuzzer
+ */
+
+#include "fuzzer.h"
+#include "binary_io.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+/** Havoc mutations tried on a corpus entry each time the queue comes round to it. */
+static constexpr unsigned HAVOC_ROUNDS = 256;
+
+/** Executions between clock reads when checking the time limit. */
+static constexpr uint64_t CLOCK_EVERY = 64;
+
+/** AFL's interesting values, as 16-bit words. */
+static const uint16_t INTERESTING[] = {
+    0, 1, 2, 7, 8, 15, 16, 31, 32, 63, 64, 100, 127, 128, 255, 256, 511, 512,
+    1000, 1023, 1024, 4095, 4096, 0x7FFF, 0x8000, 0x8001, 0xFF00, 0xFFFE, 0xFFFF
+};
+
+/** AFL hit-count bucket as a single bit: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+. */
+static uint8_t bucket(uint8_t count) {
+    if (count <= 2) return count;
+    if (count == 3) return 4;
+    if (count < 8) return 8;
+    if (count < 16) return 16;
+    if (count < 32) return 32;
+    if (count < 128) return 64;
+    return 128;
+}
+
+Fuzzer::Fuzzer(GPRCPU& cpu, Bus& bus, const FuzzOptions& opts)
+    : cpu(cpu), bus(bus), options(opts), inputSize(0), baseState(cpu.getState()),
+      baseMemory(bus.getMemory(), bus.getMemory() + MEMORY_SIZE), hits(MAP_SIZE, 0), crashAt(MEMORY_SIZE, 0),
+      crashed(false), crashPC(0), virgin(MAP_SIZE, 0), crashVirgin(MAP_SIZE, 0), hangVirgin(MAP_SIZE, 0), rng(0),
+      lastClockCheck(0), expired(false) {
+    if (options.regions.empty())
+        options.regions.push_back(FuzzRegion{0x100, 2});   // The operands main.cpp prompts for
+    for (const FuzzRegion& r : options.regions) inputSize += r.words;
+    for (unsigned slot = 0; slot < MMIO_SLOTS; ++slot) {
+        if (const Device* dev = bus.getDevice(slot)) {
+            baseDevices.emplace_back(slot, std::vector<uint8_t>());
+            dev->saveState(baseDevices.back().second);
+        }
+    }
+    touched.reserve(MAP_SIZE);
+    rng = options.seed ? options.seed
+                       : static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1;
+    cpu.addFlowListener(this);
+}
+
+Fuzzer::~Fuzzer() { cpu.removeFlowListener(this); }
+
+void Fuzzer::addCrashAddress(uint16_t pc) { crashAt[pc] = 1; }
+
+void Fuzzer::addSeed(std::vector<uint16_t> input) {
+    input.resize(inputSize, 0);
+    seeds.push_back(std::move(input));
+}
+
+size_t Fuzzer::loadSeeds() {
+    namespace fs = std::filesystem;
+    size_t loaded = 0;
+    std::error_code ec;
+    fs::path dir = fs::path(options.outDir) / "corpus";
+    if (options.outDir.empty() || !fs::is_directory(dir, ec)) return 0;
+    for (const fs::directory_entry& e : fs::directory_iterator(dir, ec)) {
+        if (!e.is_regular_file(ec)) continue;
+        std::ifstream in(e.path(), std::ios::binary);
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::vector<uint16_t> input((bytes.size() + 1) / 2, 0);
+        for (size_t i = 0; i < bytes.size(); ++i) input[i / 2] |= static_cast<uint16_t>(bytes[i] << (8 * (i & 1)));
+        addSeed(std::move(input));
+        ++loaded;
+    }
+    return loaded;
+}
+
+// =============================================================================
+// ONE EXECUTION
+// =============================================================================
+
+void Fuzzer::onBlock(uint16_t, uint16_t end, BranchKind kind, bool, uint16_t next) {
+    if (kind == BranchKind::HALT) return;
+    uint16_t from = static_cast<uint16_t>(end - 1);   // The branch (or the instruction before an interrupt)
+    uint16_t index = static_cast<uint16_t>(static_cast<uint16_t>(from * 40503u) ^ next);
+    uint8_t& count = hits[index];
+    if (count == 0) touched.push_back(index);
+    if (count != 255) ++count;
+    if (crashAt[next]) {
+        crashed = true;
+        crashPC = next;
+        cpu.requestStop();
+    }
+}
+
+Fuzzer::Outcome Fuzzer::execute(const std::vector<uint16_t>& input) {
+    // --- Back to the snapshot ---
+    cpu.restoreState(baseState);
+    bus.resetMemory(baseMemory.data());
+    for (const auto& dev : baseDevices) bus.getDevice(dev.first)->restoreState(dev.second.data(), dev.second.size());
+    for (uint16_t index : touched) hits[index] = 0;
+    touched.clear();
+    crashed = false;
+
+    size_t k = 0;
+    for (const FuzzRegion& r : options.regions)
+        for (uint16_t w = 0; w < r.words; ++w, ++k)
+            bus.write(static_cast<uint16_t>(r.addr + w), k < input.size() ? input[k] : 0);
+
+    cpu.runFor(options.cycleLimit);
+    ++stats.execs;
+    if (cpu.breakpointHit()) {
+        crashed = true;
+        crashPC = cpu.getState().PC;
+    }
+    if (crashed) return Outcome::CRASH;
+    return cpu.getState().halted ? Outcome::OK : Outcome::HANG;
+}
+
+bool Fuzzer::mergeNew(std::vector<uint8_t>& seen) {
+    bool found = false;
+    for (uint16_t index : touched) {
+        uint8_t b = bucket(hits[index]);
+        if (seen[index] & b) continue;
+        if (seen[index] == 0 && &seen == &virgin) ++stats.edges;
+        seen[index] |= b;
+        found = true;
+    }
+    return found;
+}
+
+// =============================================================================
+// CORPUS
+// =============================================================================
+
+void Fuzzer::save(const char* dir, const std::vector<uint16_t>& input, const std::string& suffix) {
+    if (options.outDir.empty()) return;
+    // Named by content, so re-finding an input (or resuming) never makes a duplicate.
+    std::vector<uint8_t> bytes;
+    for (uint16_t w : input) put16(bytes, w);
+    uint64_t h = fnv1a64(bytes.data(), bytes.size());
+    std::ostringstream name;
+    name << options.outDir << "/" << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << h << suffix;
+    std::string why;
+    if (!replaceFile(name.str(), name.str() + ".tmp", bytes, false, why) && error.empty()) error = why;
+}
+
+void Fuzzer::consider(const std::vector<uint16_t>& input, bool seed) {
+    switch (execute(input)) {
+        case Outcome::OK:
+            if (mergeNew(virgin) || seed) {
+                queue.push_back(input);
+                deterministicDone.push_back(false);
+                stats.corpus = queue.size();
+                if (!seed) save("corpus", input, "");
+            }
+            break;
+        case Outcome::CRASH:
+            if (mergeNew(crashVirgin)) {
+                std::ostringstream suffix;
+                suffix << ",pc_" << std::hex << std::setw(4) << std::setfill('0') << crashPC;
+                save("crashes", input, suffix.str());
+                ++stats.crashes;
+            }
+            break;
+        case Outcome::HANG:
+            if (mergeNew(hangVirgin)) {
+                save("hangs", input, "");
+                ++stats.hangs;
+            }
+            break;
+    }
+}
+
+// =============================================================================
+// MUTATION
+// =============================================================================
+
+uint64_t Fuzzer::random() {
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 2685821657736338717ull;
+}
+
+void Fuzzer::deterministic(size_t entry) {
+    std::vector<uint16_t> input = queue[entry];
+    for (size_t i = 0; i < input.size() && !timeUp(); ++i) {
+        uint16_t original = input[i];
+        for (unsigned bit = 0; bit < 16; ++bit) {
+            input[i] = static_cast<uint16_t>(original ^ (1u << bit));
+            consider(input, false);
+        }
+        for (unsigned d = 1; d <= 16; ++d) {
+            input[i] = static_cast<uint16_t>(original + d);
+            consider(input, false);
+            input[i] = static_cast<uint16_t>(original - d);
+            consider(input, false);
+        }
+        for (uint16_t v : INTERESTING) {
+            input[i] = v;
+            consider(input, false);
+        }
+        input[i] = original;
+    }
+}
+
+void Fuzzer::mutate(std::vector<uint16_t>& input) {
+    if (input.empty()) return;
+    unsigned stack = 1u << (1 + randomBelow(4));   // 2-16 stacked changes, as in AFL's havoc
+    for (unsigned n = 0; n < stack; ++n) {
+        uint16_t& w = input[randomBelow(input.size())];
+        switch (randomBelow(9)) {
+            case 0: w ^= static_cast<uint16_t>(1u << randomBelow(16)); break;
+            case 1: w = INTERESTING[randomBelow(sizeof(INTERESTING) / sizeof(INTERESTING[0]))]; break;
+            case 2: w = static_cast<uint16_t>(w + 1 + randomBelow(35)); break;
+            case 3: w = static_cast<uint16_t>(w - 1 - randomBelow(35)); break;
+            case 4: w = static_cast<uint16_t>(random()); break;
+            case 5: w = static_cast<uint16_t>(randomBelow(2) ? (w & 0x00FF) | (random() & 0xFF00) : (w & 0xFF00) | (random() & 0xFF)); break;
+            case 6: w = static_cast<uint16_t>((w << 8) | (w >> 8)); break;
+            case 7: w = input[randomBelow(input.size())]; break;
+            default: {   // Splice: a word from another corpus entry
+                const std::vector<uint16_t>& other = queue[randomBelow(queue.size())];
+                size_t at = randomBelow(other.size());
+                w = other[at];
+                break;
+            }
+        }
+    }
+}
+
+// =============================================================================
+// MAIN LOOP
+// =============================================================================
+
+bool Fuzzer::timeUp() {
+    if (options.maxExecs && stats.execs >= options.maxExecs) return true;
+    if (stats.execs - lastClockCheck < CLOCK_EVERY) return expired;
+    lastClockCheck = stats.execs;
+    expired = std::chrono::steady_clock::now() >= deadline;
+    return expired;
+}
+
+FuzzStats Fuzzer::run(std::ostream* progress) {
+    auto start = std::chrono::steady_clock::now();
+    deadline = options.seconds > 0
+        ? start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.seconds))
+        : std::chrono::steady_clock::time_point::max();
+    expired = false;
+    lastClockCheck = stats.execs;
+
+    if (!options.outDir.empty()) {
+        std::error_code ec;
+        for (const char* dir : {"corpus", "crashes", "hangs"}) {
+            std::filesystem::create_directories(std::filesystem::path(options.outDir) / dir, ec);
+            if (ec) {
+                error = "cannot create " + options.outDir + "/" + dir + ": " + ec.message();
+                return stats;
+            }
+        }
+    }
+
+    // --- Seeds: whatever memory holds now, unless some were given ---
+    if (seeds.empty()) {
+        std::vector<uint16_t> current;
+        for (const FuzzRegion& r : options.regions)
+            for (uint16_t w = 0; w < r.words; ++w) current.push_back(baseMemory[static_cast<uint16_t>(r.addr + w)]);
+        seeds.push_back(current);
+    }
+    for (const std::vector<uint16_t>& seed : seeds) consider(seed, true);
+    if (queue.empty()) {   // Every seed crashed or hung: mutate them anyway
+        queue = seeds;
+        deterministicDone.assign(queue.size(), false);
+        stats.corpus = queue.size();
+    }
+    seeds.clear();
+
+    auto lastReport = start;
+    for (size_t entry = 0; !timeUp(); entry = (entry + 1) % queue.size()) {
+        if (!deterministicDone[entry]) {
+            deterministicDone[entry] = true;
+            deterministic(entry);
+        }
+        for (unsigned n = 0; n < HAVOC_ROUNDS && !timeUp(); ++n) {
+            std::vector<uint16_t> input = queue[entry];
+            mutate(input);
+            consider(input, false);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (progress && now - lastReport >= std::chrono::seconds(1)) {
+            lastReport = now;
+            stats.seconds = std::chrono::duration<double>(now - start).count();
+            *progress << "[fuzz] " << std::fixed << std::setprecision(1) << stats.seconds << " s  " << stats.execs
+                      << " execs (" << std::setprecision(0) << stats.execsPerSecond() << "/s)  corpus " << stats.corpus
+                      << "  edges " << stats.edges << "  crashes " << stats.crashes << "  hangs " << stats.hangs
+                      << std::defaultfloat << std::setprecision(6) << "\n";
+        }
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
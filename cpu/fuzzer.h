@@ -0,0 +1,152 @@
+/**
+ * 16-bit GPR CPU Emulator - Coverage-Guided Fuzzer
+ * AFL-style loop in the emulator's own process: mutate input words in
+ * memory, run, keep inputs that reach new control-flow edges, reset.
+ */
+
+#ifndef FUZZER_H
+#define FUZZER_H
+
+#include "gpr_cpu.h"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** A run of memory words the fuzzer controls, e.g. the operands at 0x100. */
+struct FuzzRegion {
+    uint16_t addr;
+    uint16_t words;
+};
+
+struct FuzzOptions {
+    std::vector<FuzzRegion> regions;   // Input = these regions' words, in order
+    size_t cycleLimit = 100000;        // A run still going after this is a hang
+    double seconds = 10;               // Stop after this long (0 = no limit)
+    uint64_t maxExecs = 0;             // Stop after this many runs (0 = no limit)
+    uint64_t seed = 0;                 // 0 = seed from the clock
+    std::string outDir;                // corpus/, crashes/ and hangs/ go here ("" = keep in memory)
+};
+
+struct FuzzStats {
+    uint64_t execs = 0;
+    size_t corpus = 0;
+    size_t edges = 0;        // Distinct edges seen so far
+    size_t crashes = 0;      // Saved crashing inputs (one per new crash path)
+    size_t hangs = 0;
+    double seconds = 0;
+
+    double execsPerSecond() const { return seconds > 0 ? static_cast<double>(execs) / seconds : 0.0; }
+};
+
+/**
+ * Fuzzer: drives `cpu` and `bus` (not owned) from the state they are in
+ * when it is constructed. That state (registers, memory, device state) is
+ * kept as a snapshot and restored before every run; memory is restored
+ * with Bus::resetMemory(), so a run costs the pages it wrote, not 128 KiB.
+ *
+ * Feedback is AFL's: every control transfer (JMP, JZ either way, CALL,
+ * RET, RETI, interrupt entry) is an edge from the branch's PC to the next
+ * PC, hashed into a 64K-entry map of 8-bit hit counts. Counts are put in
+ * AFL's buckets (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+); an input that
+ * reaches a new edge or a new bucket joins the corpus. Only edges a run
+ * touched are cleared and scanned afterwards.
+ *
+ * A run ends in one of:
+ *   - HALT: normal;
+ *   - crash: it executed BRK or reached a crash address (addCrashAddress);
+ *   - hang: it neither halted nor crashed within cycleLimit cycles.
+ * Crashes and hangs are kept when they take a path no earlier crash (or
+ * hang) took, like AFL's unique crashes.
+ *
+ * New corpus entries first get a deterministic pass (walking bit flips,
+ * small add/subtract, interesting values per word), then random stacked
+ * "havoc" mutations and splicing with other entries.
+ *
+ * Files are the input's words, little-endian, e.g. 4 bytes for the default
+ * two operands. Existing files in outDir/corpus are loaded as seeds.
+ */
+class Fuzzer : public ControlFlowListener {
+public:
+    static constexpr size_t MAP_SIZE = 65536;
+
+    Fuzzer(GPRCPU& cpu, Bus& bus, const FuzzOptions& options);
+    ~Fuzzer() override;
+
+    /** Treat reaching `pc` (as a branch target or after an interrupt) as a crash. */
+    void addCrashAddress(uint16_t pc);
+
+    /** Add a starting input; it is padded or cut to the input size. */
+    void addSeed(std::vector<uint16_t> input);
+
+    /** Load every file in outDir/corpus as a seed. Returns how many. */
+    size_t loadSeeds();
+
+    /** Fuzz until the time or exec limit; prints a status line about once a second if `progress`. */
+    FuzzStats run(std::ostream* progress = nullptr);
+
+    /** How a single input ends. */
+    enum class Outcome : uint8_t { OK, CRASH, HANG };
+    Outcome execute(const std::vector<uint16_t>& input);
+
+    const std::vector<std::vector<uint16_t>>& corpus() const { return queue; }
+    size_t inputWords() const { return inputSize; }
+    const std::string& lastError() const { return error; }
+
+    void onBlock(uint16_t start, uint16_t end, BranchKind kind, bool taken, uint16_t next) override;
+
+private:
+    GPRCPU& cpu;
+    Bus& bus;
+    FuzzOptions options;
+    size_t inputSize;
+
+    // Baseline snapshot
+    CPUState baseState;
+    std::vector<uint16_t> baseMemory;
+    std::vector<std::pair<unsigned, std::vector<uint8_t>>> baseDevices;   // MMIO slot, saved state
+
+    // Edge map for the current run
+    std::vector<uint8_t> hits;
+    std::vector<uint16_t> touched;    // Indices of hits that are non-zero
+    std::vector<uint8_t> crashAt;     // 1 = crash address
+    bool crashed;
+    uint16_t crashPC;
+
+    // What has been seen across runs (one bit per bucket)
+    std::vector<uint8_t> virgin;
+    std::vector<uint8_t> crashVirgin;
+    std::vector<uint8_t> hangVirgin;
+
+    std::vector<std::vector<uint16_t>> seeds;    // Waiting for run()
+    std::vector<std::vector<uint16_t>> queue;
+    std::vector<bool> deterministicDone;
+    FuzzStats stats;
+    uint64_t rng;
+    std::string error;
+
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t lastClockCheck;
+    bool expired;
+
+    uint64_t random();
+    size_t randomBelow(size_t n) { return static_cast<size_t>(random() % n); }
+
+    /** Bucket this run's counts and merge them into `seen`; returns true if any bit was new. */
+    bool mergeNew(std::vector<uint8_t>& seen);
+
+    /**
+     * Run `input` and keep it as corpus, crash or hang if it found something
+     * new. Seeds join the corpus (unsaved) even when they add nothing.
+     */
+    void consider(const std::vector<uint16_t>& input, bool seed);
+    void mutate(std::vector<uint16_t>& input);
+    void deterministic(size_t entry);
+
+    /** Exec limit reached or deadline passed (the clock is read every CLOCK_EVERY runs). */
+    bool timeUp();
+    void save(const char* dir, const std::vector<uint16_t>& input, const std::string& suffix);
+};
+
+#endif // FUZZER_H
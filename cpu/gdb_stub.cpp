@@ -0,0 +1,514 @@
+/**
+ * 16-bit GPR CPU Emulator - GDB Remote Serial Protocol Stub
+ */
+
+#include "gdb_stub.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/** Cycles per runFor() chunk while continuing; Ctrl-C is polled between chunks. */
+static constexpr size_t CONTINUE_CHUNK = 1u << 20;
+
+/** Consecutive bad-checksum packets tolerated before the link is treated as broken. */
+static constexpr int MAX_PACKET_RETRIES = 16;
+
+/** Register numbers in the 'g' packet and target.xml. */
+enum GdbReg : unsigned { REG_R0 = 0, REG_PC = 8, REG_FLAGS = 9, REG_SP = 10, REG_COUNT = 11 };
+
+static const char TARGET_XML[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<feature name=\"org.gpr16.core\">"
+    "<reg name=\"r0\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"r1\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"r2\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"r3\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"r4\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"r5\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"r6\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"r7\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"flags\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"sp\" bitsize=\"16\" type=\"uint16\"/>"
+    "</feature>"
+    "</target>";
+
+// =============================================================================
+// HEX HELPERS
+// =============================================================================
+
+static const char HEX[] = "0123456789abcdef";
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void appendHexByte(std::string& out, uint8_t b) {
+    out += HEX[b >> 4];
+    out += HEX[b & 0xF];
+}
+
+/** Little-endian hex of the low `bytes` bytes of v (the 'g' packet byte order). */
+static void appendHexLE(std::string& out, uint32_t v, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; ++i)
+        appendHexByte(out, static_cast<uint8_t>(v >> (8 * i)));
+}
+
+static bool parseHexLE(const std::string& s, size_t pos, unsigned bytes, uint32_t& v) {
+    if (pos + bytes * 2 > s.size()) return false;
+    v = 0;
+    for (unsigned i = 0; i < bytes; ++i) {
+        int hi = hexDigit(s[pos + 2 * i]), lo = hexDigit(s[pos + 2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        v |= static_cast<uint32_t>((hi << 4) | lo) << (8 * i);
+    }
+    return true;
+}
+
+/** Big-endian hex number as used for addresses and lengths. */
+static uint32_t parseHexNumber(const std::string& s, size_t& pos) {
+    uint32_t v = 0;
+    int d;
+    while (pos < s.size() && (d = hexDigit(s[pos])) >= 0) {
+        v = (v << 4) | static_cast<uint32_t>(d);
+        ++pos;
+    }
+    return v;
+}
+
+// =============================================================================
+// CONSTRUCTION & SOCKETS
+// =============================================================================
+
+GdbStub::GdbStub(GPRCPU& cpu, Bus& bus)
+    : cpu(cpu), bus(bus), listenFd(-1), clientFd(-1), noAck(false), debugger(cpu, bus) {}
+
+GdbStub::~GdbStub() {
+#ifndef _WIN32
+    if (clientFd >= 0) close(clientFd);
+    if (listenFd >= 0) close(listenFd);
+    if (!unixPath.empty()) unlink(unixPath.c_str());
+#endif
+}
+
+bool GdbStub::listenTcp(uint16_t port) {
+#ifndef _WIN32
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) { error = std::strerror(errno); return false; }
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   // Never expose the debugger off-host
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd, 1) < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    (void)port;
+    error = "GDB stub requires POSIX sockets";
+    return false;
+#endif
+}
+
+bool GdbStub::listenUnix(const std::string& path) {
+#ifndef _WIN32
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) { error = std::strerror(errno); return false; }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) { error = "socket path too long"; return false; }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd, 1) < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    unixPath = path;
+    return true;
+#else
+    (void)path;
+    error = "GDB stub requires POSIX sockets";
+    return false;
+#endif
+}
+
+// =============================================================================
+// TRANSPORT ($payload#checksum framing)
+// =============================================================================
+
+bool GdbStub::readPacket(std::string& packet) {
+#ifndef _WIN32
+    // A NAK asks gdb to resend; a line that keeps corrupting packets is
+    // dropped rather than retried forever.
+    for (int attempt = 0; attempt < MAX_PACKET_RETRIES; ++attempt) {
+        char c;
+        // Skip acks and stray bytes until a packet starts. Ctrl-C outside a
+        // continue is meaningless, so it is dropped here as well.
+        do {
+            if (recv(clientFd, &c, 1, 0) != 1) return false;
+        } while (c != '$');
+
+        packet.clear();
+        for (;;) {
+            if (recv(clientFd, &c, 1, 0) != 1) return false;
+            if (c == '#') break;
+            packet += c;
+        }
+        char cs[2];
+        if (recv(clientFd, cs, 2, MSG_WAITALL) != 2) return false;
+
+        uint8_t sum = 0;
+        for (char ch : packet) sum = static_cast<uint8_t>(sum + static_cast<uint8_t>(ch));
+        bool good = hexDigit(cs[0]) == (sum >> 4) && hexDigit(cs[1]) == (sum & 0xF);
+        if (!noAck) {
+            char ack = good ? '+' : '-';
+            send(clientFd, &ack, 1, MSG_NOSIGNAL);   // gdb may already be gone (after 'k')
+        }
+        if (good) return true;
+    }
+    error = "too many corrupted packets";
+    return false;
+#else
+    (void)packet;
+    return false;
+#endif
+}
+
+bool GdbStub::sendPacket(const std::string& payload) {
+#ifndef _WIN32
+    uint8_t sum = 0;
+    for (char ch : payload) sum = static_cast<uint8_t>(sum + static_cast<uint8_t>(ch));
+    std::string frame = "$" + payload + "#";
+    appendHexByte(frame, sum);
+
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        if (send(clientFd, frame.data(), frame.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(frame.size())) return false;
+        if (noAck) return true;
+        char c;
+        do {
+            if (recv(clientFd, &c, 1, 0) != 1) return false;
+        } while (c != '+' && c != '-');
+        if (c == '+') return true;
+    }
+    return false;
+#else
+    (void)payload;
+    return false;
+#endif
+}
+
+bool GdbStub::interruptRequested() {
+#ifndef _WIN32
+    pollfd p{clientFd, POLLIN, 0};
+    if (poll(&p, 1, 0) <= 0) return false;
+    char c;
+    if (recv(clientFd, &c, 1, MSG_PEEK) != 1) return true;   // Disconnect: stop too
+    if (c != 0x03) return false;
+    recv(clientFd, &c, 1, 0);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// =============================================================================
+// REGISTERS & MEMORY
+// =============================================================================
+
+std::string GdbStub::readRegisters() const {
+    std::string out;
+    for (unsigned n = 0; n < REG_COUNT; ++n) {
+        std::string r;
+        readRegister(n, r);
+        out += r;
+    }
+    return out;
+}
+
+bool GdbStub::writeRegisters(const std::string& hex) {
+    size_t pos = 0;
+    for (unsigned n = 0; n < REG_COUNT; ++n) {
+        unsigned bytes = (n == REG_PC) ? 4 : 2;
+        if (!writeRegister(n, hex.substr(pos, bytes * 2))) return false;
+        pos += bytes * 2;
+    }
+    return true;
+}
+
+bool GdbStub::readRegister(unsigned n, std::string& out) const {
+    const CPUState& st = cpu.getState();
+    if (n < 8)               appendHexLE(out, st.R[n], 2);
+    else if (n == REG_PC)    appendHexLE(out, static_cast<uint32_t>(st.PC) * 2, 4);
+    else if (n == REG_FLAGS) appendHexLE(out, st.FLAGS, 2);
+    else if (n == REG_SP)    appendHexLE(out, st.SP, 2);
+    else return false;
+    return true;
+}
+
+bool GdbStub::writeRegister(unsigned n, const std::string& hex) {
+    CPUState& st = cpu.getState();
+    uint32_t v;
+    if (!parseHexLE(hex, 0, n == REG_PC ? 4 : 2, v)) return false;
+    if (n < 8)               st.R[n] = static_cast<uint16_t>(v);
+    else if (n == REG_PC)    st.PC = static_cast<uint16_t>(v / 2);
+    else if (n == REG_FLAGS) st.FLAGS = static_cast<uint16_t>(v);
+    else if (n == REG_SP)    st.SP = static_cast<uint16_t>(v);
+    else return false;
+    return true;
+}
+
+std::string GdbStub::readMemory(uint32_t addr, uint32_t len) const {
+    // Straight from RAM: debugger reads must not trigger MMIO side effects or
+    // probes. Patched breakpoints show the original instruction.
+    // Clamp first: gdb may ask for any length, and addr + len must not wrap.
+    const uint32_t limit = static_cast<uint32_t>(MEMORY_SIZE * 2);
+    if (addr >= limit) return std::string();
+    len = std::min(len, limit - addr);
+    std::string out;
+    out.reserve(static_cast<size_t>(len) * 2);
+    for (uint32_t b = addr; b < addr + len; ++b) {
+        uint16_t word = debugger.originalWord(static_cast<uint16_t>(b >> 1));
+        appendHexByte(out, static_cast<uint8_t>((b & 1) ? (word >> 8) : word));
+    }
+    return out;
+}
+
+void GdbStub::writeMemory(uint32_t addr, const std::string& bytes) {
+    // Through the debugger: a write under a breakpoint changes the saved
+    // instruction and keeps the BRK, and no probe sees the poke.
+    for (size_t i = 0; i < bytes.size() && addr + i < MEMORY_SIZE * 2; ++i) {
+        uint32_t b = addr + static_cast<uint32_t>(i);
+        uint16_t w = static_cast<uint16_t>(b >> 1);
+        uint16_t word = debugger.originalWord(w);
+        uint8_t v = static_cast<uint8_t>(bytes[i]);
+        word = (b & 1) ? static_cast<uint16_t>((word & 0x00FFu) | (v << 8)) : static_cast<uint16_t>((word & 0xFF00u) | v);
+        debugger.writeWord(w, word);
+    }
+}
+
+// =============================================================================
+// EXECUTION
+// =============================================================================
+
+std::string GdbStub::stopReply() const {
+    // SIGTRAP for breakpoints, steps, HALT and Ctrl-C alike. Watchpoints
+    // also name the data address so GDB can show old and new values.
+    const DebugStop& st = debugger.lastStop();
+    if (st.reason != DebugStop::Reason::WATCHPOINT)
+        return "S05";
+    const char* kind = "watch";
+    for (const auto& p : points) {
+        if (p.second != st.id) continue;
+        if (p.first.first == '3') kind = "rwatch";
+        else if (p.first.first == '4') kind = "awatch";
+    }
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), "T05%s:%x;", kind, static_cast<unsigned>(st.address) * 2);
+    return buf;
+}
+
+std::string GdbStub::resume(bool singleStep) {
+    if (singleStep) {
+        debugger.run(1);
+        return stopReply();
+    }
+    // Run in large chunks; the Debugger stops exactly at any breakpoint or
+    // watchpoint, and Ctrl-C is polled between chunks.
+    for (;;) {
+        debugger.run(CONTINUE_CHUNK);
+        if (debugger.lastStop().reason != DebugStop::Reason::NONE || interruptRequested())
+            return stopReply();
+    }
+}
+
+// =============================================================================
+// PACKET DISPATCH
+// =============================================================================
+
+std::string GdbStub::handle(const std::string& pkt, bool& done) {
+    if (pkt.empty()) return "";
+    size_t pos = 1;
+
+    switch (pkt[0]) {
+        case '?':
+            return stopReply();
+
+        case 'g':
+            return readRegisters();
+
+        case 'G':
+            return writeRegisters(pkt.substr(1)) ? "OK" : "E01";
+
+        case 'p': {
+            std::string out;
+            return readRegister(parseHexNumber(pkt, pos), out) ? out : "E01";
+        }
+
+        case 'P': {
+            unsigned n = parseHexNumber(pkt, pos);
+            if (pos >= pkt.size() || pkt[pos] != '=') return "E01";
+            return writeRegister(n, pkt.substr(pos + 1)) ? "OK" : "E01";
+        }
+
+        case 'm': {
+            uint32_t addr = parseHexNumber(pkt, pos);
+            if (pos >= pkt.size() || pkt[pos] != ',') return "E01";
+            ++pos;
+            uint32_t len = parseHexNumber(pkt, pos);
+            if (len != 0 && addr >= MEMORY_SIZE * 2) return "E01";
+            return readMemory(addr, len);
+        }
+
+        case 'M': case 'X': {
+            uint32_t addr = parseHexNumber(pkt, pos);
+            if (pos >= pkt.size() || pkt[pos] != ',') return "E01";
+            ++pos;
+            uint32_t len = parseHexNumber(pkt, pos);
+            if (pos >= pkt.size() || pkt[pos] != ':') return "E01";
+            ++pos;
+            std::string bytes;
+            if (pkt[0] == 'M') {
+                for (uint32_t i = 0; i < len; ++i) {
+                    uint32_t v;
+                    if (!parseHexLE(pkt, pos + 2 * i, 1, v)) return "E01";
+                    bytes += static_cast<char>(v);
+                }
+            } else {
+                // Binary: 0x7d escapes the next byte XOR 0x20.
+                for (size_t i = pos; i < pkt.size(); ++i)
+                    bytes += (pkt[i] == 0x7d && i + 1 < pkt.size()) ? static_cast<char>(pkt[++i] ^ 0x20) : pkt[i];
+                if (bytes.size() != len) return "E01";
+            }
+            writeMemory(addr, bytes);
+            return "OK";
+        }
+
+        case 'c': case 's':
+            if (pos < pkt.size()) cpu.getState().PC = static_cast<uint16_t>(parseHexNumber(pkt, pos) / 2);
+            return resume(pkt[0] == 's');
+
+        case 'Z': case 'z': {
+            // Z0/Z1 breakpoint, Z2 write, Z3 read, Z4 access watchpoint: type,addr,kind
+            if (pkt.size() < 4 || pkt[1] < '0' || pkt[1] > '4') return "";
+            char type = pkt[1] == '1' ? '0' : pkt[1];
+            pos = 3;
+            uint32_t addr = parseHexNumber(pkt, pos);
+            uint32_t len = 2;
+            if (pos < pkt.size() && pkt[pos] == ',') {
+                ++pos;
+                len = std::max<uint32_t>(parseHexNumber(pkt, pos), 1);
+            }
+            auto key = std::make_pair(type, addr);
+            if (pkt[0] == 'z') {
+                auto it = points.find(key);
+                if (it != points.end()) {
+                    debugger.remove(it->second);
+                    points.erase(it);
+                }
+                return "OK";
+            }
+            if (points.count(key)) return "OK";
+            uint16_t word = static_cast<uint16_t>(addr / 2);
+            if (type == '0') {
+                points[key] = debugger.addBreakpoint(word);
+            } else {
+                uint16_t words = static_cast<uint16_t>((addr + len + 1) / 2 - word);
+                WatchKind kind = type == '2' ? WatchKind::WRITE : type == '3' ? WatchKind::READ : WatchKind::ACCESS;
+                points[key] = debugger.addWatchpoint(word, words, kind);
+            }
+            return "OK";
+        }
+
+        case 'v':
+            if (pkt == "vCont?") return "vCont;c;s";
+            if (pkt.compare(0, 6, "vCont;") == 0) return resume(pkt[6] == 's');
+            return "";
+
+        case 'q':
+            if (pkt.compare(0, 10, "qSupported") == 0)
+                return "PacketSize=4000;qXfer:features:read+;QStartNoAckMode+;vContSupported+";
+            if (pkt.compare(0, 31, "qXfer:features:read:target.xml:") == 0) {
+                pos = 31;
+                uint32_t off = parseHexNumber(pkt, pos);
+                ++pos;
+                uint32_t len = parseHexNumber(pkt, pos);
+                std::string xml(TARGET_XML);
+                if (off >= xml.size()) return "l";
+                std::string chunk = xml.substr(off, len);
+                return (off + chunk.size() >= xml.size() ? "l" : "m") + chunk;
+            }
+            if (pkt == "qAttached") return "1";
+            if (pkt == "qC") return "QC1";
+            if (pkt == "qfThreadInfo") return "m1";
+            if (pkt == "qsThreadInfo") return "l";
+            return "";
+
+        case 'Q':
+            if (pkt == "QStartNoAckMode") {
+                sendPacket("OK");
+                noAck = true;
+                return std::string();   // Already answered
+            }
+            return "";
+
+        case 'H':
+            return "OK";   // One thread
+
+        case 'D':
+            sendPacket("OK");
+            done = true;
+            return std::string();
+
+        case 'k':
+            done = true;
+            return std::string();
+
+        default:
+            return "";    // Unsupported: empty reply
+    }
+}
+
+bool GdbStub::serve() {
+#ifndef _WIN32
+    if (listenFd < 0) { error = "not listening"; return false; }
+    clientFd = accept(listenFd, nullptr, nullptr);
+    if (clientFd < 0) { error = std::strerror(errno); return false; }
+    int one = 1;
+    setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   // Fails harmlessly on Unix sockets
+
+    noAck = false;
+    bool done = false;
+    std::string packet;
+    while (!done && readPacket(packet)) {
+        bool isQuiet = packet == "QStartNoAckMode" || packet == "k" || packet == "D";
+        std::string reply = handle(packet, done);
+        if (!isQuiet && !sendPacket(reply))
+            break;
+    }
+    close(clientFd);
+    clientFd = -1;
+    return true;
+#else
+    error = "GDB stub requires POSIX sockets";
+    return false;
+#endif
+}
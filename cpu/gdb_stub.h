@@ -0,0 +1,76 @@
+/**
+ * 16-bit GPR CPU Emulator - GDB Remote Serial Protocol Stub
+ * Lets gdb (or lldb) attach to a running GPRCPU over a local socket.
+ */
+
+#ifndef GDB_STUB_H
+#define GDB_STUB_H
+
+#include "gpr_cpu.h"
+#include "debugger.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+/**
+ * GdbStub: a minimal gdbserver for one CPU + Bus.
+ *
+ * Addressing: GDB works in bytes, the guest in 16-bit words. Memory
+ * packets use byte address = 2 * word address (little-endian words), the
+ * "pc" register is reported as that byte address, and breakpoints are set
+ * on byte addresses. R0-R7, FLAGS and SP are raw 16-bit values.
+ *
+ * Supported packets: ?, g, G, p, P, m, M, X, c, s, vCont, Z0-Z4/z0-z4,
+ * qSupported, qXfer:features:read (target.xml), QStartNoAckMode, D, k
+ * and Ctrl-C. Breakpoints and watchpoints go through a Debugger, so
+ * continuing runs runFor() in large chunks whatever is set. A HALTed
+ * CPU reports SIGTRAP, so its state can still be inspected.
+ *
+ * POSIX sockets only; on other platforms listen*() fail with an error.
+ */
+class GdbStub {
+public:
+    GdbStub(GPRCPU& cpu, Bus& bus);
+    ~GdbStub();
+
+    /** Listen on 127.0.0.1:port. */
+    bool listenTcp(uint16_t port);
+
+    /** Listen on a Unix domain socket at `path` (replacing a stale socket file). */
+    bool listenUnix(const std::string& path);
+
+    /** Accept one client and serve it until it detaches or kills. */
+    bool serve();
+
+    const std::string& lastError() const { return error; }
+
+private:
+    GPRCPU& cpu;
+    Bus& bus;
+    int listenFd;
+    int clientFd;
+    bool noAck;
+    std::string unixPath;
+    std::string error;
+    Debugger debugger;
+    std::map<std::pair<char, uint32_t>, int> points;   // (Z type, byte address) -> Debugger id
+
+    // --- Transport ---
+    bool readPacket(std::string& packet);
+    bool sendPacket(const std::string& payload);
+    bool interruptRequested();
+
+    // --- Commands ---
+    std::string handle(const std::string& packet, bool& done);
+    std::string readRegisters() const;
+    bool writeRegisters(const std::string& hex);
+    bool readRegister(unsigned n, std::string& out) const;
+    bool writeRegister(unsigned n, const std::string& hex);
+    std::string readMemory(uint32_t addr, uint32_t len) const;
+    void writeMemory(uint32_t addr, const std::string& bytes);
+    std::string resume(bool singleStep);
+    std::string stopReply() const;
+};
+
+#endif // GDB_STUB_H
@@ -3,31 +3,351 @@
  */
 
 #include "gpr_cpu.h"
+#include "program_image.h"
+#include "placement.h"
+#include "debug_map.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 // =============================================================================
 // BUS
 // =============================================================================
+// Guest words are read and written with relaxed atomics so several cores can
+// share one Bus (see smp.h) with word-level coherence. On x86 and ARM these
+// compile to the same plain loads and stores as before.
+
+static inline uint16_t loadWord(const uint16_t* p) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+    return *static_cast<const volatile uint16_t*>(p);
+#endif
+}
+
+static inline void storeWord(uint16_t* p, uint16_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(p, value, __ATOMIC_RELAXED);
+#else
+    *static_cast<volatile uint16_t*>(p) = value;
+#endif
+}
+
+static inline bool casWord(uint16_t* p, uint16_t& expected, uint16_t desired) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
+    short prev = _InterlockedCompareExchange16(reinterpret_cast<volatile short*>(p),
+                                               static_cast<short>(desired), static_cast<short>(expected));
+    bool ok = static_cast<uint16_t>(prev) == expected;
+    expected = static_cast<uint16_t>(prev);
+    return ok;
+#endif
+}
+
+// Memory backing: an anonymous private mapping is zero-filled lazily by the
+// host. Untouched pages all map the kernel's single zero page, so reads cost
+// no memory and the first write to a page allocates it. Reads and writes go
+// straight through the MMU; the Bus never tests whether a page exists.
+
+static uint16_t* mapZeroedWords() {
+#ifndef _WIN32
+    void* p = mmap(nullptr, MEMORY_SIZE * sizeof(uint16_t), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : static_cast<uint16_t*>(p);
+#else
+    return nullptr;
+#endif
+}
+
+static void unmapWords(uint16_t* words) {
+#ifndef _WIN32
+    munmap(words, MEMORY_SIZE * sizeof(uint16_t));
+#else
+    (void)words;
+#endif
+}
+
+Bus::Bus() : mapped(false), arena(nullptr), probe(nullptr), devices{}, deviceCount(0), mmioWritten(false), dirtyPages{} {
+    memory = mapZeroedWords();
+    if (memory)
+        mapped = true;
+    else
+        memory = new uint16_t[MEMORY_SIZE]();
+}
 
-Bus::Bus() {
-    memory = new uint16_t[MEMORY_SIZE]();
+Bus::Bus(const ProgramImage& image)
+    : mapped(false), arena(nullptr), probe(nullptr), devices{}, deviceCount(0), mmioWritten(false), dirtyPages{} {
+    memory = image.mapPrivate();
+    if (memory) {
+        mapped = true;
+    } else {
+        memory = new uint16_t[MEMORY_SIZE];   // Image not shareable here: copy it
+        std::memcpy(memory, image.words(), MEMORY_SIZE * sizeof(uint16_t));
+    }
+}
+
+Bus::Bus(BusArena& owner)
+    : mapped(false), arena(nullptr), probe(nullptr), devices{}, deviceCount(0), mmioWritten(false), dirtyPages{} {
+    memory = owner.allocate();
+    if (memory) {
+        arena = &owner;
+        return;
+    }
+    memory = mapZeroedWords();
+    if (memory)
+        mapped = true;
+    else
+        memory = new uint16_t[MEMORY_SIZE]();
 }
 
 Bus::~Bus() {
-    delete[] memory;
+    if (arena)
+        arena->release(memory);
+    else if (mapped)
+        unmapWords(memory);
+    else
+        delete[] memory;
+}
+
+void Bus::loadMemory(const uint16_t* src) {
+    const size_t bytes = PAGE_WORDS * sizeof(uint16_t);
+    for (size_t base = 0; base < MEMORY_SIZE; base += PAGE_WORDS) {
+        // Comparing first only reads our page, which never allocates it.
+        if (std::memcmp(memory + base, src + base, bytes) != 0)
+            std::memcpy(memory + base, src + base, bytes);
+    }
+}
+
+void Bus::clearMemory() {
+    for (size_t base = 0; base < MEMORY_SIZE; base += PAGE_WORDS) {
+        uint16_t* page = memory + base;
+        if (std::any_of(page, page + PAGE_WORDS, [](uint16_t w) { return w != 0; }))
+            std::fill_n(page, PAGE_WORDS, static_cast<uint16_t>(0));
+    }
 }
 
 uint16_t Bus::read(uint16_t address) const {
+    if (probe) probe->record(AccessKind::READ, address);
+    // MMIO page: slot = bits 7-4, register = bits 3-0. Empty slots fall through to RAM.
+    if (address >= MMIO_BASE) {
+        Device* dev = devices[(address >> 4) & 0xFu];
+        if (dev) return dev->read(address & 0xFu);
+    }
     // address is 16-bit so 0..65535; cast to size_t for comparison with MEMORY_SIZE
     if (static_cast<size_t>(address) < MEMORY_SIZE)
-        return memory[address];
+        return loadWord(memory + address);
     return 0;
 }
 
+uint16_t Bus::fetch(uint16_t address) const {
+    if (probe) probe->record(AccessKind::FETCH, address);
+    if (address >= MMIO_BASE) {
+        Device* dev = devices[(address >> 4) & 0xFu];
+        if (dev) return dev->read(address & 0xFu);
+    }
+    return loadWord(memory + address);
+}
+
 void Bus::write(uint16_t address, uint16_t value) {
-    if (static_cast<size_t>(address) < MEMORY_SIZE)
-        memory[address] = value;
+    if (probe) probe->record(AccessKind::WRITE, address);
+    if (address >= MMIO_BASE) {
+        Device* dev = devices[(address >> 4) & 0xFu];
+        if (dev) {
+            dev->write(address & 0xFu, value);
+            mmioWritten = true;
+            return;
+        }
+    }
+    if (static_cast<size_t>(address) < MEMORY_SIZE) {
+        storeWord(memory + address, value);
+        markDirty(address);
+    }
+}
+
+void Bus::markDirty(uint16_t address) {
+    // Same value from every core, but keep it an atomic store for shared Buses.
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(&dirtyPages[address >> 8], static_cast<uint8_t>(PAGE_DIRTY | PAGE_WRITTEN), __ATOMIC_RELAXED);
+#else
+    *static_cast<volatile uint8_t*>(&dirtyPages[address >> 8]) = PAGE_DIRTY | PAGE_WRITTEN;
+#endif
+}
+
+void Bus::markDirtyRange(uint16_t start, uint16_t count) {
+    if (count == 0) return;
+    uint16_t page = start >> 8;
+    uint16_t last = static_cast<uint16_t>(start + count - 1) >> 8;
+    for (;;) {   // Walks forward with wraparound
+        markDirty(static_cast<uint16_t>(page << 8));
+        if (page == last) break;
+        page = (page + 1) & 0xFFu;
+    }
+}
+
+void Bus::clearDirtyPages() {
+    for (uint8_t& d : dirtyPages)
+        d &= static_cast<uint8_t>(~PAGE_DIRTY);
+}
+
+size_t Bus::writtenPageCount() const {
+    return static_cast<size_t>(std::count_if(dirtyPages, dirtyPages + PAGE_COUNT,
+                                             [](uint8_t d) { return (d & PAGE_WRITTEN) != 0; }));
+}
+
+void Bus::resetMemory(const uint16_t* baseline) {
+    for (size_t page = 0; page < PAGE_COUNT; ++page) {
+        if (!(dirtyPages[page] & PAGE_WRITTEN))
+            continue;
+        std::memcpy(memory + page * PAGE_WORDS, baseline + page * PAGE_WORDS, PAGE_WORDS * sizeof(uint16_t));
+        dirtyPages[page] = PAGE_DIRTY;   // Reverting is itself a change
+    }
+}
+
+bool Bus::discardMemory() {
+#ifndef _WIN32
+    if (!mapped)
+        return false;
+    // Drop whole host pages holding any written Bus page, merging
+    // neighbours into one madvise() call per contiguous run.
+    static const size_t hostPage = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t perHost = std::max<size_t>(1, hostPage / (PAGE_WORDS * sizeof(uint16_t)));
+    char* base = reinterpret_cast<char*>(memory);
+    size_t runStart = 0, runLength = 0;
+    for (size_t page = 0; page < PAGE_COUNT; page += perHost) {
+        bool written = false;
+        for (size_t p = page; p < page + perHost && p < PAGE_COUNT; ++p) {
+            if (dirtyPages[p] & PAGE_WRITTEN) {
+                written = true;
+                dirtyPages[p] = PAGE_DIRTY;
+            }
+        }
+        if (written) {
+            if (runLength == 0) runStart = page;
+            runLength += perHost;
+        }
+        if ((!written || page + perHost >= PAGE_COUNT) && runLength) {
+            madvise(base + runStart * PAGE_WORDS * sizeof(uint16_t),
+                    std::min(runLength, PAGE_COUNT - runStart) * PAGE_WORDS * sizeof(uint16_t), MADV_DONTNEED);
+            runLength = 0;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Bus::compareExchange(uint16_t address, uint16_t& expected, uint16_t desired) {
+    if (probe) {
+        probe->record(AccessKind::READ, address);
+        probe->record(AccessKind::WRITE, address);
+    }
+    if (address >= MMIO_BASE && devices[(address >> 4) & 0xFu]) {
+        // Device registers have no atomic path; emulate with read + write.
+        uint16_t current = read(address);
+        if (current != expected) {
+            expected = current;
+            return false;
+        }
+        write(address, desired);
+        return true;
+    }
+    bool swapped = casWord(memory + address, expected, desired);
+    if (swapped) markDirty(address);
+    return swapped;
+}
+
+void Bus::attachDevice(unsigned slot, Device* device) {
+    if (slot >= MMIO_SLOTS)
+        return;
+    if (devices[slot]) --deviceCount;
+    devices[slot] = device;
+    if (device) ++deviceCount;
+    mmioWritten = true;  // timing may have changed
+}
+
+uint16_t Bus::tickDevices(uint64_t cycles) {
+    uint16_t irqs = 0;
+    if (deviceCount == 0 || cycles == 0)
+        return 0;
+    for (Device* dev : devices)
+        if (dev) irqs |= dev->tick(cycles);
+    return irqs;
+}
+
+uint64_t Bus::cyclesUntilEvent() const {
+    uint64_t next = UINT64_MAX;
+    if (deviceCount == 0)
+        return next;
+    for (const Device* dev : devices)
+        if (dev) next = std::min(next, dev->cyclesUntilEvent());
+    return next;
+}
+
+void Bus::copyBlock(uint16_t dst, uint16_t src, uint16_t count) {
+    if (count == 0 || dst == src)
+        return;
+    markDirtyRange(dst, count);
+
+    // A probe sees the block as the word-by-word accesses it replaces.
+    if (probe) {
+        for (uint16_t i = 0; i < count; ++i) {
+            probe->record(AccessKind::READ, static_cast<uint16_t>(src + i));
+            probe->record(AccessKind::WRITE, static_cast<uint16_t>(dst + i));
+        }
+    }
+
+    // Fast path: neither range wraps past 0xFFFF, so one memmove handles
+    // any overlap and lets the C library use its vectorized copy loop.
+    if (static_cast<size_t>(src) + count <= MEMORY_SIZE &&
+        static_cast<size_t>(dst) + count <= MEMORY_SIZE) {
+        std::memmove(memory + dst, memory + src, count * sizeof(uint16_t));
+        return;
+    }
+
+    // Wrapping range: gather the source (at most two linear pieces) into a
+    // temporary buffer, then scatter it to the destination. This keeps the
+    // "as if through a temporary" guarantee even when both ends overlap.
+    std::vector<uint16_t> tmp(count);
+    size_t first = std::min<size_t>(count, MEMORY_SIZE - src);
+    std::memcpy(tmp.data(), memory + src, first * sizeof(uint16_t));
+    std::memcpy(tmp.data() + first, memory, (count - first) * sizeof(uint16_t));
+
+    first = std::min<size_t>(count, MEMORY_SIZE - dst);
+    std::memcpy(memory + dst, tmp.data(), first * sizeof(uint16_t));
+    std::memcpy(memory, tmp.data() + first, (count - first) * sizeof(uint16_t));
+}
+
+void Bus::fillBlock(uint16_t dst, uint16_t value, uint16_t count) {
+    if (probe) {
+        for (uint16_t i = 0; i < count; ++i)
+            probe->record(AccessKind::WRITE, static_cast<uint16_t>(dst + i));
+    }
+    markDirtyRange(dst, count);
+
+    // Split at the 0xFFFF -> 0x0000 wrap; std::fill_n vectorizes each piece.
+    size_t first = std::min<size_t>(count, MEMORY_SIZE - dst);
+    std::fill_n(memory + dst, first, value);
+    std::fill_n(memory, count - first, value);
+}
+
+void Bus::writeBlock(uint16_t dst, const uint16_t* src, size_t count) {
+    if (count == 0)
+        return;
+    for (size_t page = dst / PAGE_WORDS; page <= (dst + count - 1) / PAGE_WORDS; ++page)
+        markDirty(static_cast<uint16_t>(page * PAGE_WORDS));
+    std::memcpy(memory + dst, src, count * sizeof(uint16_t));
 }
 
 // =============================================================================
@@ -58,6 +378,16 @@ uint16_t GPRCPU::decodeImm9(uint16_t inst) {
     return inst & 0x1FFu;
 }
 
+uint8_t GPRCPU::decodeExtGroup(uint16_t inst) {
+    // Extended group is in bits 5-3. Shift right by 3, mask with 0x7.
+    return static_cast<uint8_t>((inst >> 3) & 0x7u);
+}
+
+uint8_t GPRCPU::decodeRc(uint16_t inst) {
+    // Rc (or MISC sub-operation) is in bits 2-0. Mask with 0x7.
+    return static_cast<uint8_t>(inst & 0x7u);
+}
+
 // =============================================================================
 // FLAG UPDATES
 // =============================================================================
@@ -96,7 +426,9 @@ void GPRCPU::setSubFlags(uint16_t a, uint16_t b, uint16_t result) {
 // CPU CONSTRUCTION & RESET
 // =============================================================================
 
-GPRCPU::GPRCPU(Bus& bus) : bus(bus), tracing(false) {
+GPRCPU::GPRCPU(Bus& bus)
+    : bus(bus), tracing(false), blockStart(0), coreId(0), stopRequested(false), deferAtomics(false), atomicPending(false), breakHit(false),
+      compiled(nullptr), debugMap(nullptr) {
     reset();
 }
 
@@ -106,6 +438,79 @@ void GPRCPU::reset() {
     state.PC = 0;
     state.FLAGS = 0;
     state.halted = false;
+    state.SP = STACK_TOP;
+    state.pendingIRQ = 0;
+    state.IE = false;
+    state.waiting = false;
+    blockStart = 0;
+    stopRequested = false;
+    atomicPending = false;
+    breakHit = false;
+}
+
+void GPRCPU::restoreState(const CPUState& saved) {
+    state = saved;
+    blockStart = saved.PC;
+    stopRequested = false;
+    atomicPending = false;
+    breakHit = false;
+}
+
+// =============================================================================
+// CONTROL-FLOW LISTENERS
+// =============================================================================
+
+void GPRCPU::addFlowListener(ControlFlowListener* listener) {
+    if (flowListeners.empty())
+        blockStart = state.PC;     // Start counting from where we are now
+    flowListeners.push_back(listener);
+}
+
+void GPRCPU::removeFlowListener(ControlFlowListener* listener) {
+    flowListeners.erase(std::remove(flowListeners.begin(), flowListeners.end(), listener), flowListeners.end());
+}
+
+void GPRCPU::endBlock(BranchKind kind, bool taken, uint16_t end, uint16_t next) {
+    for (ControlFlowListener* l : flowListeners)
+        l->onBlock(blockStart, end, kind, taken, next);
+    blockStart = next;
+}
+
+// =============================================================================
+// STACK & INTERRUPTS
+// =============================================================================
+
+void GPRCPU::push(uint16_t value) {
+    state.SP -= 1;                 // Full-descending: move to the free slot first
+    bus.write(state.SP, value);
+}
+
+uint16_t GPRCPU::pop() {
+    uint16_t value = bus.read(state.SP);
+    state.SP += 1;
+    return value;
+}
+
+void GPRCPU::serviceInterrupts() {
+    if (state.pendingIRQ == 0)
+        return;
+    state.waiting = false;         // Any pending line wakes WFI, even with IE clear
+    if (!state.IE)
+        return;
+
+    // Lowest-numbered line wins. Save PC and FLAGS, mask further interrupts.
+    unsigned line = 0;
+    while (!(state.pendingIRQ & (1u << line)))
+        ++line;
+    state.pendingIRQ &= static_cast<uint16_t>(~(1u << line));
+    push(state.PC);
+    push(state.FLAGS);
+    state.IE = false;
+    uint16_t interrupted = state.PC;
+    state.PC = bus.read(static_cast<uint16_t>(IVT_BASE + line));
+    if (!flowListeners.empty()) endBlock(BranchKind::IRQ, true, interrupted, state.PC);
+    if (tracing) std::cout << "  [IRQ] line " << line << " -> PC = 0x" << std::hex << std::setw(4) << std::setfill('0')
+        << state.PC << std::dec << "\n";
 }
 
 // =============================================================================
@@ -113,14 +518,19 @@ void GPRCPU::reset() {
 // =============================================================================
 
 bool GPRCPU::step() {
-    if (state.halted)
+    if (state.halted || state.waiting)
         return false;
 
     // --- FETCH: Read instruction at PC from memory via bus ---
-    uint16_t instruction = bus.read(state.PC);
+    uint16_t instruction = bus.fetch(state.PC);
 
     if (tracing) {
-        std::cout << "\n--- Cycle @ PC=0x" << std::hex << std::setw(4) << std::setfill('0') << state.PC << " ---\n";
+        std::cout << "\n--- Cycle @ PC=0x" << std::hex << std::setw(4) << std::setfill('0') << state.PC;
+        if (debugMap) {
+            std::string where = debugMap->describe(state.PC);
+            if (!where.empty()) std::cout << " (" << where << ")";
+        }
+        std::cout << " ---\n";
         std::cout << "  Instruction: 0x" << std::setw(4) << instruction << "\n";
         std::cout << "  R0=" << std::setw(4) << state.R[0] << " R1=" << std::setw(4) << state.R[1]
                   << " R2=" << std::setw(4) << state.R[2] << " R3=" << std::setw(4) << state.R[3]
@@ -138,7 +548,7 @@ bool GPRCPU::step() {
     // --- EXECUTE: Perform the operation ---
     execute(instruction);
 
-    return !state.halted;
+    return !state.halted && !state.waiting && !stopRequested;
 }
 
 void GPRCPU::execute(uint16_t instruction) {
@@ -150,13 +560,15 @@ void GPRCPU::execute(uint16_t instruction) {
     switch (static_cast<Opcode>(op)) {
         case Opcode::HALT:
             state.halted = true;
+            if (!flowListeners.empty()) endBlock(BranchKind::HALT, false, state.PC, state.PC);
             if (tracing) std::cout << "  [EXEC] HALT\n";
             break;
 
         case Opcode::MOVI: {
-            // Rd = 9-bit immediate (zero-extended to 16 bits)
+            // Rd = 9-bit immediate (zero-extended to 16 bits). FLAGS are left
+            // alone so the assembler's "MOVI R7, label; JZ R7" expansion still
+            // tests the flags of the instruction before it.
             state.R[rd] = imm9;
-            setResultFlags(state.R[rd]);
             if (tracing) std::cout << "  [EXEC] MOVI R" << static_cast<unsigned>(rd) << ", " << imm9 << "\n";
             break;
         }
@@ -260,12 +672,17 @@ void GPRCPU::execute(uint16_t instruction) {
         }
 
         case Opcode::JMP: {
+            if (!flowListeners.empty()) endBlock(BranchKind::JMP, true, state.PC, state.R[rs]);
             state.PC = state.R[rs];
             if (tracing) std::cout << "  [EXEC] JMP R" << static_cast<unsigned>(rs) << "  ; PC = 0x" << std::hex << std::setw(4) << state.PC << std::dec << "\n";
             break;
         }
 
         case Opcode::JZ: {
+            if (!flowListeners.empty()) {
+                bool taken = (state.FLAGS & FLAG_ZERO) != 0;
+                endBlock(BranchKind::JZ, taken, state.PC, taken ? state.R[rs] : state.PC);
+            }
             if (state.FLAGS & FLAG_ZERO) {
                 state.PC = state.R[rs];
                 if (tracing) std::cout << "  [EXEC] JZ R" << static_cast<unsigned>(rs) << "  ; Z=1, PC = 0x" << std::hex << std::setw(4) << state.PC << std::dec << "\n";
@@ -277,6 +694,169 @@ void GPRCPU::execute(uint16_t instruction) {
 
         case Opcode::NOP:
         default:
+            executeExtended(instruction);
+            break;
+    }
+}
+
+// =============================================================================
+// EXTENDED INSTRUCTIONS (opcode 15)
+// =============================================================================
+
+bool GPRCPU::compareAndSwap(Bus& target, uint8_t rd, uint8_t rs, uint8_t rc) {
+    // Rd holds the expected value, Rc the new one. Rd receives the current value.
+    uint16_t expected = state.R[rd];
+    bool swapped = target.compareExchange(state.R[rs], expected, state.R[rc]);
+    state.R[rd] = expected;   // Unchanged on success, current value on failure
+    state.FLAGS &= ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE);
+    if (swapped) state.FLAGS |= FLAG_ZERO;
+    return swapped;
+}
+
+bool GPRCPU::completeDeferredAtomic(Bus& shared) {
+    if (!atomicPending)
+        return false;
+    atomicPending = false;
+    uint16_t instruction = bus.getMemory()[state.PC];   // Already fetched (and probed) by runFor()
+    compareAndSwap(shared, decodeRd(instruction), decodeRs(instruction), decodeRc(instruction));
+    state.PC += 1;
+    // This is the CAS's cycle; runFor() left it out.
+    state.pendingIRQ |= bus.tickDevices(1);
+    return true;
+}
+
+void GPRCPU::executeExtended(uint16_t instruction) {
+    uint8_t rd = decodeRd(instruction);
+    uint8_t rs = decodeRs(instruction);
+    uint8_t rc = decodeRc(instruction);
+
+    switch (static_cast<ExtOp>(decodeExtGroup(instruction))) {
+        case ExtOp::BMOV: {
+            // Whole block in one instruction; flags and registers are unchanged.
+            bus.copyBlock(state.R[rd], state.R[rs], state.R[rc]);
+            if (tracing) std::cout << "  [EXEC] BMOV R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs)
+                << ", R" << static_cast<unsigned>(rc) << "  ; mem[0x" << std::hex << std::setw(4) << std::setfill('0') << state.R[rd]
+                << "..] = mem[0x" << std::setw(4) << state.R[rs] << "..], " << std::dec << state.R[rc] << " words\n";
+            break;
+        }
+
+        case ExtOp::BFILL: {
+            bus.fillBlock(state.R[rd], state.R[rs], state.R[rc]);
+            if (tracing) std::cout << "  [EXEC] BFILL R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs)
+                << ", R" << static_cast<unsigned>(rc) << "  ; mem[0x" << std::hex << std::setw(4) << std::setfill('0') << state.R[rd]
+                << "..] = 0x" << std::setw(4) << state.R[rs] << ", " << std::dec << state.R[rc] << " words\n";
+            break;
+        }
+
+        case ExtOp::CAS: {
+            if (deferAtomics) {
+                // Leave PC on the CAS and stop; the scheduler completes it later.
+                state.PC -= 1;
+                atomicPending = true;
+                requestStop();
+                if (tracing) std::cout << "  [EXEC] CAS deferred\n";
+                break;
+            }
+            uint16_t addr = state.R[rs];
+            bool swapped = compareAndSwap(bus, rd, rs, rc);
+            if (tracing) {
+                std::cout << "  [EXEC] CAS R" << static_cast<unsigned>(rd) << ", (R" << static_cast<unsigned>(rs)
+                    << "), R" << static_cast<unsigned>(rc) << "  ; mem[0x" << std::hex << std::setw(4) << std::setfill('0') << addr << "] ";
+                if (swapped) std::cout << "swapped";
+                else std::cout << "mismatch, R" << static_cast<unsigned>(rd) << " = 0x" << std::setw(4) << state.R[rd];
+                std::cout << std::dec << "\n";
+            }
+            break;
+        }
+
+        case ExtOp::MISC:
+            switch (static_cast<MiscOp>(rc)) {
+                case MiscOp::RET: {
+                    uint16_t end = state.PC;
+                    state.PC = pop();
+                    if (!flowListeners.empty()) endBlock(BranchKind::RET, true, end, state.PC);
+                    if (tracing) std::cout << "  [EXEC] RET  ; PC = 0x" << std::hex << std::setw(4) << std::setfill('0') << state.PC << std::dec << "\n";
+                    break;
+                }
+                case MiscOp::RETI: {
+                    uint16_t end = state.PC;
+                    state.FLAGS = pop();
+                    state.PC = pop();
+                    state.IE = true;
+                    if (!flowListeners.empty()) endBlock(BranchKind::RETI, true, end, state.PC);
+                    if (tracing) std::cout << "  [EXEC] RETI  ; PC = 0x" << std::hex << std::setw(4) << std::setfill('0') << state.PC << std::dec << "\n";
+                    break;
+                }
+                case MiscOp::EI:
+                    state.IE = true;
+                    if (tracing) std::cout << "  [EXEC] EI\n";
+                    break;
+                case MiscOp::DI:
+                    state.IE = false;
+                    if (tracing) std::cout << "  [EXEC] DI\n";
+                    break;
+                case MiscOp::CALL:
+                    if (!flowListeners.empty()) endBlock(BranchKind::CALL, true, state.PC, state.R[rs]);
+                    push(state.PC);        // PC already points at the return address
+                    state.PC = state.R[rs];
+                    if (tracing) std::cout << "  [EXEC] CALL R" << static_cast<unsigned>(rs) << "  ; PC = 0x" << std::hex << std::setw(4)
+                        << std::setfill('0') << state.PC << ", SP = 0x" << state.SP << std::dec << "\n";
+                    break;
+                case MiscOp::PUSH:
+                    push(state.R[rd]);
+                    if (tracing) std::cout << "  [EXEC] PUSH R" << static_cast<unsigned>(rd) << "  ; SP = 0x" << std::hex << std::setw(4)
+                        << std::setfill('0') << state.SP << std::dec << "\n";
+                    break;
+                case MiscOp::POP:
+                    state.R[rd] = pop();
+                    if (tracing) std::cout << "  [EXEC] POP R" << static_cast<unsigned>(rd) << "  ; SP = 0x" << std::hex << std::setw(4)
+                        << std::setfill('0') << state.SP << std::dec << "\n";
+                    break;
+                case MiscOp::NOP:
+                default:
+                    if (tracing) std::cout << "  [EXEC] NOP\n";
+                    break;
+            }
+            break;
+
+        case ExtOp::SYS:
+            switch (static_cast<SysOp>(rc)) {
+                case SysOp::SETSP:
+                    state.SP = state.R[rd];
+                    if (tracing) std::cout << "  [EXEC] SETSP R" << static_cast<unsigned>(rd) << "\n";
+                    break;
+                case SysOp::GETSP:
+                    state.R[rd] = state.SP;
+                    if (tracing) std::cout << "  [EXEC] GETSP R" << static_cast<unsigned>(rd) << "\n";
+                    break;
+                case SysOp::WFI:
+                    // Sleep; runFor skips ahead to the next device event.
+                    state.waiting = (state.pendingIRQ == 0);
+                    if (tracing) std::cout << "  [EXEC] WFI\n";
+                    break;
+                case SysOp::CPUID:
+                    state.R[rd] = coreId;
+                    if (tracing) std::cout << "  [EXEC] CPUID R" << static_cast<unsigned>(rd) << "  ; = " << coreId << "\n";
+                    break;
+                case SysOp::FENCE:
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (tracing) std::cout << "  [EXEC] FENCE\n";
+                    break;
+                case SysOp::BRK:
+                    // Rewind onto the BRK and stop; runFor() does not count it.
+                    state.PC -= 1;
+                    breakHit = true;
+                    requestStop();
+                    if (tracing) std::cout << "  [EXEC] BRK\n";
+                    break;
+                default:
+                    if (tracing) std::cout << "  [EXEC] NOP\n";
+                    break;
+            }
+            break;
+
+        default:
+            // Every unassigned encoding behaves as NOP.
             if (tracing) std::cout << "  [EXEC] NOP\n";
             break;
     }
@@ -287,8 +867,92 @@ void GPRCPU::execute(uint16_t instruction) {
 // =============================================================================
 
 size_t GPRCPU::run() {
-    size_t cycles = 0;
-    while (step())
-        ++cycles;
-    return cycles;
+    // runFor only returns before its budget when halted, stopped by
+    // requestStop(), or asleep with no device left to wake us.
+    return runFor(SIZE_MAX);
+}
+
+// =============================================================================
+// COMPILED SLICES
+// =============================================================================
+// Same counting as the interpreter loop in runFor(): every instruction is a
+// cycle except HALT and BRK, and the slice ends after any instruction that
+// stops the CPU or writes MMIO.
+
+size_t GPRCPU::runCompiledSlice(size_t slice) {
+    size_t n = 0;
+    while (n < slice) {
+        CompiledCode::Exit exit = compiled->execute(state, bus, coreId, slice - n, n);
+        if (exit == CompiledCode::Exit::HALT || exit == CompiledCode::Exit::SLICE_BREAK)
+            return n;
+        if (exit == CompiledCode::Exit::CODE_WRITTEN) {
+            compiled = nullptr;    // Stale: interpret from here on
+            if (bus.sliceBreak())
+                return n;
+            break;
+        }
+        if (n >= slice)
+            return n;
+        // One instruction the compiled code could not run (WFI, BRK, CAS,
+        // or code it never saw).
+        bool running = step();
+        if (!state.halted && !breakHit)
+            ++n;
+        if (!running || bus.sliceBreak())
+            return n;
+    }
+    while (n < slice && step() && !bus.sliceBreak())
+        ++n;
+    if (n < slice && !state.halted && !breakHit)
+        ++n;
+    return n;
+}
+
+// =============================================================================
+// RUN FOR A CYCLE BUDGET (slice scheduler for devices and interrupts)
+// =============================================================================
+
+size_t GPRCPU::runFor(size_t maxCycles) {
+    size_t done = 0;
+    breakHit = false;
+
+    while (done < maxCycles && !state.halted) {
+        // Slice boundary: the only place interrupts are examined.
+        serviceInterrupts();
+
+        // End the slice on the exact cycle the next device event fires.
+        uint64_t untilEvent = bus.cyclesUntilEvent();
+        size_t slice = maxCycles - done;
+        if (untilEvent < slice)
+            slice = static_cast<size_t>(untilEvent == 0 ? 1 : untilEvent);
+
+        size_t n = 0;
+        if (state.waiting) {
+            if (untilEvent == UINT64_MAX)
+                break;             // Asleep forever: no device will wake us
+            n = slice;             // Fast-forward idle time in a single jump
+        } else {
+            bus.clearSliceBreak();
+            if (compiled && !tracing && flowListeners.empty() && !bus.getProbe() && !deferAtomics) {
+                n = runCompiledSlice(slice);
+            } else {
+                // Hot loop: one instruction per cycle, no interrupt checks.
+                while (n < slice && step() && !bus.sliceBreak())
+                    ++n;
+                // Count the instruction that broke the slice; a deferred CAS
+                // is counted when it completes.
+                if (n < slice && !state.halted && !breakHit && !atomicPending)
+                    ++n;
+            }
+        }
+
+        done += n;
+        state.pendingIRQ |= bus.tickDevices(n);
+
+        if (stopRequested) {
+            stopRequested = false;
+            break;
+        }
+    }
+    return done;
 }
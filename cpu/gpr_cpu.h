@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <vector>
 
 // =============================================================================
 // MEMORY & BUS
@@ -16,27 +17,254 @@
 /** 64KB addressable memory (2^16 = 65536 words, each 16 bits) */
 constexpr size_t MEMORY_SIZE = 65536;
 
+/** Memory is tracked in 256-word pages (page = address >> 8). */
+constexpr size_t PAGE_WORDS = 256;
+constexpr size_t PAGE_COUNT = MEMORY_SIZE / PAGE_WORDS;
+
+/**
+ * Fixed memory map for the stack, interrupt vectors and devices:
+ *   0x0000-0xFEEF  RAM (program, data; the stack grows down from 0xFEF0)
+ *   0xFEF0-0xFEFF  Interrupt vector table: handler address for IRQ line 0..15
+ *   0xFF00-0xFFFF  MMIO: 16 device slots of 16 registers each
+ */
+constexpr uint16_t STACK_TOP   = 0xFEF0;
+constexpr uint16_t IVT_BASE    = 0xFEF0;
+constexpr uint16_t MMIO_BASE   = 0xFF00;
+constexpr unsigned MMIO_SLOTS  = 16;
+constexpr unsigned IRQ_LINES   = 16;
+
+/**
+ * Device: a memory-mapped peripheral occupying one 16-register MMIO slot.
+ * Devices advance in CPU cycles and report interrupts through tick().
+ */
+class Device {
+public:
+    virtual ~Device() = default;
+
+    /** Read register `reg` (0-15) of this device. */
+    virtual uint16_t read(uint16_t reg) = 0;
+
+    /** Write register `reg` (0-15) of this device. */
+    virtual void write(uint16_t reg, uint16_t value) = 0;
+
+    /** Advance the device by `cycles`. Returns a bitmask of IRQ lines to raise. */
+    virtual uint16_t tick(uint64_t cycles) { (void)cycles; return 0; }
+
+    /** Cycles until the next interrupt this device will raise (UINT64_MAX if none). */
+    virtual uint64_t cyclesUntilEvent() const { return UINT64_MAX; }
+
+    /** Append the device's internal state to `out` (for snapshots). */
+    virtual void saveState(std::vector<uint8_t>& out) const { (void)out; }
+
+    /** Restore state written by saveState(). Returns false if `data` does not fit. */
+    virtual bool restoreState(const uint8_t* data, size_t size) { (void)data; return size == 0; }
+};
+
+/** Kind of Bus access seen by a BusProbe. */
+enum class AccessKind : uint8_t {
+    FETCH,  // Instruction fetch from GPRCPU::step()
+    READ,   // Data read (LOAD, POP, vector fetch, ...)
+    WRITE   // Data write (STORE, PUSH, ...)
+};
+
+/**
+ * BusProbe: observes every Bus access in batches. record() is inline and
+ * only appends to a fixed buffer; the virtual processBatch() runs once per
+ * BATCH accesses, so an attached probe costs a store per access rather
+ * than a virtual call. Call flush() before reading a probe's results.
+ * Pages marked immediate flush on every access, so a probe can react
+ * during the instruction that touched them (watchpoints).
+ */
+class BusProbe {
+public:
+    struct Access {
+        uint16_t address;
+        AccessKind kind;
+    };
+    static constexpr size_t BATCH = 4096;
+
+    virtual ~BusProbe() = default;
+
+    void record(AccessKind kind, uint16_t address) {
+        batch[count++] = Access{address, kind};
+        if (count == BATCH || immediatePages[address >> 8])
+            flush();
+    }
+
+    /** Hand any buffered accesses to processBatch(). */
+    void flush() {
+        if (count) {
+            processBatch(batch, count);
+            count = 0;
+        }
+    }
+
+protected:
+    /** Consume `n` accesses in program order. */
+    virtual void processBatch(const Access* accesses, size_t n) = 0;
+
+    /** Deliver accesses to `page` as they happen instead of batched. */
+    void setImmediatePage(unsigned page, bool immediate) { immediatePages[page] = immediate; }
+
+private:
+    Access batch[BATCH];
+    size_t count = 0;
+    uint8_t immediatePages[PAGE_COUNT] = {};
+};
+
+class ProgramImage;
+class BusArena;
+class DebugMap;
+
 /**
  * Bus: Simple abstraction for memory reads/writes.
- * Decouples the CPU from raw memory and allows future expansion (e.g., MMIO).
+ * Decouples the CPU from raw memory and routes the MMIO page to devices.
  */
 class Bus {
 public:
+    /**
+     * Fresh, all-zero memory. On POSIX it is an anonymous mapping: every
+     * page reads from the host's shared zero page and gets real memory only
+     * on its first write, so a Bus costs the pages a program touches.
+     */
     Bus();
+
+    /**
+     * Start from a shared program image: memory is mapped copy-on-write,
+     * so untouched pages are shared with every other Bus using `image`.
+     * The image may be destroyed before the Bus.
+     */
+    explicit Bus(const ProgramImage& image);
+
+    /**
+     * Zeroed memory carved from `arena` (huge-page / NUMA placement, see
+     * placement.h). The arena must outlive the Bus. Falls back to Bus()'s
+     * backing if the arena cannot map more memory.
+     */
+    explicit Bus(BusArena& arena);
     ~Bus();
 
+    Bus(const Bus&) = delete;
+    Bus& operator=(const Bus&) = delete;
+
     /** Read 16-bit word at address. Returns 0 if address out of range. */
     uint16_t read(uint16_t address) const;
 
+    /** Instruction fetch: same as read() but reported to the probe as FETCH. */
+    uint16_t fetch(uint16_t address) const;
+
     /** Write 16-bit word at address. No-op if address out of range. */
     void write(uint16_t address, uint16_t value);
 
+    /**
+     * Atomic compare-and-swap (sequentially consistent): if mem[address] ==
+     * expected, store desired and return true; otherwise load the current
+     * value into expected and return false.
+     */
+    bool compareExchange(uint16_t address, uint16_t& expected, uint16_t desired);
+
+    /**
+     * Block move: copy `count` words from src to dst with memmove semantics
+     * (overlapping ranges behave as if copied through a temporary buffer).
+     * Addresses wrap from 0xFFFF back to 0x0000.
+     */
+    void copyBlock(uint16_t dst, uint16_t src, uint16_t count);
+
+    /** Block fill: write `value` into `count` words starting at dst (wraps at 0xFFFF). */
+    void fillBlock(uint16_t dst, uint16_t value, uint16_t count);
+
+    /**
+     * Host bulk write: copy `count` words (dst + count <= MEMORY_SIZE) from
+     * `src` into memory with one memcpy, marking the pages dirty like
+     * write(). Like the block instructions it does not go to MMIO devices;
+     * unlike them it is not shown to the probe, since the guest did not do it.
+     */
+    void writeBlock(uint16_t dst, const uint16_t* src, size_t count);
+
     /** Direct pointer to memory for loading programs (use with care). */
     uint16_t* getMemory() { return memory; }
     const uint16_t* getMemory() const { return memory; }
 
+    /**
+     * Make this Bus's memory equal to `src` (MEMORY_SIZE words, e.g. another
+     * Bus's getMemory()) without touching pages that already match, so
+     * pages that stay zero are never allocated. Not seen by probes or the
+     * dirty-page bitmap.
+     */
+    void loadMemory(const uint16_t* src);
+
+    /** Zero all memory, skipping pages that are already zero. */
+    void clearMemory();
+
+    /**
+     * Map a device into MMIO slot 0-15 (registers at MMIO_BASE + slot*16).
+     * The Bus does not own the device; pass nullptr to unmap.
+     */
+    void attachDevice(unsigned slot, Device* device);
+    Device* getDevice(unsigned slot) const { return slot < MMIO_SLOTS ? devices[slot] : nullptr; }
+
+    /** Advance every attached device. Returns the OR of their IRQ masks. */
+    uint16_t tickDevices(uint64_t cycles);
+
+    /** Smallest cyclesUntilEvent() across attached devices. */
+    uint64_t cyclesUntilEvent() const;
+
+    /**
+     * Set when an MMIO write may have changed device timing. GPRCPU::runFor
+     * ends its current slice early so the next event is rescheduled.
+     */
+    bool sliceBreak() const { return mmioWritten; }
+    void clearSliceBreak() { mmioWritten = false; }
+
+    /**
+     * Dirty-page tracking: every write through the Bus (write, block ops,
+     * CAS) marks its 256-word page. Writes through getMemory() are not seen.
+     * Two independent views share the one store per write: "dirty" is
+     * cleared by clearDirtyPages() (used by DeterministicSMP), "written"
+     * only by resetMemory()/discardMemory().
+     */
+    bool isPageDirty(unsigned page) const { return (dirtyPages[page] & PAGE_DIRTY) != 0; }
+    void clearDirtyPages();
+
+    bool isPageWritten(unsigned page) const { return (dirtyPages[page] & PAGE_WRITTEN) != 0; }
+    size_t writtenPageCount() const;
+
+    /**
+     * Copy every page written since the last reset back from `baseline`
+     * (MEMORY_SIZE words) and clear the written marks. Costs one 512-byte
+     * copy per written page, so a short run is undone in nanoseconds.
+     */
+    void resetMemory(const uint16_t* baseline);
+
+    /**
+     * Revert written pages to the Bus's initial contents (zeros, or its
+     * ProgramImage) by dropping the host pages that hold them
+     * (madvise MADV_DONTNEED), which also returns their memory to the
+     * host. Best for runs that wrote many pages. Returns false, changing
+     * nothing, if memory is not an mmap; use resetMemory() then. Any
+     * untracked getMemory() edits in a dropped host page are lost too.
+     */
+    bool discardMemory();
+
+    /** Attach an access probe (not owned); nullptr detaches. */
+    void setProbe(BusProbe* p) { probe = p; }
+    BusProbe* getProbe() const { return probe; }
+
 private:
     uint16_t* memory;
+    bool mapped;           // memory is an mmap (anonymous or ProgramImage), not new[]
+    BusArena* arena;       // Owner of memory when it came from a BusArena
+    BusProbe* probe;
+    Device* devices[MMIO_SLOTS];
+    unsigned deviceCount;
+    bool mmioWritten;
+    uint8_t dirtyPages[PAGE_COUNT];    // PAGE_DIRTY | PAGE_WRITTEN per page
+
+    static constexpr uint8_t PAGE_DIRTY   = 1;
+    static constexpr uint8_t PAGE_WRITTEN = 2;
+
+    void markDirty(uint16_t address);
+    void markDirtyRange(uint16_t start, uint16_t count);
 };
 
 // =============================================================================
@@ -68,9 +296,52 @@ enum class Opcode : uint8_t {
     SHR,    // Shift right logical by 1
     JMP,    // PC = Rs (jump to address in Rs)
     JZ,     // If Zero flag set, PC = Rs
-    NOP
+    NOP     // Also the prefix for extended instructions (see ExtOp)
+};
+
+// =============================================================================
+// EXTENDED INSTRUCTIONS (opcode 15, selected by the low 6 bits)
+// =============================================================================
+// Format: [15:12]=0xF, [11:9]=Rd, [8:6]=Rs, [5:3]=ExtOp group, [2:0]=Rc
+// A plain NOP is 0xF000 (group MISC, sub-op 0), so old programs are unaffected.
+
+enum class ExtOp : uint8_t {
+    MISC  = 0,  // [2:0] selects a register-less operation (0 = NOP)
+    BMOV  = 1,  // Block move:  mem[Rd .. Rd+Rc-1] = mem[Rs .. Rs+Rc-1]
+    BFILL = 2,  // Block fill:  mem[Rd .. Rd+Rc-1] = Rs
+    CAS   = 3,  // Atomic: if mem[Rs] == Rd { mem[Rs] = Rc; Z=1 } else { Rd = mem[Rs]; Z=0 }
+    SYS   = 4   // [2:0] selects a stack-pointer / system operation on Rd
 };
 
+/** Sub-operations of ExtOp::MISC, held in bits 2-0. */
+enum class MiscOp : uint8_t {
+    NOP  = 0,
+    RET  = 1,   // PC = pop()
+    RETI = 2,   // FLAGS = pop(), PC = pop(), enable interrupts
+    EI   = 3,   // Enable interrupts
+    DI   = 4,   // Disable interrupts
+    CALL = 5,   // push(PC), PC = Rs
+    PUSH = 6,   // push(Rd)
+    POP  = 7    // Rd = pop()
+};
+
+/** Sub-operations of ExtOp::SYS, held in bits 2-0. */
+enum class SysOp : uint8_t {
+    SETSP = 0,  // SP = Rd
+    GETSP = 1,  // Rd = SP
+    WFI   = 2,  // Sleep until an interrupt is pending
+    CPUID = 3,  // Rd = index of this core (0 on a single-core machine)
+    FENCE = 4,  // Full memory barrier between this core's accesses
+    BRK   = 7   // Breakpoint: stop the run with PC left on the BRK
+};
+
+/**
+ * Encoding of BRK (opcode 15, group SYS, sub-op 7). A debugger patches it
+ * over the instruction at a breakpoint address, so breakpoints cost nothing
+ * until they are reached (see debugger.h).
+ */
+constexpr uint16_t BRK_INSTRUCTION = 0xF000u | (static_cast<uint16_t>(ExtOp::SYS) << 3) | static_cast<uint16_t>(SysOp::BRK);
+
 // =============================================================================
 // CPU STATE
 // =============================================================================
@@ -80,6 +351,75 @@ struct CPUState {
     uint16_t PC;         // Program Counter (next instruction address)
     uint16_t FLAGS;      // Flags: Zero, Carry, Negative
     bool halted;         // True after HALT instruction
+    uint16_t SP;         // Stack Pointer (full-descending: push pre-decrements)
+    uint16_t pendingIRQ; // Bitmask of raised, not yet serviced IRQ lines
+    bool IE;             // Interrupt Enable: vector pending IRQs when set
+    bool waiting;        // True after WFI until an interrupt is pending
+};
+
+// =============================================================================
+// CONTROL-FLOW OBSERVATION (basic-block granularity)
+// =============================================================================
+
+/** What ended a basic block. */
+enum class BranchKind : uint8_t {
+    JMP,    // JMP Rs (always taken)
+    JZ,     // JZ Rs (taken when Z was set)
+    CALL,
+    RET,
+    RETI,
+    IRQ,    // Interrupt entry: the block was cut short, not ended by a branch
+    HALT
+};
+
+/**
+ * ControlFlowListener: analysis hook called once per executed basic block
+ * instead of once per instruction. A block is the straight-line run of
+ * words [start, end) that the CPU fetched since the previous control
+ * transfer; end - start (mod 65536) is its instruction count. For branch
+ * kinds the last word of the block is the branch itself.
+ */
+class ControlFlowListener {
+public:
+    virtual ~ControlFlowListener() = default;
+
+    /**
+     * @param start  first PC of the block
+     * @param end    PC after the last instruction of the block
+     * @param kind   what ended the block
+     * @param taken  whether control left the fall-through path (always true except JZ)
+     * @param next   PC where execution continues
+     */
+    virtual void onBlock(uint16_t start, uint16_t end, BranchKind kind, bool taken, uint16_t next) = 0;
+};
+
+// =============================================================================
+// COMPILED CODE (native stand-in for the interpreter, see aot.h)
+// =============================================================================
+
+/**
+ * CompiledCode: runs guest code natively with the interpreter's exact
+ * semantics, cycle counting included. GPRCPU::runFor() hands it whole
+ * slices and steps the interpreter itself for anything it returns.
+ */
+class CompiledCode {
+public:
+    /** Why execute() returned. */
+    enum class Exit : uint8_t {
+        INTERPRET,      // No compiled code at PC (or too little budget for the block there)
+        HALT,           // Executed HALT (not counted, like the interpreter)
+        SLICE_BREAK,    // An MMIO write ended the slice (Bus::sliceBreak())
+        CODE_WRITTEN    // A write hit compiled code: the compiled copy is stale
+    };
+
+    virtual ~CompiledCode() = default;
+
+    /**
+     * Run from state.PC for at most `budget` cycles, adding the cycles run
+     * to `cycles`. Memory goes through `bus`, so devices and dirty-page
+     * tracking see every access.
+     */
+    virtual Exit execute(CPUState& state, Bus& bus, uint16_t coreId, size_t budget, size_t& cycles) = 0;
 };
 
 /**
@@ -92,12 +432,61 @@ public:
     /** Reset CPU: clear registers, PC=0, clear flags, not halted. */
     void reset();
 
+    /**
+     * Load a saved CPUState (e.g. a fuzzing baseline). Like reset(), this
+     * also drops a pending stop, BRK or deferred CAS, and the next basic
+     * block starts at the restored PC.
+     */
+    void restoreState(const CPUState& saved);
+
     /** Execute one FDE cycle. Returns false if CPU is halted. */
     bool step();
 
     /** Run until HALT. Returns number of cycles executed. */
     size_t run();
 
+    /**
+     * Run for at most `maxCycles` cycles, stopping early at HALT or when
+     * waiting with no device event pending. Execution is split into slices
+     * that end exactly at the next device event, so interrupts are checked
+     * once per slice (not per instruction) yet arrive on the exact cycle.
+     * Cycles spent asleep in WFI are skipped in one jump and counted.
+     * Returns the number of cycles that elapsed.
+     */
+    size_t runFor(size_t maxCycles);
+
+    /** Core index returned by CPUID (set by SMPMachine). */
+    void setCoreId(uint16_t id) { coreId = id; }
+    uint16_t getCoreId() const { return coreId; }
+
+    /**
+     * Ask runFor()/run() to return once the current instruction completes.
+     * Safe to call from listeners, probes and devices during execution.
+     */
+    void requestStop() { stopRequested = true; }
+
+    /**
+     * True if the last runFor() stopped on a BRK. PC is left on the BRK and
+     * the BRK itself is not counted as a cycle, so cycle counts and device
+     * timing are the same as a run without the breakpoint.
+     */
+    bool breakpointHit() const { return breakHit; }
+
+    /**
+     * Deferred atomics (used by DeterministicSMP): CAS does not execute but
+     * stops the CPU with PC still on the CAS, and runFor() does not count
+     * it. completeDeferredAtomic() then performs it against `shared`,
+     * advances PC and ticks this CPU's devices by the CAS's one cycle,
+     * which the caller adds to its count. Returns false if no CAS was
+     * pending.
+     */
+    void setDeferAtomics(bool defer) { deferAtomics = defer; }
+    bool hasPendingAtomic() const { return atomicPending; }
+    bool completeDeferredAtomic(Bus& shared);
+
+    /** Raise interrupt line 0-15; it is serviced at the next slice boundary. */
+    void raiseInterrupt(unsigned line) { state.pendingIRQ |= static_cast<uint16_t>(1u << (line & 15u)); }
+
     /** Access current state (for debugger/trace). */
     const CPUState& getState() const { return state; }
     CPUState& getState() { return state; }
@@ -106,10 +495,44 @@ public:
     void trace(bool enable) { tracing = enable; }
     bool isTracing() const { return tracing; }
 
+    /** Label and source line shown with each traced PC (not owned; nullptr for none). */
+    void setDebugMap(const DebugMap* map) { debugMap = map; }
+
+    /**
+     * Register a block-level listener (not owned). With none registered the
+     * only cost is an empty() test on each control transfer.
+     */
+    void addFlowListener(ControlFlowListener* listener);
+    void removeFlowListener(ControlFlowListener* listener);
+
+    /**
+     * Run through `code` (not owned; nullptr detaches) instead of the
+     * interpreter. It is used only while nothing observes single steps: no
+     * tracing, flow listeners, Bus probe or deferred atomics. If the guest
+     * writes to compiled code, the CPU drops it and interprets from then on.
+     */
+    void setCompiledCode(CompiledCode* code) { compiled = code; }
+    CompiledCode* getCompiledCode() const { return compiled; }
+
 private:
     Bus& bus;
     CPUState state;
     bool tracing;
+    std::vector<ControlFlowListener*> flowListeners;
+    uint16_t blockStart;   // First PC of the current basic block (tracked only with listeners)
+    uint16_t coreId;
+    bool stopRequested;
+    bool deferAtomics;
+    bool atomicPending;
+    bool breakHit;
+    CompiledCode* compiled;
+    const DebugMap* debugMap;
+
+    /** One runFor() slice through compiled code; returns cycles as the interpreter would count them. */
+    size_t runCompiledSlice(size_t slice);
+
+    /** Report the block that ends here to every listener and start a new one at `next`. */
+    void endBlock(BranchKind kind, bool taken, uint16_t end, uint16_t next);
 
     // --- Decoding helpers (bitwise masking and shifting) ---
     // Instruction format: [15:12] opcode, [11:9] Rd, [8:6] Rs, [5:0] extra/imm
@@ -127,6 +550,12 @@ private:
     /** Extract 9-bit immediate (bits 8-0) for MOVI: mask with 0x1FF. */
     static uint16_t decodeImm9(uint16_t inst);
 
+    /** Extract 3-bit extended group (bits 5-3): shift right 3, mask 0x7. */
+    static uint8_t decodeExtGroup(uint16_t inst);
+
+    /** Extract 3-bit Rc / sub-operation field (bits 2-0): mask 0x7. */
+    static uint8_t decodeRc(uint16_t inst);
+
     /** Update Zero and Negative flags from 16-bit result. Clear Carry. */
     void setResultFlags(uint16_t result);
 
@@ -138,6 +567,19 @@ private:
 
     /** Execute one instruction (after fetch and decode). */
     void execute(uint16_t instruction);
+
+    /** Execute an extended (opcode 15) instruction. */
+    void executeExtended(uint16_t instruction);
+
+    /** CAS Rd, (Rs), Rc against `target`; updates Rd and FLAGS. Returns true if swapped. */
+    bool compareAndSwap(Bus& target, uint8_t rd, uint8_t rs, uint8_t rc);
+
+    /** Stack helpers: push pre-decrements SP, pop post-increments. */
+    void push(uint16_t value);
+    uint16_t pop();
+
+    /** Wake from WFI and vector the lowest pending IRQ if IE is set. */
+    void serviceInterrupts();
 };
 
 #endif // GPR_CPU_H
@@ -0,0 +1,501 @@
+/**
+ * 16-bit GPR CPU Emulator - Job Server
+ */
+
+#include "job_server.h"
+#include "assembler.h"
+#include "binary_io.h"
+#include "bus_pool.h"
+#include "program_image.h"
+#include "timer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/** How often serve() wakes to check stop(), in milliseconds. */
+static constexpr int STOP_POLL_MS = 200;
+
+/** BusPools a worker keeps before dropping them all and starting over. */
+static constexpr size_t WORKER_POOLS = 16;
+
+/** A client that does not read its responses for this long is dropped. */
+static constexpr int SEND_TIMEOUT_S = 10;
+
+/** Bytes in a response body before the region words. */
+static constexpr size_t RESPONSE_HEADER = 48;
+
+/**
+ * A cached program with the bytes it was built from. A 64-bit hash alone
+ * could collide, so a hit only counts once the bytes compare equal.
+ */
+struct JobServer::Program {
+    Program(const uint16_t* words, uint8_t kind, const uint8_t* data, size_t size)
+        : image(words), kind(kind), content(data, data + size) {}
+
+    bool same(uint8_t k, const uint8_t* data, size_t size) const {
+        return k == kind && size == content.size() && std::equal(content.begin(), content.end(), data);
+    }
+
+    ProgramImage image;
+    uint8_t kind;
+    std::vector<uint8_t> content;
+};
+
+struct JobServer::Connection {
+    int fd;
+    std::vector<uint8_t> inbox;      // Bytes read but not yet a whole frame (serve() thread only)
+    std::mutex writeLock;            // One response frame at a time
+    std::atomic<bool> broken;        // A send failed; stop writing
+
+    explicit Connection(int fd) : fd(fd), broken(false) {}
+    ~Connection() {
+#ifndef _WIN32
+        close(fd);
+#endif
+    }
+};
+
+/**
+ * Per-worker state: a BusPool for each program the worker ran recently
+ * (the pool borrows the Program's image, so it is held alongside and
+ * destroyed after), and scratch space for decoding patches.
+ */
+struct JobServer::WorkerState {
+    std::unordered_map<uint64_t, std::pair<std::shared_ptr<Program>, std::unique_ptr<BusPool>>> pools;
+    std::vector<uint16_t> words;
+};
+
+// =============================================================================
+// WIRE HELPERS
+// =============================================================================
+
+namespace {
+
+/** Bounds-checked little-endian reader over a request body. */
+struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    bool need(size_t n) {
+        if (ok && static_cast<size_t>(end - p) >= n) return true;
+        ok = false;
+        return false;
+    }
+    uint8_t u8() { return need(1) ? *p++ : 0; }
+    uint16_t u16() {
+        if (!need(2)) return 0;
+        uint16_t v = static_cast<uint16_t>(p[0] | (p[1] << 8));
+        p += 2;
+        return v;
+    }
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t v = get32(p);
+        p += 4;
+        return v;
+    }
+    uint64_t u64() {
+        uint64_t lo = u32();
+        return lo | (static_cast<uint64_t>(u32()) << 32);
+    }
+    const uint8_t* bytes(size_t n) {
+        if (!need(n)) return nullptr;
+        const uint8_t* at = p;
+        p += n;
+        return at;
+    }
+};
+
+} // namespace
+
+static std::vector<uint8_t> errorResponse(JobStatus status, uint32_t jobId, const std::string& message) {
+    std::vector<uint8_t> out;
+    out.push_back(static_cast<uint8_t>(status));
+    out.push_back(0);
+    put16(out, 0);
+    put32(out, jobId);
+    put32(out, static_cast<uint32_t>(message.size()));
+    out.insert(out.end(), message.begin(), message.end());
+    return out;
+}
+
+static bool inRange(uint16_t addr, size_t count) { return count <= MEMORY_SIZE - addr; }
+
+/** A Bus borrowed from a BusPool for one job, returned however runJob() leaves. */
+class PooledBus {
+public:
+    explicit PooledBus(BusPool& pool) : pool(pool), bus(pool.acquire()) {}
+    ~PooledBus() { pool.release(bus); }
+
+    PooledBus(const PooledBus&) = delete;
+    PooledBus& operator=(const PooledBus&) = delete;
+
+    Bus* operator->() const { return bus; }
+    Bus& operator*() const { return *bus; }
+
+private:
+    BusPool& pool;
+    Bus* bus;
+};
+
+// =============================================================================
+// LIFECYCLE
+// =============================================================================
+
+JobServer::JobServer(unsigned workerThreads, size_t cacheLimit)
+    : cacheLimit(std::max<size_t>(1, cacheLimit)), listenFd(-1), stopping(false),
+      jobCount(0), hitCount(0), missCount(0), connectionCount(0) {
+    if (workerThreads == 0) workerThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned t = 0; t < workerThreads; ++t)
+        workers.emplace_back(&JobServer::workerLoop, this);
+}
+
+JobServer::~JobServer() {
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        stopping = true;
+        queue.clear();
+    }
+    queueReady.notify_all();
+    for (std::thread& t : workers) t.join();
+#ifndef _WIN32
+    if (listenFd >= 0) close(listenFd);
+    if (!socketPath.empty()) unlink(socketPath.c_str());
+#endif
+}
+
+JobServerStats JobServer::stats() const {
+    JobServerStats s;
+    s.jobs = jobCount;
+    s.cacheHits = hitCount;
+    s.cacheMisses = missCount;
+    s.connections = connectionCount;
+    return s;
+}
+
+uint64_t JobServer::hashProgram(uint8_t kind, const uint8_t* data, size_t size) {
+    return fnv1a64(data, size, fnv1a64(&kind, 1));
+}
+
+// =============================================================================
+// PROGRAM CACHE
+// =============================================================================
+
+std::shared_ptr<JobServer::Program> JobServer::lookup(uint64_t hash, uint8_t kind, const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(cacheLock);
+    auto it = cache.find(hash);
+    if (it == cache.end()) return nullptr;
+    // A hash sent by the client was handed out for exactly this entry;
+    // program bytes must match, or it is another program with the same hash.
+    if (kind != 2 && !it->second.first->same(kind, data, size)) return nullptr;
+    lru.splice(lru.begin(), lru, it->second.second);
+    return it->second.first;
+}
+
+std::shared_ptr<JobServer::Program> JobServer::insert(uint64_t hash, const std::shared_ptr<Program>& program) {
+    std::lock_guard<std::mutex> lock(cacheLock);
+    auto it = cache.find(hash);
+    if (it != cache.end()) {
+        // Another worker built it first, or a different program holds the hash
+        const Program& held = *it->second.first;
+        return held.same(program->kind, program->content.data(), program->content.size()) ? it->second.first : nullptr;
+    }
+    lru.push_front(hash);
+    cache.emplace(hash, std::make_pair(program, lru.begin()));
+    // Evicted programs live on while a worker still holds them
+    while (cache.size() > cacheLimit) {
+        cache.erase(lru.back());
+        lru.pop_back();
+    }
+    return program;
+}
+
+// =============================================================================
+// JOBS
+// =============================================================================
+
+std::vector<uint8_t> JobServer::runJob(const std::vector<uint8_t>& body, WorkerState& worker) {
+    Reader in{body.data(), body.data() + body.size()};
+    uint8_t type = in.u8();
+    uint8_t kind = in.u8();
+    uint16_t flags = in.u16();
+    uint32_t jobId = in.u32();
+    uint64_t maxCycles = in.u64();
+    uint32_t programBytes = in.u32();
+    const uint8_t* programData = in.bytes(programBytes);
+    if (!in.ok) return errorResponse(JobStatus::BAD_REQUEST, jobId, "truncated request");
+    if (type != JOB_RUN) return errorResponse(JobStatus::BAD_REQUEST, jobId, "unknown request type");
+
+    // Find or build the program
+    uint64_t hash;
+    bool cacheable = true;
+    if (kind == 2) {
+        if (programBytes != 8) return errorResponse(JobStatus::BAD_REQUEST, jobId, "hash must be 8 bytes");
+        hash = get64(programData);
+    } else if (kind <= 1) {
+        hash = hashProgram(kind, programData, programBytes);
+    } else {
+        return errorResponse(JobStatus::BAD_REQUEST, jobId, "unknown program kind");
+    }
+    std::shared_ptr<Program> program = lookup(hash, kind, programData, programBytes);
+    if (program) {
+        ++hitCount;
+    } else {
+        if (kind == 2) return errorResponse(JobStatus::UNKNOWN_PROGRAM, jobId, "program not in cache");
+        ++missCount;
+        std::vector<uint16_t> mem(MEMORY_SIZE, 0);
+        if (kind == 0) {
+            std::string source(reinterpret_cast<const char*>(programData), programBytes);
+            AssembleResult ar = assemble(source, mem.data(), MEMORY_SIZE);
+            if (!ar.ok)
+                return errorResponse(JobStatus::ASSEMBLY_ERROR, jobId,
+                                     "line " + std::to_string(ar.lineNum) + ": " + ar.error);
+        } else {
+            if (programBytes % 2 || programBytes > MEMORY_SIZE * 2)
+                return errorResponse(JobStatus::BAD_REQUEST, jobId, "image must be at most 65536 whole words");
+            for (size_t i = 0; i < programBytes / 2; ++i)
+                mem[i] = static_cast<uint16_t>(programData[2 * i] | (programData[2 * i + 1] << 8));
+        }
+        program = std::make_shared<Program>(mem.data(), kind, programData, programBytes);
+        // On a hash collision the program runs uncached and gets no hash to reuse
+        std::shared_ptr<Program> cached = insert(hash, program);
+        if (cached) program = cached;
+        else cacheable = false;
+    }
+
+    // Patches are checked before a Bus is taken, so a bad request leaves no mess
+    uint16_t patchCount = in.u16();
+    const uint8_t* patches = in.p;
+    for (uint16_t i = 0; i < patchCount && in.ok; ++i) {
+        uint16_t addr = in.u16(), count = in.u16();
+        in.bytes(count * 2u);
+        if (in.ok && !inRange(addr, count))
+            return errorResponse(JobStatus::BAD_REQUEST, jobId, "patch runs past 0xFFFF");
+    }
+    uint16_t regionCount = in.u16();
+    const uint8_t* regions = in.p;
+    size_t regionWords = 0;
+    for (uint16_t i = 0; i < regionCount && in.ok; ++i) {
+        uint16_t addr = in.u16(), count = in.u16();
+        if (in.ok && !inRange(addr, count))
+            return errorResponse(JobStatus::BAD_REQUEST, jobId, "region runs past 0xFFFF");
+        regionWords += count;
+    }
+    if (!in.ok) return errorResponse(JobStatus::BAD_REQUEST, jobId, "truncated request");
+
+    // This worker's pool for the program; an uncached one gets a pool for this job only
+    std::unique_ptr<BusPool> privatePool;
+    BusPool* pool;
+    if (cacheable) {
+        auto slot = worker.pools.find(hash);
+        if (slot == worker.pools.end() || slot->second.first != program) {
+            if (worker.pools.size() >= WORKER_POOLS) worker.pools.clear();
+            std::unique_ptr<BusPool> fresh(new BusPool(program->image));
+            slot = worker.pools.insert_or_assign(hash, std::make_pair(program, std::move(fresh))).first;
+        }
+        pool = slot->second.second.get();
+    } else {
+        privatePool.reset(new BusPool(program->image));
+        pool = privatePool.get();
+    }
+    PooledBus bus(*pool);
+    Timer timer;
+    if (flags & 1) bus->attachDevice(0, &timer);
+
+    Reader patch{patches, body.data() + body.size()};
+    for (uint16_t i = 0; i < patchCount; ++i) {
+        uint16_t addr = patch.u16(), count = patch.u16();
+        worker.words.resize(count);
+        for (uint16_t w = 0; w < count; ++w) worker.words[w] = patch.u16();
+        bus->writeBlock(addr, worker.words.data(), count);
+    }
+
+    GPRCPU cpu(*bus);
+    cpu.reset();
+    size_t cycles = cpu.runFor(static_cast<size_t>(std::min<uint64_t>(maxCycles, SIZE_MAX)));
+    const CPUState& s = cpu.getState();
+    uint8_t exitCode = 1;                                      // Budget spent
+    if (s.halted) exitCode = 0;
+    else if (cpu.breakpointHit()) exitCode = 2;
+    else if (cycles < maxCycles && s.waiting) exitCode = 3;    // Idle in WFI
+
+    std::vector<uint8_t> out;
+    out.reserve(RESPONSE_HEADER + regionWords * 2);
+    out.push_back(static_cast<uint8_t>(JobStatus::OK));
+    out.push_back(exitCode);
+    put16(out, 0);
+    put32(out, jobId);
+    put64(out, cycles);
+    put64(out, cacheable ? hash : 0);
+    for (uint16_t r : s.R) put16(out, r);
+    put16(out, s.PC);
+    put16(out, s.FLAGS);
+    put16(out, s.SP);
+    out.push_back(s.halted ? 1 : 0);
+    out.push_back(0);
+
+    const uint16_t* mem = bus->getMemory();
+    Reader region{regions, body.data() + body.size()};
+    for (uint16_t i = 0; i < regionCount; ++i) {
+        uint16_t addr = region.u16(), count = region.u16();
+        for (uint16_t w = 0; w < count; ++w) put16(out, mem[addr + w]);
+    }
+    ++jobCount;
+    return out;
+}
+
+void JobServer::workerLoop() {
+    WorkerState state;
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(queueLock);
+            queueReady.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        std::vector<uint8_t> response;
+        try {
+            response = runJob(job.body, state);
+        } catch (const std::exception& e) {
+            // Out of memory or shared memory could not be mapped: report it, keep serving
+            uint32_t jobId = job.body.size() >= 8 ? get32(job.body.data() + 4) : 0;
+            response = errorResponse(JobStatus::BAD_REQUEST, jobId, e.what());
+        }
+
+#ifndef _WIN32
+        Connection& conn = *job.conn;
+        std::vector<uint8_t> frame;
+        frame.reserve(4 + response.size());
+        put32(frame, static_cast<uint32_t>(response.size()));
+        frame.insert(frame.end(), response.begin(), response.end());
+
+        std::lock_guard<std::mutex> lock(conn.writeLock);
+        for (size_t sent = 0; sent < frame.size() && !conn.broken;) {
+            ssize_t n = send(conn.fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) conn.broken = true;    // Client gone or not reading
+            else sent += static_cast<size_t>(n);
+        }
+#endif
+    }
+}
+
+// =============================================================================
+// SOCKET
+// =============================================================================
+
+bool JobServer::listen(const std::string& path) {
+#ifndef _WIN32
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) { error = std::strerror(errno); return false; }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) { error = "socket path too long"; return false; }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // Only replace a socket left by a server that is gone: never a regular
+    // file, and never the socket of one that still accepts connections.
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) { error = path + " exists and is not a socket"; return false; }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0) { error = std::strerror(errno); return false; }
+        bool live = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        int why = errno;
+        close(probe);
+        if (live) { error = path + " is in use by a running server"; return false; }
+        if (why != ECONNREFUSED) { error = path + ": " + std::strerror(why); return false; }
+        unlink(path.c_str());
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listenFd, 64) < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    socketPath = path;
+    return true;
+#else
+    (void)path;
+    error = "job server requires POSIX sockets";
+    return false;
+#endif
+}
+
+void JobServer::takeFrames(const std::shared_ptr<Connection>& conn) {
+    std::vector<uint8_t>& inbox = conn->inbox;
+    size_t pos = 0;
+    while (inbox.size() - pos >= 4) {
+        uint32_t len = get32(inbox.data() + pos);
+        if (inbox.size() - pos - 4 < len) break;
+        Job job{conn, std::vector<uint8_t>(inbox.begin() + pos + 4, inbox.begin() + pos + 4 + len)};
+        pos += 4 + len;
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            queue.push_back(std::move(job));
+        }
+        queueReady.notify_one();
+    }
+    inbox.erase(inbox.begin(), inbox.begin() + pos);
+}
+
+bool JobServer::serve() {
+#ifndef _WIN32
+    if (listenFd < 0) { error = "not listening"; return false; }
+    std::vector<std::shared_ptr<Connection>> clients;
+    std::vector<pollfd> fds;
+    std::vector<uint8_t> buffer(1 << 16);
+
+    while (!stopping) {
+        fds.assign(1, pollfd{listenFd, POLLIN, 0});
+        for (const auto& c : clients) fds.push_back(pollfd{c->fd, POLLIN, 0});
+        int ready = poll(fds.data(), fds.size(), STOP_POLL_MS);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            error = std::strerror(errno);
+            return false;
+        }
+        if (ready == 0) continue;
+
+        // Read first: accepting appends to `clients`, which fds[] mirrors
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (!fds[i + 1].revents) continue;
+            Connection& c = *clients[i];
+            ssize_t n = recv(c.fd, buffer.data(), buffer.size(), 0);
+            if (n < 0 && errno == EINTR) continue;
+            bool drop = n <= 0 || c.broken;
+            if (!drop) {
+                c.inbox.insert(c.inbox.end(), buffer.begin(), buffer.begin() + n);
+                takeFrames(clients[i]);
+                drop = c.inbox.size() >= 4 && get32(c.inbox.data()) > JOB_MAX_FRAME;
+            }
+            // Queued jobs keep the connection (and its socket) until they reply
+            if (drop) clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                timeval timeout{SEND_TIMEOUT_S, 0};
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                clients.push_back(std::make_shared<Connection>(fd));
+                ++connectionCount;
+            }
+        }
+    }
+    return true;
+#else
+    error = "job server requires POSIX sockets";
+    return false;
+#endif
+}
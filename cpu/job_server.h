@@ -0,0 +1,163 @@
+/**
+ * 16-bit GPR CPU Emulator - Job Server
+ * A resident process that runs emulator jobs sent over a Unix domain
+ * socket, so callers skip process startup and repeated assembly.
+ */
+
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include "gpr_cpu.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ProgramImage;
+
+/**
+ * Protocol (all integers little-endian). Every message in either direction
+ * is a frame: u32 length of the rest, then the body. A client may send
+ * any number of requests without waiting; responses come back as jobs
+ * finish, matched by job id.
+ *
+ * Request body:
+ *   u8  type            1 = RUN
+ *   u8  programKind     0 = .asm source, 1 = raw image words loaded at 0,
+ *                       2 = program hash from an earlier response
+ *   u16 flags           bit 0: attach the timer at MMIO slot 0
+ *   u32 jobId           echoed back
+ *   u64 maxCycles
+ *   u32 programBytes, then the source text, image words or u64 hash
+ *   u16 patchCount,  then per patch:  u16 addr, u16 count, count words
+ *   u16 regionCount, then per region: u16 addr, u16 count
+ *
+ * Response body:
+ *   u8  status          0 = ok, 1 = assembly error, 2 = bad request,
+ *                       3 = unknown program hash
+ *   u8  exit            0 HALT, 1 budget spent, 2 BRK, 3 idle in WFI
+ *   u16 reserved
+ *   u32 jobId
+ *   u64 cycles
+ *   u64 programHash     Send this with programKind 2 to skip the program
+ *                       (0: not cached, send the program again)
+ *   u16 R0-R7, PC, FLAGS, SP
+ *   u8  halted, u8 reserved
+ *   then each requested region's words, in request order
+ *   (on an error status instead: u32 length, message text)
+ *
+ * Patches are applied before the run, over the program image; regions
+ * are read after it.
+ */
+constexpr uint8_t JOB_RUN = 1;
+
+enum class JobStatus : uint8_t { OK = 0, ASSEMBLY_ERROR = 1, BAD_REQUEST = 2, UNKNOWN_PROGRAM = 3 };
+
+/** Largest frame accepted (a frame holding a full image is about 128 KiB). */
+constexpr uint32_t JOB_MAX_FRAME = 16u << 20;
+
+struct JobServerStats {
+    uint64_t jobs = 0;
+    uint64_t cacheHits = 0;       // Program found already assembled
+    uint64_t cacheMisses = 0;
+    uint64_t connections = 0;
+};
+
+/**
+ * JobServer: listens on a Unix socket. One thread (serve()) accepts
+ * clients and reads requests from all of them with poll(); a fixed pool
+ * of workers runs the jobs and writes each response back.
+ *
+ * Programs are cached as ProgramImages keyed by a hash of their content
+ * (source text or image words), least recently used first out once the
+ * cache holds `cacheLimit` programs. The content is kept too and compared
+ * on every hit, so two programs with the same hash never mix. Each worker keeps a BusPool per
+ * program it ran recently, so a job costs the pages it writes; the first
+ * run of a program on a worker maps the image copy-on-write.
+ *
+ * POSIX only.
+ */
+class JobServer {
+public:
+    /** `workers` 0 = one per CPU. */
+    explicit JobServer(unsigned workers = 0, size_t cacheLimit = 256);
+    ~JobServer();
+
+    JobServer(const JobServer&) = delete;
+    JobServer& operator=(const JobServer&) = delete;
+
+    /**
+     * Bind the Unix socket `path`. A socket file left there by a server
+     * that is gone is replaced; a live server's socket or any other file
+     * is an error.
+     */
+    bool listen(const std::string& path);
+
+    /** Accept and serve clients until stop(); returns false on a socket error. */
+    bool serve();
+
+    /** Make serve() return (safe from any thread; polled a few times a second). */
+    void stop() { stopping = true; }
+
+    JobServerStats stats() const;
+    unsigned workerCount() const { return static_cast<unsigned>(workers.size()); }
+    const std::string& lastError() const { return error; }
+
+    /** 64-bit FNV-1a of a program's kind and bytes (its cache key). */
+    static uint64_t hashProgram(uint8_t kind, const uint8_t* data, size_t size);
+
+private:
+    struct Program;
+    struct Connection;
+    struct WorkerState;
+
+    struct Job {
+        std::shared_ptr<Connection> conn;
+        std::vector<uint8_t> body;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Job> queue;
+    std::mutex queueLock;
+    std::condition_variable queueReady;
+
+    // Program cache: LRU list of hashes, newest first
+    size_t cacheLimit;
+    std::unordered_map<uint64_t, std::pair<std::shared_ptr<Program>, std::list<uint64_t>::iterator>> cache;
+    std::list<uint64_t> lru;
+    mutable std::mutex cacheLock;
+
+    int listenFd;
+    std::string socketPath;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> jobCount, hitCount, missCount, connectionCount;
+    std::string error;
+
+    void workerLoop();
+
+    /** Queue every complete frame in `conn`'s input buffer. */
+    void takeFrames(const std::shared_ptr<Connection>& conn);
+
+    /** Decode and run one request; returns the response body. */
+    std::vector<uint8_t> runJob(const std::vector<uint8_t>& body, WorkerState& worker);
+
+    /** Cached program for `hash` whose bytes match (kind 2: any), else nullptr. */
+    std::shared_ptr<Program> lookup(uint64_t hash, uint8_t kind, const uint8_t* data, size_t size);
+
+    /**
+     * Cache `program`; returns the entry now held for `hash` (`program`, or
+     * an identical one another worker stored first), or nullptr if a
+     * different program already holds the hash.
+     */
+    std::shared_ptr<Program> insert(uint64_t hash, const std::shared_ptr<Program>& program);
+};
+
+#endif // JOB_SERVER_H
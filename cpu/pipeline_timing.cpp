@@ -0,0 +1,263 @@
+/**
+ * 16-bit GPR CPU Emulator - Pipeline Timing Model
+ */
+
+#include "pipeline_timing.h"
+#include "branch_predictor.h"
+#include "debug_map.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+// =============================================================================
+// REGISTER USE (which GPRs an instruction reads / writes)
+// =============================================================================
+// Same field layout as the CPU decoder: [15:12] op, [11:9] Rd, [8:6] Rs, [5:3] group, [2:0] Rc.
+
+/** Bitmask of GPRs read by `inst` (bit n = Rn). */
+static uint8_t regsRead(uint16_t inst) {
+    uint8_t op = (inst >> 12) & 0xFu;
+    uint8_t rd = 1u << ((inst >> 9) & 0x7u);
+    uint8_t rs = 1u << ((inst >> 6) & 0x7u);
+    uint8_t rc = 1u << (inst & 0x7u);
+
+    switch (static_cast<Opcode>(op)) {
+        case Opcode::MOV: case Opcode::LOAD: case Opcode::NOT:
+        case Opcode::JMP: case Opcode::JZ:
+            return rs;
+        case Opcode::STORE: case Opcode::ADD: case Opcode::SUB:
+        case Opcode::AND: case Opcode::OR: case Opcode::XOR:
+            return rd | rs;
+        case Opcode::SHL: case Opcode::SHR:
+            return rd;
+        case Opcode::NOP:
+            switch (static_cast<ExtOp>((inst >> 3) & 0x7u)) {
+                case ExtOp::BMOV: case ExtOp::BFILL: case ExtOp::CAS:
+                    return rd | rs | rc;
+                case ExtOp::MISC: {
+                    MiscOp sub = static_cast<MiscOp>(inst & 0x7u);
+                    if (sub == MiscOp::CALL) return rs;
+                    if (sub == MiscOp::PUSH) return rd;
+                    return 0;
+                }
+                case ExtOp::SYS:
+                    return (static_cast<SysOp>(inst & 0x7u) == SysOp::SETSP) ? rd : 0;
+                default:
+                    return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+/** Number of data-memory accesses `inst` makes in the MEM stage. */
+static unsigned memAccesses(uint16_t inst) {
+    uint8_t op = (inst >> 12) & 0xFu;
+    if (op == static_cast<uint8_t>(Opcode::LOAD) || op == static_cast<uint8_t>(Opcode::STORE))
+        return 1;
+    if (op != static_cast<uint8_t>(Opcode::NOP))
+        return 0;
+    switch (static_cast<ExtOp>((inst >> 3) & 0x7u)) {
+        case ExtOp::BMOV: case ExtOp::BFILL: case ExtOp::CAS:
+            return 1;
+        case ExtOp::MISC:
+            switch (static_cast<MiscOp>(inst & 0x7u)) {
+                case MiscOp::CALL: case MiscOp::RET: case MiscOp::PUSH: case MiscOp::POP: return 1;
+                case MiscOp::RETI: return 2;
+                default: return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+/** Bitmask of the GPR a LOAD or POP writes (0 for anything else). */
+static uint8_t loadTarget(uint16_t inst) {
+    uint8_t op = (inst >> 12) & 0xFu;
+    bool isPop = op == static_cast<uint8_t>(Opcode::NOP) &&
+                 static_cast<ExtOp>((inst >> 3) & 0x7u) == ExtOp::MISC &&
+                 static_cast<MiscOp>(inst & 0x7u) == MiscOp::POP;
+    return (op == static_cast<uint8_t>(Opcode::LOAD) || isPop) ? static_cast<uint8_t>(1u << ((inst >> 9) & 0x7u)) : 0;
+}
+
+// =============================================================================
+// PIPELINE TIMING
+// =============================================================================
+
+PipelineTiming::PipelineTiming(const Bus& bus, const PipelineConfig& config)
+    : bus(bus), config(config), branchSim(nullptr) {
+    resetStats();
+}
+
+void PipelineTiming::resetStats() {
+    stats = PipelineStats();
+    stats.cycles = 4;   // Fill: the first instruction retires in cycle 5
+    retired.clear();
+    for (BlockCost& c : cache) c.runs = c.exitStalls = 0;
+}
+
+void PipelineTiming::invalidate() {
+    for (size_t start = 0; start < cache.size(); ++start)
+        retire(static_cast<uint16_t>(start), cache[start]);
+    cache.clear();
+}
+
+PipelineTiming::BlockCost PipelineTiming::analyze(uint16_t start, uint16_t end) const {
+    BlockCost cost{end, true, 0, 0, 0, 0};
+    uint8_t loadedReg = 0;   // Bitmask: destination of a LOAD/POP in the previous slot
+    for (uint16_t pc = start; pc != end; ++pc) {
+        uint16_t inst = bus.getMemory()[pc];   // Not read(): a probe would count it as a data access
+        if (regsRead(inst) & loadedReg)
+            cost.loadUse += config.loadUseStall;
+        cost.memOps += memAccesses(inst);
+        loadedReg = loadTarget(inst);
+    }
+    return cost;
+}
+
+unsigned PipelineTiming::branchCost(uint16_t branchPC, BranchKind kind, bool taken, uint16_t next) {
+    if (branchSim)
+        return branchSim->resolve(branchPC, kind, taken, next) ? 0 : config.branchPenalty;
+    return taken ? config.branchPenalty : 0;
+}
+
+void PipelineTiming::onBlock(uint16_t start, uint16_t end, BranchKind kind, bool taken, uint16_t next) {
+    if (cache.empty())
+        cache.assign(MEMORY_SIZE, BlockCost{0, false, 0, 0, 0, 0});
+
+    // Cached cost is reused only for the same extent; an interrupt can cut a block short.
+    BlockCost& slot = cache[start];
+    if (!slot.valid || slot.end != end) {
+        retire(start, slot);
+        slot = analyze(start, end);
+    }
+
+    uint64_t count = static_cast<uint16_t>(end - start);
+    uint64_t memStall = static_cast<uint64_t>(slot.memOps) * config.memLatency;
+    uint64_t branchStall = 0, irqStall = 0;
+
+    if (kind == BranchKind::IRQ)
+        irqStall = config.interruptEntry;
+    else if (kind != BranchKind::HALT)
+        branchStall = branchCost(static_cast<uint16_t>(end - 1), kind, taken, next);
+
+    stats.instructions += count;
+    stats.blocks += 1;
+    stats.loadUseStalls += slot.loadUse;
+    stats.memoryStalls += memStall;
+    stats.branchStalls += branchStall;
+    stats.interruptStalls += irqStall;
+    stats.cycles += count + slot.loadUse + memStall + branchStall + irqStall;
+    slot.runs += 1;
+    slot.exitStalls += branchStall + irqStall;
+}
+
+void PipelineTiming::printReport(std::ostream& os) const {
+    os << "\n--- Pipeline timing (5-stage) ---\n";
+    os << "Instructions:     " << stats.instructions << "\n";
+    os << "Cycles:           " << stats.cycles << "\n";
+    os << "CPI:              " << std::fixed << std::setprecision(3) << stats.cpi() << std::defaultfloat << "\n";
+    os << "Basic blocks:     " << stats.blocks << "\n";
+    os << "Stalls: load-use  " << stats.loadUseStalls << "\n";
+    os << "        branch    " << stats.branchStalls << "\n";
+    os << "        memory    " << stats.memoryStalls << "\n";
+    os << "        interrupt " << stats.interruptStalls << "\n";
+}
+
+// =============================================================================
+// PROFILE
+// =============================================================================
+
+void PipelineTiming::addBlockProfile(uint16_t start, const BlockCost& cost, std::vector<PCProfile>& out) const {
+    if (!cost.valid || cost.runs == 0) return;
+    // Same per-instruction costs as analyze(), charged where they arise.
+    uint8_t loadedReg = 0;
+    for (uint16_t pc = start; pc != cost.end; ++pc) {
+        uint16_t inst = bus.getMemory()[pc];
+        uint64_t stall = static_cast<uint64_t>(memAccesses(inst)) * config.memLatency;
+        if (regsRead(inst) & loadedReg) stall += config.loadUseStall;
+        out[pc].executions += cost.runs;
+        out[pc].stalls += stall * cost.runs;
+        loadedReg = loadTarget(inst);
+    }
+    out[cost.end != start ? static_cast<uint16_t>(cost.end - 1) : start].stalls += cost.exitStalls;
+}
+
+void PipelineTiming::retire(uint16_t start, const BlockCost& cost) {
+    if (!cost.valid || cost.runs == 0) return;
+    if (retired.empty()) retired.resize(MEMORY_SIZE);
+    addBlockProfile(start, cost, retired);
+}
+
+std::vector<PCProfile> PipelineTiming::profile() const {
+    std::vector<PCProfile> out = retired;
+    out.resize(MEMORY_SIZE);
+    for (size_t start = 0; start < cache.size(); ++start)
+        addBlockProfile(static_cast<uint16_t>(start), cache[start], out);
+    return out;
+}
+
+/** Print the `topN` entries of `totals` with the most cycles. */
+static void printHotSpots(std::ostream& os, const char* title, const std::map<std::string, PCProfile>& totals,
+                          uint64_t allCycles, size_t topN) {
+    std::vector<std::pair<std::string, PCProfile>> rows(totals.begin(), totals.end());
+    std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, PCProfile>& a, const std::pair<std::string, PCProfile>& b) {
+        return a.second.cycles() > b.second.cycles();
+    });
+    if (rows.size() > topN) rows.resize(topN);
+    os << std::setfill(' ') << "\n  " << std::left << std::setw(28) << title << std::right << " |     cycles      %     stalls   executed\n";
+    for (const auto& r : rows) {
+        os << "  " << std::left << std::setw(28) << r.first << std::right << " | " << std::setw(10) << r.second.cycles()
+           << " " << std::fixed << std::setprecision(1) << std::setw(6)
+           << (allCycles ? 100.0 * static_cast<double>(r.second.cycles()) / static_cast<double>(allCycles) : 0.0)
+           << std::defaultfloat << " " << std::setw(10) << r.second.stalls << " " << std::setw(10) << r.second.executions << "\n";
+    }
+}
+
+void PipelineTiming::printProfile(std::ostream& os, const DebugMap* map, size_t topN) const {
+    std::vector<PCProfile> pcs = profile();
+    bool useMap = map && !map->empty();
+    std::map<std::string, PCProfile> byLabel, byLine, byPC;
+    std::map<std::string, unsigned> labelUses;   // Names given to more than one address get "@addr"
+    if (useMap)
+        for (const auto& l : map->labelList()) ++labelUses[l.second];
+    uint64_t allCycles = 0;
+    for (size_t a = 0; a < pcs.size(); ++a) {
+        const PCProfile& p = pcs[a];
+        if (!p.cycles()) continue;
+        allCycles += p.cycles();
+        uint16_t pc = static_cast<uint16_t>(a), offset = 0;
+        std::vector<std::pair<std::map<std::string, PCProfile>*, std::string>> keys;
+        if (useMap) {
+            const std::string* label = map->labelAt(pc, offset);
+            SourceLine src = map->lineAt(pc);
+            std::string name = label ? *label : "(no label)";
+            if (label && labelUses[*label] > 1) {
+                std::ostringstream at;
+                at << "@0x" << std::hex << std::setw(4) << std::setfill('0') << static_cast<uint16_t>(pc - offset);
+                name += at.str();
+            }
+            keys.emplace_back(&byLabel, name);
+            keys.emplace_back(&byLine, src.line ? (src.file->empty() ? "line " : *src.file + ":") + std::to_string(src.line)
+                                                : "(no line)");
+        } else {
+            std::ostringstream hex;
+            hex << "0x" << std::hex << std::setw(4) << std::setfill('0') << pc;
+            keys.emplace_back(&byPC, hex.str());
+        }
+        for (auto& k : keys) {
+            PCProfile& t = (*k.first)[k.second];
+            t.executions += p.executions;
+            t.stalls += p.stalls;
+        }
+    }
+
+    os << "\n--- Profile (" << allCycles << " cycles attributed) ---\n";
+    if (useMap) {
+        printHotSpots(os, "Label", byLabel, allCycles, topN);
+        printHotSpots(os, "Source line", byLine, allCycles, topN);
+    } else {
+        printHotSpots(os, "PC", byPC, allCycles, topN);
+    }
+}
@@ -0,0 +1,130 @@
+/**
+ * 16-bit GPR CPU Emulator - Pipeline Timing Model
+ * Estimates cycles on a classic 5-stage pipeline (IF ID EX MEM WB)
+ * alongside the functional core, one basic block at a time.
+ */
+
+#ifndef PIPELINE_TIMING_H
+#define PIPELINE_TIMING_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class BranchSim;
+class DebugMap;
+
+/** Tunable pipeline parameters (all in cycles). */
+struct PipelineConfig {
+    unsigned loadUseStall  = 1;  // Bubble when the next instruction reads a LOAD result
+    unsigned branchPenalty = 2;  // Flushed slots for a taken branch (resolved in EX)
+    unsigned memLatency    = 0;  // Extra MEM-stage cycles per LOAD/STORE/PUSH/POP access
+    unsigned interruptEntry = 3; // Flush + vector fetch on interrupt entry
+};
+
+/** Cycle totals and stall breakdown. */
+struct PipelineStats {
+    uint64_t instructions   = 0;
+    uint64_t cycles         = 0;  // Includes the 4-cycle pipeline fill
+    uint64_t loadUseStalls  = 0;
+    uint64_t branchStalls   = 0;
+    uint64_t memoryStalls   = 0;
+    uint64_t interruptStalls = 0;
+    uint64_t blocks         = 0;
+
+    double cpi() const { return instructions ? static_cast<double>(cycles) / static_cast<double>(instructions) : 0.0; }
+};
+
+/** Cycles charged to one instruction address. */
+struct PCProfile {
+    uint64_t executions = 0;
+    uint64_t stalls = 0;     // Load-use, memory, branch and interrupt-entry cycles caused here
+
+    uint64_t cycles() const { return executions + stalls; }
+};
+
+/**
+ * PipelineTiming: attach with GPRCPU::addFlowListener().
+ *
+ * Static costs of a block (instruction count, load-use bubbles, memory
+ * latency) are computed the first time the block runs and cached by start
+ * PC, so a hot loop costs one table lookup per iteration. Only the branch
+ * outcome is dynamic. By default the model predicts not-taken: JZ pays
+ * the penalty only when taken; JMP/CALL/RET always pay it. With
+ * setBranchSim() the penalty is paid only on a misprediction.
+ *
+ * Approximations: hazards are not tracked across block boundaries, and
+ * BMOV/BFILL count as a single memory access. Call invalidate() after
+ * modifying code that has already run.
+ */
+class PipelineTiming : public ControlFlowListener {
+public:
+    PipelineTiming(const Bus& bus, const PipelineConfig& config = PipelineConfig());
+
+    void onBlock(uint16_t start, uint16_t end, BranchKind kind, bool taken, uint16_t next) override;
+
+    const PipelineStats& getStats() const { return stats; }
+    const PipelineConfig& getConfig() const { return config; }
+
+    /** Clear statistics and the profile (cached block costs are kept). */
+    void resetStats();
+
+    /** Drop cached block costs, e.g. after code was modified. */
+    void invalidate();
+
+    /** Print cycles, CPI and stalls by cause. */
+    void printReport(std::ostream& os) const;
+
+    /**
+     * Cycles per address (MEMORY_SIZE entries): each instruction's own
+     * cycle plus the stalls it caused. A branch or interrupt entry is
+     * charged to the last instruction of its block; the pipeline fill is
+     * not charged. Counts are kept per block and only spread over
+     * addresses here, so profiling adds nothing per instruction.
+     */
+    std::vector<PCProfile> profile() const;
+
+    /**
+     * Print the `topN` labels and source lines with the most cycles, or the
+     * top PCs when `map` is null or empty.
+     */
+    void printProfile(std::ostream& os, const DebugMap* map, size_t topN = 10) const;
+
+    /**
+     * Charge the branch penalty only on mispredictions from `sim` (not owned)
+     * instead of on every taken branch. nullptr restores predict-not-taken.
+     */
+    void setBranchSim(BranchSim* sim) { branchSim = sim; }
+
+private:
+    /** Cached static cost of one block, keyed by start PC. */
+    struct BlockCost {
+        uint16_t end;
+        bool valid;
+        uint32_t loadUse;    // Load-use bubbles inside the block
+        uint32_t memOps;     // Memory accesses in the MEM stage
+        uint64_t runs;       // Profile: times this extent ran
+        uint64_t exitStalls; // Profile: branch and interrupt-entry cycles at its end
+    };
+
+    const Bus& bus;
+    PipelineConfig config;
+    PipelineStats stats;
+    std::vector<BlockCost> cache;   // 65536 entries, allocated on first use
+    std::vector<PCProfile> retired; // Profile of block extents no longer cached
+    BranchSim* branchSim;
+
+    BlockCost analyze(uint16_t start, uint16_t end) const;
+
+    /** Spread the profile counts of the block at `start` over its addresses. */
+    void addBlockProfile(uint16_t start, const BlockCost& cost, std::vector<PCProfile>& out) const;
+
+    /** Move a cached block's profile into `retired` before the entry is replaced. */
+    void retire(uint16_t start, const BlockCost& cost);
+
+    /** Extra cycles for the branch that ended a block. */
+    unsigned branchCost(uint16_t branchPC, BranchKind kind, bool taken, uint16_t next);
+};
+
+#endif // PIPELINE_TIMING_H
@@ -0,0 +1,205 @@
+/**
+ * 16-bit GPR CPU Emulator - Memory Placement
+ */
+
+#include "placement.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+// =============================================================================
+// HOST TOPOLOGY AND AFFINITY
+// =============================================================================
+// Read straight from sysfs and raw syscalls so there is no libnuma
+// dependency. Anything missing reads as "one node, CPU 0".
+
+/** Last number in a sysfs list such as "0-3,8-11", or -1. */
+static int lastInList(const char* path) {
+    std::FILE* f = std::fopen(path, "r");
+    if (!f) return -1;
+    char buf[256] = {};
+    size_t n = std::fread(buf, 1, sizeof(buf) - 1, f);
+    std::fclose(f);
+    int last = -1, value = -1;
+    for (size_t i = 0; i < n; ++i) {
+        if (buf[i] >= '0' && buf[i] <= '9') {
+            value = (value < 0 ? 0 : value * 10) + (buf[i] - '0');
+        } else if (value >= 0) {
+            last = value;
+            value = -1;
+        }
+    }
+    return value >= 0 ? value : last;
+}
+
+unsigned numaNodeCount() {
+    int last = lastInList("/sys/devices/system/node/online");
+    return last < 0 ? 1u : static_cast<unsigned>(last) + 1;
+}
+
+int currentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+        return static_cast<int>(node);
+#endif
+    return 0;
+}
+
+int numaNodeOfCpu(unsigned cpu) {
+#ifdef __linux__
+    // The CPU's sysfs directory holds a "nodeN" link for its node.
+    unsigned nodes = numaNodeCount();
+    char path[96];
+    for (unsigned node = 0; node < nodes; ++node) {
+        std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/node%u", cpu, node);
+        if (access(path, F_OK) == 0)
+            return static_cast<int>(node);
+    }
+#else
+    (void)cpu;
+#endif
+    return 0;
+}
+
+std::vector<unsigned> allowedCpus() {
+    std::vector<unsigned> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        for (unsigned c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+#endif
+    if (cpus.empty()) {
+        cpus.push_back(0);
+        return cpus;
+    }
+    if (numaNodeCount() > 1) {
+        std::vector<int> node(cpus.back() + 1, 0);
+        for (unsigned c : cpus) node[c] = numaNodeOfCpu(c);
+        std::stable_sort(cpus.begin(), cpus.end(), [&](unsigned a, unsigned b) { return node[a] < node[b]; });
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(unsigned cpu) {
+#ifdef __linux__
+    if (cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool bindToNode(void* addr, size_t bytes, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node < 0) return false;
+    const int MPOL_PREFERRED_MODE = 1;   // <numaif.h> MPOL_PREFERRED
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(static_cast<size_t>(node) / bitsPerWord + 1, 0);
+    mask[static_cast<size_t>(node) / bitsPerWord] = 1ul << (static_cast<size_t>(node) % bitsPerWord);
+    // maxnode counts one past the last bit the kernel should read.
+    unsigned long maxnode = mask.size() * bitsPerWord + 1;
+    return syscall(SYS_mbind, addr, bytes, MPOL_PREFERRED_MODE, mask.data(), maxnode, 0u) == 0;
+#else
+    (void)addr;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
+
+// =============================================================================
+// BUS ARENA
+// =============================================================================
+
+BusArena::BusArena(const PlacementPolicy& p) : policy(p), boundNode(p.numaNode), hugetlbCount(0) {
+    if (boundNode == NUMA_LOCAL)
+        boundNode = numaNodeCount() > 1 ? currentNumaNode() : NUMA_FIRST_TOUCH;
+}
+
+BusArena::~BusArena() {
+    for (const Slab& s : slabs) {
+#ifndef _WIN32
+        munmap(s.base, s.mapped);
+#else
+        delete[] static_cast<char*>(s.base);
+#endif
+    }
+}
+
+bool BusArena::addSlab() {
+#ifndef _WIN32
+    void* base = MAP_FAILED;
+    size_t length = SLAB_BYTES;
+#ifdef MAP_HUGETLB
+    // Reserved huge pages come back already 2 MiB aligned.
+    if (policy.hugePages == HugePages::EXPLICIT) {
+        base = mmap(nullptr, SLAB_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) ++hugetlbCount;
+    }
+#endif
+    if (base == MAP_FAILED) {
+        // Over-map, then trim to a 2 MiB boundary so the kernel can back the
+        // slab with one transparent huge page.
+        void* raw = mmap(nullptr, 2 * SLAB_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return false;
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + SLAB_BYTES - 1) & ~(uintptr_t(SLAB_BYTES) - 1);
+        if (aligned > start) munmap(raw, aligned - start);
+        size_t tail = (start + 2 * SLAB_BYTES) - (aligned + SLAB_BYTES);
+        if (tail) munmap(reinterpret_cast<void*>(aligned + SLAB_BYTES), tail);
+        base = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        if (policy.hugePages != HugePages::NONE)
+            madvise(base, SLAB_BYTES, MADV_HUGEPAGE);
+#endif
+    }
+    // Bind before anything touches the slab; placement happens on first write.
+    if (boundNode >= 0)
+        bindToNode(base, SLAB_BYTES, boundNode);
+#else
+    void* base = new char[SLAB_BYTES]();
+    size_t length = SLAB_BYTES;
+#endif
+    slabs.push_back({base, length});
+    // Hand out low addresses first.
+    char* bytes = static_cast<char*>(base);
+    for (size_t i = BUSES_PER_SLAB; i-- > 0;)
+        freeBlocks.push_back(reinterpret_cast<uint16_t*>(bytes + i * BUS_BYTES));
+    return true;
+}
+
+uint16_t* BusArena::allocate() {
+    if (freeBlocks.empty() && !addSlab())
+        return nullptr;
+    uint16_t* block = freeBlocks.back();
+    freeBlocks.pop_back();
+    return block;
+}
+
+void BusArena::release(uint16_t* memory) {
+    // Zero now rather than madvise: dropping part of a huge page would split
+    // it. Skipping pages that are already zero leaves untouched small pages
+    // unallocated.
+    static const uint16_t zeros[PAGE_WORDS] = {};
+    for (size_t base = 0; base < MEMORY_SIZE; base += PAGE_WORDS)
+        if (std::memcmp(memory + base, zeros, sizeof(zeros)) != 0)
+            std::memset(memory + base, 0, sizeof(zeros));
+    freeBlocks.push_back(memory);
+}
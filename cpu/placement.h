@@ -0,0 +1,126 @@
+/**
+ * 16-bit GPR CPU Emulator - Memory Placement
+ * Huge-page and NUMA-aware backing for large numbers of Buses, plus host
+ * thread pinning.
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include "gpr_cpu.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** How BusArena backs its slabs. */
+enum class HugePages : uint8_t {
+    NONE,          // Ordinary host pages
+    TRANSPARENT,   // madvise(MADV_HUGEPAGE): the kernel uses 2 MiB pages when it can
+    EXPLICIT       // MAP_HUGETLB from the reserved pool, else TRANSPARENT
+};
+
+/** NUMA node choices besides an explicit node number. */
+constexpr int NUMA_FIRST_TOUCH = -1;   // Host default: the node of the thread that first writes
+constexpr int NUMA_LOCAL       = -2;   // The node of the thread that builds the BusArena
+
+struct PlacementPolicy {
+    HugePages hugePages = HugePages::TRANSPARENT;
+    int numaNode = NUMA_LOCAL;
+};
+
+// =============================================================================
+// HOST TOPOLOGY AND AFFINITY (Linux; elsewhere one node and no pinning)
+// =============================================================================
+
+/** Number of online NUMA nodes (1 if the host has no NUMA information). */
+unsigned numaNodeCount();
+
+/** NUMA node the calling thread is running on right now (0 if unknown). */
+int currentNumaNode();
+
+/** NUMA node of host CPU `cpu` (0 if unknown). */
+int numaNodeOfCpu(unsigned cpu);
+
+/**
+ * Host CPUs this process may run on, grouped by NUMA node (node 0's CPUs
+ * first). Worker i pinned to element i % size() keeps neighbours together.
+ */
+std::vector<unsigned> allowedCpus();
+
+/** Pin the calling thread to host CPU `cpu`. Returns false if unsupported. */
+bool pinCurrentThread(unsigned cpu);
+
+/**
+ * Prefer node `node` for the pages of [addr, addr + bytes) that have not
+ * been touched yet (mbind MPOL_PREFERRED). Returns false if unsupported.
+ */
+bool bindToNode(void* addr, size_t bytes, int node);
+
+// =============================================================================
+// BUS ARENA
+// =============================================================================
+
+/**
+ * BusArena: carves Bus memories out of 2 MiB slabs, 16 per slab.
+ *
+ * A Bus's own 128 KiB mapping is too small and too unaligned for a huge
+ * page, so a fleet of thousands of Buses spends a TLB entry per 4 KiB it
+ * touches. Packing 16 Buses into one aligned slab lets the whole slab sit
+ * behind a single 2 MiB TLB entry. Each slab is also bound to one NUMA
+ * node, so a worker that owns an arena only touches local memory.
+ *
+ * Trade-offs:
+ *   - huge pages are allocated whole, so an arena Bus costs real memory
+ *     even for pages it never writes (no lazy zero pages);
+ *   - arena memory is not an mmap per Bus, so Bus::discardMemory() returns
+ *     false and BusPool falls back to Bus::resetMemory().
+ *
+ * Typical use: each worker thread pins itself, builds its own arena
+ * (NUMA_LOCAL then means its node) and a BusPool over it. Create the
+ * worker's GPRCPU objects on that thread too, so first touch places them
+ * locally as well.
+ *
+ * Not thread-safe, and must outlive every Bus built from it.
+ */
+class BusArena {
+public:
+    static constexpr size_t SLAB_BYTES = size_t(2) << 20;
+    static constexpr size_t BUS_BYTES = MEMORY_SIZE * sizeof(uint16_t);
+    static constexpr size_t BUSES_PER_SLAB = SLAB_BYTES / BUS_BYTES;
+
+    explicit BusArena(const PlacementPolicy& policy = PlacementPolicy());
+    ~BusArena();
+
+    BusArena(const BusArena&) = delete;
+    BusArena& operator=(const BusArena&) = delete;
+
+    /** A zeroed MEMORY_SIZE-word block, or nullptr if no slab could be mapped. */
+    uint16_t* allocate();
+
+    /** Give back a block from allocate(); it is zeroed for its next user. */
+    void release(uint16_t* memory);
+
+    /** Node slabs are bound to (NUMA_FIRST_TOUCH if none). */
+    int node() const { return boundNode; }
+
+    size_t slabCount() const { return slabs.size(); }
+
+    /** Slabs backed by the reserved huge-page pool (HugePages::EXPLICIT). */
+    size_t hugetlbSlabs() const { return hugetlbCount; }
+
+private:
+    struct Slab {
+        void* base;
+        size_t mapped;    // Length to munmap
+    };
+
+    PlacementPolicy policy;
+    int boundNode;
+    std::vector<Slab> slabs;
+    std::vector<uint16_t*> freeBlocks;
+    size_t hugetlbCount;
+
+    bool addSlab();
+};
+
+#endif // PLACEMENT_H
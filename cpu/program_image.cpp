@@ -0,0 +1,78 @@
+/**
+ * 16-bit GPR CPU Emulator - Shared Program Images
+ */
+
+#include "program_image.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t IMAGE_BYTES = MEMORY_SIZE * sizeof(uint16_t);
+
+#ifndef _WIN32
+/** Anonymous file for the image: memfd on Linux, an unlinked temp file elsewhere. */
+static int createImageFile() {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    int fd = memfd_create("gpr16-image", MFD_CLOEXEC);
+    if (fd >= 0) return fd;
+#endif
+    char name[] = "/tmp/gpr16-image-XXXXXX";
+    int fd2 = mkstemp(name);
+    if (fd2 >= 0) unlink(name);
+    return fd2;
+}
+#endif
+
+ProgramImage::ProgramImage(const uint16_t* words) : fd(-1), view(nullptr) {
+#ifndef _WIN32
+    fd = createImageFile();
+    if (fd >= 0 && ftruncate(fd, static_cast<off_t>(IMAGE_BYTES)) == 0) {
+        // Write only non-zero Bus pages; the rest stay file holes.
+        bool written = true;
+        for (size_t page = 0; page < PAGE_COUNT && written; ++page) {
+            const uint16_t* p = words + page * PAGE_WORDS;
+            bool zero = true;
+            for (size_t i = 0; i < PAGE_WORDS && zero; ++i) zero = (p[i] == 0);
+            if (!zero) {
+                size_t bytes = PAGE_WORDS * sizeof(uint16_t);
+                written = pwrite(fd, p, bytes, static_cast<off_t>(page * bytes)) == static_cast<ssize_t>(bytes);
+            }
+        }
+        void* map = written ? mmap(nullptr, IMAGE_BYTES, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        if (map != MAP_FAILED) {
+            view = static_cast<uint16_t*>(map);
+            return;
+        }
+    }
+    if (fd >= 0) close(fd);
+    fd = -1;
+#endif
+    // Fallback: a plain copy; each Bus copies it again.
+    view = new uint16_t[MEMORY_SIZE];
+    std::memcpy(view, words, IMAGE_BYTES);
+}
+
+ProgramImage::~ProgramImage() {
+#ifndef _WIN32
+    if (fd >= 0) {
+        munmap(view, IMAGE_BYTES);
+        close(fd);   // Existing Bus mappings keep the file alive
+        return;
+    }
+#endif
+    delete[] view;
+}
+
+uint16_t* ProgramImage::mapPrivate() const {
+#ifndef _WIN32
+    if (fd < 0) return nullptr;
+    void* map = mmap(nullptr, IMAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    return map == MAP_FAILED ? nullptr : static_cast<uint16_t*>(map);
+#else
+    return nullptr;
+#endif
+}
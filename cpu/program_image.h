@@ -0,0 +1,57 @@
+/**
+ * 16-bit GPR CPU Emulator - Shared Program Images
+ * One assembled memory image mapped copy-on-write into many Buses.
+ */
+
+#ifndef PROGRAM_IMAGE_H
+#define PROGRAM_IMAGE_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <string>
+
+/**
+ * ProgramImage: an immutable 65536-word memory image (code plus initial
+ * data) kept in an anonymous shared-memory file. Every Bus built from it
+ * (Bus(const ProgramImage&)) maps the file privately, so:
+ *
+ *   - the program is assembled once, not once per instance;
+ *   - untouched pages are shared by all instances (one physical copy);
+ *   - the first write to a page gives that instance a private copy
+ *     (copy-on-write, handled by the host MMU at no cost to reads or
+ *     writes that follow).
+ *
+ * Sharing works on host pages (usually 4 KiB = 2048 words = 8 Bus pages),
+ * so an instance costs the host pages it writes, not 128 KiB.
+ *
+ * POSIX only: on other platforms (or if the shared file cannot be made)
+ * shared() is false and each Bus gets a plain private copy instead.
+ */
+class ProgramImage {
+public:
+    /** Copy a flat MEMORY_SIZE-word image, e.g. one filled by assembleFile(). */
+    explicit ProgramImage(const uint16_t* words);
+    ~ProgramImage();
+
+    ProgramImage(const ProgramImage&) = delete;
+    ProgramImage& operator=(const ProgramImage&) = delete;
+
+    /** Read-only view of the image. */
+    const uint16_t* words() const { return view; }
+
+    /** True if Buses map the image copy-on-write (false: they copy it). */
+    bool shared() const { return fd >= 0; }
+
+    /**
+     * Map a private, writable copy-on-write view for a Bus (MEMORY_SIZE
+     * words). Returns nullptr if the image is not shared. The Bus releases
+     * it with munmap like its other mapped memory.
+     */
+    uint16_t* mapPrivate() const;
+
+private:
+    int fd;               // Shared-memory file holding the image (-1 if not shared)
+    uint16_t* view;       // Read-only mapping (or heap copy when not shared)
+};
+
+#endif // PROGRAM_IMAGE_H
@@ -0,0 +1,209 @@
+/**
+ * 16-bit GPR CPU Emulator - Symmetric Multiprocessing
+ */
+
+#include "smp.h"
+#include "placement.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+SMPMachine::SMPMachine(Bus& bus, unsigned n) : bus(bus) {
+    n = std::min(std::max(n, 1u), SMP_MAX_CORES);
+    for (unsigned i = 0; i < n; ++i)
+        cores.emplace_back(new GPRCPU(bus));
+    reset();
+}
+
+void SMPMachine::reset(uint16_t entry) {
+    for (unsigned i = 0; i < cores.size(); ++i) {
+        GPRCPU& cpu = *cores[i];
+        cpu.reset();
+        cpu.setCoreId(static_cast<uint16_t>(i));
+        cpu.getState().PC = entry;
+        cpu.getState().SP = static_cast<uint16_t>(STACK_TOP - i * SMP_STACK_WORDS);
+    }
+}
+
+static size_t runCore(GPRCPU& cpu, size_t budget) {
+    size_t cycles = 0;
+    while (cycles < budget) {
+        size_t n = cpu.runFor(budget - cycles);
+        cycles += n;
+        if (cpu.getState().halted || n == 0)
+            break;
+    }
+    return cycles;
+}
+
+std::vector<size_t> SMPMachine::run(size_t maxCyclesPerCore) {
+    std::vector<size_t> cycles(cores.size(), 0);
+    std::vector<std::thread> threads;
+    threads.reserve(cores.size());
+
+    // Core 0 runs on the calling thread; the rest get one host thread each.
+    std::vector<unsigned> cpus = pinThreads ? allowedCpus() : std::vector<unsigned>();
+    for (size_t i = 1; i < cores.size(); ++i)
+        threads.emplace_back([this, &cycles, &cpus, i, maxCyclesPerCore] {
+            if (!cpus.empty()) pinCurrentThread(cpus[i % cpus.size()]);
+            cycles[i] = runCore(*cores[i], maxCyclesPerCore);
+        });
+    cycles[0] = runCore(*cores[0], maxCyclesPerCore);
+
+    for (std::thread& t : threads)
+        t.join();
+    return cycles;
+}
+
+// =============================================================================
+// DETERMINISTIC SMP (quantum-synchronized)
+// =============================================================================
+
+DeterministicSMP::DeterministicSMP(Bus& shared, unsigned n, size_t q)
+    : shared(shared), pageOwner(PAGE_COUNT, -1), quantum(q ? q : 1), quanta(0) {
+    n = std::min(std::max(n, 1u), SMP_MAX_CORES);
+    for (unsigned i = 0; i < n; ++i) {
+        cores.emplace_back(new Core());
+        cores.back()->cpu->setDeferAtomics(true);
+    }
+    reset();
+}
+
+DeterministicSMP::~DeterministicSMP() = default;
+
+void DeterministicSMP::setPrivatePages(unsigned core, unsigned firstPage, unsigned count) {
+    for (unsigned p = firstPage; p < firstPage + count && p < PAGE_COUNT; ++p)
+        pageOwner[p] = static_cast<int>(core);
+}
+
+void DeterministicSMP::reset(uint16_t entry) {
+    for (unsigned i = 0; i < cores.size(); ++i) {
+        GPRCPU& cpu = *cores[i]->cpu;
+        cpu.reset();
+        cpu.setCoreId(static_cast<uint16_t>(i));
+        cpu.getState().PC = entry;
+        cpu.getState().SP = static_cast<uint16_t>(STACK_TOP - i * SMP_STACK_WORDS);
+    }
+}
+
+void DeterministicSMP::runQuantum(unsigned i, const std::vector<uint16_t>& refresh, size_t maxCycles) {
+    Core& c = *cores[i];
+    uint16_t* mine = c.bus.getMemory();
+    const uint16_t* master = shared.getMemory();
+
+    // Pull in the words other cores committed at the last barrier.
+    for (uint16_t page : refresh) {
+        if (pageOwner[page] < 0 || pageOwner[page] == static_cast<int>(i))
+            std::memcpy(mine + page * PAGE_WORDS, master + page * PAGE_WORDS, PAGE_WORDS * sizeof(uint16_t));
+    }
+
+    c.writes.clear();
+    if (c.done)
+        return;
+
+    c.bus.clearDirtyPages();
+    size_t budget = std::min(quantum, maxCycles - c.cycles);
+    size_t n = c.cpu->runFor(budget);
+    c.cycles += n;
+    const CPUState& st = c.cpu->getState();
+    c.done = st.halted || c.cycles >= maxCycles || (n < budget && !c.cpu->hasPendingAtomic());
+
+    // The master image is frozen during the quantum, so a word differs from
+    // it exactly when this core changed it.
+    for (size_t page = 0; page < PAGE_COUNT; ++page) {
+        if (!c.bus.isPageDirty(static_cast<unsigned>(page)))
+            continue;
+        size_t base = page * PAGE_WORDS;
+        for (size_t w = base; w < base + PAGE_WORDS; ++w)
+            if (mine[w] != master[w])
+                c.writes.emplace_back(static_cast<uint16_t>(w), mine[w]);
+    }
+}
+
+std::vector<size_t> DeterministicSMP::run(size_t maxCyclesPerCore) {
+    const unsigned n = numCores();
+    quanta = 0;
+    for (auto& c : cores) {
+        c->cycles = 0;
+        c->done = false;
+    }
+
+    // Persistent workers for cores 1..n-1; core 0 runs on this thread.
+    std::mutex m;
+    std::condition_variable startCv, doneCv;
+    uint64_t generation = 0;
+    unsigned pending = 0;
+    bool quit = false;
+    std::vector<uint16_t> refresh;
+
+    // Each worker copies in its own private memory, so the pages it writes
+    // are first touched (and placed) on the node it runs on. The shared Bus
+    // does not change until every worker has finished its first quantum.
+    std::vector<unsigned> cpus = pinThreads ? allowedCpus() : std::vector<unsigned>();
+    cores[0]->bus.loadMemory(shared.getMemory());
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < n; ++i) {
+        workers.emplace_back([&, i] {
+            if (!cpus.empty()) pinCurrentThread(cpus[i % cpus.size()]);
+            cores[i]->bus.loadMemory(shared.getMemory());
+            uint64_t seen = 0;
+            for (;;) {
+                std::unique_lock<std::mutex> lk(m);
+                startCv.wait(lk, [&] { return generation != seen || quit; });
+                if (quit) return;
+                seen = generation;
+                lk.unlock();
+                runQuantum(i, refresh, maxCyclesPerCore);
+                lk.lock();
+                if (--pending == 0) doneCv.notify_one();
+            }
+        });
+    }
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            pending = n - 1;
+            ++generation;
+        }
+        startCv.notify_all();
+        runQuantum(0, refresh, maxCyclesPerCore);
+        {
+            std::unique_lock<std::mutex> lk(m);
+            doneCv.wait(lk, [&] { return pending == 0; });
+        }
+
+        // Barrier: commit in fixed core order, then resolve deferred CAS.
+        // The shared Bus's dirty pages are exactly the pages to refresh.
+        shared.clearDirtyPages();
+        for (auto& c : cores)
+            for (const auto& w : c->writes)
+                shared.write(w.first, w.second);
+        for (auto& c : cores)
+            if (c->cpu->completeDeferredAtomic(shared)) ++c->cycles;   // The CAS's cycle
+        ++quanta;
+
+        refresh.clear();
+        for (size_t p = 0; p < PAGE_COUNT; ++p)
+            if (shared.isPageDirty(static_cast<unsigned>(p))) refresh.push_back(static_cast<uint16_t>(p));
+
+        bool allDone = std::all_of(cores.begin(), cores.end(), [](const std::unique_ptr<Core>& c) { return c->done; });
+        if (allDone)
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(m);
+        quit = true;
+    }
+    startCv.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+
+    std::vector<size_t> cycles;
+    for (auto& c : cores)
+        cycles.push_back(c->cycles);
+    return cycles;
+}
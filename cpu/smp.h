@@ -0,0 +1,146 @@
+/**
+ * 16-bit GPR CPU Emulator - Symmetric Multiprocessing
+ * Several GPRCPU cores sharing one Bus, each on its own host thread.
+ */
+
+#ifndef SMP_H
+#define SMP_H
+
+#include "gpr_cpu.h"
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** Words of stack reserved per core below STACK_TOP. */
+constexpr uint16_t SMP_STACK_WORDS = 256;
+
+/**
+ * Lowest address a core's stack may reach. Everything below it is left to
+ * the program's code and data (such as main.cpp's operands at 0x100).
+ */
+constexpr uint16_t SMP_STACK_FLOOR = 0x8000;
+
+/** Most cores whose stacks fit between SMP_STACK_FLOOR and STACK_TOP (126); more are clamped to this. */
+constexpr unsigned SMP_MAX_CORES = (STACK_TOP - SMP_STACK_FLOOR) / SMP_STACK_WORDS;
+
+/**
+ * SMPMachine: N cores over one shared Bus.
+ *
+ * Guest memory is word-coherent: every LOAD/STORE is a relaxed atomic, so
+ * cores never see torn words but get no ordering guarantees beyond that.
+ * Synchronize with CAS (sequentially consistent) and FENCE. BMOV/BFILL are
+ * not atomic with respect to other cores.
+ *
+ * Bus devices and probes are not thread-safe; leave them detached while
+ * run() executes. Per-core ControlFlowListeners are fine.
+ */
+class SMPMachine {
+public:
+    SMPMachine(Bus& bus, unsigned cores);
+
+    unsigned numCores() const { return static_cast<unsigned>(cores.size()); }
+    GPRCPU& core(unsigned i) { return *cores[i]; }
+    Bus& getBus() { return bus; }
+
+    /**
+     * Reset every core to start at `entry`. Core i gets CPUID = i and its own
+     * stack at STACK_TOP - i * SMP_STACK_WORDS.
+     */
+    void reset(uint16_t entry = 0);
+
+    /**
+     * Run each core on its own host thread until it halts (or sleeps with
+     * nothing to wake it), at most `maxCyclesPerCore` cycles each. Blocks
+     * until every core has stopped. Returns the cycles each core ran.
+     */
+    std::vector<size_t> run(size_t maxCyclesPerCore = SIZE_MAX);
+
+    /**
+     * Pin core i's host thread (i >= 1) to allowedCpus()[i % count]. Core 0
+     * runs on the caller's thread, which is left as it is.
+     */
+    void setPinThreads(bool on) { pinThreads = on; }
+
+private:
+    Bus& bus;
+    std::vector<std::unique_ptr<GPRCPU>> cores;
+    bool pinThreads = false;
+};
+
+/**
+ * DeterministicSMP: bit-reproducible multi-core runs that still use one
+ * host thread per core.
+ *
+ * Each core executes against a private copy of memory. All cores run one
+ * quantum of `quantum` cycles in parallel. Then, at a barrier, each core's
+ * changed words are found from its dirty pages and committed to the shared
+ * Bus in core order (core 0 first, so the highest core wins a same-word
+ * race). Changed pages are then copied back into every core. The result
+ * depends only on the program and the quantum, never on host timing.
+ *
+ * CAS cannot be resolved in a private copy, so a core that reaches one ends
+ * its quantum early. Pending CAS operations run at the barrier, in core
+ * order, against the shared Bus.
+ *
+ * Smaller quanta make cross-core communication more timely; larger quanta
+ * amortize barrier cost. Pages marked private with setPrivatePages() are
+ * copied back only into their owner, which skips broadcast work for
+ * per-core data. No other core may read such a page.
+ */
+class DeterministicSMP {
+public:
+    DeterministicSMP(Bus& shared, unsigned cores, size_t quantum = 10000);
+    ~DeterministicSMP();
+
+    unsigned numCores() const { return static_cast<unsigned>(cores.size()); }
+    GPRCPU& core(unsigned i) { return *cores[i]->cpu; }
+
+    void setQuantum(size_t q) { quantum = q ? q : 1; }
+    size_t getQuantum() const { return quantum; }
+
+    /** Mark pages [firstPage, firstPage + count) as private to `core`. */
+    void setPrivatePages(unsigned core, unsigned firstPage, unsigned count);
+
+    /** Same start-up state as SMPMachine::reset(): PC, CPUID and per-core stacks. */
+    void reset(uint16_t entry = 0);
+
+    /**
+     * Run quanta until every core has halted (or sleeps with nothing to wake
+     * it) or has used `maxCyclesPerCore`. The shared Bus holds the final
+     * memory image. Returns the cycles each core ran.
+     */
+    std::vector<size_t> run(size_t maxCyclesPerCore = SIZE_MAX);
+
+    /** Number of barriers completed by the last run(). */
+    uint64_t quantaRun() const { return quanta; }
+
+    /**
+     * Pin worker threads as SMPMachine::setPinThreads() does. Each worker
+     * fills its own private memory, so with pinning it is placed on that
+     * worker's NUMA node.
+     */
+    void setPinThreads(bool on) { pinThreads = on; }
+
+private:
+    struct Core {
+        Bus bus;                                  // Private view of memory
+        std::unique_ptr<GPRCPU> cpu;
+        std::vector<std::pair<uint16_t, uint16_t>> writes;   // (address, value) to commit
+        size_t cycles = 0;
+        bool done = false;
+        Core() : cpu(new GPRCPU(bus)) {}
+    };
+
+    Bus& shared;
+    std::vector<std::unique_ptr<Core>> cores;
+    std::vector<int> pageOwner;     // -1 = shared, else owning core
+    size_t quantum;
+    uint64_t quanta;
+    bool pinThreads = false;
+
+    /** One quantum for core `i`: refresh pages, run, collect writes. */
+    void runQuantum(unsigned i, const std::vector<uint16_t>& refresh, size_t budget);
+};
+
+#endif // SMP_H
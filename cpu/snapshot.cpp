@@ -0,0 +1,239 @@
+/**
+ * 16-bit GPR CPU Emulator - Machine Snapshots
+ */
+
+#include "snapshot.h"
+#include "binary_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAGIC[8] = {'G', 'P', 'R', '1', '6', 'S', 'N', 'P'};
+
+enum PageEncoding : uint8_t { PAGE_RAW = 1, PAGE_RLE = 2 };
+
+/** Bounds-checked cursor over the snapshot bytes. */
+struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool need(size_t n) const { return static_cast<size_t>(end - p) >= n; }
+};
+
+// =============================================================================
+// SAVE
+// =============================================================================
+
+/** Append one page as RLE runs if that beats RAW; returns false if RAW is smaller. */
+static bool encodeRle(const uint16_t* words, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    for (size_t i = 0; i < PAGE_WORDS;) {
+        size_t run = 1;
+        while (i + run < PAGE_WORDS && words[i + run] == words[i]) ++run;
+        put16(out, static_cast<uint16_t>(run));
+        put16(out, words[i]);
+        i += run;
+        if (out.size() - start >= PAGE_WORDS * 2) {
+            out.resize(start);
+            return false;
+        }
+    }
+    return true;
+}
+
+SnapshotResult saveSnapshot(const char* path, const GPRCPU& cpu, const Bus& bus, uint64_t cycles) {
+    const CPUState& st = cpu.getState();
+    std::vector<uint8_t> out;
+    out.reserve(4096);
+
+    // --- Header ---
+    out.insert(out.end(), MAGIC, MAGIC + sizeof(MAGIC));
+    put32(out, SNAPSHOT_VERSION);
+    put64(out, cycles);
+    for (uint16_t r : st.R) put16(out, r);
+    put16(out, st.PC);
+    put16(out, st.FLAGS);
+    put16(out, st.SP);
+    put16(out, st.pendingIRQ);
+    put16(out, cpu.getCoreId());
+    out.push_back(st.halted ? 1 : 0);
+    out.push_back(st.IE ? 1 : 0);
+    out.push_back(st.waiting ? 1 : 0);
+    out.push_back(0);
+    size_t countsAt = out.size();
+    put32(out, 0);   // Device records, patched below
+    put32(out, 0);   // Page records, patched below
+
+    // --- Devices ---
+    uint32_t deviceRecords = 0;
+    std::vector<uint8_t> devState;
+    for (unsigned slot = 0; slot < MMIO_SLOTS; ++slot) {
+        const Device* dev = bus.getDevice(slot);
+        if (!dev) continue;
+        devState.clear();
+        dev->saveState(devState);
+        out.push_back(static_cast<uint8_t>(slot));
+        out.insert(out.end(), 3, 0);
+        put32(out, static_cast<uint32_t>(devState.size()));
+        out.insert(out.end(), devState.begin(), devState.end());
+        ++deviceRecords;
+    }
+
+    // --- Memory pages ---
+    uint32_t pageRecords = 0;
+    const uint16_t* mem = bus.getMemory();
+    for (unsigned page = 0; page < PAGE_COUNT; ++page) {
+        const uint16_t* words = mem + page * PAGE_WORDS;
+        if (std::all_of(words, words + PAGE_WORDS, [](uint16_t w) { return w == 0; }))
+            continue;
+        out.push_back(static_cast<uint8_t>(page));
+        size_t encodingAt = out.size();
+        out.push_back(PAGE_RLE);
+        put16(out, 0);
+        size_t lengthAt = out.size();
+        put32(out, 0);
+        size_t payloadAt = out.size();
+        if (!encodeRle(words, out)) {
+            out[encodingAt] = PAGE_RAW;
+            for (size_t i = 0; i < PAGE_WORDS; ++i) put16(out, words[i]);
+        }
+        uint32_t length = static_cast<uint32_t>(out.size() - payloadAt);
+        patch32(out, lengthAt, length);
+        ++pageRecords;
+    }
+
+    patch32(out, countsAt, deviceRecords);
+    patch32(out, countsAt + 4, pageRecords);
+    put32(out, fnv1a32(out.data(), out.size()));
+
+    // --- Write beside the target, then rename over it ---
+    std::string error;
+    if (!replaceFile(path, std::string(path) + ".tmp", out, true, error))
+        return {false, error, cycles};
+    return {true, "", cycles};
+}
+
+// =============================================================================
+// RESTORE
+// =============================================================================
+
+/** Decode a complete snapshot image into cpu and bus. */
+static SnapshotResult decodeSnapshot(const uint8_t* data, size_t size, GPRCPU& cpu, Bus& bus) {
+    const size_t HEADER = 8 + 4 + 8 + 13 * 2 + 4 + 8;
+    if (size < HEADER + 4 || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+        return {false, "not a snapshot file", 0};
+    uint32_t version = get32(data + 8);
+    if (version != SNAPSHOT_VERSION)
+        return {false, "unsupported snapshot version " + std::to_string(version), 0};
+    if (fnv1a32(data, size - 4) != get32(data + size - 4))
+        return {false, "snapshot checksum mismatch (truncated or corrupt)", 0};
+
+    // --- Header ---
+    Reader in{data + 12, data + size - 4};
+    uint64_t cycles = get64(in.p);
+    in.p += 8;
+    CPUState st;
+    for (uint16_t& r : st.R) { r = get16(in.p); in.p += 2; }
+    st.PC = get16(in.p);
+    st.FLAGS = get16(in.p + 2);
+    st.SP = get16(in.p + 4);
+    st.pendingIRQ = get16(in.p + 6);
+    uint16_t coreId = get16(in.p + 8);
+    st.halted = in.p[10] != 0;
+    st.IE = in.p[11] != 0;
+    st.waiting = in.p[12] != 0;
+    in.p += 14;
+    uint32_t deviceRecords = get32(in.p);
+    uint32_t pageRecords = get32(in.p + 4);
+    in.p += 8;
+
+    // --- Devices ---
+    for (uint32_t i = 0; i < deviceRecords; ++i) {
+        if (!in.need(8))
+            return {false, "truncated device record", cycles};
+        unsigned slot = in.p[0];
+        uint32_t length = get32(in.p + 4);
+        in.p += 8;
+        if (!in.need(length))
+            return {false, "truncated device record", cycles};
+        Device* dev = bus.getDevice(slot);
+        if (!dev || !dev->restoreState(in.p, length))
+            return {false, "device in MMIO slot " + std::to_string(slot) + " missing or incompatible", cycles};
+        in.p += length;
+    }
+
+    // --- Memory: clear, then decode each stored page in place ---
+    uint16_t* mem = bus.getMemory();
+    bus.clearMemory();   // Leaves never-written pages unallocated
+    for (uint32_t i = 0; i < pageRecords; ++i) {
+        if (!in.need(8))
+            return {false, "truncated page record", cycles};
+        unsigned page = in.p[0];
+        uint8_t encoding = in.p[1];
+        uint32_t length = get32(in.p + 4);
+        in.p += 8;
+        if (!in.need(length))
+            return {false, "truncated page record", cycles};
+        uint16_t* words = mem + page * PAGE_WORDS;
+        if (encoding == PAGE_RAW && length == PAGE_WORDS * 2) {
+            for (size_t w = 0; w < PAGE_WORDS; ++w) words[w] = get16(in.p + 2 * w);
+        } else if (encoding == PAGE_RLE && length % 4 == 0) {
+            size_t w = 0;
+            for (const uint8_t* r = in.p; r < in.p + length; r += 4) {
+                uint16_t run = get16(r);
+                if (run > PAGE_WORDS - w)
+                    return {false, "bad RLE run in page " + std::to_string(page), cycles};
+                std::fill_n(words + w, run, get16(r + 2));
+                w += run;
+            }
+        } else {
+            return {false, "bad encoding for page " + std::to_string(page), cycles};
+        }
+        in.p += length;
+    }
+
+    cpu.reset();
+    cpu.getState() = st;
+    cpu.setCoreId(coreId);
+    bus.clearDirtyPages();
+    return {true, "", cycles};
+}
+
+SnapshotResult loadSnapshot(const char* path, GPRCPU& cpu, Bus& bus) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return {false, std::string("cannot open ") + path, 0};
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size <= 0) {
+        close(fd);
+        return {false, std::string("cannot read ") + path, 0};
+    }
+    size_t size = static_cast<size_t>(sb.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return {false, std::string("cannot map ") + path, 0};
+    SnapshotResult r = decodeSnapshot(static_cast<const uint8_t*>(map), size, cpu, bus);
+    munmap(map, size);
+    return r;
+#else
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f)
+        return {false, std::string("cannot open ") + path, 0};
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    std::fclose(f);
+    return decodeSnapshot(data.data(), data.size(), cpu, bus);
+#endif
+}
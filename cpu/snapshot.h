@@ -0,0 +1,55 @@
+/**
+ * 16-bit GPR CPU Emulator - Machine Snapshots
+ * Save a GPRCPU + Bus (registers, memory, device state, cycle count) to a
+ * file and resume it later, e.g. to checkpoint long jobs.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <string>
+
+/**
+ * File format, version 1 (all fields little-endian):
+ *
+ *   Header   "GPR16SNP", u32 version, u64 cycles,
+ *            u16 R0-R7, PC, FLAGS, SP, pendingIRQ, coreId,
+ *            u8 halted, IE, waiting, reserved,
+ *            u32 device records, u32 page records
+ *   Device   u8 slot, u8 reserved[3], u32 length, state bytes (Device::saveState)
+ *   Page     u8 page, u8 encoding, u16 reserved, u32 payload bytes, payload
+ *   Trailer  u32 FNV-1a checksum of everything before it
+ *
+ * Memory is stored in 256-word pages. All-zero pages are left out, and each
+ * other page is stored RAW (512 bytes) or as RLE (u16 count, u16 value)
+ * runs, whichever is smaller. A typical program plus data is a few hundred
+ * bytes instead of 128 KiB.
+ *
+ * Restore maps the file (mmap on POSIX) and decodes pages straight from the
+ * mapping into Bus memory; no intermediate copy is made. Devices are matched
+ * by MMIO slot, so attach the same devices before restoring. The Bus's
+ * dirty-page bitmap is cleared, since the restored image is the new baseline.
+ * The checksum is verified before anything is touched; a structurally bad
+ * file that passes it may leave the machine partially restored.
+ */
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+/** Result of a snapshot operation: success, error message, saved cycle count. */
+struct SnapshotResult {
+    bool ok;
+    std::string error;
+    uint64_t cycles;
+};
+
+/**
+ * Write `cpu` and `bus` to `path`. The file is written beside the target
+ * and renamed over it, so an interrupted save never leaves a torn snapshot.
+ */
+SnapshotResult saveSnapshot(const char* path, const GPRCPU& cpu, const Bus& bus, uint64_t cycles);
+
+/** Restore `cpu` and `bus` from `path`; `cycles` in the result is the saved count. */
+SnapshotResult loadSnapshot(const char* path, GPRCPU& cpu, Bus& bus);
+
+#endif // SNAPSHOT_H
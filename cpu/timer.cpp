@@ -0,0 +1,101 @@
+/**
+ * 16-bit GPR CPU Emulator - Programmable Timer Device
+ */
+
+#include "timer.h"
+
+Timer::Timer(unsigned irqLine)
+    : irqLine(irqLine & 15u), ctrl(0), reload(0), prescale(0), status(0), remaining(0) {}
+
+uint64_t Timer::periodCycles() const {
+    uint64_t ticks = reload ? reload : 65536u;
+    return ticks * (static_cast<uint64_t>(prescale) + 1);
+}
+
+uint16_t Timer::read(uint16_t reg) {
+    switch (reg) {
+        case CTRL:     return ctrl;
+        case RELOAD:   return reload;
+        case PRESCALE: return prescale;
+        case COUNT: {
+            // Round up so COUNT only reads 0 once the timer has actually expired.
+            uint64_t perTick = static_cast<uint64_t>(prescale) + 1;
+            return static_cast<uint16_t>((remaining + perTick - 1) / perTick);
+        }
+        case STATUS:   return status;
+        default:       return 0;
+    }
+}
+
+void Timer::write(uint16_t reg, uint16_t value) {
+    switch (reg) {
+        case CTRL:
+            ctrl = value;
+            if (ctrl & CTRL_ENABLE)
+                remaining = periodCycles();
+            break;
+        case RELOAD:   reload = value; break;
+        case PRESCALE: prescale = value; break;
+        case COUNT:
+            remaining = (value ? value : 65536u) * (static_cast<uint64_t>(prescale) + 1);
+            break;
+        case STATUS:
+            status &= static_cast<uint16_t>(~value);  // Write-1-to-clear
+            break;
+        default: break;
+    }
+}
+
+uint16_t Timer::tick(uint64_t cycles) {
+    if (!(ctrl & CTRL_ENABLE) || cycles < remaining) {
+        if (ctrl & CTRL_ENABLE) remaining -= cycles;
+        return 0;
+    }
+
+    // Expired during this slice.
+    status |= 1;
+    uint16_t irq = (ctrl & CTRL_IRQ) ? static_cast<uint16_t>(1u << irqLine) : 0;
+    if (ctrl & CTRL_PERIODIC) {
+        uint64_t period = periodCycles();
+        uint64_t over = (cycles - remaining) % period;
+        remaining = period - over;
+    } else {
+        ctrl &= static_cast<uint16_t>(~CTRL_ENABLE);  // One-shot: stop
+        remaining = 0;
+    }
+    return irq;
+}
+
+uint64_t Timer::cyclesUntilEvent() const {
+    if ((ctrl & (CTRL_ENABLE | CTRL_IRQ)) != (CTRL_ENABLE | CTRL_IRQ))
+        return UINT64_MAX;
+    return remaining;
+}
+
+// =============================================================================
+// SNAPSHOT STATE
+// =============================================================================
+// Layout (little-endian): CTRL, RELOAD, PRESCALE, STATUS as 16-bit words,
+// then the remaining cycle count as 64 bits. The IRQ line is wiring, not
+// state, so it comes from the constructor.
+
+void Timer::saveState(std::vector<uint8_t>& out) const {
+    for (uint16_t v : {ctrl, reload, prescale, status}) {
+        out.push_back(static_cast<uint8_t>(v));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+    }
+    for (unsigned i = 0; i < 8; ++i)
+        out.push_back(static_cast<uint8_t>(remaining >> (8 * i)));
+}
+
+bool Timer::restoreState(const uint8_t* data, size_t size) {
+    if (size != 16)
+        return false;
+    uint16_t* regs[] = {&ctrl, &reload, &prescale, &status};
+    for (unsigned i = 0; i < 4; ++i)
+        *regs[i] = static_cast<uint16_t>(data[2 * i] | (data[2 * i + 1] << 8));
+    remaining = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        remaining |= static_cast<uint64_t>(data[8 + i]) << (8 * i);
+    return true;
+}
@@ -0,0 +1,52 @@
+/**
+ * 16-bit GPR CPU Emulator - Programmable Timer Device
+ * Counts CPU cycles and raises an interrupt when it reaches zero.
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "gpr_cpu.h"
+
+/**
+ * Timer registers (offsets within the device's MMIO slot):
+ *   0 CTRL     bit 0 = enable, bit 1 = periodic (auto-reload), bit 2 = IRQ enable
+ *   1 RELOAD   period in ticks (0 is treated as 65536)
+ *   2 PRESCALE cycles per tick minus one (tick every PRESCALE+1 cycles)
+ *   3 COUNT    ticks remaining (read); writing restarts the countdown
+ *   4 STATUS   bit 0 = expired since last acknowledge; write 1 to clear
+ *
+ * Writing CTRL with the enable bit set (re)loads COUNT from RELOAD.
+ * Time is tracked in cycles, so expiry lands on an exact cycle.
+ */
+class Timer : public Device {
+public:
+    /** IRQ line the timer raises on expiry (default 0). */
+    explicit Timer(unsigned irqLine = 0);
+
+    enum Reg : uint16_t { CTRL = 0, RELOAD = 1, PRESCALE = 2, COUNT = 3, STATUS = 4 };
+
+    static constexpr uint16_t CTRL_ENABLE   = (1 << 0);
+    static constexpr uint16_t CTRL_PERIODIC = (1 << 1);
+    static constexpr uint16_t CTRL_IRQ      = (1 << 2);
+
+    uint16_t read(uint16_t reg) override;
+    void write(uint16_t reg, uint16_t value) override;
+    uint16_t tick(uint64_t cycles) override;
+    uint64_t cyclesUntilEvent() const override;
+    void saveState(std::vector<uint8_t>& out) const override;
+    bool restoreState(const uint8_t* data, size_t size) override;
+
+private:
+    unsigned irqLine;
+    uint16_t ctrl;
+    uint16_t reload;
+    uint16_t prescale;
+    uint16_t status;
+    uint64_t remaining;   // Cycles until expiry while enabled
+
+    /** Length of one full period in cycles. */
+    uint64_t periodCycles() const;
+};
+
+#endif // TIMER_H
@@ -0,0 +1,196 @@
+/**
+ * 16-bit GPR CPU Emulator - C API (libgprcpu)
+ * Thin layer over Bus/GPRCPU/assemble(); nothing here may throw across
+ * the C boundary.
+ */
+
+#include "gprcpu.h"
+#include "gpr_cpu.h"
+#include "timer.h"
+#include "assembler.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+static_assert(sizeof(gpr_state) == 32, "gpr_state layout is part of the ABI");
+
+struct gpr_machine {
+    Bus bus;
+    GPRCPU cpu;
+    Timer timer;
+    bool hasTimer;
+    std::vector<uint16_t> image;        // What gpr_reset() returns memory to
+    std::vector<uint8_t> timerState;    // Timer as created
+    std::string error;
+
+    explicit gpr_machine(bool withTimer)
+        : cpu(bus), hasTimer(withTimer), image(MEMORY_SIZE, 0) {
+        if (hasTimer) {
+            bus.attachDevice(0, &timer);
+            timer.saveState(timerState);
+        }
+    }
+};
+
+static bool inRange(uint16_t addr, size_t count) { return count <= MEMORY_SIZE - addr; }
+
+/** Make the current memory the image, with nothing marked written. */
+static void adoptImage(gpr_machine* m) {
+    const uint16_t* mem = m->bus.getMemory();
+    std::copy(mem, mem + MEMORY_SIZE, m->image.begin());
+    m->bus.resetMemory(m->image.data());   // Clears the written marks; contents already match
+    gpr_reset(m);
+}
+
+extern "C" {
+
+uint32_t gpr_api_version(void) { return GPR_API_VERSION; }
+
+gpr_machine* gpr_create(uint32_t flags) {
+    try {
+        return new gpr_machine((flags & GPR_CREATE_TIMER) != 0);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void gpr_destroy(gpr_machine* m) { delete m; }
+
+const char* gpr_last_error(const gpr_machine* m) { return m ? m->error.c_str() : "null machine"; }
+
+int gpr_load_image(gpr_machine* m, const uint16_t* image, size_t count, uint16_t addr) {
+    if (!m || (!image && count)) return GPR_ERR_ARGUMENT;
+    if (!inRange(addr, count)) return GPR_ERR_RANGE;
+    m->bus.clearMemory();
+    if (count) std::copy(image, image + count, m->bus.getMemory() + addr);
+    adoptImage(m);
+    m->error.clear();
+    return GPR_OK;
+}
+
+int gpr_assemble(gpr_machine* m, const char* source) {
+    if (!m || !source) return GPR_ERR_ARGUMENT;
+    try {
+        m->bus.clearMemory();
+        AssembleResult ar = assemble(source, m->bus.getMemory(), MEMORY_SIZE);
+        if (!ar.ok) {
+            m->error = "line " + std::to_string(ar.lineNum) + ": " + ar.error;
+            m->bus.loadMemory(m->image.data());   // Leave the previous image in place
+            return GPR_ERR_ASSEMBLY;
+        }
+        adoptImage(m);
+    } catch (const std::bad_alloc&) {
+        m->bus.loadMemory(m->image.data());
+        return GPR_ERR_MEMORY;
+    } catch (const std::exception& e) {
+        m->error = e.what();
+        m->bus.loadMemory(m->image.data());
+        return GPR_ERR_ASSEMBLY;
+    }
+    m->error.clear();
+    return GPR_OK;
+}
+
+void gpr_reset(gpr_machine* m) {
+    if (!m) return;
+    m->cpu.reset();
+    m->bus.resetMemory(m->image.data());
+    if (m->hasTimer) m->timer.restoreState(m->timerState.data(), m->timerState.size());
+}
+
+int gpr_write(gpr_machine* m, uint16_t addr, const uint16_t* words, size_t count) {
+    if (!m || (!words && count)) return GPR_ERR_ARGUMENT;
+    if (!inRange(addr, count)) return GPR_ERR_RANGE;
+    m->bus.writeBlock(addr, words, count);
+    return GPR_OK;
+}
+
+int gpr_read(const gpr_machine* m, uint16_t addr, uint16_t* words, size_t count) {
+    if (!m || (!words && count)) return GPR_ERR_ARGUMENT;
+    if (!inRange(addr, count)) return GPR_ERR_RANGE;
+    const uint16_t* mem = m->bus.getMemory() + addr;
+    std::copy(mem, mem + count, words);
+    return GPR_OK;
+}
+
+const uint16_t* gpr_memory(const gpr_machine* m) { return m ? m->bus.getMemory() : nullptr; }
+
+void gpr_get_state(const gpr_machine* m, gpr_state* out) {
+    if (!m || !out) return;
+    const CPUState& s = m->cpu.getState();
+    *out = gpr_state();
+    std::copy(s.R, s.R + 8, out->r);
+    out->pc = s.PC;
+    out->flags = s.FLAGS;
+    out->sp = s.SP;
+    out->pending_irq = s.pendingIRQ;
+    out->halted = s.halted;
+    out->ie = s.IE;
+    out->waiting = s.waiting;
+}
+
+int gpr_set_state(gpr_machine* m, const gpr_state* in) {
+    if (!m || !in) return GPR_ERR_ARGUMENT;
+    CPUState s;
+    std::copy(in->r, in->r + 8, s.R);
+    s.PC = in->pc;
+    s.FLAGS = in->flags;
+    s.SP = in->sp;
+    s.pendingIRQ = in->pending_irq;
+    s.halted = in->halted != 0;
+    s.IE = in->ie != 0;
+    s.waiting = in->waiting != 0;
+    m->cpu.restoreState(s);
+    return GPR_OK;
+}
+
+int gpr_raise_interrupt(gpr_machine* m, unsigned line) {
+    if (!m || line > 15) return GPR_ERR_ARGUMENT;   // raiseInterrupt() would fold it onto line & 15
+    m->cpu.raiseInterrupt(line);
+    return GPR_OK;
+}
+
+int gpr_run(gpr_machine* m, uint64_t max_cycles, uint64_t* cycles) {
+    if (!m) return GPR_ERR_ARGUMENT;
+    size_t n = m->cpu.runFor(static_cast<size_t>(std::min<uint64_t>(max_cycles, SIZE_MAX)));
+    if (cycles) *cycles = n;
+    const CPUState& s = m->cpu.getState();
+    if (s.halted) return GPR_EXIT_HALT;
+    if (m->cpu.breakpointHit()) return GPR_EXIT_BREAK;
+    if (n < max_cycles && s.waiting) return GPR_EXIT_IDLE;
+    return GPR_EXIT_BUDGET;
+}
+
+int gpr_run_batch(gpr_batch_item* items, size_t count, unsigned threads) {
+    if (!items && count) return GPR_ERR_ARGUMENT;
+    for (size_t k = 0; k < count; ++k)
+        if (!items[k].machine) return GPR_ERR_ARGUMENT;
+
+    auto runOne = [items](size_t k) {
+        uint64_t cycles = 0;
+        items[k].exit = gpr_run(items[k].machine, items[k].max_cycles, &cycles);
+        items[k].cycles = cycles;
+    };
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads > count) threads = static_cast<unsigned>(count);
+
+    // The calling thread is one of the workers, so a batch still finishes
+    // if fewer threads than asked for can be started.
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t k; (k = next++) < count;) runOne(k);
+    };
+    std::vector<std::thread> pool;
+    try {
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    } catch (const std::exception&) {
+        // Carry on with the threads that did start
+    }
+    worker();
+    for (std::thread& th : pool) th.join();
+    return GPR_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,143 @@
+/**
+ * 16-bit GPR CPU Emulator - C API (libgprcpu)
+ * A stable C interface for embedding the emulator: no C++ types cross it,
+ * so any language with a C FFI can drive many machines in one process.
+ *
+ * Compatibility: GPR_API_VERSION changes only when an existing function or
+ * struct changes; the library's SONAME follows it. New functions may be
+ * added without a bump. Check gpr_api_version() at run time.
+ */
+
+#ifndef GPRCPU_H
+#define GPRCPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(GPRCPU_BUILD)
+#    define GPR_API __declspec(dllexport)
+#  else
+#    define GPR_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__) || defined(__clang__)
+#  define GPR_API __attribute__((visibility("default")))
+#else
+#  define GPR_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPR_API_VERSION 1
+#define GPR_MEMORY_WORDS 65536u
+
+/** One emulated machine: a CPU and its 64K-word memory. Opaque. */
+typedef struct gpr_machine gpr_machine;
+
+/** Status codes: 0 is success, errors are negative. */
+enum {
+    GPR_OK           = 0,
+    GPR_ERR_ARGUMENT = -1,   /* NULL pointer or bad value */
+    GPR_ERR_RANGE    = -2,   /* addr + count runs past 0xFFFF */
+    GPR_ERR_ASSEMBLY = -3,   /* see gpr_last_error() */
+    GPR_ERR_MEMORY   = -4    /* allocation failed */
+};
+
+/** Why gpr_run() returned. */
+typedef enum gpr_exit {
+    GPR_EXIT_HALT   = 0,     /* Executed HALT */
+    GPR_EXIT_BUDGET = 1,     /* Ran max_cycles without halting */
+    GPR_EXIT_BREAK  = 2,     /* Stopped on BRK; PC is left on it */
+    GPR_EXIT_IDLE   = 3      /* Asleep in WFI with no device event to wake it */
+} gpr_exit;
+
+/** Registers and status, with a fixed layout (32 bytes). */
+typedef struct gpr_state {
+    uint16_t r[8];
+    uint16_t pc;
+    uint16_t flags;          /* Bit 0 Z, bit 1 C, bit 2 N */
+    uint16_t sp;
+    uint16_t pending_irq;    /* Raised, not yet serviced IRQ lines */
+    uint8_t halted;
+    uint8_t ie;              /* Interrupts enabled */
+    uint8_t waiting;         /* In WFI */
+    uint8_t reserved[5];
+} gpr_state;
+
+/** Flags for gpr_create(). */
+#define GPR_CREATE_TIMER 1u  /* Attach the programmable timer at MMIO slot 0 (0xFF00), as the CLI does */
+
+GPR_API uint32_t gpr_api_version(void);
+
+/** New machine with zeroed memory and reset CPU; NULL if out of memory. */
+GPR_API gpr_machine* gpr_create(uint32_t flags);
+GPR_API void gpr_destroy(gpr_machine* m);
+
+/**
+ * Text of the machine's last error ("" if none). Valid until the next call
+ * on the machine.
+ */
+GPR_API const char* gpr_last_error(const gpr_machine* m);
+
+/**
+ * Zero memory, copy `count` words of `image` to `addr` and make that the
+ * machine's image: gpr_reset() returns to it. Resets the CPU.
+ */
+GPR_API int gpr_load_image(gpr_machine* m, const uint16_t* image, size_t count, uint16_t addr);
+
+/** Same as gpr_load_image() with the image assembled from .asm `source`. */
+GPR_API int gpr_assemble(gpr_machine* m, const char* source);
+
+/**
+ * Back to the loaded image: CPU reset, devices reset, and every page
+ * written since copied back from the image. Costs the pages a run wrote.
+ */
+GPR_API void gpr_reset(gpr_machine* m);
+
+/** Bulk copy into / out of memory at [addr, addr + count). Writes count for gpr_reset(). */
+GPR_API int gpr_write(gpr_machine* m, uint16_t addr, const uint16_t* words, size_t count);
+GPR_API int gpr_read(const gpr_machine* m, uint16_t addr, uint16_t* words, size_t count);
+
+/**
+ * Zero-copy view of all GPR_MEMORY_WORDS words of memory, valid until
+ * gpr_destroy(). Read it between runs (not during gpr_run_batch()); to
+ * change memory use gpr_write() so gpr_reset() sees the change.
+ */
+GPR_API const uint16_t* gpr_memory(const gpr_machine* m);
+
+GPR_API void gpr_get_state(const gpr_machine* m, gpr_state* out);
+GPR_API int gpr_set_state(gpr_machine* m, const gpr_state* in);
+
+/**
+ * Raise IRQ line 0-15; it is taken at the next slice boundary if enabled.
+ * Returns GPR_ERR_ARGUMENT, raising nothing, for any other line.
+ */
+GPR_API int gpr_raise_interrupt(gpr_machine* m, unsigned line);
+
+/**
+ * Run for at most `max_cycles` cycles. `cycles` (may be NULL) receives the
+ * cycles that elapsed. Returns a gpr_exit, or a negative status.
+ */
+GPR_API int gpr_run(gpr_machine* m, uint64_t max_cycles, uint64_t* cycles);
+
+/** One machine's part of a batch. */
+typedef struct gpr_batch_item {
+    gpr_machine* machine;    /* Each machine at most once per batch */
+    uint64_t max_cycles;
+    uint64_t cycles;         /* Out */
+    int32_t exit;            /* Out: gpr_run()'s return value */
+} gpr_batch_item;
+
+/**
+ * Run every item's machine, spread over `threads` host threads (0 = one per
+ * CPU, capped at `count`). Returns once all are done.
+ */
+GPR_API int gpr_run_batch(gpr_batch_item* items, size_t count, unsigned threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPRCPU_H */
@@ -1,40 +1,504 @@
 /**
  * 16-bit GPR CPU Emulator - Load and run .asm programs
  *
- * Usage: gpr_emulator [program.asm]
+ * Usage: gpr_emulator [--timing] [--cache] [--branch=KIND] [--cores=N [--quantum=Q] [--pin]]
+ *                    [--gdb=PORT|--gdb=unix:PATH]
+ *                    [--save=FILE] [--resume=FILE] [--cfg[=dot]] [--aot=LIB] [--opt]
+ *                    [--obj=FILE] [--link=OBJ[,OBJ...]] [--map=FILE] [--profile[=N]]
+ *                    [--coverage[=FILE]] [--lcov=FILE] [--coverage-json=FILE]
+ *                    [--fuzz=DIR [--fuzz-region=ADDR:WORDS[,...]] [--fuzz-time=S]
+ *                     [--fuzz-cycles=N] [--fuzz-crash=WHERE[,...]]]
+ *                    [--serve=PATH [--workers=N]] [--asm-cache=DIR]
+ *                    [program.asm|program.o]
  * If no file given, runs program.asm in current directory.
  * Trace is enabled by default.
+ *   --timing   Report 5-stage pipeline cycles, stalls and CPI after HALT
+ *   --cache    Report L1I/L1D hit and miss rates per PC and region after HALT
+ *   --branch=KIND  Simulate a branch predictor (static, bimodal, gshare, tage);
+ *                  with --timing its mispredictions drive the branch penalty
+ *   --cores=N  Run N cores in SMP mode, one host thread each (no trace,
+ *              no timer, analysis flags ignored)
+ *   --quantum=Q  With --cores: deterministic SMP, synchronizing every Q cycles
+ *   --pin      With --cores: pin each core's host thread to its own CPU
+ *   --gdb=PORT   Wait for a GDB connection on 127.0.0.1:PORT (or a Unix socket
+ *                with --gdb=unix:PATH) instead of running straight through
+ *   --save=FILE  Write a snapshot when the run ends or on SIGINT/SIGTERM
+ *   --resume=FILE  Continue from a snapshot instead of assembling a program
+ *   --cfg      Print the program's control-flow graph and analysis, then exit
+ *              (--cfg=dot prints it as a Graphviz digraph)
+ *   --aot=LIB  Run natively from shared library LIB, compiling the program
+ *              into it first unless LIB already matches (no trace)
+ *   --opt      Run the assembler's peephole optimizer and report what it saved
+ *   --obj=FILE   Assemble the program into relocatable object FILE, then exit
+ *   --link=OBJ[,OBJ...]  Link these objects after the program (which may
+ *                itself be an object file) before running
+ *   --map=FILE   Write the address -> source line and label map to FILE
+ *   --profile[=N]  Report the N (default 10) labels and source lines with the
+ *                most pipeline cycles after HALT
+ *   --coverage[=FILE]  Record executed words and JZ outcomes and report them
+ *                after HALT; with FILE, merge this run into FILE's bitmaps
+ *   --lcov=FILE  Write the (merged) coverage as an lcov tracefile
+ *   --coverage-json=FILE  Write the (merged) coverage as JSON
+ *   --fuzz=DIR   Fuzz the input region instead of prompting, writing
+ *                corpus/, crashes/ and hangs/ under DIR
+ *   --fuzz-region=ADDR:WORDS[,...]  Words to fuzz (default 0x100:2)
+ *   --fuzz-time=S  Seconds to fuzz (default 10)
+ *   --fuzz-cycles=N  Cycles after which a run counts as a hang (default 100000)
+ *   --fuzz-crash=WHERE[,...]  Labels, file:line or addresses that count as
+ *                a crash when reached (BRK always does)
+ *   --serve=PATH  Run as a job server on Unix socket PATH until SIGINT/SIGTERM
+ *                 (no program is loaded; clients send their own)
+ *   --workers=N  With --serve: worker threads (default one per CPU)
+ *   --asm-cache=DIR  Reuse assembled programs from DIR, keyed by source and
+ *                options (default: $GPR_ASM_CACHE if set)
  */
 
 #include "gpr_cpu.h"
+#include "timer.h"
+#include "pipeline_timing.h"
+#include "cache_sim.h"
+#include "branch_predictor.h"
+#include "smp.h"
+#include "gdb_stub.h"
+#include "snapshot.h"
+#include "cfg.h"
+#include "aot.h"
 #include "assembler.h"
+#include "debug_map.h"
+#include "coverage.h"
+#include "fuzzer.h"
+#include "job_server.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <iomanip>
 
+/** Parse all of `text` as a number (decimal or 0x...) no larger than `max`. */
+static bool parseNumber(const std::string& text, unsigned long max, unsigned long& value) {
+    if (text.empty() || text[0] == '-' || text[0] == '+' || std::isspace(static_cast<unsigned char>(text[0])))
+        return false;
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoul(text.c_str(), &end, 0);
+    return errno == 0 && *end == '\0' && value <= max;
+}
+
+/**
+ * Parse the N of option `arg` ("--name=N", N at arg + prefix) as a number
+ * from `min` to `max`. Otherwise print a usage error saying what was
+ * `expected` and return false.
+ */
+static bool parseOption(const char* arg, size_t prefix, unsigned long min, unsigned long max, const char* expected,
+                        unsigned long& value) {
+    if (parseNumber(arg + prefix, max, value) && value >= min)
+        return true;
+    std::cerr << "Bad " << std::string(arg, prefix - 1) << " " << arg + prefix << " (expected " << expected << ")\n";
+    return false;
+}
+
+/** Cycles between checks for a stop signal when --save is given. */
+static constexpr size_t CHECKPOINT_CHUNK = 1u << 20;
+
+static volatile std::sig_atomic_t stopSignal = 0;
+
+static void onStopSignal(int) { stopSignal = 1; }
+
+static JobServer* activeServer = nullptr;
+
+static void onServeSignal(int) {
+    if (activeServer) activeServer->stop();
+}
+
+/**
+ * Assemble or load `program` as an object, then link it with the objects in
+ * the comma-separated `libraries` into `mem`.
+ */
+static AssembleResult linkProgram(const char* program, const std::string& libraries,
+                                  const AssembleOptions& options, uint16_t* mem) {
+
+    std::vector<ObjectFile> objects(1);
+    AssembleResult ar = isObjectFile(program) ? loadObject(program, objects[0])
+                                              : assembleObjectFile(program, objects[0], options);
+    if (!ar.ok) return ar;
+    for (size_t pos = 0; pos < libraries.size();) {
+        size_t comma = std::min(libraries.find(',', pos), libraries.size());
+        objects.emplace_back();
+        AssembleResult lr = loadObject(libraries.substr(pos, comma - pos).c_str(), objects.back());
+        if (!lr.ok) return lr;
+        pos = comma + 1;
+    }
+    std::vector<const ObjectFile*> parts;
+    for (const ObjectFile& o : objects) parts.push_back(&o);
+    auto t0 = std::chrono::steady_clock::now();
+    LinkOptions linkOptions;
+    linkOptions.debugMap = options.debugMap;
+    AssembleResult lr = link(parts, mem, MEMORY_SIZE, linkOptions);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    if (!lr.ok) return lr;
+    std::cout << "Linked " << objects.size() << " objects in " << us << " us\n";
+    lr.report = ar.report;
+    return lr;
+}
+
 static void printTraceHeader() {
     std::cout << "\n  PC    | R0    R1    R2    R3    R4    R5    R6    R7    | Z C N | Instruction\n";
     std::cout << "--------+--------------------------------------------------+-------+----------------\n";
 }
 
+/**
+ * Count the run just finished, merge it into `path` (if given and present),
+ * save it back and write the requested exports and report.
+ */
+static bool writeCoverage(Coverage& coverage, const char* path, const char* lcovPath, const char* jsonPath,
+                          const DebugMap& map, const uint16_t* image) {
+    coverage.countRun();
+    if (path) {
+        Coverage previous;
+        std::ifstream exists(path);
+        if (exists) {
+            CoverageResult cr = previous.load(path);
+            if (!cr.ok) {
+                std::cerr << "Coverage: " << cr.error << "\n";
+                return false;
+            }
+            coverage.merge(previous);
+        }
+        CoverageResult cr = coverage.save(path);
+        if (!cr.ok) {
+            std::cerr << "Coverage: " << cr.error << "\n";
+            return false;
+        }
+    }
+    coverage.printReport(std::cout, &map, image);
+    if (lcovPath) {
+        std::ofstream out(lcovPath);
+        coverage.writeLcov(out, map, image);
+        if (!out) {
+            std::cerr << "Cannot write " << lcovPath << "\n";
+            return false;
+        }
+    }
+    if (jsonPath) {
+        std::ofstream out(jsonPath);
+        coverage.writeJson(out, &map, image);
+        if (!out) {
+            std::cerr << "Cannot write " << jsonPath << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Split "a,b,c" into its parts. */
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> parts;
+    for (size_t pos = 0; pos < list.size();) {
+        size_t comma = std::min(list.find(',', pos), list.size());
+        parts.push_back(list.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return parts;
+}
+
+/** Parse all of `text` as a finite number of seconds above zero. */
+static bool parseSeconds(const std::string& text, double& value) {
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0])))
+        return false;
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtod(text.c_str(), &end);
+    return errno == 0 && *end == '\0' && std::isfinite(value) && value > 0;
+}
+
+/** --fuzz: fuzz the loaded program from its current state and report what was found. */
+static int runFuzzer(GPRCPU& cpu, Bus& bus, const char* dir, FuzzOptions options, const std::string& regions,
+                     const std::string& crashes, const DebugMap& map) {
+    for (const std::string& r : splitList(regions)) {
+        // The region must lie inside memory, and WORDS must fit FuzzRegion's 16 bits.
+        size_t colon = r.find(':');
+        unsigned long addr = 0, words = 0;
+        if (colon == std::string::npos || !parseNumber(r.substr(0, colon), MEMORY_SIZE - 1, addr) ||
+            !parseNumber(r.substr(colon + 1), std::min<unsigned long>(MEMORY_SIZE - addr, 0xFFFF), words) || words == 0) {
+            std::cerr << "Bad --fuzz-region " << r << " (expected ADDR:WORDS inside 0x0000-0xFFFF)\n";
+            return 1;
+        }
+        options.regions.push_back(FuzzRegion{static_cast<uint16_t>(addr), static_cast<uint16_t>(words)});
+    }
+    options.outDir = dir;
+    cpu.trace(false);
+    Fuzzer fuzzer(cpu, bus, options);
+    for (const std::string& where : splitList(crashes)) {
+        uint16_t pc;
+        if (!map.resolve(where, pc)) {
+            std::cerr << "Unknown --fuzz-crash location: " << where << "\n";
+            return 1;
+        }
+        fuzzer.addCrashAddress(pc);
+    }
+    size_t seeds = fuzzer.loadSeeds();
+    std::cout << "Fuzzing " << fuzzer.inputWords() << " input words into " << dir << " (" << seeds
+              << " seeds)\n";
+    FuzzStats stats = fuzzer.run(&std::cout);
+    if (!fuzzer.lastError().empty()) {
+        std::cerr << "Fuzzer: " << fuzzer.lastError() << "\n";
+        return 1;
+    }
+    std::cout << "Done: " << stats.execs << " execs in " << std::fixed << std::setprecision(1) << stats.seconds
+              << " s (" << std::setprecision(0) << stats.execsPerSecond() << "/s), corpus " << stats.corpus
+              << ", edges " << stats.edges << ", crashes " << stats.crashes << ", hangs " << stats.hangs << "\n";
+    return 0;
+}
+
+/** --serve: run jobs from clients until SIGINT/SIGTERM, then report totals. */
+static int runServer(const char* path, unsigned workers) {
+    JobServer server(workers);
+    if (!server.listen(path)) {
+        std::cerr << "Cannot listen on " << path << ": " << server.lastError() << "\n";
+        return 1;
+    }
+    activeServer = &server;
+    std::signal(SIGINT, onServeSignal);
+    std::signal(SIGTERM, onServeSignal);
+    std::cout << "Serving jobs on " << path << " with " << server.workerCount() << " workers" << std::endl;
+    bool ok = server.serve();
+    activeServer = nullptr;
+    if (!ok) {
+        std::cerr << "Job server: " << server.lastError() << "\n";
+        return 1;
+    }
+    JobServerStats stats = server.stats();
+    std::cout << "Served " << stats.jobs << " jobs over " << stats.connections << " connections (program cache: "
+              << stats.cacheHits << " hits, " << stats.cacheMisses << " misses)\n";
+    return 0;
+}
+
 int main(int argc, char** argv) {
     const char* asmPath = "addition.asm";
-    if (argc >= 2)
-        asmPath = argv[1];
-
-    Bus bus;
-    GPRCPU cpu(bus);
+    bool timingReport = false;
+    bool cacheReport = false;
+    std::string predictorName;
+    unsigned cores = 1;
+    size_t quantum = 0;
+    bool pinThreads = false;
+    std::string gdbTarget;
+    uint16_t gdbPort = 0;
+    const char* savePath = nullptr;
+    const char* resumePath = nullptr;
+    std::string cfgMode;
+    const char* aotPath = nullptr;
+    AssembleOptions asmOptions;
+    const char* objPath = nullptr;
+    std::string linkPaths;
+    const char* mapPath = nullptr;
+    size_t profileTop = 0;
+    bool coverageReport = false;
+    const char* coveragePath = nullptr;
+    const char* lcovPath = nullptr;
+    const char* coverageJsonPath = nullptr;
+    const char* fuzzDir = nullptr;
+    FuzzOptions fuzzOptions;
+    std::string fuzzRegions;
+    std::string fuzzCrash;
+    const char* servePath = nullptr;
+    unsigned serveWorkers = 0;
+    DebugMap debugMap;
+    asmOptions.debugMap = &debugMap;
+    if (const char* cacheDir = std::getenv("GPR_ASM_CACHE"))
+        asmOptions.cacheDir = cacheDir;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--timing") == 0)
+            timingReport = true;
+        else if (std::strcmp(argv[i], "--cache") == 0)
+            cacheReport = true;
+        else if (std::strncmp(argv[i], "--branch=", 9) == 0)
+            predictorName = argv[i] + 9;
+        else if (std::strncmp(argv[i], "--cores=", 8) == 0) {
+            unsigned long n = 0;
+            cores = parseNumber(argv[i] + 8, SMP_MAX_CORES, n) ? static_cast<unsigned>(n) : 0;   // 0: refused below
+        }
+        else if (std::strncmp(argv[i], "--quantum=", 10) == 0) {
+            unsigned long n = 0;
+            if (!parseOption(argv[i], 10, 1, ULONG_MAX, "a cycle count of 1 or more", n))
+                return 1;
+            quantum = n;
+        }
+        else if (std::strcmp(argv[i], "--pin") == 0)
+            pinThreads = true;
+        else if (std::strncmp(argv[i], "--gdb=", 6) == 0) {
+            gdbTarget = argv[i] + 6;
+            unsigned long port = 0;
+            if (gdbTarget.compare(0, 5, "unix:") != 0 &&
+                !parseOption(argv[i], 6, 1, 65535, "a TCP port 1-65535 or unix:PATH", port))
+                return 1;
+            gdbPort = static_cast<uint16_t>(port);
+        }
+        else if (std::strncmp(argv[i], "--save=", 7) == 0)
+            savePath = argv[i] + 7;
+        else if (std::strncmp(argv[i], "--resume=", 9) == 0)
+            resumePath = argv[i] + 9;
+        else if (std::strcmp(argv[i], "--cfg") == 0)
+            cfgMode = "text";
+        else if (std::strncmp(argv[i], "--cfg=", 6) == 0)
+            cfgMode = argv[i] + 6;
+        else if (std::strncmp(argv[i], "--aot=", 6) == 0)
+            aotPath = argv[i] + 6;
+        else if (std::strcmp(argv[i], "--opt") == 0)
+            asmOptions.optimize = true;
+        else if (std::strncmp(argv[i], "--obj=", 6) == 0)
+            objPath = argv[i] + 6;
+        else if (std::strncmp(argv[i], "--link=", 7) == 0)
+            linkPaths = argv[i] + 7;
+        else if (std::strncmp(argv[i], "--map=", 6) == 0)
+            mapPath = argv[i] + 6;
+        else if (std::strcmp(argv[i], "--profile") == 0)
+            profileTop = 10;
+        else if (std::strncmp(argv[i], "--profile=", 10) == 0) {
+            unsigned long n = 0;
+            if (!parseOption(argv[i], 10, 1, MEMORY_SIZE, "a count of 1-65536", n))
+                return 1;
+            profileTop = n;
+        }
+        else if (std::strcmp(argv[i], "--coverage") == 0)
+            coverageReport = true;
+        else if (std::strncmp(argv[i], "--coverage=", 11) == 0)
+            coveragePath = argv[i] + 11;
+        else if (std::strncmp(argv[i], "--lcov=", 7) == 0)
+            lcovPath = argv[i] + 7;
+        else if (std::strncmp(argv[i], "--coverage-json=", 16) == 0)
+            coverageJsonPath = argv[i] + 16;
+        else if (std::strncmp(argv[i], "--fuzz=", 7) == 0)
+            fuzzDir = argv[i] + 7;
+        else if (std::strncmp(argv[i], "--fuzz-region=", 14) == 0)
+            fuzzRegions = argv[i] + 14;
+        else if (std::strncmp(argv[i], "--fuzz-time=", 12) == 0) {
+            if (!parseSeconds(argv[i] + 12, fuzzOptions.seconds)) {
+                std::cerr << "Bad --fuzz-time " << argv[i] + 12 << " (expected seconds above 0)\n";
+                return 1;
+            }
+        } else if (std::strncmp(argv[i], "--fuzz-cycles=", 14) == 0) {
+            unsigned long n = 0;
+            if (!parseOption(argv[i], 14, 1, ULONG_MAX, "a cycle count of 1 or more", n))
+                return 1;
+            fuzzOptions.cycleLimit = n;
+        }
+        else if (std::strncmp(argv[i], "--fuzz-crash=", 13) == 0)
+            fuzzCrash = argv[i] + 13;
+        else if (std::strncmp(argv[i], "--serve=", 8) == 0)
+            servePath = argv[i] + 8;
+        else if (std::strncmp(argv[i], "--workers=", 10) == 0) {
+            unsigned long n = 0;
+            if (!parseOption(argv[i], 10, 0, 1024, "0 (one per CPU) to 1024 threads", n))
+                return 1;
+            serveWorkers = static_cast<unsigned>(n);
+        }
+        else if (std::strncmp(argv[i], "--asm-cache=", 12) == 0)
+            asmOptions.cacheDir = argv[i] + 12;
+        else
+            asmPath = argv[i];
+    }
+    if (servePath)
+        return runServer(servePath, serveWorkers);
 
-    AssembleResult ar = assembleFile(asmPath, bus.getMemory(), MEMORY_SIZE);
-    if (!ar.ok) {
-        std::cerr << "Assembly error at line " << ar.lineNum << ": " << ar.error << "\n";
+    if (cores == 0 || cores > SMP_MAX_CORES) {
+        std::cerr << "--cores must be 1-" << SMP_MAX_CORES << " (each core needs its own " << SMP_STACK_WORDS
+                  << "-word stack in 0x" << std::hex << SMP_STACK_FLOOR << "-0x" << STACK_TOP - 1 << std::dec << ")\n";
         return 1;
     }
 
-    // Optional: place operands at 0x100 and 0x101 for math programs
-    std::cout << "Operand A at 0x100 (decimal or 0x...): ";
+    std::unique_ptr<BranchSim> branches;
+    if (!predictorName.empty()) {
+        std::unique_ptr<BranchPredictor> predictor = makeBranchPredictor(predictorName);
+        if (!predictor) {
+            std::cerr << "Unknown branch predictor: " << predictorName << " (static, bimodal, gshare, tage)\n";
+            return 1;
+        }
+        branches.reset(new BranchSim(std::move(predictor)));
+    }
+
+    Bus bus;
+    GPRCPU cpu(bus);
+    Timer timer;                 // MMIO slot 0 (0xFF00), raises IRQ line 0
+    bus.attachDevice(0, &timer);
+
+    uint64_t startCycles = 0;
     std::string sa;
-    std::getline(std::cin, sa);
+    if (resumePath) {
+        SnapshotResult sr = loadSnapshot(resumePath, cpu, bus);
+        if (!sr.ok) {
+            std::cerr << "Cannot resume from " << resumePath << ": " << sr.error << "\n";
+            return 1;
+        }
+        startCycles = sr.cycles;
+        asmPath = resumePath;
+        std::cout << "Resumed from " << resumePath << " at cycle " << startCycles << "\n";
+    } else if (objPath) {
+        ObjectFile object;
+        AssembleResult ar = assembleObjectFile(asmPath, object, asmOptions);
+        if (ar.ok) ar = saveObject(objPath, object);
+        if (!ar.ok) {
+            std::cerr << "Assembly error at line " << ar.lineNum << ": " << ar.error << "\n";
+            return 1;
+        }
+        std::cout << "Wrote " << objPath << " (" << object.items.size() << " items, " << object.symbols.size()
+                  << " symbols, " << object.relocations.size() << " relocations)\n";
+        return 0;
+    } else {
+        AssembleResult ar = linkPaths.empty() && !isObjectFile(asmPath)
+                                ? assembleFile(asmPath, bus.getMemory(), MEMORY_SIZE, asmOptions)
+                                : linkProgram(asmPath, linkPaths, asmOptions, bus.getMemory());
+        if (!ar.ok) {
+            std::cerr << "Assembly error at line " << ar.lineNum << ": " << ar.error << "\n";
+            return 1;
+        }
+        if (asmOptions.optimize) {
+            const OptimizeReport& r = ar.report;
+            std::cout << "Optimizer: " << r.wordsBefore << " -> " << r.wordsAfter << " words ("
+                      << r.loadsRemoved << " loads, " << r.movesRemoved << " moves, "
+                      << r.jumpsThreaded << " jumps threaded, " << r.jumpsRemoved << " jump words, "
+                      << r.unreachableRemoved << " unreachable)\n";
+        }
+
+        if (mapPath) {
+            std::ofstream mapFile(mapPath);
+            debugMap.write(mapFile);
+            if (!mapFile) {
+                std::cerr << "Cannot write " << mapPath << "\n";
+                return 1;
+            }
+        }
+
+        if (!cfgMode.empty()) {
+            auto t0 = std::chrono::steady_clock::now();
+            ProgramCFG cfg = buildCFG(bus.getMemory(), defaultEntries(bus.getMemory()));
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+            if (cfgMode == "dot") {
+                dumpCFGDot(cfg, bus.getMemory(), std::cout);
+            } else {
+                std::cout << "Program: " << asmPath << " (analyzed in " << us << " us)\n";
+                dumpCFG(cfg, bus.getMemory(), std::cout);
+            }
+            return 0;
+        }
+
+        // Optional: place operands at 0x100 and 0x101 for math programs
+        if (!fuzzDir) {
+            std::cout << "Operand A at 0x100 (decimal or 0x...): ";
+            std::getline(std::cin, sa);
+        }
+    }
+    if (fuzzDir)
+        return runFuzzer(cpu, bus, fuzzDir, fuzzOptions, fuzzRegions, fuzzCrash, debugMap);
     if (!sa.empty()) {
         uint16_t a = static_cast<uint16_t>(std::stoul(sa, nullptr, 0));
         bus.write(0x100, a);
@@ -47,21 +511,140 @@ int main(int argc, char** argv) {
         }
     }
 
-    cpu.trace(true);
+    if (cores > 1) {
+        // SMP: devices and probes are not thread-safe, so run bare cores.
+        bus.attachDevice(0, nullptr);
+        std::vector<uint16_t> r0;
+        std::vector<size_t> perCore;
+        std::cout << "\n=== 16-bit GPR CPU Emulator (SMP, " << cores << " cores"
+                  << (quantum ? ", deterministic" : "") << ") ===\n";
+        std::cout << "Program: " << asmPath << "\n";
+        if (quantum) {
+            DeterministicSMP smp(bus, cores, quantum);
+            smp.setPinThreads(pinThreads);
+            perCore = smp.run();
+            for (unsigned i = 0; i < smp.numCores(); ++i) r0.push_back(smp.core(i).getState().R[0]);
+            std::cout << "Quanta: " << smp.quantaRun() << " of " << quantum << " cycles\n";
+        } else {
+            SMPMachine smp(bus, cores);
+            smp.setPinThreads(pinThreads);
+            perCore = smp.run();
+            for (unsigned i = 0; i < smp.numCores(); ++i) r0.push_back(smp.core(i).getState().R[0]);
+        }
+        std::cout << "\n--- HALTED ---\n";
+        for (unsigned i = 0; i < cores; ++i)
+            std::cout << "Core " << i << ": " << perCore[i] << " cycles, R0 = " << r0[i] << "\n";
+        uint16_t result = bus.read(0x102);
+        std::cout << "Result at 0x102: " << result << " (0x" << std::hex << std::setw(4) << std::setfill('0') << result << std::dec << ")\n";
+        return 0;
+    }
+
+    if (!gdbTarget.empty()) {
+        GdbStub stub(cpu, bus);
+        bool listening = gdbTarget.compare(0, 5, "unix:") == 0
+            ? stub.listenUnix(gdbTarget.substr(5))
+            : stub.listenTcp(gdbPort);
+        if (!listening) {
+            std::cerr << "GDB stub: " << stub.lastError() << "\n";
+            return 1;
+        }
+        std::cout << "Waiting for GDB on " << gdbTarget << " (target remote ...)\n";
+        if (!stub.serve()) {
+            std::cerr << "GDB stub: " << stub.lastError() << "\n";
+            return 1;
+        }
+        std::cout << "GDB detached. R0 = " << cpu.getState().R[0] << ", PC = " << cpu.getState().PC << "\n";
+        return 0;
+    }
+
+    AotProgram aot;
+    if (aotPath) {
+        // Reuse the library if it was built from this exact code.
+        if (!aot.load(aotPath) || !aot.matches(bus.getMemory())) {
+            auto t0 = std::chrono::steady_clock::now();
+            AotResult result = compileAot(bus.getMemory(), aotPath);
+            if (!result.ok || !aot.load(aotPath)) {
+                std::cerr << "AOT: " << (result.ok ? aot.lastError() : result.error) << "\n";
+                return 1;
+            }
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+            std::cout << "AOT: compiled " << aot.codeWords() << " words into " << aotPath << " in " << ms << " ms\n";
+        } else {
+            std::cout << "AOT: reusing " << aotPath << " (" << aot.codeWords() << " words)\n";
+        }
+        cpu.setCompiledCode(&aot);
+    }
+
+    cpu.trace(!aotPath);   // The trace would force the interpreter
+    cpu.setDebugMap(&debugMap);
+
+    PipelineTiming timing(bus);
+    if (timingReport || profileTop) {
+        timing.setBranchSim(branches.get());   // Timing drives the predictor when both are on
+        cpu.addFlowListener(&timing);
+    } else if (branches) {
+        cpu.addFlowListener(branches.get());
+    }
+
+    CacheSim caches;
+    if (cacheReport)
+        bus.setProbe(&caches);
+
+    Coverage coverage;
+    bool coverageOn = coverageReport || coveragePath || lcovPath || coverageJsonPath;
+    std::vector<uint16_t> image;   // The program as loaded, for finding JZs that never ran
+    if (coverageOn) {
+        image.assign(bus.getMemory(), bus.getMemory() + MEMORY_SIZE);
+        cpu.addFlowListener(&coverage);
+    }
 
     std::cout << "\n=== 16-bit GPR CPU Emulator ===\n";
     std::cout << "Program: " << asmPath << "\n";
-    printTraceHeader();
+    if (!aotPath)
+        printTraceHeader();
+
+    uint64_t cycles = startCycles;
+    if (!savePath) {
+        cycles += cpu.run();
+    } else {
+        // Run in chunks so SIGINT/SIGTERM can end the run at an instruction
+        // boundary and the snapshot below captures a consistent machine.
+        std::signal(SIGINT, onStopSignal);
+        std::signal(SIGTERM, onStopSignal);
+        for (;;) {
+            size_t n = cpu.runFor(CHECKPOINT_CHUNK);
+            cycles += n;
+            if (cpu.getState().halted || n < CHECKPOINT_CHUNK || stopSignal)
+                break;
+        }
+    }
+    bus.setProbe(nullptr);   // Keep the result printout below out of the cache stats
 
-    size_t cycles = 0;
-    while (cpu.step())
-        cycles++;
+    if (savePath) {
+        SnapshotResult sr = saveSnapshot(savePath, cpu, bus, cycles);
+        if (!sr.ok) {
+            std::cerr << "Snapshot failed: " << sr.error << "\n";
+            return 1;
+        }
+        std::cout << "\nSnapshot saved to " << savePath << " at cycle " << cycles << "\n";
+    }
 
-    std::cout << "\n--- HALTED ---\n";
+    std::cout << (cpu.getState().halted ? "\n--- HALTED ---\n" : "\n--- STOPPED ---\n");
     std::cout << "Total cycles: " << cycles << "\n";
     std::cout << "R0: " << cpu.getState().R[0] << " (0x" << std::hex << std::setw(4) << std::setfill('0') << cpu.getState().R[0] << std::dec << ")\n";
     uint16_t result = bus.read(0x102);
     std::cout << "Result at 0x102: " << std::dec << result << " (0x" << std::hex << std::setw(4) << std::setfill('0') << result << std::dec << ")\n";
 
+    if (timingReport)
+        timing.printReport(std::cout);
+    if (profileTop)
+        timing.printProfile(std::cout, &debugMap, profileTop);
+    if (cacheReport)
+        caches.printReport(std::cout, 10, &debugMap);
+    if (branches)
+        branches->printReport(std::cout, 10, &debugMap);
+    if (coverageOn && !writeCoverage(coverage, coveragePath, lcovPath, coverageJsonPath, debugMap, image.data()))
+        return 1;
+
     return 0;
 }
@@ -0,0 +1,188 @@
+/**
+ * AOT recompiler: compiled runs match the interpreter in cycles, registers
+ * and memory, including code rewritten by STORE and by CAS; paths are not
+ * run by a shell, and breakpoints stop runs with compiled code attached.
+ */
+
+#include "test_util.h"
+#include "aot.h"
+#include "debugger.h"
+#include "timer.h"
+#include <cstdio>
+#include <vector>
+
+#ifndef _WIN32
+
+// Timer interrupts every 50 cycles while a loop calls a routine that fills memory.
+// MOVI reaches only 0-511, so the vector and MMIO addresses are built with NOT.
+static const char* MIXED_PROGRAM =
+    "MOVI R1, handler\n"
+    "MOVI R2, 0x10F\n"
+    "NOT R2\n"
+    "STORE R1, (R2)\n"
+    "MOVI R2, 0xFE\n"
+    "NOT R2\n"
+    "MOVI R1, 50\n"
+    "STORE R1, (R2)\n"
+    "MOVI R2, 0xFF\n"
+    "NOT R2\n"
+    "MOVI R1, 7\n"
+    "STORE R1, (R2)\n"
+    "MOVI R5, 1\n"
+    "MOVI R6, 0x180\n"
+    "MOVI R4, 40\n"
+    "EI\n"
+    "loop:\n"
+    "CALL put\n"
+    "SUB R4, R5\n"
+    "JZ done\n"
+    "JMP loop\n"
+    "done:\n"
+    "DI\n"
+    "HALT\n"
+    "put:\n"
+    "MOV R3, R4\n"
+    "SHL R3\n"
+    "ADD R3, R0\n"
+    "STORE R3, (R6)\n"
+    "ADD R6, R5\n"
+    "RET\n"
+    "handler:\n"
+    "PUSH R2\n"
+    "ADD R0, R5\n"
+    "MOVI R2, 0xFB\n"
+    "NOT R2\n"
+    "STORE R5, (R2)\n"
+    "POP R2\n"
+    "RETI\n";
+
+// A STORE replaces "MOVI R0, 1" at PATCH with "MOVI R0, 2" before it runs.
+static const char* STORE_PATCH_PROGRAM =
+    "MOVI R6, patch\n"
+    "MOVI R5, alt\n"
+    "LOAD R2, (R5)\n"
+    "STORE R2, (R6)\n"
+    "patch:\n"
+    "MOVI R0, 1\n"
+    "HALT\n"
+    "alt:\n"
+    "MOVI R0, 2\n";
+
+// The same patch made by CAS, which the compiled code leaves to the interpreter.
+static const char* CAS_PATCH_PROGRAM =
+    "MOVI R6, patch\n"
+    "LOAD R1, (R6)\n"
+    "MOVI R5, alt\n"
+    "LOAD R2, (R5)\n"
+    "CAS R1, (R6), R2\n"
+    "patch:\n"
+    "MOVI R0, 1\n"
+    "HALT\n"
+    "alt:\n"
+    "MOVI R0, 2\n";
+
+struct Run {
+    size_t cycles = 0;
+    CPUState state{};
+    std::vector<uint16_t> memory;
+};
+
+static Run runProgram(const char* source, AotProgram* program) {
+    Run run;
+    Bus bus;
+    Timer timer;
+    bus.attachDevice(0, &timer);
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, source)) return run;
+    if (program) cpu.setCompiledCode(program);
+    run.cycles = runToHalt(cpu);
+    run.state = cpu.getState();
+    run.memory.assign(bus.getMemory(), bus.getMemory() + MMIO_BASE);
+    return run;
+}
+
+static void checkAgainstInterpreter(const char* source, const std::string& name, uint16_t expectR0) {
+    std::vector<uint16_t> image(MEMORY_SIZE, 0);
+    CHECK(assemble(source, image.data(), MEMORY_SIZE).ok);
+    const std::string so = tempPath(name);
+    AotResult built = compileAot(image.data(), so);
+    if (!built.ok) std::fprintf(stderr, "compileAot: %s\n", built.error.c_str());
+    CHECK(built.ok);
+    AotProgram program;
+    CHECK(program.load(so));
+    CHECK(program.codeWords() > 0);
+    CHECK(program.matches(image.data()));
+
+    Run interpreted = runProgram(source, nullptr);
+    Run compiled = runProgram(source, &program);
+    CHECK_EQ(interpreted.state.R[0], expectR0);
+    CHECK_EQ(compiled.cycles, interpreted.cycles);
+    for (unsigned r = 0; r < 8; ++r) CHECK_EQ(compiled.state.R[r], interpreted.state.R[r]);
+    CHECK_EQ(compiled.state.PC, interpreted.state.PC);
+    CHECK_EQ(compiled.state.FLAGS, interpreted.state.FLAGS);
+    CHECK(compiled.memory == interpreted.memory);
+    CHECK(!std::filesystem::exists(so + ".cpp"));   // Removed after the build
+    std::remove(so.c_str());
+}
+
+/** Quotes, command substitution and spaces in the path reach the compiler as plain text. */
+static void checkPathNotRunByShell() {
+    std::vector<uint16_t> image(MEMORY_SIZE, 0);
+    CHECK(assemble(STORE_PATCH_PROGRAM, image.data(), MEMORY_SIZE).ok);
+    const std::string so = tempPath("gpr test \"aot\" $(touch gpr_aot_shell) `touch gpr_aot_shell`.so");
+    AotResult built = compileAot(image.data(), so);
+    if (!built.ok) std::fprintf(stderr, "compileAot: %s\n", built.error.c_str());
+    CHECK(built.ok);
+    AotProgram program;
+    CHECK(program.load(so));
+    CHECK(!std::filesystem::exists("gpr_aot_shell"));
+    CHECK(!std::filesystem::exists(tempPath("gpr_aot_shell")));
+    std::remove(so.c_str());
+}
+
+/** A breakpoint still stops a run with compiled code attached, and the cycles match. */
+static void checkBreakpointWithCompiledCode() {
+    std::vector<uint16_t> image(MEMORY_SIZE, 0);
+    CHECK(assemble(MIXED_PROGRAM, image.data(), MEMORY_SIZE).ok);
+    const std::string so = tempPath("gpr_test_aot_break.so");
+    CHECK(compileAot(image.data(), so).ok);
+    AotProgram program;
+    CHECK(program.load(so));
+
+    Bus bus;
+    Timer timer;
+    bus.attachDevice(0, &timer);
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, MIXED_PROGRAM)) return;
+    const uint16_t put = static_cast<uint16_t>(findInstruction(bus, "MOV R3, R4"));
+    cpu.setCompiledCode(&program);
+    size_t cycles = 0;
+    {
+        Debugger debugger(cpu, bus);
+        int bp = debugger.addBreakpoint(put);
+        cycles += debugger.run(1000000);
+        CHECK(debugger.lastStop().reason == DebugStop::Reason::BREAKPOINT);
+        CHECK_EQ(cpu.getState().PC, put);
+        debugger.remove(bp);
+    }
+    cycles += runToHalt(cpu);   // Compiled again once the debugger is gone
+    Run interpreted = runProgram(MIXED_PROGRAM, nullptr);
+    CHECK_EQ(cycles, interpreted.cycles);
+    CHECK_EQ(cpu.getState().R[0], interpreted.state.R[0]);
+    std::remove(so.c_str());
+}
+
+int main() {
+    checkAgainstInterpreter(MIXED_PROGRAM, "gpr_test_aot_mixed.so", 12);   // R0 counts interrupts
+    checkAgainstInterpreter(STORE_PATCH_PROGRAM, "gpr_test_aot_store.so", 2);
+    checkAgainstInterpreter(CAS_PATCH_PROGRAM, "gpr_test_aot_cas.so", 2);
+    checkPathNotRunByShell();
+    checkBreakpointWithCompiledCode();
+    return testResult();
+}
+
+#else
+
+int main() { return 0; }   // AotProgram needs dlopen
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Assembly cache: hits, misses on damaged entries, separate entries per
+ * option and eviction, each checked against assembling without a cache.
+ */
+
+#include "test_util.h"
+#include "debug_map.h"
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char* SOURCE =
+    "; sum 1..10 into 0x200\n"
+    "    MOVI R0, 0\n"
+    "    MOVI R1, 10\n"
+    "    MOVI R2, 1\n"
+    "loop:\n"
+    "    ADD R0, R1\n"
+    "    MOV R3, R3\n"
+    "    SUB R1, R2\n"
+    "    JZ done\n"
+    "    JMP loop\n"
+    "done:\n"
+    "    MOVI R6, 0x200\n"
+    "    STORE R0, (R6)\n"
+    "    HALT\n"
+    ".ORG 0x300\n"
+    "table:\n"
+    "    .WORD 0x1234\n";
+
+/** What one assembly produced: memory (over a 0xAAAA fill), the text map and the report. */
+struct Output {
+    bool ok = false;
+    std::vector<uint16_t> mem;
+    std::string map;
+    OptimizeReport report;
+};
+
+static Output assembleThrough(const std::string& path, const std::string& cacheDir, bool optimize,
+                              uint64_t cacheLimit = 64ull << 20) {
+    Output out;
+    out.mem.assign(MEMORY_SIZE, 0xAAAA);
+    DebugMap map;
+    AssembleOptions options;
+    options.optimize = optimize;
+    options.debugMap = &map;
+    options.cacheDir = cacheDir;
+    options.cacheLimit = cacheLimit;
+    AssembleResult ar = assembleFile(path.c_str(), out.mem.data(), MEMORY_SIZE, options);
+    out.ok = ar.ok;
+    out.report = ar.report;
+    std::ostringstream text;
+    map.write(text);
+    out.map = text.str();
+    return out;
+}
+
+static bool sameOutput(const Output& a, const Output& b) {
+    return a.ok && b.ok && a.mem == b.mem && a.map == b.map && a.report.wordsBefore == b.report.wordsBefore &&
+           a.report.wordsAfter == b.report.wordsAfter && a.report.loadsRemoved == b.report.loadsRemoved &&
+           a.report.movesRemoved == b.report.movesRemoved && a.report.jumpsThreaded == b.report.jumpsThreaded &&
+           a.report.jumpsRemoved == b.report.jumpsRemoved &&
+           a.report.unreachableRemoved == b.report.unreachableRemoved;
+}
+
+static std::vector<fs::path> entries(const std::string& dir) {
+    std::vector<fs::path> found;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), last; !ec && it != last; it.increment(ec))
+        if (it->path().extension() == ".gprc") found.push_back(it->path());
+    return found;
+}
+
+static std::vector<char> fileBytes(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+/** The program halts with the sum of 1..10 stored. */
+static void checkRuns(const Output& out) {
+    Bus bus;
+    GPRCPU cpu(bus);
+    for (size_t a = 0; a < MEMORY_SIZE; ++a) bus.getMemory()[a] = out.mem[a];
+    runToHalt(cpu);
+    CHECK_EQ(bus.read(0x200), 55);
+    CHECK_EQ(bus.read(0x300), 0x1234);
+}
+
+int main() {
+    const std::string tag = std::to_string(std::random_device()());
+    const std::string source = tempPath("gpr_cache_test_" + tag + ".asm");
+    const std::string dir = tempPath("gpr_cache_test_" + tag);
+    fs::remove_all(dir);
+    { std::ofstream(source) << SOURCE; }
+
+    for (bool optimize : {false, true}) {
+        const Output plain = assembleThrough(source, "", optimize);
+        CHECK(plain.ok);
+        checkRuns(plain);
+
+        // Miss, then a hit: both as if assembled, and the hit refreshes the entry's time.
+        CHECK(sameOutput(assembleThrough(source, dir, optimize), plain));
+        CHECK_EQ(entries(dir).size(), optimize ? 2 : 1);
+        std::vector<fs::path> before = entries(dir);
+        const auto old = fs::file_time_type::clock::now() - std::chrono::hours(2);
+        for (const fs::path& e : before) fs::last_write_time(e, old);
+        const Output hit = assembleThrough(source, dir, optimize);
+        CHECK(sameOutput(hit, plain));
+        checkRuns(hit);
+        size_t refreshed = 0;
+        for (const fs::path& e : entries(dir)) refreshed += fs::last_write_time(e) > old;
+        CHECK_EQ(refreshed, 1);
+    }
+    CHECK_EQ(entries(dir).size(), 2);
+
+    // A damaged entry is a miss: same output, and the entry is rebuilt.
+    for (const fs::path& e : entries(dir)) {
+        std::vector<char> good = fileBytes(e);
+        std::vector<char> bad = good;
+        bad[bad.size() / 2] ^= 0x40;
+        { std::ofstream(e, std::ios::binary).write(bad.data(), static_cast<std::streamsize>(bad.size())); }
+        fs::last_write_time(e, fs::file_time_type::clock::now() - std::chrono::hours(1));
+    }
+    for (bool optimize : {false, true})
+        CHECK(sameOutput(assembleThrough(source, dir, optimize), assembleThrough(source, "", optimize)));
+    for (const fs::path& e : entries(dir)) {
+        CHECK(fs::last_write_time(e) > fs::file_time_type::clock::now() - std::chrono::minutes(30));
+    }
+
+    // A failed assembly stores nothing.
+    { std::ofstream(source) << "FROB R9\n"; }
+    CHECK(!assembleThrough(source, dir, false).ok);
+    CHECK_EQ(entries(dir).size(), 2);
+
+    // A new source over the limit leaves only its own entry.
+    { std::ofstream(source) << SOURCE << "; changed\n"; }
+    CHECK(assembleThrough(source, dir, false, 1).ok);
+    CHECK_EQ(entries(dir).size(), 1);
+    CHECK(sameOutput(assembleThrough(source, dir, false), assembleThrough(source, "", false)));
+
+    fs::remove_all(dir);
+    std::remove(source.c_str());
+    return testResult();
+}
@@ -0,0 +1,65 @@
+/**
+ * Binary helpers: little-endian fields, FNV-1a reference values and
+ * crash-safe file replacement.
+ */
+
+#include "test_util.h"
+#include "binary_io.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+static void checkFields() {
+    std::vector<uint8_t> out;
+    put16(out, 0xBEEF);
+    put32(out, 0x01234567u);
+    put64(out, 0x89ABCDEF00112233ull);
+    const uint8_t expect[] = {0xEF, 0xBE, 0x67, 0x45, 0x23, 0x01,
+                              0x33, 0x22, 0x11, 0x00, 0xEF, 0xCD, 0xAB, 0x89};
+    CHECK_EQ(out.size(), sizeof(expect));
+    CHECK(std::memcmp(out.data(), expect, sizeof(expect)) == 0);
+    CHECK_EQ(get16(out.data()), 0xBEEF);
+    CHECK_EQ(get32(out.data() + 2), 0x01234567u);
+    CHECK(get64(out.data() + 6) == 0x89ABCDEF00112233ull);
+    patch32(out, 2, 0xCAFEF00Du);
+    CHECK_EQ(get32(out.data() + 2), 0xCAFEF00Du);
+    CHECK_EQ(get16(out.data()), 0xBEEF);
+}
+
+static void checkHashes() {
+    // Published FNV-1a test vectors.
+    CHECK_EQ(fnv1a32("", 0), 0x811C9DC5u);
+    CHECK_EQ(fnv1a32("a", 1), 0xE40C292Cu);
+    CHECK_EQ(fnv1a32("foobar", 6), 0xBF9CF968u);
+    CHECK(fnv1a64("", 0) == FNV64_OFFSET);
+    CHECK(fnv1a64("a", 1) == 0xAF63DC4C8601EC8Cull);
+    CHECK(fnv1a64("foobar", 6) == 0x85944171F73967E8ull);
+    // Hashing in pieces equals hashing the whole.
+    CHECK(fnv1a64("bar", 3, fnv1a64("foo", 3)) == fnv1a64("foobar", 6));
+}
+
+static void checkReplaceFile() {
+    const std::string path = tempPath("gpr_test_binary_io.bin");
+    const std::string tmp = path + ".tmp";
+    std::string error;
+    CHECK(replaceFile(path, tmp, {1, 2, 3}, false, error));
+    CHECK(replaceFile(path, tmp, {4, 5}, true, error));
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(bytes == std::vector<char>({4, 5}));
+    CHECK(!std::ifstream(tmp));
+    in.close();
+    std::remove(path.c_str());
+
+    // Unwritable temporary: the call fails, says why and leaves no file.
+    const std::string missing = tempPath("gpr_test_no_such_dir/x.bin");
+    CHECK(!replaceFile(missing, missing + ".tmp", {1}, false, error));
+    CHECK(!error.empty());
+}
+
+int main() {
+    checkFields();
+    checkHashes();
+    checkReplaceFile();
+    return testResult();
+}
@@ -0,0 +1,96 @@
+/**
+ * Branch prediction: predictors on synthetic patterns, TAGE with empty
+ * tables, and BranchSim's counts for a program with a loop and calls.
+ */
+
+#include "test_util.h"
+#include "branch_predictor.h"
+
+/** Feed `pattern` (repeated) to one branch; returns mispredictions over the last half of `runs`. */
+static unsigned lateMisses(BranchPredictor& p, const char* pattern, unsigned period, unsigned runs) {
+    unsigned misses = 0;
+    for (unsigned i = 0; i < runs; ++i) {
+        bool taken = pattern[i % period] == 'T';
+        bool predicted = p.predict(0x40, 0x20);
+        p.update(0x40, 0x20, taken);
+        if (i >= runs / 2) misses += predicted != taken;
+    }
+    return misses;
+}
+
+static void checkPredictors() {
+    StaticPredictor fixed;
+    CHECK(fixed.predict(0x40, 0x20));    // backward: taken
+    CHECK(!fixed.predict(0x40, 0x60));   // forward: not taken
+    CHECK(makeBranchPredictor("nope") == nullptr);
+
+    for (const char* name : {"bimodal", "gshare", "tage"}) {
+        auto p = makeBranchPredictor(name);
+        CHECK(p != nullptr);
+        if (p) CHECK_EQ(lateMisses(*p, "T", 1, 1000), 0);
+    }
+    // A period-3 pattern is learned from history but not by per-PC counters.
+    for (const char* name : {"gshare", "tage"}) {
+        auto p = makeBranchPredictor(name);
+        if (p) CHECK(lateMisses(*p, "TTN", 3, 3000) < 15);
+    }
+    auto bimodal = makeBranchPredictor("bimodal");
+    CHECK(lateMisses(*bimodal, "TTN", 3, 3000) >= 400);
+}
+
+/**
+ * With no history a branch's TAGE tag is its PC's low byte, so PCs ending
+ * in 00 look up tag 0. Tables that were never allocated must not match it:
+ * a fresh predictor falls back to the base counters, like bimodal.
+ */
+static void checkTageUnallocated() {
+    for (uint16_t pc : {0x0000, 0x0100, 0x4200, 0x0101}) {
+        TagePredictor tage;
+        BimodalPredictor bimodal;
+        CHECK_EQ(tage.predict(pc, 0x0800), bimodal.predict(pc, 0x0800));
+    }
+    // A never-taken branch at such a PC is predicted not taken from the start.
+    TagePredictor tage;
+    unsigned misses = 0;
+    for (int i = 0; i < 50; ++i) {
+        misses += tage.predict(0x0200, 0x0800);
+        tage.update(0x0200, 0x0800, false);
+    }
+    CHECK_EQ(misses, 0);
+}
+
+static void checkSimOnProgram() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    BranchSim sim(makeBranchPredictor("bimodal"));
+    cpu.addFlowListener(&sim);
+    // Ten calls from one loop: JZ runs 10 times (taken once), RET 10 times.
+    const char* source =
+        "MOVI R0, 10\n"
+        "MOVI R1, 1\n"
+        "loop:\n"
+        "CALL work\n"
+        "SUB R0, R1\n"
+        "JZ done\n"
+        "JMP loop\n"
+        "done:\n"
+        "HALT\n"
+        "work:\n"
+        "ADD R2, R1\n"
+        "RET\n";
+    if (!assembleInto(bus, source)) return;
+    runToHalt(cpu);
+    CHECK_EQ(cpu.getState().R[2], 10);
+    CHECK_EQ(sim.conditionalTotals().executed, 10);
+    CHECK_EQ(sim.returnTotals().executed, 10);
+    CHECK_EQ(sim.returnTotals().mispredicted, 0);    // The return stack always holds the caller
+    CHECK_EQ(sim.indirectTotals().executed, 19);     // 10 CALLs and 9 JMPs back
+    CHECK(sim.indirectTotals().mispredicted <= 2);   // Only the BTB's first sight of each
+}
+
+int main() {
+    checkPredictors();
+    checkTageUnallocated();
+    checkSimOnProgram();
+    return testResult();
+}
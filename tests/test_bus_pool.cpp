@@ -0,0 +1,64 @@
+/**
+ * Bus pool: a released Bus comes back equal to the image, whether its run
+ * wrote a few pages (copied back) or many (discarded).
+ */
+
+#include "test_util.h"
+#include "bus_pool.h"
+#include "timer.h"
+#include <vector>
+
+/** Words that differ from the image. */
+static size_t differences(const Bus& bus, const std::vector<uint16_t>& image) {
+    size_t n = 0;
+    for (size_t a = 0; a < MEMORY_SIZE; ++a) n += bus.getMemory()[a] != image[a];
+    return n;
+}
+
+// Fills R3 words from 0x180 with 0xFFFF (R3 is set before running), then stores R3 at 0x100.
+static const char* FILL_PROGRAM =
+    "MOVI R1, 0x180\n"
+    "MOVI R2, 0\n"
+    "NOT R2\n"
+    "BFILL R1, R2, R3\n"
+    "MOVI R4, 0x100\n"
+    "STORE R3, (R4)\n"
+    "HALT\n";
+
+static void checkReuse() {
+    std::vector<uint16_t> words(MEMORY_SIZE, 0);
+    CHECK(assemble(FILL_PROGRAM, words.data(), MEMORY_SIZE).ok);
+    words[0x100] = 0x7777;
+    ProgramImage image(words.data());
+    BusPool pool(image);
+    Timer timer;
+
+    // 16 pages are copied back; 128 pages exceed DISCARD_PAGES.
+    for (uint16_t count : {uint16_t(16 * PAGE_WORDS), uint16_t(128 * PAGE_WORDS), uint16_t(3)}) {
+        Bus* bus = pool.acquire();
+        CHECK_EQ(differences(*bus, words), 0);
+        bus->attachDevice(0, &timer);
+        GPRCPU cpu(*bus);
+        cpu.getState().R[3] = count;
+        runToHalt(cpu);
+        CHECK_EQ(bus->read(0x100), count);
+        CHECK(differences(*bus, words) >= count);
+        pool.release(bus);
+        CHECK(bus->getDevice(0) == nullptr);
+        CHECK_EQ(differences(*bus, words), 0);
+    }
+    CHECK_EQ(pool.created(), 1);
+    CHECK_EQ(pool.available(), 1);
+
+    Bus* a = pool.acquire();
+    Bus* b = pool.acquire();
+    CHECK(a != b);
+    CHECK_EQ(pool.created(), 2);
+    pool.release(a);
+    pool.release(b);
+}
+
+int main() {
+    checkReuse();
+    return testResult();
+}
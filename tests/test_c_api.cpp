@@ -0,0 +1,131 @@
+/**
+ * libgprcpu C API: runs, resets, batches against single runs, and
+ * argument errors. Uses only gprcpu.h, as an embedding program would.
+ */
+
+#include "gprcpu.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// test_util.h needs the C++ headers; this test sees only the C API.
+static int failures = 0;
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                               \
+        }                                                                             \
+    } while (0)
+
+// Stores A * B (by repeated addition) at 0x102 for operands at 0x100 and 0x101.
+static const char* MULTIPLY =
+    "MOVI R6, 0x100\n"
+    "LOAD R1, (R6)\n"
+    "MOVI R6, 0x101\n"
+    "LOAD R2, (R6)\n"
+    "MOVI R0, 0\n"
+    "MOVI R5, 1\n"
+    "MOVI R3, 0\n"
+    "ADD R3, R2\n"
+    "JZ done\n"
+    "loop:\n"
+    "ADD R0, R1\n"
+    "SUB R2, R5\n"
+    "JZ done\n"
+    "JMP loop\n"
+    "done:\n"
+    "MOVI R6, 0x102\n"
+    "STORE R0, (R6)\n"
+    "HALT\n";
+
+static void checkSingleMachine() {
+    CHECK(gpr_api_version() == GPR_API_VERSION);
+    CHECK(sizeof(gpr_state) == 32);
+
+    gpr_machine* m = gpr_create(0);
+    CHECK(m != nullptr);
+    if (!m) return;
+    CHECK(gpr_assemble(m, MULTIPLY) == GPR_OK);
+    const uint16_t operands[2] = {7, 6};
+    CHECK(gpr_write(m, 0x100, operands, 2) == GPR_OK);
+    uint64_t cycles = 0;
+    CHECK(gpr_run(m, 100000, &cycles) == GPR_EXIT_HALT);
+    CHECK(cycles > 0);
+    uint16_t result = 0;
+    CHECK(gpr_read(m, 0x102, &result, 1) == GPR_OK);
+    CHECK(result == 42);
+    CHECK(gpr_memory(m)[0x102] == 42);
+
+    // Reset returns to the assembled image: operands and result are gone.
+    gpr_reset(m);
+    gpr_state s;
+    gpr_get_state(m, &s);
+    CHECK(s.pc == 0 && !s.halted);
+    CHECK(gpr_memory(m)[0x100] == 0 && gpr_memory(m)[0x102] == 0);
+
+    // A budget too small to finish.
+    CHECK(gpr_write(m, 0x100, operands, 2) == GPR_OK);
+    CHECK(gpr_run(m, 10, &cycles) == GPR_EXIT_BUDGET);
+    CHECK(cycles == 10);
+
+    // Interrupt lines: 0-15 only.
+    gpr_reset(m);
+    CHECK(gpr_raise_interrupt(m, 3) == GPR_OK);
+    CHECK(gpr_raise_interrupt(m, 16) == GPR_ERR_ARGUMENT);
+    CHECK(gpr_raise_interrupt(m, 0xFFFFFFFFu) == GPR_ERR_ARGUMENT);
+    CHECK(gpr_raise_interrupt(nullptr, 1) == GPR_ERR_ARGUMENT);
+    gpr_get_state(m, &s);
+    CHECK(s.pending_irq == (1u << 3));
+
+    // Other argument errors.
+    CHECK(gpr_write(m, 0xFFFF, operands, 2) == GPR_ERR_RANGE);
+    CHECK(gpr_read(m, 0xFFFF, &result, 2) == GPR_ERR_RANGE);
+    CHECK(gpr_assemble(m, "FROB R9\n") == GPR_ERR_ASSEMBLY);
+    CHECK(std::strlen(gpr_last_error(m)) > 0);
+
+    // BRK stops the run with PC on it.
+    CHECK(gpr_assemble(m, "NOP\nBRK\nHALT\n") == GPR_OK);
+    CHECK(gpr_run(m, 100, nullptr) == GPR_EXIT_BREAK);
+    gpr_get_state(m, &s);
+    CHECK(s.pc == 1);
+    gpr_destroy(m);
+}
+
+static void checkBatch() {
+    const size_t count = 48;
+    std::vector<gpr_machine*> machines(count);
+    std::vector<gpr_batch_item> items(count);
+    for (size_t i = 0; i < count; ++i) {
+        machines[i] = gpr_create(0);
+        CHECK(machines[i] && gpr_assemble(machines[i], MULTIPLY) == GPR_OK);
+        const uint16_t operands[2] = {static_cast<uint16_t>(i + 3), static_cast<uint16_t>(i % 7)};
+        gpr_write(machines[i], 0x100, operands, 2);
+        items[i] = gpr_batch_item{machines[i], 100000, 0, -1};
+    }
+    CHECK(gpr_run_batch(items.data(), count, 4) == GPR_OK);
+
+    // Each result and cycle count equals a plain gpr_run of the same input.
+    gpr_machine* single = gpr_create(0);
+    gpr_assemble(single, MULTIPLY);
+    for (size_t i = 0; i < count; ++i) {
+        gpr_reset(single);
+        const uint16_t operands[2] = {static_cast<uint16_t>(i + 3), static_cast<uint16_t>(i % 7)};
+        gpr_write(single, 0x100, operands, 2);
+        uint64_t cycles = 0;
+        CHECK(gpr_run(single, 100000, &cycles) == items[i].exit);
+        CHECK(items[i].exit == GPR_EXIT_HALT);
+        CHECK(items[i].cycles == cycles);
+        CHECK(gpr_memory(machines[i])[0x102] == static_cast<uint16_t>((i + 3) * (i % 7)));
+        gpr_destroy(machines[i]);
+    }
+    gpr_destroy(single);
+}
+
+int main() {
+    checkSingleMachine();
+    checkBatch();
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * Cache simulator: CacheModel against a plain LRU/FIFO reference, and the
+ * L1D counts of a program sweeping an array twice, with and without the
+ * pipeline timing model attached.
+ */
+
+#include "test_util.h"
+#include "cache_sim.h"
+#include "pipeline_timing.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/** Reference cache: each set is a list of line numbers, most recent (LRU) or newest (FIFO) last. */
+static bool referenceAccess(std::vector<std::vector<uint32_t>>& sets, const CacheConfig& c, uint16_t address) {
+    const uint32_t line = address / (c.lineBytes / 2);
+    std::vector<uint32_t>& set = sets[line % sets.size()];
+    auto it = std::find(set.begin(), set.end(), line);
+    if (it != set.end()) {
+        if (c.policy == ReplacementPolicy::LRU) {
+            set.erase(it);
+            set.push_back(line);
+        }
+        return true;
+    }
+    if (set.size() == c.associativity) set.erase(set.begin());
+    set.push_back(line);
+    return false;
+}
+
+static void checkAgainstReference(ReplacementPolicy policy, unsigned sizeBytes, unsigned associativity, unsigned lineBytes) {
+    CacheConfig c;
+    c.sizeBytes = sizeBytes;
+    c.associativity = associativity;
+    c.lineBytes = lineBytes;
+    c.policy = policy;
+    CacheModel model(c);
+    std::vector<std::vector<uint32_t>> sets(sizeBytes / (lineBytes * associativity));
+    CHECK_EQ(model.numSets(), sets.size());
+
+    // Mostly a small working set, with occasional far accesses to force evictions.
+    std::mt19937 rng(sizeBytes + associativity);
+    size_t mismatches = 0;
+    for (unsigned i = 0; i < 20000; ++i) {
+        uint16_t address = static_cast<uint16_t>(rng() % 4 ? rng() % 1024 : rng());
+        bool hit = model.access(address, rng() % 3 == 0) == 1;
+        mismatches += hit != referenceAccess(sets, c, address);
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+/** The timing model reads each block's words as well; none of that may reach the cache. */
+static void checkProgramSweep(bool withTiming) {
+    Bus bus;
+    GPRCPU cpu(bus);
+    CacheSim sim;
+    bus.setProbe(&sim);
+    PipelineTiming timing(bus);
+    if (withTiming) cpu.addFlowListener(&timing);
+    // Read 0x100..0x13F twice: 64 words in 8-word lines, all fitting the 512-word L1D.
+    const char* source =
+        "MOVI R4, 2\n"
+        "MOVI R5, 1\n"
+        "pass:\n"
+        "MOVI R1, 0x100\n"
+        "MOVI R2, 64\n"
+        "word:\n"
+        "LOAD R3, (R1)\n"
+        "ADD R1, R5\n"
+        "SUB R2, R5\n"
+        "JZ next\n"
+        "JMP word\n"
+        "next:\n"
+        "SUB R4, R5\n"
+        "JZ done\n"
+        "JMP pass\n"
+        "done:\n"
+        "HALT\n";
+    if (!assembleInto(bus, source)) return;
+    runToHalt(cpu);
+    sim.flush();
+    CHECK_EQ(sim.dcacheTotals().accesses, 128);
+    CHECK_EQ(sim.dcacheTotals().misses, 8);
+    CHECK_EQ(sim.regionCounters(0x01, false).accesses, 128);
+    CHECK(sim.icacheTotals().misses > 0);
+    CHECK(sim.icacheTotals().misses <= 4);   // The whole program fits in a few 8-word lines
+    bus.setProbe(nullptr);
+}
+
+int main() {
+    checkAgainstReference(ReplacementPolicy::LRU, 1024, 2, 16);
+    checkAgainstReference(ReplacementPolicy::LRU, 512, 4, 32);
+    checkAgainstReference(ReplacementPolicy::FIFO, 1024, 2, 16);
+    checkAgainstReference(ReplacementPolicy::FIFO, 256, 1, 8);
+    checkProgramSweep(false);
+    checkProgramSweep(true);
+    return testResult();
+}
@@ -0,0 +1,103 @@
+/**
+ * Control-flow graph: loop nesting, call targets and dead words, every
+ * block the interpreter runs being found statically, and the disassembler
+ * round-tripping through the assembler.
+ */
+
+#include "test_util.h"
+#include "cfg.h"
+#include <vector>
+
+// An outer loop over R4 around an inner loop over R2, a call, and a dead word.
+static const char* NESTED_PROGRAM =
+    "MOVI R4, 3\n"
+    "MOVI R5, 1\n"
+    "outer:\n"
+    "MOVI R2, 4\n"
+    "inner:\n"
+    "CALL bump\n"
+    "SUB R2, R5\n"
+    "JZ next\n"
+    "JMP inner\n"
+    "next:\n"
+    "SUB R4, R5\n"
+    "JZ done\n"
+    "JMP outer\n"
+    "done:\n"
+    "HALT\n"
+    "MOVI R6, 77\n"           // Never reached
+    "bump:\n"
+    "ADD R0, R5\n"
+    "RET\n";
+
+/** Records every block the CPU executes. */
+class BlockRecorder : public ControlFlowListener {
+public:
+    std::vector<std::pair<uint16_t, uint16_t>> blocks;
+    void onBlock(uint16_t start, uint16_t end, BranchKind, bool, uint16_t) override { blocks.push_back({start, end}); }
+};
+
+static void checkStructure() {
+    Bus bus;
+    if (!assembleInto(bus, NESTED_PROGRAM)) return;
+    const uint16_t* mem = bus.getMemory();
+    ProgramCFG cfg = buildCFG(mem, defaultEntries(mem));
+
+    CHECK_EQ(cfg.loops.size(), 2);
+    unsigned inner = 0, outer = 0;
+    for (size_t i = 0; i < cfg.loops.size(); ++i)
+        (cfg.loops[i].depth == 2 ? inner : outer) = static_cast<unsigned>(i);
+    if (cfg.loops.size() == 2) {
+        CHECK_EQ(cfg.loops[inner].parent, static_cast<int>(outer));
+        CHECK_EQ(cfg.loops[outer].parent, -1);
+        CHECK(cfg.loops[outer].blocks.size() > cfg.loops[inner].blocks.size());
+    }
+
+    const size_t bump = findInstruction(bus, "ADD R0, R5");
+    const size_t done = findInstruction(bus, "HALT");
+    CHECK_EQ(cfg.functions.size(), 1);
+    if (!cfg.functions.empty()) CHECK_EQ(cfg.functions[0], bump);
+    // The MOVI after HALT is neither a block nor forgotten.
+    CHECK_EQ(cfg.blockAt(static_cast<uint16_t>(done + 1)), -1);
+    bool listed = false;
+    for (const auto& range : cfg.unreachable) listed |= range.first <= done + 1 && done + 1 <= range.second;
+    CHECK(listed);
+
+    // Everything the interpreter runs lies in reachable blocks of the CFG.
+    GPRCPU cpu(bus);
+    BlockRecorder recorder;
+    cpu.addFlowListener(&recorder);
+    runToHalt(cpu);
+    CHECK_EQ(cpu.getState().R[0], 12);
+    for (const auto& block : recorder.blocks) {
+        for (uint16_t pc = block.first; pc != block.second; ++pc) {
+            int b = cfg.blockAt(pc);
+            CHECK(b >= 0);
+            if (b >= 0) CHECK(cfg.blocks[b].reachable);
+        }
+    }
+}
+
+static void checkDisassembler() {
+    const char* lines[] = {
+        "MOVI R3, 300", "MOV R1, R2", "LOAD R0, (R6)", "STORE R4, (R5)", "ADD R0, R1", "SUB R7, R2",
+        "AND R1, R1", "OR R2, R3", "XOR R4, R5", "NOT R6", "SHL R1", "SHR R2", "JMP R7", "JZ R3",
+        "BMOV R1, R2, R3", "BFILL R4, R5, R6", "CAS R0, (R6), R2", "CALL R5", "RET", "RETI", "EI",
+        "DI", "PUSH R3", "POP R4", "SETSP R1", "GETSP R2", "WFI", "CPUID R0", "FENCE", "BRK", "NOP", "HALT",
+    };
+    for (const char* line : lines) {
+        uint16_t first[4] = {}, second[4] = {};
+        AssembleResult ar = assemble(line, first, 4);
+        CHECK(ar.ok);
+        std::string text = disassemble(first[0]);
+        CHECK(assemble(text, second, 4).ok);
+        if (first[0] != second[0]) std::fprintf(stderr, "%s -> %s\n", line, text.c_str());
+        CHECK_EQ(second[0], first[0]);
+    }
+}
+
+int main() {
+    checkStructure();
+    checkDisassembler();
+    return testResult();
+}
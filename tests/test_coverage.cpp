@@ -0,0 +1,117 @@
+/**
+ * Coverage: bitmaps equal what single-stepping the interpreter visits,
+ * JZ outcomes are recorded each way, and files merge and round-trip.
+ */
+
+#include "test_util.h"
+#include "coverage.h"
+#include "debug_map.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <vector>
+
+// Counts R2 down from 3: the first JZ goes both ways, the second is never
+// taken, so NEVER only runs when a test starts there.
+static const char* PROGRAM =
+    "MOVI R1, 1\n"
+    "MOVI R2, 3\n"
+    "MOVI R3, 5\n"
+    "loop:\n"
+    "SUB R2, R1\n"
+    "JZ done\n"
+    "ADD R3, R1\n"
+    "JZ never\n"
+    "JMP loop\n"
+    "done:\n"
+    "HALT\n"
+    "never:\n"
+    "MOVI R0, 9\n"
+    "HALT\n";
+
+static void checkAgainstStepping() {
+    Bus bus;
+    DebugMap map;
+    AssembleOptions options;
+    options.debugMap = &map;
+    if (!assembleInto(bus, PROGRAM, options)) return;
+    std::vector<uint16_t> image(bus.getMemory(), bus.getMemory() + MEMORY_SIZE);
+
+    // Reference: every PC the interpreter executes, and each JZ's outcomes.
+    std::set<uint16_t> visited, taken, notTaken;
+    {
+        Bus stepBus;
+        stepBus.loadMemory(image.data());
+        GPRCPU cpu(stepBus);
+        while (!cpu.getState().halted) {
+            uint16_t pc = cpu.getState().PC;
+            bool isJz = (stepBus.read(pc) >> 12) == static_cast<unsigned>(Opcode::JZ);
+            visited.insert(pc);
+            cpu.step();
+            if (isJz) (cpu.getState().PC != pc + 1 ? taken : notTaken).insert(pc);
+        }
+    }
+
+    GPRCPU cpu(bus);
+    Coverage coverage;
+    cpu.addFlowListener(&coverage);
+    runToHalt(cpu);
+    coverage.countRun();
+    CHECK_EQ(coverage.executedCount(), visited.size());
+    CHECK_EQ(coverage.jzTakenCount(), taken.size());
+    CHECK_EQ(coverage.jzNotTakenCount(), notTaken.size());
+    for (uint16_t pc : visited) CHECK(coverage.executed(pc));
+    for (uint16_t pc : taken) CHECK(coverage.jzTaken(pc));
+    for (uint16_t pc : notTaken) CHECK(coverage.jzNotTaken(pc));
+    CHECK_EQ(taken.size(), 1);
+    CHECK_EQ(notTaken.size(), 2);
+
+    // A second run entering NEVER: merging adds only its new words.
+    Coverage other;
+    {
+        Bus b;
+        b.loadMemory(image.data());
+        GPRCPU c(b);
+        c.addFlowListener(&other);
+        uint16_t never = 0;
+        CHECK(map.resolve("never", never));
+        c.getState().PC = never;
+        runToHalt(c);
+        other.countRun();
+    }
+    size_t before = coverage.executedCount();
+    size_t added = coverage.merge(other);
+    CHECK_EQ(added, 2);
+    CHECK_EQ(coverage.executedCount(), before + 2);
+    CHECK_EQ(coverage.runs(), 2);
+    CHECK_EQ(coverage.merge(other), 0);   // Nothing new, but its run still counts
+    CHECK_EQ(coverage.runs(), 3);
+
+    // File round trip; a damaged file is refused.
+    const std::string path = tempPath("gpr_test_coverage.cov");
+    CHECK(coverage.save(path.c_str()).ok);
+    Coverage loaded;
+    CHECK(loaded.load(path.c_str()).ok);
+    CHECK_EQ(loaded.runs(), 3);
+    CHECK_EQ(loaded.executedCount(), coverage.executedCount());
+    CHECK_EQ(loaded.merge(coverage), 0);
+    std::vector<char> bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    bytes[40] ^= 2;
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    Coverage damaged;
+    CHECK(!damaged.load(path.c_str()).ok);
+    std::remove(path.c_str());
+}
+
+int main() {
+    checkAgainstStepping();
+    return testResult();
+}
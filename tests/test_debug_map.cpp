@@ -0,0 +1,102 @@
+/**
+ * Debug maps: addresses resolve from labels, file:line and numbers,
+ * malformed text is refused, the text form round-trips and the pipeline
+ * profile charges every cycle to a source line.
+ */
+
+#include "test_util.h"
+#include "debug_map.h"
+#include "pipeline_timing.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+static const char* PROGRAM =
+    "MOVI R0, 0\n"          // line 1, address 0
+    "MOVI R1, 1\n"          // line 2
+    "MOVI R2, 50\n"         // line 3
+    "loop:\n"
+    "ADD R0, R1\n"          // line 5, address 3
+    "SUB R2, R1\n"          // line 6
+    "JZ done\n"             // line 7: two words
+    "JMP loop\n"            // line 8: two words
+    "done:\n"
+    "HALT\n";               // line 10, address 9
+
+static void checkResolve(const DebugMap& map, const std::string& path) {
+    uint16_t pc = 0;
+    CHECK(map.resolve("loop", pc) && pc == 3);
+    CHECK(map.resolve("LOOP", pc) && pc == 3);
+    CHECK(map.resolve(path + ":6", pc) && pc == 4);
+    CHECK(map.resolve("7", pc) && pc == 5);
+    CHECK(map.resolve("0x9", pc) && pc == 9);
+    CHECK(map.resolve("0xFFFF", pc) && pc == 0xFFFF);
+
+    const char* bad[] = {"nowhere", "0x", "0x10000", "0x12g", "0x-1", "0x 5", path.c_str(),
+                         "99999999999999999999", "4294967297", "-1", "x.asm:3", "4:"};
+    for (const char* text : bad) {
+        pc = 0xABCD;
+        bool ok = map.resolve(text, pc);
+        if (ok) std::fprintf(stderr, "resolve(\"%s\") accepted\n", text);
+        CHECK(!ok);
+        CHECK_EQ(pc, 0xABCD);
+    }
+}
+
+static void checkMap() {
+    const std::string path = tempPath("gpr_test_debug_map.asm");
+    {
+        std::ofstream out(path);
+        out << PROGRAM;
+    }
+    Bus bus;
+    DebugMap map;
+    AssembleOptions options;
+    options.debugMap = &map;
+    CHECK(assembleFile(path.c_str(), bus.getMemory(), MEMORY_SIZE, options).ok);
+    std::remove(path.c_str());
+    checkResolve(map, path);
+
+    SourceLine line = map.lineAt(6);
+    CHECK(line.file && *line.file == path);
+    CHECK_EQ(line.line, 7);
+    uint16_t offset = 0;
+    const std::string* label = map.labelAt(6, offset);
+    CHECK(label && *label == "LOOP");
+    CHECK_EQ(offset, 3);
+    CHECK(map.describe(5) == "LOOP+2 " + path + ":7");
+
+    // Text form: read(write(map)) describes every address the same way.
+    std::stringstream text;
+    map.write(text);
+    DebugMap back;
+    CHECK(back.read(text));
+    size_t differing = 0;
+    for (uint32_t pc = 0; pc < 16; ++pc)
+        differing += back.describe(static_cast<uint16_t>(pc)) != map.describe(static_cast<uint16_t>(pc));
+    CHECK_EQ(differing, 0);
+    std::stringstream garbage("line zz 1 0 1\n");
+    DebugMap rejected;
+    CHECK(!rejected.read(garbage));
+
+    // Profile: every cycle but the pipeline fill lands on an address with a source line.
+    GPRCPU cpu(bus);
+    PipelineTiming timing(bus);
+    cpu.addFlowListener(&timing);
+    runToHalt(cpu);
+    std::vector<PCProfile> profile = timing.profile();
+    uint64_t charged = 0, unattributed = 0;
+    for (uint32_t pc = 0; pc < MEMORY_SIZE; ++pc) {
+        charged += profile[pc].cycles();
+        if (profile[pc].cycles() && map.lineAt(static_cast<uint16_t>(pc)).line == 0) ++unattributed;
+    }
+    CHECK_EQ(charged, timing.getStats().cycles - 4);
+    CHECK_EQ(unattributed, 0);
+    CHECK_EQ(profile[3].executions, 50);   // ADD in the loop body
+}
+
+int main() {
+    checkMap();
+    return testResult();
+}
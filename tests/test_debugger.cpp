@@ -0,0 +1,127 @@
+/**
+ * Breakpoints and watchpoints: conditional stops, ignore counts, guest
+ * writes over a breakpoint, and a debugged run costing the same cycles as
+ * a plain one.
+ */
+
+#include "test_util.h"
+#include "debugger.h"
+
+// R0 counts 1..10 in LOOP, then is stored at 0x1F0.
+static const char* COUNT_PROGRAM =
+    "MOVI R0, 0\n"
+    "MOVI R1, 1\n"
+    "MOVI R2, 10\n"
+    "loop:\n"
+    "ADD R0, R1\n"
+    "MOV R3, R2\n"
+    "SUB R3, R0\n"
+    "JZ done\n"
+    "JMP loop\n"
+    "done:\n"
+    "MOVI R4, 0x1F0\n"
+    "STORE R0, (R4)\n"
+    "HALT\n";
+
+static size_t plainCycles() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, COUNT_PROGRAM)) return 0;
+    return runToHalt(cpu);
+}
+
+static void checkStops() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, COUNT_PROGRAM)) return;
+    const uint16_t loop = static_cast<uint16_t>(findInstruction(bus, "ADD R0, R1"));
+    const uint16_t addWord = bus.getMemory()[loop];
+
+    size_t cycles = 0;
+    {
+        Debugger debugger(cpu, bus);
+        DebugCondition third;
+        third.source = DebugCondition::Source::REGISTER;
+        third.index = 0;
+        third.value = 3;
+        int bp = debugger.addBreakpoint(loop, third);
+        CHECK(bp >= 0);
+        CHECK(debugger.hasBreakpointAt(loop));
+        CHECK_EQ(debugger.originalWord(loop), addWord);
+
+        cycles += debugger.run(100000);
+        CHECK(debugger.lastStop().reason == DebugStop::Reason::BREAKPOINT);
+        CHECK_EQ(debugger.lastStop().id, bp);
+        CHECK_EQ(cpu.getState().PC, loop);
+        CHECK_EQ(cpu.getState().R[0], 3);
+        CHECK(debugger.remove(bp));
+        CHECK(!debugger.remove(bp));
+
+        // The run first executes the ADD it starts on (R0 = 4); the next four
+        // visits are ignored, so it stops on the fifth with R0 = 8.
+        DebugCondition fifth;
+        fifth.ignoreHits = 4;
+        int counted = debugger.addBreakpoint(loop, fifth);
+        cycles += debugger.run(100000);
+        CHECK(debugger.lastStop().reason == DebugStop::Reason::BREAKPOINT);
+        CHECK_EQ(cpu.getState().R[0], 8);
+        CHECK_EQ(debugger.hitCount(counted), 5);
+        debugger.remove(counted);
+
+        int watch = debugger.addWatchpoint(0x1F0, 1, WatchKind::WRITE);
+        cycles += debugger.run(100000);
+        CHECK(debugger.lastStop().reason == DebugStop::Reason::WATCHPOINT);
+        CHECK_EQ(debugger.lastStop().id, watch);
+        CHECK_EQ(debugger.lastStop().address, 0x1F0);
+        CHECK(debugger.lastStop().access == AccessKind::WRITE);
+        CHECK_EQ(bus.read(0x1F0), 10);   // The STORE completed before the stop
+
+        cycles += debugger.run(100000);
+        CHECK(debugger.lastStop().reason == DebugStop::Reason::HALT);
+    }
+    CHECK_EQ(bus.getMemory()[loop], addWord);   // Patches removed with the debugger
+    CHECK(bus.getProbe() == nullptr);
+    CHECK_EQ(cycles, plainCycles());
+}
+
+/**
+ * The program copies a new instruction over a breakpointed one (STORE, or
+ * BMOV for `viaBlock`) and then runs it: the breakpoint still stops there,
+ * and neither remove() nor the destructor puts the old word back.
+ */
+static void checkGuestWritesUnderBreakpoint(bool viaBlock, bool removeFirst) {
+    Bus bus;
+    GPRCPU cpu(bus);
+    const char* source = viaBlock
+        ? "MOVI R1, target\nMOVI R2, patch\nMOVI R3, 1\nBMOV R1, R2, R3\n"
+          "target:\nMOVI R0, 5\nHALT\npatch:\nMOVI R0, 9\n"
+        : "MOVI R1, patch\nLOAD R2, (R1)\nMOVI R1, target\nSTORE R2, (R1)\n"
+          "target:\nMOVI R0, 5\nHALT\npatch:\nMOVI R0, 9\n";
+    if (!assembleInto(bus, source)) return;
+    const uint16_t target = static_cast<uint16_t>(findInstruction(bus, "MOVI R0, 5"));
+    const uint16_t patch = static_cast<uint16_t>(findInstruction(bus, "MOVI R0, 9"));
+    const uint16_t newWord = bus.getMemory()[patch];
+    {
+        Debugger debugger(cpu, bus);
+        int bp = debugger.addBreakpoint(target);
+        debugger.run(1000);
+        CHECK(debugger.lastStop().reason == DebugStop::Reason::BREAKPOINT);
+        CHECK_EQ(cpu.getState().PC, target);
+        CHECK_EQ(debugger.originalWord(target), newWord);
+        CHECK_EQ(bus.getMemory()[target], BRK_INSTRUCTION);
+        if (removeFirst) debugger.remove(bp);
+        debugger.run(1000);
+        CHECK(debugger.lastStop().reason == DebugStop::Reason::HALT);
+        CHECK_EQ(cpu.getState().R[0], 9);
+    }
+    CHECK_EQ(bus.getMemory()[target], newWord);
+}
+
+int main() {
+    checkStops();
+    for (bool viaBlock : {false, true}) {
+        checkGuestWritesUnderBreakpoint(viaBlock, false);
+        checkGuestWritesUnderBreakpoint(viaBlock, true);
+    }
+    return testResult();
+}
@@ -0,0 +1,77 @@
+/**
+ * Deterministic SMP: reproducible results, and cycle counts (CAS included)
+ * equal to the plain interpreter's.
+ */
+
+#include "test_util.h"
+#include "smp.h"
+
+// Each core adds 1 to the word at 0x1F0 50 times with a CAS loop.
+static const char* COUNTER_PROGRAM =
+    "MOVI R6, 0x1F0\n"
+    "MOVI R5, 1\n"
+    "MOVI R4, 50\n"
+    "again:\n"
+    "LOAD R0, (R6)\n"
+    "retry:\n"
+    "MOV R2, R0\n"
+    "ADD R2, R5\n"
+    "CAS R0, (R6), R2\n"
+    "JZ ok\n"
+    "JMP retry\n"
+    "ok:\n"
+    "SUB R4, R5\n"
+    "JZ done\n"
+    "JMP again\n"
+    "done:\n"
+    "HALT\n";
+
+struct Outcome {
+    std::vector<size_t> cycles;
+    std::vector<CPUState> states;
+    uint16_t counter = 0;
+};
+
+static Outcome runDeterministic(unsigned cores, size_t quantum) {
+    Outcome out;
+    Bus bus;
+    if (!assembleInto(bus, COUNTER_PROGRAM)) return out;
+    DeterministicSMP machine(bus, cores, quantum);
+    machine.reset();
+    out.cycles = machine.run(1000000);
+    for (unsigned i = 0; i < cores; ++i) out.states.push_back(machine.core(i).getState());
+    out.counter = bus.read(0x1F0);
+    return out;
+}
+
+static void checkMatchesInterpreter() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, COUNTER_PROGRAM)) return;
+    size_t expected = runToHalt(cpu);
+    for (size_t quantum : {1u, 7u, 64u, 100000u}) {
+        Outcome one = runDeterministic(1, quantum);
+        CHECK_EQ(one.counter, 50);
+        CHECK_EQ(one.cycles.size(), 1);
+        if (!one.cycles.empty()) CHECK_EQ(one.cycles[0], expected);
+    }
+}
+
+static void checkReproducible() {
+    for (size_t quantum : {5u, 300u}) {
+        Outcome a = runDeterministic(4, quantum);
+        Outcome b = runDeterministic(4, quantum);
+        CHECK_EQ(a.counter, 200);
+        CHECK(a.cycles == b.cycles);
+        for (size_t i = 0; i < a.states.size() && i < b.states.size(); ++i) {
+            CHECK(a.states[i].halted);
+            for (unsigned r = 0; r < 8; ++r) CHECK_EQ(a.states[i].R[r], b.states[i].R[r]);
+        }
+    }
+}
+
+int main() {
+    checkMatchesInterpreter();
+    checkReproducible();
+    return testResult();
+}
@@ -0,0 +1,84 @@
+/**
+ * Fuzzer: finds a crash and a hang hidden behind input checks, classifies
+ * single inputs correctly and restores the machine between runs.
+ */
+
+#include "test_util.h"
+#include "debug_map.h"
+#include "fuzzer.h"
+#include <vector>
+
+// Operands at 0x100/0x101: B == 0 spins forever, A == B hits BRK, else A - B at 0x102.
+static const char* TARGET_PROGRAM =
+    "MOVI R6, 0x100\n"
+    "LOAD R0, (R6)\n"
+    "MOVI R5, 0x101\n"
+    "LOAD R1, (R5)\n"
+    "MOVI R2, 0\n"
+    "ADD R2, R1\n"
+    "JZ spin\n"
+    "SUB R0, R1\n"
+    "JZ boom\n"
+    "MOVI R4, 0x102\n"
+    "STORE R0, (R4)\n"
+    "HALT\n"
+    "boom:\n"
+    "BRK\n"
+    "spin:\n"
+    "JMP spin\n";
+
+static void checkFuzzer() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, TARGET_PROGRAM)) return;
+    FuzzOptions options;
+    options.regions = {{0x100, 2}};
+    options.cycleLimit = 2000;
+    options.seconds = 0;
+    options.maxExecs = 20000;
+    options.seed = 1;
+    Fuzzer fuzzer(cpu, bus, options);
+    CHECK_EQ(fuzzer.inputWords(), 2);
+
+    // Single inputs, in any order: each run starts from the same machine.
+    CHECK(fuzzer.execute({7, 2}) == Fuzzer::Outcome::OK);
+    CHECK_EQ(bus.read(0x102), 5);
+    CHECK(fuzzer.execute({3, 0}) == Fuzzer::Outcome::HANG);
+    CHECK(fuzzer.execute({9, 9}) == Fuzzer::Outcome::CRASH);
+    CHECK(fuzzer.execute({7, 2}) == Fuzzer::Outcome::OK);
+    CHECK_EQ(bus.read(0x102), 5);
+
+    fuzzer.addSeed({1, 2});
+    FuzzStats stats = fuzzer.run();
+    CHECK_EQ(stats.execs, 20000);
+    CHECK(stats.crashes >= 1);
+    CHECK(stats.hangs >= 1);
+    CHECK(stats.corpus >= 1);
+    CHECK(stats.edges > 0);
+    CHECK(fuzzer.lastError().empty());
+}
+
+static void checkCrashAddress() {
+    // Once SPIN is a crash address, the input that used to hang crashes instead.
+    Bus bus;
+    GPRCPU cpu(bus);
+    DebugMap map;
+    AssembleOptions assembleOptions;
+    assembleOptions.debugMap = &map;
+    if (!assembleInto(bus, TARGET_PROGRAM, assembleOptions)) return;
+    FuzzOptions options;
+    options.regions = {{0x100, 2}};
+    options.cycleLimit = 2000;
+    Fuzzer fuzzer(cpu, bus, options);
+    uint16_t spin = 0;
+    CHECK(map.resolve("spin", spin));
+    fuzzer.addCrashAddress(spin);
+    CHECK(fuzzer.execute({3, 0}) == Fuzzer::Outcome::CRASH);
+    CHECK(fuzzer.execute({7, 2}) == Fuzzer::Outcome::OK);
+}
+
+int main() {
+    checkFuzzer();
+    checkCrashAddress();
+    return testResult();
+}
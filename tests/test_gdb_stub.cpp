@@ -0,0 +1,174 @@
+/**
+ * GDB stub: a client on a Unix socket reading memory at the top of the
+ * address space, writing over a breakpoint, running to HALT and sending
+ * corrupted packets.
+ */
+
+#include "test_util.h"
+#include "gdb_stub.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <thread>
+
+/** A tiny gdb: frames packets, acknowledges replies and skips the stub's acks. */
+class Client {
+public:
+    explicit Client(const std::string& path) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    ~Client() { if (fd >= 0) close(fd); }
+
+    bool connected() const { return fd >= 0; }
+
+    void sendRaw(const std::string& bytes) { (void)!write(fd, bytes.data(), bytes.size()); }
+
+    void send(const std::string& payload, bool corrupt = false) {
+        unsigned sum = 0;
+        for (char c : payload) sum += static_cast<uint8_t>(c);
+        char cs[3];
+        std::snprintf(cs, sizeof(cs), "%02x", (sum + (corrupt ? 1 : 0)) & 0xFF);
+        sendRaw("$" + payload + "#" + cs);
+    }
+
+    /** Next reply payload; "<eof>" once the stub has closed the connection. */
+    std::string reply() {
+        char c;
+        do {
+            if (read(fd, &c, 1) != 1) return "<eof>";
+        } while (c != '$');
+        std::string payload;
+        while (read(fd, &c, 1) == 1 && c != '#') payload += c;
+        char cs[2];
+        if (read(fd, cs, 2) != 2) return "<eof>";
+        sendRaw("+");
+        return payload;
+    }
+
+    std::string ask(const std::string& payload) {
+        send(payload);
+        return reply();
+    }
+
+    /** True once the stub has closed its end (skipping any acks still queued). */
+    bool closedByPeer() {
+        char c;
+        for (;;) {
+            ssize_t n = read(fd, &c, 1);
+            if (n <= 0) return true;
+            if (c != '+' && c != '-') return false;
+        }
+    }
+
+private:
+    int fd;
+};
+
+static std::string socketPath() {
+    return "/tmp/gpr_gdb_test_" + std::to_string(getpid()) + ".sock";
+}
+
+static void checkSession() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, "MOVI R0, 0x1AB\nMOVI R1, 2\nADD R0, R1\nHALT\n")) return;
+    bus.getMemory()[0xFFFF] = 0xBEEF;
+
+    GdbStub stub(cpu, bus);
+    const std::string path = socketPath();
+    CHECK(stub.listenUnix(path));
+    bool served = false;
+    std::thread server([&] { served = stub.serve(); });
+    {
+        Client gdb(path);
+        CHECK(gdb.connected());
+        // The last word (bytes 0x1FFFE-0x1FFFF): a longer read is cut at the end of memory.
+        CHECK(gdb.ask("m1fffe,4") == "efbe");
+        CHECK(gdb.ask("m20000,2") == "E01");
+        CHECK(gdb.ask("mfffffffe,4") == "E01");
+        CHECK(gdb.ask("m0,0") == "");
+
+        std::string stop = gdb.ask("c");
+        CHECK(!stop.empty() && (stop[0] == 'S' || stop[0] == 'T'));
+        CHECK(gdb.ask("p0") == "ad01");   // R0 = 0x1AD, little-endian
+        gdb.send("k");
+    }
+    server.join();
+    CHECK(served);
+    CHECK(cpu.getState().halted);
+}
+
+/** Memory written by gdb over a breakpoint replaces the instruction and keeps the breakpoint. */
+static void checkWriteUnderBreakpoint() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, "MOVI R0, 0x1AB\nMOVI R1, 2\nADD R0, R1\nHALT\n")) return;
+    uint16_t doubled[1] = {};
+    CHECK(assemble("ADD R0, R0\n", doubled, 1).ok);
+    char hex[8];
+    std::snprintf(hex, sizeof(hex), "%02x%02x", doubled[0] & 0xFF, doubled[0] >> 8);
+
+    GdbStub stub(cpu, bus);
+    const std::string path = socketPath();
+    CHECK(stub.listenUnix(path));
+    std::thread server([&] { stub.serve(); });
+    {
+        Client gdb(path);
+        CHECK(gdb.connected());
+        CHECK(gdb.ask("Z0,4,2") == "OK");                      // The ADD at word 2
+        CHECK(gdb.ask(std::string("M4,2:") + hex) == "OK");
+        CHECK(gdb.ask("m4,2") == hex);
+        CHECK(gdb.ask("c").substr(0, 3) == "S05");
+        CHECK(gdb.ask("p0") == "ab01");                         // Stopped before the new ADD
+        CHECK(gdb.ask("z0,4,2") == "OK");
+        CHECK(gdb.ask("m4,2") == hex);                          // Removing it kept gdb's word
+        gdb.ask("c");
+        CHECK(gdb.ask("p0") == "5603");                         // 0x1AB + 0x1AB
+        gdb.send("k");
+    }
+    server.join();
+    CHECK_EQ(bus.getMemory()[2], doubled[0]);
+}
+
+static void checkCorruptedPackets() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    GdbStub stub(cpu, bus);
+    const std::string path = socketPath();
+    CHECK(stub.listenUnix(path));
+    std::thread server([&] { stub.serve(); });
+    {
+        Client gdb(path);
+        CHECK(gdb.connected());
+        // One bad packet is NAKed and then resent intact.
+        gdb.send("?", true);
+        CHECK(gdb.ask("?").size() >= 3);
+        // A line that never delivers a good packet is dropped.
+        for (int i = 0; i < 16; ++i) gdb.send("g", true);
+        CHECK(gdb.closedByPeer());
+    }
+    server.join();
+    CHECK(stub.lastError() == "too many corrupted packets");
+}
+
+int main() {
+    checkSession();
+    checkWriteUnderBreakpoint();
+    checkCorruptedPackets();
+    return testResult();
+}
+
+#else
+
+int main() { return 0; }   // GdbStub needs POSIX sockets
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * Job server: jobs sent over its socket against the interpreter, the
+ * program cache, and which files at the socket path it will replace.
+ */
+
+#include "test_util.h"
+#include "job_server.h"
+#include "binary_io.h"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fstream>
+#include <thread>
+
+static const char* ADDITION =
+    "MOVI R6, 0x100\n"
+    "LOAD R0, (R6)\n"
+    "MOVI R7, 0x101\n"
+    "LOAD R1, (R7)\n"
+    "ADD R0, R1\n"
+    "MOVI R2, 0x102\n"
+    "STORE R0, (R2)\n"
+    "HALT\n";
+
+struct Response {
+    uint8_t status = 0xFF, exit = 0xFF;
+    uint32_t jobId = 0;
+    uint64_t cycles = 0, programHash = 0;
+    uint16_t regs[11] = {};       // R0-R7, PC, FLAGS, SP
+    std::vector<uint16_t> words;  // Requested regions (or nothing on an error)
+};
+
+/** A client speaking the frame protocol of job_server.h. */
+class Client {
+public:
+    explicit Client(const std::string& path) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    ~Client() { if (fd >= 0) close(fd); }
+
+    bool connected() const { return fd >= 0; }
+
+    /** Queue a RUN of `program` with operands a, b patched in; reads back 0x102. */
+    void run(uint8_t kind, const std::vector<uint8_t>& program, uint32_t jobId, uint16_t a, uint16_t b) {
+        std::vector<uint8_t> body;
+        body.push_back(JOB_RUN);
+        body.push_back(kind);
+        put16(body, 0);
+        put32(body, jobId);
+        put64(body, 100000);
+        put32(body, static_cast<uint32_t>(program.size()));
+        body.insert(body.end(), program.begin(), program.end());
+        put16(body, 1);
+        put16(body, 0x100);
+        put16(body, 2);
+        put16(body, a);
+        put16(body, b);
+        put16(body, 1);
+        put16(body, 0x102);
+        put16(body, 1);
+        std::vector<uint8_t> frame;
+        put32(frame, static_cast<uint32_t>(body.size()));
+        frame.insert(frame.end(), body.begin(), body.end());
+        (void)!write(fd, frame.data(), frame.size());
+    }
+
+    Response response() {
+        Response r;
+        uint8_t len[4];
+        if (!readAll(len, 4)) return r;
+        std::vector<uint8_t> body(get32(len));
+        if (body.size() < 8 || !readAll(body.data(), body.size())) return r;
+        r.status = body[0];
+        r.exit = body[1];
+        r.jobId = get32(&body[4]);
+        if (r.status != 0 || body.size() < 48) return r;
+        r.cycles = get64(&body[8]);
+        r.programHash = get64(&body[16]);
+        for (unsigned i = 0; i < 11; ++i) r.regs[i] = get16(&body[24 + 2 * i]);
+        for (size_t at = 48; at + 1 < body.size(); at += 2) r.words.push_back(get16(&body[at]));
+        return r;
+    }
+
+private:
+    int fd;
+
+    bool readAll(uint8_t* p, size_t n) {
+        while (n) {
+            ssize_t got = read(fd, p, n);
+            if (got <= 0) return false;
+            p += got;
+            n -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+};
+
+static std::vector<uint8_t> bytesOf(const std::string& s) { return std::vector<uint8_t>(s.begin(), s.end()); }
+
+static std::string socketPath() {
+    return "/tmp/gpr_job_test_" + std::to_string(getpid()) + ".sock";
+}
+
+/** The interpreter's result for ADDITION with operands a, b. */
+static void checkAgainstInterpreter(const Response& r, uint16_t a, uint16_t b) {
+    Bus bus;
+    GPRCPU cpu(bus);
+    if (!assembleInto(bus, ADDITION)) return;
+    bus.write(0x100, a);
+    bus.write(0x101, b);
+    size_t cycles = runToHalt(cpu);
+    CHECK_EQ(r.status, 0);
+    CHECK_EQ(r.exit, 0);
+    CHECK_EQ(r.cycles, cycles);
+    CHECK_EQ(r.regs[0], cpu.getState().R[0]);
+    CHECK_EQ(r.regs[8], cpu.getState().PC);
+    CHECK_EQ(r.words.size(), 1);
+    if (!r.words.empty()) CHECK_EQ(r.words[0], static_cast<uint16_t>(a + b));
+}
+
+static void checkJobs() {
+    const std::string path = socketPath();
+    JobServer server(2);
+    CHECK(server.listen(path));
+    std::thread serving([&] { server.serve(); });
+    {
+        Client client(path);
+        CHECK(client.connected());
+
+        // First run assembles and hands back the program's hash.
+        client.run(0, bytesOf(ADDITION), 1, 2, 3);
+        Response first = client.response();
+        checkAgainstInterpreter(first, 2, 3);
+        CHECK(first.programHash != 0);
+
+        // The same text again, and then the hash alone, are cache hits.
+        client.run(0, bytesOf(ADDITION), 2, 40, 2);
+        checkAgainstInterpreter(client.response(), 40, 2);
+        std::vector<uint8_t> hash;
+        put64(hash, first.programHash);
+        client.run(2, hash, 3, 0xFFFF, 2);
+        checkAgainstInterpreter(client.response(), 0xFFFF, 2);
+        JobServerStats s = server.stats();
+        CHECK_EQ(s.cacheMisses, 1);
+        CHECK_EQ(s.cacheHits, 2);
+
+        // Requests sent without waiting all come back, matched by id.
+        for (uint32_t id = 10; id < 26; ++id) client.run(2, hash, id, static_cast<uint16_t>(id), 100);
+        unsigned seen = 0;
+        for (int i = 0; i < 16; ++i) {
+            Response r = client.response();
+            if (r.jobId < 10 || r.jobId >= 26) continue;
+            checkAgainstInterpreter(r, static_cast<uint16_t>(r.jobId), 100);
+            seen |= 1u << (r.jobId - 10);
+        }
+        CHECK_EQ(seen, 0xFFFF);
+
+        client.run(0, bytesOf("FROB R9\n"), 30, 0, 0);
+        CHECK_EQ(client.response().status, static_cast<uint8_t>(JobStatus::ASSEMBLY_ERROR));
+        std::vector<uint8_t> unknown;
+        put64(unknown, first.programHash ^ 1);
+        client.run(2, unknown, 31, 0, 0);
+        CHECK_EQ(client.response().status, static_cast<uint8_t>(JobStatus::UNKNOWN_PROGRAM));
+
+        // A second server may not take over the live socket.
+        JobServer rival(1);
+        CHECK(!rival.listen(path));
+        CHECK(rival.lastError().find("in use") != std::string::npos);
+    }
+    server.stop();
+    serving.join();
+    std::remove(path.c_str());
+}
+
+static void checkSocketPath() {
+    const std::string path = socketPath();
+
+    // A regular file is left alone.
+    { std::ofstream(path) << "keep me"; }
+    {
+        JobServer server(1);
+        CHECK(!server.listen(path));
+        CHECK(server.lastError().find("not a socket") != std::string::npos);
+    }
+    std::string kept;
+    std::getline(std::ifstream(path), kept);
+    CHECK(kept == "keep me");
+    std::remove(path.c_str());
+
+    // A socket nobody listens on is replaced.
+    int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    CHECK(bind(stale, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    close(stale);
+    {
+        JobServer server(1);
+        CHECK(server.listen(path));
+    }
+    std::remove(path.c_str());
+}
+
+int main() {
+    checkJobs();
+    checkSocketPath();
+    return testResult();
+}
+
+#else
+
+int main() { return 0; }   // JobServer needs POSIX sockets
+
+#endif
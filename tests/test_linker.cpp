@@ -0,0 +1,113 @@
+/**
+ * Objects and linking: a linked program runs like the same source
+ * assembled whole, objects survive a save/load round trip, and bad links
+ * are refused.
+ */
+
+#include "test_util.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+static const char* MAIN_SOURCE =
+    "MOVI R0, 21\n"
+    "CALL double\n"
+    "MOVI R1, 0x102\n"
+    "STORE R0, (R1)\n"
+    "HALT\n";
+
+static const char* LIBRARY_SOURCE =
+    ".GLOBAL double\n"
+    "double:\n"
+    "CALL add\n"
+    "RET\n"
+    "add:\n"                 // Local: not visible to other objects
+    "ADD R0, R0\n"
+    "RET\n";
+
+/** Run the image in `mem` and return the word at 0x102. */
+static uint16_t runImage(const std::vector<uint16_t>& mem) {
+    Bus bus;
+    bus.loadMemory(mem.data());
+    GPRCPU cpu(bus);
+    runToHalt(cpu);
+    return bus.read(0x102);
+}
+
+static void checkLinkMatchesWhole() {
+    ObjectFile mainObj, libObj;
+    CHECK(assembleObject(MAIN_SOURCE, mainObj).ok);
+    CHECK(assembleObject(LIBRARY_SOURCE, libObj).ok);
+    std::vector<uint16_t> linked(MEMORY_SIZE, 0), whole(MEMORY_SIZE, 0);
+    for (unsigned threads : {1u, 4u}) {
+        LinkOptions options;
+        options.threads = threads;
+        std::fill(linked.begin(), linked.end(), 0);
+        AssembleResult lr = link({&mainObj, &libObj}, linked.data(), MEMORY_SIZE, options);
+        CHECK(lr.ok);
+        CHECK_EQ(runImage(linked), 42);
+    }
+    // The library placed right after the program, as link() does.
+    std::string source = std::string(MAIN_SOURCE) + LIBRARY_SOURCE;
+    CHECK(assemble(source, whole.data(), MEMORY_SIZE).ok);
+    CHECK(linked == whole);
+
+    // Save and reload both objects: linking them again gives the same image.
+    const std::string mainPath = tempPath("gpr_test_main.o"), libPath = tempPath("gpr_test_lib.o");
+    CHECK(saveObject(mainPath.c_str(), mainObj).ok);
+    CHECK(saveObject(libPath.c_str(), libObj).ok);
+    CHECK(isObjectFile(libPath.c_str()));
+    ObjectFile mainBack, libBack;
+    CHECK(loadObject(mainPath.c_str(), mainBack).ok);
+    CHECK(loadObject(libPath.c_str(), libBack).ok);
+    std::vector<uint16_t> relinked(MEMORY_SIZE, 0);
+    CHECK(link({&mainBack, &libBack}, relinked.data(), MEMORY_SIZE).ok);
+    CHECK(relinked == linked);
+
+    // A damaged object is refused.
+    std::vector<char> bytes;
+    {
+        std::ifstream in(libPath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    bytes[bytes.size() / 2] ^= 1;
+    {
+        std::ofstream out(libPath, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    ObjectFile damaged;
+    CHECK(!loadObject(libPath.c_str(), damaged).ok);
+    std::remove(mainPath.c_str());
+    std::remove(libPath.c_str());
+}
+
+static void checkRefusedLinks() {
+    std::vector<uint16_t> mem(MEMORY_SIZE, 0);
+
+    // add is local to the library, so importing it fails.
+    ObjectFile caller, libObj;
+    CHECK(assembleObject("CALL add\nHALT\n", caller).ok);
+    CHECK(assembleObject(LIBRARY_SOURCE, libObj).ok);
+    CHECK(!link({&caller, &libObj}, mem.data(), MEMORY_SIZE).ok);
+
+    // b.o sits inside a.o's 0x200-0x23F, after a later .ORG in a.o went back to 0x205.
+    std::string a = ".ORG 0x200\n";
+    for (int i = 0; i < 64; ++i) a += "NOP\n";
+    a += ".ORG 0x205\nNOP\n";
+    ObjectFile oa, ob;
+    CHECK(assembleObject(a, oa).ok);
+    CHECK(assembleObject(".ORG 0x220\nNOP\n", ob).ok);
+    oa.name = "a.o";
+    ob.name = "b.o";
+    AssembleResult lr = link({&oa, &ob}, mem.data(), MEMORY_SIZE);
+    CHECK(!lr.ok);
+    CHECK(lr.error.find("Overlaps a.o") != std::string::npos);
+}
+
+int main() {
+    checkLinkMatchesWhole();
+    checkRefusedLinks();
+    return testResult();
+}
@@ -0,0 +1,92 @@
+/**
+ * Constant synthesis and long jumps: every 16-bit value loads exactly, R7
+ * is only used when .SCRATCH allows it, and jumps reach any address.
+ */
+
+#include "test_util.h"
+#include <algorithm>
+#include <vector>
+
+/** Run loadConstant(rd, value, scratch) followed by HALT; returns the CPU state. */
+static CPUState runConstant(Bus& bus, GPRCPU& cpu, uint8_t rd, uint16_t value, bool scratch, size_t& words) {
+    std::vector<uint16_t> seq = loadConstant(rd, value, scratch);
+    words = seq.size();
+    uint16_t* mem = bus.getMemory();
+    for (size_t i = 0; i < seq.size(); ++i) mem[i] = seq[i];
+    mem[seq.size()] = 0x0000;   // HALT
+    cpu.reset();
+    for (unsigned r = 0; r < 8; ++r) cpu.getState().R[r] = static_cast<uint16_t>(0xA5A0 + r);
+    cpu.runFor(100);
+    return cpu.getState();
+}
+
+static void checkEveryValue() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    size_t wrong = 0, clobbered = 0, longest = 0, shorterWithScratch = 0;
+    for (uint32_t v = 0; v <= 0xFFFF; ++v) {
+        const uint16_t value = static_cast<uint16_t>(v);
+        size_t single = 0, pair = 0;
+        CPUState s = runConstant(bus, cpu, 3, value, false, single);
+        wrong += !s.halted || s.R[3] != value;
+        for (unsigned r = 0; r < 8; ++r)
+            if (r != 3) clobbered += s.R[r] != 0xA5A0 + r;
+        longest = std::max(longest, single);
+
+        CPUState t = runConstant(bus, cpu, 3, value, true, pair);
+        wrong += !t.halted || t.R[3] != value;
+        for (unsigned r = 0; r < 7; ++r)
+            if (r != 3) clobbered += t.R[r] != 0xA5A0 + r;
+        CHECK(pair <= single);
+        shorterWithScratch += pair < single;
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(clobbered, 0);
+    CHECK(longest <= 14);
+    CHECK(shorterWithScratch > 0);
+}
+
+static void checkScratchDirective() {
+    // Without .SCRATCH a long MOVI leaves R7 alone; 513 is one of the values a second chain shortens.
+    const char* plain = "MOVI R7, 0x1234\nMOVI R1, 513\nMOVI R2, 40000\nHALT\n";
+    const char* scratch = ".SCRATCH R7\nMOVI R7, 0x1234\nMOVI R1, 513\nMOVI R2, 40000\nHALT\n";
+    for (const char* source : {plain, scratch}) {
+        Bus bus;
+        GPRCPU cpu(bus);
+        if (!assembleInto(bus, source)) continue;
+        runToHalt(cpu);
+        CHECK_EQ(cpu.getState().R[1], 513);
+        CHECK_EQ(cpu.getState().R[2], 40000);
+        if (source == plain) CHECK_EQ(cpu.getState().R[7], 0x1234);
+    }
+}
+
+static void checkLongJumps() {
+    Bus bus;
+    GPRCPU cpu(bus);
+    const char* source =
+        "MOVI R0, 1\n"
+        "CALL far\n"
+        "MOVI R2, 0x0100\n"
+        "STORE R0, (R2)\n"
+        "HALT\n"
+        ".ORG 0xC000\n"
+        "far:\n"
+        "SHL R0\n"
+        "JZ never\n"
+        "RET\n"
+        ".ORG 0x9ABC\n"
+        "never:\n"
+        "HALT\n";
+    if (!assembleInto(bus, source)) return;
+    runToHalt(cpu);
+    CHECK_EQ(bus.read(0x100), 2);
+    CHECK(cpu.getState().PC < 0x100);   // Halted back in the caller, not at NEVER
+}
+
+int main() {
+    checkEveryValue();
+    checkScratchDirective();
+    checkLongJumps();
+    return testResult();
+}
@@ -0,0 +1,67 @@
+/**
+ * Pipeline timing model: stall counts worked out by hand.
+ */
+
+#include "test_util.h"
+#include "pipeline_timing.h"
+
+/** Run `source` with a PipelineTiming attached and return its stats. */
+static PipelineStats timeProgram(const char* source, const PipelineConfig& config = PipelineConfig()) {
+    Bus bus;
+    GPRCPU cpu(bus);
+    PipelineTiming timing(bus, config);
+    cpu.addFlowListener(&timing);
+    if (!assembleInto(bus, source)) return PipelineStats();
+    runToHalt(cpu);
+    return timing.getStats();
+}
+
+/** Every cycle is an instruction, the 4-cycle fill or a counted stall. */
+static void checkTotal(const PipelineStats& s) {
+    CHECK_EQ(s.cycles, s.instructions + 4 + s.loadUseStalls + s.branchStalls + s.memoryStalls + s.interruptStalls);
+}
+
+static void checkLoadUse() {
+    PipelineStats dependent = timeProgram("MOVI R1, 0x100\nLOAD R2, (R1)\nADD R2, R2\nHALT\n");
+    CHECK_EQ(dependent.loadUseStalls, 1);
+    checkTotal(dependent);
+
+    PipelineStats independent = timeProgram("MOVI R1, 0x100\nLOAD R2, (R1)\nADD R3, R3\nADD R2, R2\nHALT\n");
+    CHECK_EQ(independent.loadUseStalls, 0);
+    checkTotal(independent);
+
+    PipelineConfig slow;
+    slow.memLatency = 3;
+    PipelineStats memory = timeProgram("MOVI R1, 0x100\nLOAD R2, (R1)\nSTORE R2, (R1)\nHALT\n", slow);
+    CHECK_EQ(memory.memoryStalls, 6);
+    checkTotal(memory);
+}
+
+static void checkBranches() {
+    // Four taken JMPs back to the loop and one taken JZ out of it.
+    const char* loop =
+        "MOVI R0, 5\n"
+        "MOVI R1, 1\n"
+        "loop:\n"
+        "SUB R0, R1\n"
+        "JZ done\n"
+        "JMP loop\n"
+        "done:\n"
+        "HALT\n";
+    PipelineStats s = timeProgram(loop);
+    CHECK_EQ(s.branchStalls, 5 * PipelineConfig().branchPenalty);
+    checkTotal(s);
+
+    PipelineConfig free;
+    free.branchPenalty = 0;
+    PipelineStats unpenalized = timeProgram(loop, free);
+    CHECK_EQ(unpenalized.branchStalls, 0);
+    CHECK_EQ(unpenalized.instructions, s.instructions);
+    CHECK_EQ(s.cycles - unpenalized.cycles, s.branchStalls);
+}
+
+int main() {
+    checkLoadUse();
+    checkBranches();
+    return testResult();
+}
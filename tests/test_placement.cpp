@@ -0,0 +1,82 @@
+/**
+ * Memory placement: arena slabs hand out zeroed, disjoint Bus memories
+ * that pooled runs reset, and the host topology queries are consistent.
+ */
+
+#include "test_util.h"
+#include "bus_pool.h"
+#include "placement.h"
+#include <memory>
+#include <set>
+#include <vector>
+
+static void checkArena() {
+    BusArena arena;
+    std::vector<std::unique_ptr<Bus>> buses;
+    const size_t count = BusArena::BUSES_PER_SLAB + 4;   // Spills into a second slab
+    for (size_t i = 0; i < count; ++i) {
+        buses.emplace_back(new Bus(arena));
+        Bus& bus = *buses.back();
+        CHECK_EQ(bus.read(0x0000), 0);
+        CHECK_EQ(bus.read(0xFEEF), 0);
+        bus.write(0x0000, static_cast<uint16_t>(i + 1));
+        bus.write(0xFEEF, static_cast<uint16_t>(i + 1));
+    }
+    CHECK_EQ(arena.slabCount(), 2);
+    std::set<const uint16_t*> memories;
+    for (size_t i = 0; i < count; ++i) {
+        CHECK_EQ(buses[i]->read(0x0000), i + 1);
+        CHECK_EQ(buses[i]->read(0xFEEF), i + 1);
+        memories.insert(buses[i]->getMemory());
+    }
+    CHECK_EQ(memories.size(), count);
+
+    // A returned block is zeroed for its next user.
+    buses.pop_back();
+    Bus reused(arena);
+    CHECK_EQ(reused.read(0x0000), 0);
+    CHECK_EQ(reused.read(0xFEEF), 0);
+    CHECK_EQ(arena.slabCount(), 2);
+}
+
+static void checkPooledArena() {
+    std::vector<uint16_t> words(MEMORY_SIZE, 0);
+    CHECK(assemble("MOVI R1, 0x180\nMOVI R2, 9\nMOVI R3, 500\nBFILL R1, R2, R3\nHALT\n",
+                   words.data(), MEMORY_SIZE).ok);
+    ProgramImage image(words.data());
+    BusArena arena;
+    BusPool pool(image, &arena);
+    for (int round = 0; round < 3; ++round) {
+        Bus* bus = pool.acquire();
+        CHECK_EQ(bus->read(0x180), 0);
+        CHECK_EQ(bus->read(0), words[0]);
+        GPRCPU cpu(*bus);
+        runToHalt(cpu);
+        CHECK_EQ(bus->read(0x180 + 499), 9);
+        pool.release(bus);
+    }
+    CHECK_EQ(pool.created(), 1);
+}
+
+static void checkTopology() {
+    unsigned nodes = numaNodeCount();
+    CHECK(nodes >= 1);
+    int here = currentNumaNode();
+    CHECK(here >= 0 && static_cast<unsigned>(here) < nodes);
+    std::vector<unsigned> cpus = allowedCpus();
+    CHECK(!cpus.empty());
+    for (unsigned cpu : cpus) {
+        int node = numaNodeOfCpu(cpu);
+        CHECK(node >= 0 && static_cast<unsigned>(node) < nodes);
+    }
+#ifdef __linux__
+    if (!cpus.empty()) CHECK(pinCurrentThread(cpus[0]));
+#endif
+}
+
+int main() {
+    checkArena();
+    checkPooledArena();
+    checkTopology();
+    return testResult();
+}
@@ -0,0 +1,68 @@
+/**
+ * Shared program images: Buses built from one image run like a Bus loaded
+ * directly, and writes stay private to the Bus that made them.
+ */
+
+#include "test_util.h"
+#include "program_image.h"
+#include <vector>
+
+// Sums the ten words at DATA into 0x102, then overwrites DATA with zeros.
+static const char* SUM_PROGRAM =
+    "MOVI R1, data\n"
+    "MOVI R2, 10\n"
+    "MOVI R5, 1\n"
+    "MOVI R0, 0\n"
+    "sum:\n"
+    "LOAD R3, (R1)\n"
+    "ADD R0, R3\n"
+    "ADD R1, R5\n"
+    "SUB R2, R5\n"
+    "JZ store\n"
+    "JMP sum\n"
+    "store:\n"
+    "MOVI R4, 0x102\n"
+    "STORE R0, (R4)\n"
+    "MOVI R1, data\n"
+    "MOVI R2, 0\n"
+    "MOVI R3, 10\n"
+    "BFILL R1, R2, R3\n"
+    "HALT\n"
+    "data:\n"
+    ".WORD 1\n.WORD 2\n.WORD 3\n.WORD 4\n.WORD 5\n"
+    ".WORD 6\n.WORD 7\n.WORD 8\n.WORD 9\n.WORD 100\n";
+
+static void checkSharedImage() {
+    std::vector<uint16_t> words(MEMORY_SIZE, 0);
+    AssembleResult ar = assemble(SUM_PROGRAM, words.data(), MEMORY_SIZE);
+    CHECK(ar.ok);
+    ProgramImage image(words.data());
+#ifndef _WIN32
+    CHECK(image.shared());
+#endif
+
+    Bus first(image);
+    Bus second(image);
+    CHECK_EQ(second.getMemory()[0x102], 0);
+    GPRCPU cpu(first);
+    runToHalt(cpu);
+    CHECK_EQ(first.read(0x102), 145);
+
+    // Neither the other Bus nor the image saw the run's writes.
+    size_t changed = 0;
+    for (size_t a = 0; a < MEMORY_SIZE; ++a) {
+        changed += second.getMemory()[a] != words[a];
+        changed += image.words()[a] != words[a];
+    }
+    CHECK_EQ(changed, 0);
+
+    // The second Bus runs the untouched program to the same result.
+    GPRCPU other(second);
+    runToHalt(other);
+    CHECK_EQ(second.read(0x102), 145);
+}
+
+int main() {
+    checkSharedImage();
+    return testResult();
+}
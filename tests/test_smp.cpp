@@ -0,0 +1,62 @@
+/**
+ * SMP: cores incrementing one counter with CAS, CPUID and per-core stacks.
+ */
+
+#include "test_util.h"
+#include "smp.h"
+
+// Each core adds 1 to the word at 0x1F0 100 times with a CAS loop, then
+// stores its CPUID + 1 at 0x1C0 + CPUID and its SP at 0x180 + CPUID.
+static const char* COUNTER_PROGRAM =
+    "MOVI R6, 0x1F0\n"
+    "MOVI R5, 1\n"
+    "MOVI R4, 100\n"
+    "again:\n"
+    "LOAD R0, (R6)\n"
+    "retry:\n"
+    "MOV R2, R0\n"
+    "ADD R2, R5\n"
+    "CAS R0, (R6), R2\n"
+    "JZ ok\n"
+    "JMP retry\n"
+    "ok:\n"
+    "SUB R4, R5\n"
+    "JZ done\n"
+    "JMP again\n"
+    "done:\n"
+    "CPUID R3\n"
+    "MOVI R2, 0x1C0\n"
+    "ADD R2, R3\n"
+    "MOV R1, R3\n"
+    "ADD R1, R5\n"
+    "STORE R1, (R2)\n"
+    "MOVI R2, 0x180\n"
+    "ADD R2, R3\n"
+    "GETSP R1\n"
+    "STORE R1, (R2)\n"
+    "HALT\n";
+
+static void checkCounter(unsigned cores) {
+    Bus bus;
+    if (!assembleInto(bus, COUNTER_PROGRAM)) return;
+    SMPMachine machine(bus, cores);
+    machine.reset();
+    std::vector<size_t> cycles = machine.run(10000000);
+    CHECK_EQ(cycles.size(), cores);
+    CHECK_EQ(bus.read(0x1F0), 100 * cores);
+    for (unsigned i = 0; i < cores; ++i) {
+        CHECK(machine.core(i).getState().halted);
+        CHECK_EQ(bus.read(static_cast<uint16_t>(0x1C0 + i)), i + 1);
+        CHECK_EQ(bus.read(static_cast<uint16_t>(0x180 + i)), STACK_TOP - i * SMP_STACK_WORDS);
+    }
+}
+
+int main() {
+    checkCounter(1);
+    checkCounter(4);
+    checkCounter(16);
+    // The lowest stack ends at the floor, clear of the program and its data.
+    CHECK_EQ(SMP_MAX_CORES, 126);
+    CHECK(STACK_TOP - SMP_MAX_CORES * SMP_STACK_WORDS >= SMP_STACK_FLOOR);
+    return testResult();
+}
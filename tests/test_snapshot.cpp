@@ -0,0 +1,111 @@
+/**
+ * Snapshots: a run saved midway and resumed matches an uninterrupted run,
+ * timer state included; a damaged file is refused.
+ */
+
+#include "test_util.h"
+#include "snapshot.h"
+#include "timer.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Five periodic timer interrupts (every 100 cycles) while filling 0x180.. with a counter.
+// MOVI reaches only 0-511, so the vector and MMIO addresses are built with NOT.
+static const char* TIMER_PROGRAM =
+    "MOVI R1, handler\n"
+    "MOVI R2, 0x10F\n"
+    "NOT R2\n"
+    "STORE R1, (R2)\n"
+    "MOVI R2, 0xFE\n"
+    "NOT R2\n"
+    "MOVI R1, 100\n"
+    "STORE R1, (R2)\n"
+    "MOVI R2, 0xFF\n"
+    "NOT R2\n"
+    "MOVI R1, 7\n"
+    "STORE R1, (R2)\n"
+    "MOVI R5, 0\n"
+    "MOVI R6, 0x180\n"
+    "MOVI R1, 1\n"
+    "EI\n"
+    "work:\n"
+    "STORE R5, (R6)\n"
+    "ADD R6, R1\n"
+    "MOVI R3, 5\n"
+    "SUB R3, R5\n"
+    "JZ done\n"
+    "JMP work\n"
+    "done:\n"
+    "DI\n"
+    "HALT\n"
+    "handler:\n"
+    "PUSH R2\n"
+    "ADD R5, R1\n"
+    "MOVI R2, 0xFB\n"
+    "NOT R2\n"
+    "STORE R1, (R2)\n"
+    "POP R2\n"
+    "RETI\n";
+
+static void checkResume() {
+    // Uninterrupted reference run.
+    Bus refBus;
+    Timer refTimer;
+    refBus.attachDevice(0, &refTimer);
+    GPRCPU ref(refBus);
+    if (!assembleInto(refBus, TIMER_PROGRAM)) return;
+    size_t refCycles = runToHalt(ref);
+    CHECK_EQ(ref.getState().R[5], 5);
+
+    // Same program, saved after 250 cycles (mid-countdown, two interrupts in).
+    const std::string path = tempPath("gpr_test_snapshot.snp");
+    {
+        Bus bus;
+        Timer timer;
+        bus.attachDevice(0, &timer);
+        GPRCPU cpu(bus);
+        if (!assembleInto(bus, TIMER_PROGRAM)) return;
+        size_t first = cpu.runFor(250);
+        CHECK_EQ(first, 250);
+        SnapshotResult sr = saveSnapshot(path.c_str(), cpu, bus, first);
+        CHECK(sr.ok);
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(!bytes.empty() && bytes.size() < 2048);   // Zero pages left out
+
+    Bus bus;
+    Timer timer;
+    bus.attachDevice(0, &timer);
+    GPRCPU cpu(bus);
+    SnapshotResult lr = loadSnapshot(path.c_str(), cpu, bus);
+    CHECK(lr.ok);
+    CHECK_EQ(lr.cycles, 250);
+    size_t total = lr.cycles + runToHalt(cpu);
+    CHECK_EQ(total, refCycles);
+    for (unsigned r = 0; r < 8; ++r) CHECK_EQ(cpu.getState().R[r], ref.getState().R[r]);
+    size_t differing = 0;
+    for (size_t a = 0; a < MMIO_BASE; ++a) differing += bus.getMemory()[a] != refBus.getMemory()[a];
+    CHECK_EQ(differing, 0);
+
+    // Flip one byte: the checksum catches it and nothing is restored.
+    bytes[bytes.size() / 2] ^= 0x40;
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    Bus other;
+    GPRCPU fresh(other);
+    CHECK(!loadSnapshot(path.c_str(), fresh, other).ok);
+    CHECK_EQ(fresh.getState().PC, 0);
+    CHECK_EQ(other.getMemory()[0], 0);
+    std::remove(path.c_str());
+}
+
+int main() {
+    checkResume();
+    return testResult();
+}
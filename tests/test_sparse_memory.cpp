@@ -0,0 +1,64 @@
+/**
+ * Lazily allocated Bus memory: reads as zero, keeps what is written, and
+ * untouched Buses cost (almost) no resident memory.
+ */
+
+#include "test_util.h"
+#include <memory>
+#include <vector>
+
+#ifdef __linux__
+#include <fstream>
+#include <unistd.h>
+
+/** Resident set size of this process in bytes (0 if unknown). */
+static size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+#endif
+
+static void checkContents() {
+    Bus bus;
+    size_t nonzero = 0;
+    for (size_t a = 0; a < MEMORY_SIZE; ++a) nonzero += bus.getMemory()[a] != 0;
+    CHECK_EQ(nonzero, 0);
+
+    const uint16_t addresses[] = {0x0000, 0x00FF, 0x0100, 0x7FFF, 0xC123, 0xFEEF};
+    for (uint16_t a : addresses) bus.write(a, static_cast<uint16_t>(a ^ 0x5A5A));
+    for (uint16_t a : addresses) CHECK_EQ(bus.read(a), a ^ 0x5A5A);
+    CHECK_EQ(bus.writtenPageCount(), 5);   // 0x00FF and 0x0000 share page 0
+    CHECK(bus.isPageWritten(0xC1));
+    CHECK(!bus.isPageWritten(0xC2));
+
+    std::vector<uint16_t> image(MEMORY_SIZE, 0);
+    image[0x4000] = 0x1234;
+    Bus copy;
+    copy.loadMemory(image.data());
+    CHECK_EQ(copy.read(0x4000), 0x1234);
+    bus.clearMemory();
+    for (uint16_t a : addresses) CHECK_EQ(bus.read(a), 0);
+}
+
+static void checkResidentCost() {
+#ifdef __linux__
+    // 512 Buses would be 64 MiB if allocated up front; each touching one word stays far below.
+    size_t before = residentBytes();
+    std::vector<std::unique_ptr<Bus>> buses;
+    for (unsigned i = 0; i < 512; ++i) {
+        buses.emplace_back(new Bus());
+        buses.back()->write(0x100, static_cast<uint16_t>(i));
+    }
+    size_t grown = residentBytes() - before;
+    CHECK(grown < (16u << 20));
+    CHECK_EQ(buses[300]->read(0x100), 300);
+#endif
+}
+
+int main() {
+    checkContents();
+    checkResidentCost();
+    return testResult();
+}
@@ -0,0 +1,83 @@
+/**
+ * 16-bit GPR CPU Emulator - Test Helpers
+ * Every tests/test_*.cpp is its own executable, run by ctest. CHECK()
+ * prints each failed condition and keeps going, so one run shows every
+ * failure; main() ends with `return testResult();`.
+ */
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include "gpr_cpu.h"
+#include "assembler.h"
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+inline int testFailures = 0;
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++testFailures;                                                           \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                    \
+    do {                                                                              \
+        const long long a_ = static_cast<long long>(actual);                          \
+        const long long e_ = static_cast<long long>(expected);                        \
+        if (a_ != e_) {                                                               \
+            std::fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, \
+                         #actual, a_, e_);                                            \
+            ++testFailures;                                                           \
+        }                                                                             \
+    } while (0)
+
+/** Exit status for main(): 0 if every CHECK held. */
+inline int testResult() {
+    if (testFailures) std::fprintf(stderr, "%d check(s) failed\n", testFailures);
+    return testFailures ? 1 : 0;
+}
+
+/** `name` in the system's temporary directory. */
+inline std::string tempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+/** Assemble `source` into `bus`'s memory; a failure is reported as a failed check. */
+inline bool assembleInto(Bus& bus, const std::string& source, const AssembleOptions& options = AssembleOptions()) {
+    AssembleResult ar = assemble(source, bus.getMemory(), MEMORY_SIZE, options);
+    if (!ar.ok) {
+        std::fprintf(stderr, "assembly failed at line %zu: %s\n", ar.lineNum, ar.error.c_str());
+        ++testFailures;
+    }
+    return ar.ok;
+}
+
+/**
+ * Address of the first word in `bus` equal to what `line` assembles to,
+ * e.g. the instruction behind a label. MEMORY_SIZE if there is none.
+ */
+inline size_t findInstruction(Bus& bus, const std::string& line) {
+    Bus scratch;
+    if (!assembleInto(scratch, line)) return MEMORY_SIZE;
+    const uint16_t word = scratch.getMemory()[0];
+    const uint16_t* mem = bus.getMemory();
+    size_t address = 0;
+    while (address < MEMORY_SIZE && mem[address] != word) ++address;
+    return address;
+}
+
+/** Run `cpu` to HALT, giving up after `maxCycles`. Returns the cycles run. */
+inline size_t runToHalt(GPRCPU& cpu, size_t maxCycles = 1000000) {
+    size_t cycles = cpu.runFor(maxCycles);
+    if (!cpu.getState().halted) {
+        std::fprintf(stderr, "program did not halt within %zu cycles (PC 0x%04x)\n", maxCycles, cpu.getState().PC);
+        ++testFailures;
+    }
+    return cycles;
+}
+
+#endif // TEST_UTIL_H